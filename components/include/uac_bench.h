@@ -0,0 +1,69 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "sdkconfig.h"
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief One kernel to time, a call processes the same amount of data every time
+ *
+ */
+typedef struct {
+    const char *name;                            /*!< JSON key, must stay valid */
+    void (*run)(void *ctx);                      /*!< one call of the kernel */
+    void *ctx;                                   /*!< passed to run, holds the buffers and positions */
+    uint32_t frames;                             /*!< frames, or items, processed per call */
+    uint32_t bytes;                              /*!< bytes read plus bytes written per call */
+} uac_bench_case_t;
+
+/**
+ * @brief Fill a buffer with reproducible pseudo random data, xorshift32.
+ *
+ * @param buf Buffer to fill
+ * @param len Bytes to fill
+ * @param state Seed on the first call, advanced so consecutive buffers differ
+ */
+void uac_bench_fill(void *buf, size_t len, uint32_t *state);
+
+/**
+ * @brief Time the component kernels and the given application kernels, report as JSON.
+ *
+ * The component kernels are the capture and loopback ring copies, the TinyUSB FIFO of the OUT endpoint and,
+ * with CONFIG_UAC_MIC_RESAMPLER, the capture resampler for 16-bit and 32-bit samples on a filter state of its
+ * own, so a running IN stream is not disturbed. Every case is timed iterations times with the CPU cycle counter
+ * of the calling core, the fastest call gives ns_per_frame and bytes_per_s, the mean shows preemption:
+ *
+ * {"cpu_mhz", "iterations", "seed", "kernels": {name: {"frames", "bytes", "ns_per_frame", "ns_per_frame_mean",
+ * "bytes_per_s"}...}}
+ *
+ * Blocks the calling task for the whole run and yields between cases. Run it below the audio task priorities.
+ *
+ * @param cases Application kernels, NULL if num_cases is 0
+ * @param num_cases Number of application kernels
+ * @param iterations Calls per case
+ * @param seed Seed of the component kernel inputs, the same seed gives the same data
+ * @param json Output buffer
+ * @param size Size of json
+ * @return
+ *       - ESP_OK on success
+ *       - ESP_ERR_INVALID_ARG if iterations is 0 or json is NULL
+ *       - ESP_ERR_NO_MEM if the buffers cannot be allocated
+ *       - ESP_ERR_INVALID_SIZE if json is too small for the report, the error log gives the size needed
+ */
+esp_err_t uac_bench_run(const uac_bench_case_t *cases, size_t num_cases, uint32_t iterations, uint32_t seed,
+                        char *json, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
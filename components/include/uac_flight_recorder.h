@@ -0,0 +1,117 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "usb_device_uac.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Recorded stream direction
+ *
+ */
+typedef enum {
+    UAC_RECORDER_OUT = 0,                        /*!< playback, as handed to the output callback */
+    UAC_RECORDER_IN,                             /*!< capture, as returned by the input callback */
+    UAC_RECORDER_STREAM_NUM,
+} uac_recorder_stream_t;
+
+/**
+ * @brief Contents of one frozen stream
+ *
+ */
+typedef struct {
+    uac_format_t format;                         /*!< format of the last recorded block */
+    uint32_t bytes;                              /*!< recorded bytes available for reading */
+    uint64_t first_sample_pos;                   /*!< sample position of the first recorded frame */
+    uint32_t lost_bytes;                         /*!< bytes skipped because the writer task fell behind */
+} uac_recorder_stream_info_t;
+
+/**
+ * @brief Flight recorder state
+ *
+ */
+typedef struct {
+    bool frozen;                                 /*!< buffer is frozen and can be read */
+    uint32_t reason;                             /*!< reason passed to uac_recorder_trigger() */
+    int64_t trigger_time_us;                     /*!< esp_timer time of the trigger */
+    uac_recorder_stream_info_t stream[UAC_RECORDER_STREAM_NUM];
+} uac_recorder_info_t;
+
+/**
+ * @brief Freeze the flight recorder, keeping the last CONFIG_UAC_FLIGHT_RECORDER_SECONDS of both directions.
+ *
+ * Safe to call from any task. Data staged before the trigger is still written to PSRAM, the buffer is frozen
+ * once that completes. Further triggers are ignored until uac_recorder_rearm().
+ *
+ * @param reason Application defined reason, reported in uac_recorder_info_t
+ * @return
+ *       - ESP_OK on success
+ *       - ESP_ERR_INVALID_STATE if the recorder is not running
+ */
+esp_err_t uac_recorder_trigger(uint32_t reason);
+
+/**
+ * @brief Discard the frozen recording and start recording again.
+ *
+ * @return
+ *       - ESP_OK on success
+ *       - ESP_ERR_INVALID_STATE if the recorder is not initialized, not frozen or a read is open
+ */
+esp_err_t uac_recorder_rearm(void);
+
+/**
+ * @brief Get the recorder state.
+ *
+ * @param info Pointer to the info structure to fill
+ * @return
+ *       - ESP_OK on success
+ *       - ESP_ERR_INVALID_ARG if info is NULL
+ *       - ESP_ERR_INVALID_STATE if the recorder is not initialized
+ */
+esp_err_t uac_recorder_get_info(uac_recorder_info_t *info);
+
+/**
+ * @brief Keep the frozen recording until uac_recorder_read_end(), for a download made of several reads.
+ *
+ * uac_recorder_rearm() fails while a read is open. Every successful call needs one uac_recorder_read_end().
+ *
+ * @return
+ *       - ESP_OK on success
+ *       - ESP_ERR_INVALID_STATE if the recorder is not initialized or not frozen
+ */
+esp_err_t uac_recorder_read_begin(void);
+
+/**
+ * @brief End a read opened with uac_recorder_read_begin().
+ */
+void uac_recorder_read_end(void);
+
+/**
+ * @brief Read a frozen recording in chronological order.
+ *
+ * @param stream Stream to read
+ * @param offset Byte offset from the oldest recorded byte
+ * @param buf Destination buffer
+ * @param len Bytes to read
+ * @param bytes_read Returned number of bytes copied, 0 past the end of the recording
+ * @return
+ *       - ESP_OK on success
+ *       - ESP_ERR_INVALID_ARG if an argument is invalid
+ *       - ESP_ERR_INVALID_STATE if the recorder is not frozen
+ */
+esp_err_t uac_recorder_read(uac_recorder_stream_t stream, uint32_t offset, void *buf, size_t len, size_t *bytes_read);
+
+#ifdef __cplusplus
+}
+#endif
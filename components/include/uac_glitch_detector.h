@@ -0,0 +1,72 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define UAC_GLITCH_STREAM_OUT   0                /*!< playback */
+#define UAC_GLITCH_STREAM_IN    1                /*!< capture */
+#define UAC_GLITCH_STREAM_NUM   2
+
+/**
+ * @brief Detected event type, the meaning of uac_glitch_event_t::value is given per type
+ *
+ */
+typedef enum {
+    UAC_GLITCH_SHORT_PACKET = 0,                 /*!< fewer bytes than required were available, value: missing bytes */
+    UAC_GLITCH_LATE_PACKET,                      /*!< packet or capture block arrived late, value: interval in us */
+    UAC_GLITCH_FIFO_FLUSH,                       /*!< OUT FIFO was flushed while streaming and refilled with silence, value: gap in us */
+    UAC_GLITCH_OVERRUN,                          /*!< a block was replaced before it was consumed, value: 0 */
+    UAC_GLITCH_ZERO_RUN,                         /*!< exact digital silence inside running audio, value: frames */
+    UAC_GLITCH_JUMP,                             /*!< sample step above CONFIG_UAC_GLITCH_JUMP_THRESHOLD, value: step */
+    UAC_GLITCH_TYPE_NUM,
+} uac_glitch_type_t;
+
+/**
+ * @brief Detector event
+ *
+ */
+typedef struct {
+    uint32_t seq;                                /*!< sequence number, increments by one per event */
+    uint8_t type;                                /*!< uac_glitch_type_t */
+    uint8_t stream;                              /*!< UAC_GLITCH_STREAM_OUT or UAC_GLITCH_STREAM_IN */
+    uint16_t channel;                            /*!< channel of a sample jump, 0 otherwise */
+    uint32_t sof_frame;                          /*!< USB SOF frame count when detected */
+    int64_t timestamp_us;                        /*!< esp_timer time when detected */
+    uint64_t sample_pos;                         /*!< stream position of the affected frame */
+    int32_t value;                               /*!< type specific, see uac_glitch_type_t */
+} uac_glitch_event_t;
+
+/**
+ * @brief Read events from the lock-free event log.
+ *
+ * The log keeps the most recent CONFIG_UAC_GLITCH_LOG_LEN events, older events are skipped.
+ * Safe to call from any task, writers are never blocked by readers.
+ *
+ * @param cursor In: sequence number of the next event to read, start with 0. Out: position after the last event returned
+ * @param events Destination array
+ * @param max_events Size of the destination array
+ * @return Number of events copied
+ */
+size_t uac_glitch_read(uint32_t *cursor, uac_glitch_event_t *events, size_t max_events);
+
+/**
+ * @brief Get the number of events per type and stream since boot.
+ *
+ * @param counts Destination, indexed [type][stream]
+ */
+void uac_glitch_get_counts(uint32_t counts[UAC_GLITCH_TYPE_NUM][UAC_GLITCH_STREAM_NUM]);
+
+#ifdef __cplusplus
+}
+#endif
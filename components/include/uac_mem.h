@@ -0,0 +1,77 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "sdkconfig.h"
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Alignment of every arena allocation. A whole number of cache lines, so DMA cache maintenance
+ *        on one buffer never touches a neighbour.
+ */
+#if CONFIG_CACHE_L1_CACHE_LINE_SIZE > 16
+#define UAC_MEM_ALIGN           CONFIG_CACHE_L1_CACHE_LINE_SIZE
+#else
+#define UAC_MEM_ALIGN           16
+#endif
+
+/**
+ * @brief Allocate a zeroed buffer from the hot arena in internal RAM.
+ *
+ * The arena is a static block of CONFIG_UAC_HOT_ARENA_SIZE bytes that is never placed in PSRAM, whatever
+ * the SPIRAM malloc settings are. Start and size are rounded to UAC_MEM_ALIGN and the memory is DMA capable.
+ * If the arena is exhausted the buffer comes from the internal DMA capable heap instead, which the boot
+ * report shows. Arena memory is never freed.
+ *
+ * @param name Name for the boot report, must stay valid
+ * @param size Bytes to allocate
+ * @return Buffer, NULL if no internal memory is left
+ */
+void *uac_mem_alloc(const char *name, size_t size);
+
+/**
+ * @brief Create a task with stack and TCB in the hot arena.
+ *
+ * @param core Core to pin the task to, tskNO_AFFINITY for none
+ * @return
+ *       - ESP_OK on success
+ *       - ESP_ERR_NO_MEM if neither the arena nor the internal heap can hold the stack
+ */
+esp_err_t uac_mem_create_task(TaskFunction_t fn, const char *name, uint32_t stack_size, void *arg,
+                              UBaseType_t priority, TaskHandle_t *handle, BaseType_t core);
+
+/**
+ * @brief List a buffer allocated elsewhere in the boot report, e.g. driver DMA buffers or static buffers.
+ */
+void uac_mem_note(const char *name, const void *ptr, size_t size);
+
+/**
+ * @brief Write back a buffer the CPU has filled before a DMA engine reads it. No-op where internal RAM is not cached.
+ */
+esp_err_t uac_mem_sync_for_device(void *ptr, size_t size);
+
+/**
+ * @brief Invalidate a buffer a DMA engine has filled before the CPU reads it. No-op where internal RAM is not cached.
+ */
+esp_err_t uac_mem_sync_for_cpu(void *ptr, size_t size);
+
+/**
+ * @brief Log where every hot buffer and task stack lives and how much of the arena is used.
+ */
+void uac_mem_report(void);
+
+#ifdef __cplusplus
+}
+#endif
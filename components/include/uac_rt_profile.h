@@ -0,0 +1,49 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+
+/**
+ * @brief Core and priority of every task on the audio path.
+ *
+ * With CONFIG_UAC_RT_PROFILE the USB servicing and the audio tasks own CONFIG_UAC_RT_AUDIO_CORE and run above
+ * every other application task, TinyUSB first since it feeds both directions. Control work (SPI API, flight
+ * recorder writer, codec control requests from the application) runs on the other core below them, so a long
+ * control request can never preempt audio. Without the profile the individual menuconfig settings apply to the
+ * USB tasks, control tasks float between the cores and the audio helpers stay on core 0.
+ */
+#if CONFIG_UAC_RT_PROFILE
+#define UAC_RT_AUDIO_CORE               CONFIG_UAC_RT_AUDIO_CORE
+#define UAC_RT_CONTROL_CORE             (1 - CONFIG_UAC_RT_AUDIO_CORE)
+
+#define UAC_TINYUSB_TASK_PRIORITY       (configMAX_PRIORITIES - 3)
+#define UAC_TINYUSB_TASK_CORE           UAC_RT_AUDIO_CORE
+#define UAC_SPK_TASK_PRIORITY           (configMAX_PRIORITIES - 4)
+#define UAC_SPK_TASK_CORE               UAC_RT_AUDIO_CORE
+#define UAC_MIC_TASK_PRIORITY           (configMAX_PRIORITIES - 4)
+#define UAC_MIC_TASK_CORE               UAC_RT_AUDIO_CORE
+#define UAC_AUDIO_AUX_TASK_PRIORITY     (configMAX_PRIORITIES - 5)    /*!< application audio helpers, e.g. a monitor mixer */
+#define UAC_CONTROL_TASK_PRIORITY       5
+#define UAC_CONTROL_TASK_CORE           UAC_RT_CONTROL_CORE
+#define UAC_BACKGROUND_TASK_PRIORITY    2                             /*!< bulk work such as the flight recorder writer */
+#else
+#define UAC_RT_AUDIO_CORE               0
+#define UAC_RT_CONTROL_CORE             1                             /*!< only where a core must be named, e.g. an ISR */
+
+#define UAC_TINYUSB_TASK_PRIORITY       CONFIG_UAC_TINYUSB_TASK_PRIORITY
+#define UAC_TINYUSB_TASK_CORE           (CONFIG_UAC_TINYUSB_TASK_CORE == -1 ? tskNO_AFFINITY : CONFIG_UAC_TINYUSB_TASK_CORE)
+#define UAC_SPK_TASK_PRIORITY           CONFIG_UAC_SPK_TASK_PRIORITY
+#define UAC_SPK_TASK_CORE               (CONFIG_UAC_SPK_TASK_CORE == -1 ? tskNO_AFFINITY : CONFIG_UAC_SPK_TASK_CORE)
+#define UAC_MIC_TASK_PRIORITY           CONFIG_UAC_MIC_TASK_PRIORITY
+#define UAC_MIC_TASK_CORE               (CONFIG_UAC_MIC_TASK_CORE == -1 ? tskNO_AFFINITY : CONFIG_UAC_MIC_TASK_CORE)
+#define UAC_AUDIO_AUX_TASK_PRIORITY     6
+#define UAC_CONTROL_TASK_PRIORITY       5
+#define UAC_CONTROL_TASK_CORE           tskNO_AFFINITY
+#define UAC_BACKGROUND_TASK_PRIORITY    2
+#endif
@@ -0,0 +1,134 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include "sdkconfig.h"
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Trace point identifiers, names are resolved by tools/uac_trace_to_perfetto.py
+ *
+ */
+typedef enum {
+    UAC_TRACE_SPK_RX_CB = 0,                     /*!< tud_audio_rx_done_post_read_cb */
+    UAC_TRACE_MIC_TX_CB,                         /*!< tud_audio_tx_done_pre_load_cb */
+    UAC_TRACE_SPK_TASK,                          /*!< usb_spk_task, one playback block */
+    UAC_TRACE_MIC_TASK,                          /*!< usb_mic_task, one capture block */
+    UAC_TRACE_I2S_READ,                          /*!< i2s_channel_read */
+    UAC_TRACE_I2S_WRITE,                         /*!< i2s_channel_write */
+    UAC_TRACE_SPI_API,                           /*!< spi_api worker, one request */
+    UAC_TRACE_USER_BASE = 32,                    /*!< first id free for the application */
+} uac_trace_id_t;
+
+/**
+ * @brief Trace record phase
+ *
+ */
+typedef enum {
+    UAC_TRACE_PHASE_BEGIN = 0,
+    UAC_TRACE_PHASE_END,
+    UAC_TRACE_PHASE_INSTANT,
+} uac_trace_phase_t;
+
+/**
+ * @brief One trace record as stored in the per-core rings
+ *
+ */
+typedef struct {
+    uint32_t cycles;                             /*!< CPU cycle counter of the recording core */
+    uint8_t id;                                  /*!< uac_trace_id_t */
+    uint8_t phase;                               /*!< uac_trace_phase_t */
+    uint16_t arg;                                /*!< trace point specific, e.g. bytes or request type */
+} uac_trace_record_t;
+
+#define UAC_TRACE_DUMP_MAGIC    0x43525455       /*!< "UTRC" */
+#define UAC_TRACE_DUMP_VERSION  1
+#define UAC_TRACE_MAX_CORES     2
+
+/**
+ * @brief Per-core part of the dump header
+ *
+ */
+typedef struct {
+    uint32_t anchor_cycles;                      /*!< cycle counter of the core ... */
+    int64_t anchor_us;                           /*!< ... taken together with this esp_timer time */
+    uint32_t records;                            /*!< records of this core in the dump */
+    uint32_t lost;                               /*!< records overwritten before the dump */
+} __attribute__((packed)) uac_trace_core_info_t;
+
+/**
+ * @brief Dump header, followed by the records of core 0, then core 1, each in chronological order
+ *
+ */
+typedef struct {
+    uint32_t magic;                              /*!< UAC_TRACE_DUMP_MAGIC */
+    uint16_t version;                            /*!< UAC_TRACE_DUMP_VERSION */
+    uint16_t num_cores;
+    uint32_t cpu_hz;                             /*!< cycle counter frequency */
+    uac_trace_core_info_t core[UAC_TRACE_MAX_CORES];
+} __attribute__((packed)) uac_trace_dump_header_t;
+
+#if CONFIG_UAC_TRACE
+/**
+ * @brief Store a record in the ring of the calling core. Lock-free, callable from tasks and ISRs.
+ */
+void uac_trace_record(uac_trace_id_t id, uac_trace_phase_t phase, uint16_t arg);
+
+#define UAC_TRACE_BEGIN(id, arg)    uac_trace_record((id), UAC_TRACE_PHASE_BEGIN, (arg))
+#define UAC_TRACE_END(id, arg)      uac_trace_record((id), UAC_TRACE_PHASE_END, (arg))
+#define UAC_TRACE_INSTANT(id, arg)  uac_trace_record((id), UAC_TRACE_PHASE_INSTANT, (arg))
+
+/**
+ * @brief Stop recording and prepare a dump of the rings.
+ *
+ * Recording stays stopped until uac_trace_resume(), so the dump is consistent while it is read.
+ *
+ * @param dump_size Returned size of the dump in bytes, header included
+ * @return
+ *       - ESP_OK on success
+ *       - ESP_ERR_INVALID_ARG if dump_size is NULL
+ */
+esp_err_t uac_trace_freeze(size_t *dump_size);
+
+/**
+ * @brief Read the frozen dump.
+ *
+ * @param offset Byte offset into the dump
+ * @param buf Destination buffer
+ * @param len Bytes to read
+ * @param bytes_read Returned number of bytes copied, 0 past the end of the dump
+ * @return
+ *       - ESP_OK on success
+ *       - ESP_ERR_INVALID_ARG if an argument is NULL
+ *       - ESP_ERR_INVALID_STATE if the trace is not frozen
+ */
+esp_err_t uac_trace_read(uint32_t offset, void *buf, size_t len, size_t *bytes_read);
+
+/**
+ * @brief Clear the rings and start recording again.
+ *
+ * @return
+ *       - ESP_OK on success
+ */
+esp_err_t uac_trace_resume(void);
+
+#else
+#define UAC_TRACE_BEGIN(id, arg)    do { } while (0)
+#define UAC_TRACE_END(id, arg)      do { } while (0)
+#define UAC_TRACE_INSTANT(id, arg)  do { } while (0)
+#endif
+
+#ifdef __cplusplus
+}
+#endif
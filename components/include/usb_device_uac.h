@@ -14,10 +14,65 @@
 extern "C" {
 #endif
 
+/**
+ * @brief Sample format of an audio block
+ *
+ */
+typedef struct {
+    uint32_t sample_rate;                        /*!< frames per second */
+    uint8_t channels;                            /*!< interleaved channels per frame */
+    uint8_t bits_per_sample;                     /*!< resolution of the active alternate setting */
+    uint8_t bytes_per_frame;                     /*!< channels * bytes per sample */
+} uac_format_t;
+
+#define UAC_BLOCK_FLAG_DISCONTINUITY    (1 << 0) /*!< first block of a stream, or data before this block was discarded */
+
+/**
+ * @brief Frame based audio block, passed to the v2 data callbacks
+ *
+ */
+typedef struct {
+    const uac_format_t *format;                  /*!< format of the samples in data */
+    void *data;                                  /*!< interleaved samples */
+    size_t frames;                               /*!< number of frames in data, for input the capacity of data */
+    uint64_t sample_pos;                         /*!< stream position of the first frame, increases monotonically over the device lifetime */
+    uint32_t sof_frame;                          /*!< USB SOF frame count at arrival (output) or when the block was requested (input) */
+    int64_t timestamp_us;                        /*!< esp_timer time matching sof_frame */
+    uint32_t flags;                              /*!< UAC_BLOCK_FLAG_x */
+} uac_block_t;
+
+typedef struct uac_subscriber_s *uac_subscriber_handle_t;
+
+/**
+ * @brief Range of a volume control, in 1/256 dB
+ *
+ */
+typedef struct {
+    int16_t min;                                 /*!< lowest volume */
+    int16_t max;                                 /*!< highest volume */
+    int16_t res;                                 /*!< step between volumes */
+} uac_volume_range_t;
+
+/**
+ * @brief Feature unit a control request is addressed to
+ *
+ */
+typedef enum {
+    UAC_FEATURE_UNIT_SPK = 0,                    /*!< speaker path, USB OUT to the output */
+    UAC_FEATURE_UNIT_MIC,                        /*!< microphone path, input to USB IN */
+    UAC_FEATURE_UNIT_NUM,
+} uac_feature_unit_t;
+
 typedef esp_err_t (*uac_output_cb_t)(uint8_t *buf, size_t len, void *cb_ctx);
 typedef esp_err_t (*uac_input_cb_t)(uint8_t *buf, size_t len, size_t *bytes_read, void *cb_ctx);
 typedef void (*uac_set_mute_cb_t)(uint32_t mute, void *cb_ctx);
 typedef void (*uac_set_volume_cb_t)(uint32_t volume, void *cb_ctx);
+typedef esp_err_t (*uac_output_block_cb_t)(const uac_block_t *block, void *cb_ctx);
+typedef esp_err_t (*uac_input_block_cb_t)(uac_block_t *block, size_t *frames_read, void *cb_ctx);
+typedef void (*uac_set_monitor_cb_t)(uint8_t in_ch, uint8_t out_ch, int16_t gain, void *cb_ctx);
+typedef void (*uac_set_agc_cb_t)(uac_feature_unit_t unit, uint8_t channel, bool enable, void *cb_ctx);
+typedef void (*uac_set_fu_mute_cb_t)(uac_feature_unit_t unit, uint8_t channel, bool mute, void *cb_ctx);
+typedef void (*uac_set_fu_volume_cb_t)(uac_feature_unit_t unit, uint8_t channel, int16_t volume, void *cb_ctx);
 
 /**
  * @brief USB UAC Device Config
@@ -27,8 +82,16 @@ typedef struct  {
     bool skip_tinyusb_init;                      /*!< if true, the Tinyusb and usb phy will not be initialized */
     uac_output_cb_t output_cb;                   /*!< callback function for UAC data output, if NULL, output will be disabled */
     uac_input_cb_t input_cb;                     /*!< callback function for UAC data input, if NULL, input will be disabled */
+    uac_output_block_cb_t output_block_cb;       /*!< frame based output callback with position and timestamp, takes precedence over output_cb */
+    uac_input_block_cb_t input_block_cb;         /*!< frame based input callback with position and timestamp, takes precedence over input_cb */
     uac_set_mute_cb_t set_mute_cb;               /*!< callback function for set mute, if NULL, the set mute request will be ignored */
-    uac_set_volume_cb_t set_volume_cb;           /*!< callback function for set volume, if NULL, the set volume request will be ignored */
+    uac_set_volume_cb_t set_volume_cb;           /*!< callback function for set volume as 0 .. 100 percent of the speaker volume range, for all channels, if NULL, the set volume request will be ignored */
+    uac_set_monitor_cb_t set_monitor_cb;         /*!< callback function for the monitor mixer crosspoints (mic in_ch to speaker out_ch, gain in 1/256 dB), if NULL, the mixer requests will be ignored */
+    uac_set_fu_mute_cb_t set_fu_mute_cb;         /*!< callback function for the mute of a feature unit channel (0 master), speaker requests go to set_mute_cb instead if that is set */
+    uac_set_fu_volume_cb_t set_fu_volume_cb;     /*!< callback function for the volume of a feature unit channel (0 master) in 1/256 dB, speaker requests go to set_volume_cb instead if that is set */
+    uac_volume_range_t spk_volume_range;         /*!< range of the speaker volume control, if all 0, -50 .. 0 dB in 1 dB steps */
+    uac_volume_range_t mic_volume_range;         /*!< range of the microphone volume control, if all 0, -50 .. 0 dB in 1 dB steps */
+    uac_set_agc_cb_t set_agc_cb;                 /*!< callback function for the automatic gain control of a feature unit channel (0 all channels), if NULL, the AGC requests will be ignored */
     void *cb_ctx;                                /*!< callback context, for user specific usage */
 #if CONFIG_USB_DEVICE_UAC_AS_PART
     int spk_itf_num;                             /*!< If CONFIG_USB_DEVICE_UAC_AS_PART is enabled, you need to provide the speaker interface number */
@@ -36,6 +99,96 @@ typedef struct  {
 #endif
 } uac_device_config_t;
 
+/**
+ * @brief USB UAC Device latency, as reported to the host
+ *
+ */
+typedef struct {
+    uint32_t spk_latency_ns;                     /*!< USB OUT packet to analog output, in ns */
+    uint32_t mic_latency_ns;                     /*!< analog input to USB IN packet, in ns */
+} uac_device_latency_t;
+
+/**
+ * @brief Tasks whose scheduling latency is measured
+ *
+ */
+typedef enum {
+    UAC_TASK_TINYUSB = 0,                        /*!< SOF handling delay beyond one frame */
+    UAC_TASK_SPK,                                /*!< OUT packet published to usb_spk_task running */
+    UAC_TASK_MIC,                                /*!< usb_mic_task wake up against its period schedule */
+    UAC_TASK_NUM,
+} uac_task_id_t;
+
+#define UAC_TASK_LATE_US    1000                 /*!< latency above one USB frame counts as late */
+
+/**
+ * @brief Scheduling latency of one task
+ *
+ */
+typedef struct {
+    uint32_t wakeups;                            /*!< measured wake ups */
+    uint32_t mean_us;                            /*!< mean latency */
+    uint32_t max_us;                             /*!< worst latency */
+    uint32_t late;                               /*!< wake ups later than UAC_TASK_LATE_US */
+} uac_task_latency_t;
+
+/**
+ * @brief Digital loopback mode. The USB OUT stream is returned on USB IN, the data callbacks are not called.
+ *
+ */
+typedef enum {
+    UAC_LOOPBACK_OFF = 0,                        /*!< normal operation through the data callbacks */
+    UAC_LOOPBACK_ON,                             /*!< OUT data returned unchanged */
+    UAC_LOOPBACK_CRC,                            /*!< as ON, the last frame of every 1 ms of IN data carries the CRC32 of the frames before it */
+} uac_loopback_mode_t;
+
+#define UAC_VENDOR_REQ_LOOPBACK 0x4C             /*!< vendor request to the device: OUT sets wValue as mode, IN returns uac_loopback_stats_t, wValue 1 resets */
+
+/**
+ * @brief Loopback statistics since the mode was set or the last reset
+ *
+ */
+typedef struct {
+    uint32_t mode;                               /*!< uac_loopback_mode_t */
+    uint32_t blocks;                             /*!< OUT blocks looped back */
+    uint32_t bytes;                              /*!< OUT bytes looped back, wraps */
+    uint32_t underruns;                          /*!< IN blocks sent as silence for lack of OUT data */
+    uint32_t overruns;                           /*!< OUT blocks dropped because IN did not drain */
+    uint32_t format_mismatch;                    /*!< OUT blocks dropped because the sample size of IN differs */
+    uint32_t latency_mean_us;                    /*!< OUT packet arrival to the data being queued for IN */
+    uint32_t latency_max_us;
+    uint32_t jitter_max_us;                      /*!< largest deviation of the OUT packet spacing from its nominal duration */
+} uac_loopback_stats_t;
+
+/**
+ * @brief Capture stream statistics since the mic interface was opened or the last reset
+ *
+ */
+typedef struct {
+    uint32_t packets;                            /*!< IN packets sent while streaming */
+    uint32_t short_packets;                      /*!< IN packets below the servo size for lack of capture data, empty ones included */
+    uint32_t underruns;                          /*!< times the capture ring ran dry, the stream is primed again after each */
+    uint32_t overruns;                           /*!< capture blocks dropped because the ring was full */
+    uint32_t frames_min;                         /*!< smallest full IN packet, in frames */
+    uint32_t frames_max;                         /*!< largest IN packet, in frames */
+    uint32_t rate_mhz;                           /*!< capture rate measured against the USB frame clock, in mHz */
+    uint32_t fill_frames;                        /*!< mean capture ring fill over the last servo period */
+    uint32_t margin_ms;                          /*!< ring fill kept ahead of a capture period, grows by 1 ms per underrun */
+    uint32_t resampling;                         /*!< 1 while the capture data is resampled to the USB clock */
+    uint32_t resampler_dropped;                  /*!< capture frames the resampler had no room for */
+} uac_mic_stats_t;
+
+/**
+ * @brief The host frame clock, one SOF timestamp per measurement window
+ *
+ */
+typedef struct {
+    uint32_t epoch;                              /*!< incremented when the SOF count restarts (bus reset, suspend, speed change) */
+    uint32_t frames;                             /*!< SOF periods from the start of the epoch to the timestamped SOF */
+    int64_t time_us;                             /*!< esp_timer time of that SOF */
+    uint32_t period_us;                          /*!< SOF period, 1000 at full speed and 125 at high speed */
+} uac_sof_time_t;
+
 /**
  * @brief Initialize the USB Audio Class (UAC) device.
  *
@@ -46,6 +199,183 @@ typedef struct  {
  */
 esp_err_t uac_device_init(uac_device_config_t *config);
 
+/**
+ * @brief Set the latency of the audio path behind the UAC callbacks.
+ *
+ * The device adds its own USB buffering and reports the sum through the UAC2 terminal latency controls.
+ * Call again whenever the codec or I2S configuration changes.
+ *
+ * @param spk_frames Frames between output_cb and the analog output (filters, DMA queue)
+ * @param mic_frames Frames between the analog input and input_cb (filters, DMA buffer)
+ * @return
+ *       - ESP_OK on success
+ *       - ESP_ERR_INVALID_STATE if the device is not initialized
+ */
+esp_err_t uac_device_set_path_latency(uint32_t spk_frames, uint32_t mic_frames);
+
+/**
+ * @brief Set the controls a feature unit channel reports to the host, the callbacks are not called.
+ *
+ * For settings the application restored, call it after uac_device_init, before the host reads the controls.
+ *
+ * @param unit Feature unit
+ * @param channel Channel number, 0 is the master control
+ * @param mute Mute control
+ * @param volume Volume control in 1/256 dB, clamped to the volume range of the unit
+ * @param agc Automatic gain control
+ * @return
+ *       - ESP_OK on success
+ *       - ESP_ERR_INVALID_ARG if the unit or channel does not exist
+ *       - ESP_ERR_INVALID_STATE if the device is not initialized
+ */
+esp_err_t uac_device_set_fu_state(uac_feature_unit_t unit, uint8_t channel, bool mute, int16_t volume, bool agc);
+
+/**
+ * @brief Get the total device latency for the active configuration.
+ *
+ * @param latency Pointer to the latency structure to fill
+ * @return
+ *       - ESP_OK on success
+ *       - ESP_ERR_INVALID_ARG if latency is NULL
+ *       - ESP_ERR_INVALID_STATE if the device is not initialized
+ */
+esp_err_t uac_device_get_latency(uac_device_latency_t *latency);
+
+/**
+ * @brief Get the scheduling latency of the USB and audio tasks since init or the last reset.
+ *
+ * @param stats Array of UAC_TASK_NUM entries, indexed by uac_task_id_t
+ * @param reset Start a new measurement after reading
+ * @return
+ *       - ESP_OK on success
+ *       - ESP_ERR_INVALID_ARG if stats is NULL
+ *       - ESP_ERR_INVALID_STATE if the device is not initialized
+ */
+esp_err_t uac_device_get_task_latency(uac_task_latency_t stats[UAC_TASK_NUM], bool reset);
+
+/**
+ * @brief Route the USB OUT stream back to USB IN, bypassing the data callbacks.
+ *
+ * Used to measure the USB stack on its own and to check bit-perfect transport. Channels present in both
+ * directions are copied, missing IN channels are zero; the sample size must match. While the loopback is on
+ * the output is muted through the speaker mute callback, leaving it restores the host mute setting. Also available to the
+ * host through the UAC_VENDOR_REQ_LOOPBACK vendor request.
+ *
+ * @param mode Loopback mode, the statistics are reset
+ * @return
+ *       - ESP_OK on success
+ *       - ESP_ERR_INVALID_ARG if mode is unknown
+ *       - ESP_ERR_INVALID_STATE if the device is not initialized
+ *       - ESP_ERR_NOT_SUPPORTED if CONFIG_UAC_LOOPBACK is disabled
+ */
+esp_err_t uac_device_set_loopback(uac_loopback_mode_t mode);
+
+/**
+ * @brief Get the loopback statistics.
+ *
+ * @param stats Statistics to fill
+ * @param reset Start a new measurement after reading
+ * @return
+ *       - ESP_OK on success
+ *       - ESP_ERR_INVALID_ARG if stats is NULL
+ *       - ESP_ERR_INVALID_STATE if the device is not initialized
+ *       - ESP_ERR_NOT_SUPPORTED if CONFIG_UAC_LOOPBACK is disabled
+ */
+esp_err_t uac_device_get_loopback_stats(uac_loopback_stats_t *stats, bool reset);
+
+/**
+ * @brief Check whether the host streams audio, e.g. to hold off flash writes that stall the cache.
+ *
+ * @return true while the speaker or the microphone interface is open, false if neither is or the device is
+ *         not initialized
+ */
+bool uac_device_is_streaming(void);
+
+/**
+ * @brief Get the capture stream statistics.
+ *
+ * Every IN packet carries the frames of one service interval, sized 47, 48 or 49 frames at 48 kHz so that the
+ * stream follows the measured capture rate. Short or empty packets are only sent when the capture ring runs dry;
+ * each underrun widens the margin kept in the ring by 1 ms, which the terminal latency control reports.
+ * With CONFIG_UAC_MIC_RESAMPLER the packets keep the nominal size and the capture data is resampled instead.
+ *
+ * @param stats Statistics to fill
+ * @param reset Start a new measurement after reading
+ * @return
+ *       - ESP_OK on success
+ *       - ESP_ERR_INVALID_ARG if stats is NULL
+ *       - ESP_ERR_INVALID_STATE if the device is not initialized
+ *       - ESP_ERR_NOT_SUPPORTED if the device has no microphone channels
+ */
+esp_err_t uac_device_get_mic_stats(uac_mic_stats_t *stats, bool reset);
+
+/**
+ * @brief Get the latest timestamp of the host frame clock.
+ *
+ * tud_sof_cb runs in the TinyUSB task, so every callback is late by the task latency but never early. The
+ * earliest callback of each 32 ms window, relative to the SOF count, is taken as the timestamp; comparing
+ * two of them measures the host clock against the local one to within a few microseconds.
+ *
+ * @param sof Timestamp to fill
+ * @return
+ *       - ESP_OK on success
+ *       - ESP_ERR_INVALID_ARG if sof is NULL
+ *       - ESP_ERR_INVALID_STATE if the device is not initialized or no window has completed yet
+ *       - ESP_ERR_NOT_SUPPORTED if TinyUSB callbacks are handled by the application (CONFIG_USB_DEVICE_UAC_AS_PART)
+ */
+esp_err_t uac_device_get_sof_time(uac_sof_time_t *sof);
+
+/**
+ * @brief Subscribe to the playback stream.
+ *
+ * Every block that reaches output_cb is also queued to each subscriber, without a copy. Blocks are read-only
+ * and go back to the pool when the last reader releases them. A subscriber that already has depth blocks
+ * queued or held misses the block; the count of missed blocks is reported by the next receive.
+ * The playback path never waits for a subscriber.
+ *
+ * @param depth Maximum number of blocks queued or held by this subscriber, reserved from CONFIG_UAC_SPK_POOL_BLOCKS
+ * @param ret_sub Returned subscriber handle
+ * @return
+ *       - ESP_OK on success
+ *       - ESP_ERR_INVALID_ARG if depth is 0 or ret_sub is NULL
+ *       - ESP_ERR_INVALID_STATE if the device is not initialized
+ *       - ESP_ERR_NO_MEM if no subscriber slot or not enough pool blocks are left
+ */
+esp_err_t uac_device_subscribe_output(uint32_t depth, uac_subscriber_handle_t *ret_sub);
+
+/**
+ * @brief Unsubscribe from the playback stream, queued blocks are released.
+ *
+ * @param sub Subscriber handle
+ * @return
+ *       - ESP_OK on success
+ *       - ESP_ERR_INVALID_ARG if sub is not subscribed
+ *       - ESP_ERR_INVALID_STATE if the subscriber still holds received blocks
+ */
+esp_err_t uac_device_unsubscribe_output(uac_subscriber_handle_t sub);
+
+/**
+ * @brief Wait for the next playback block.
+ *
+ * @param sub Subscriber handle
+ * @param block Returned block, must be passed to uac_subscriber_release() when done
+ * @param dropped If not NULL, returns the number of blocks missed since the previous receive
+ * @param timeout_ms Time to wait for a block
+ * @return
+ *       - ESP_OK on success
+ *       - ESP_ERR_INVALID_ARG if sub or block is NULL
+ *       - ESP_ERR_TIMEOUT if no block arrived in time
+ */
+esp_err_t uac_subscriber_receive(uac_subscriber_handle_t sub, const uac_block_t **block, uint32_t *dropped, uint32_t timeout_ms);
+
+/**
+ * @brief Release a block returned by uac_subscriber_receive().
+ *
+ * @param sub Subscriber handle
+ * @param block Block to release
+ */
+void uac_subscriber_release(uac_subscriber_handle_t sub, const uac_block_t *block);
+
 #ifdef __cplusplus
 }
 #endif
@@ -29,9 +29,6 @@ extern "C" {
 
 #define CFG_TUD_AUDIO_FUNC_1_DESC_LEN                                TUD_AUDIO_DEVICE_DESC_LEN
 
-// How many formats are used, need to adjust USB descriptor if changed
-#define CFG_TUD_AUDIO_FUNC_1_N_FORMATS                               1
-
 #define CFG_TUD_AUDIO_FUNC_1_MAX_SAMPLE_RATE                         DEFAULT_SAMPLE_RATE
 #define CFG_TUD_AUDIO_FUNC_1_N_CHANNELS_TX                           SPEAK_CHANNEL_NUM
 #define CFG_TUD_AUDIO_FUNC_1_N_CHANNELS_RX                           MIC_CHANNEL_NUM
@@ -42,23 +39,49 @@ extern "C" {
 #define CFG_TUD_AUDIO_FUNC_1_FORMAT_1_N_BYTES_PER_SAMPLE_RX          2
 #define CFG_TUD_AUDIO_FUNC_1_FORMAT_1_RESOLUTION_RX                  16
 
+// Formats of the speaker (TX) and mic (RX) streaming interfaces, X(alt, bytes per sample, resolution, ...) with
+// one alternate setting each. The descriptors, the endpoint sizes and the resolution tables are all expanded from
+// these lists, so a format is added here only. Format 1 must be the widest, the buffers are sized from it
+#define UAC_SPK_FORMATS(X, ...) \
+    X(1, CFG_TUD_AUDIO_FUNC_1_FORMAT_1_N_BYTES_PER_SAMPLE_TX, CFG_TUD_AUDIO_FUNC_1_FORMAT_1_RESOLUTION_TX, __VA_ARGS__)
+#define UAC_MIC_FORMATS(X, ...) \
+    X(1, CFG_TUD_AUDIO_FUNC_1_FORMAT_1_N_BYTES_PER_SAMPLE_RX, CFG_TUD_AUDIO_FUNC_1_FORMAT_1_RESOLUTION_RX, __VA_ARGS__)
+
+#define UAC_FORMAT_COUNT_X(...)                                      + 1
+#define UAC_SPK_N_FORMATS                                            (0 UAC_SPK_FORMATS(UAC_FORMAT_COUNT_X, 0))
+#define UAC_MIC_N_FORMATS                                            (0 UAC_MIC_FORMATS(UAC_FORMAT_COUNT_X, 0))
+
+// How many formats are used, the larger of both directions
+#define CFG_TUD_AUDIO_FUNC_1_N_FORMATS                               (UAC_SPK_N_FORMATS > UAC_MIC_N_FORMATS ? UAC_SPK_N_FORMATS : UAC_MIC_N_FORMATS)
+
+// Both data endpoints are serviced every 1 ms (bInterval 4 is 2^3 microframes at high speed)
+#define UAC_EP_INTERVAL                                              (TUD_OPT_HIGH_SPEED ? 4 : 1)
+// Largest packet of one service interval: the frames at the highest rate rounded up, plus the frame the host adds
+// while following the feedback (OUT) and the capture servo adds while draining its ring (IN). Exactly this much
+// isochronous bandwidth is reserved for an alternate setting, nothing is added for safety
+#define UAC_EP_FRAMES_MAX                                            ((CFG_TUD_AUDIO_FUNC_1_MAX_SAMPLE_RATE + 999) / 1000 + 1)
+#define UAC_EP_SZ(_channels, _bytes)                                 (UAC_EP_FRAMES_MAX * (_channels) * (_bytes))
+
 // EP and buffer size - for isochronous EP´s, the buffer and EP size are equal (different sizes would not make sense)
 #define CFG_TUD_AUDIO_ENABLE_EP_IN                1
 
 // MIC
-#define CFG_TUD_AUDIO_FUNC_1_FORMAT_1_EP_SZ_IN    ((CFG_TUD_AUDIO_FUNC_1_MAX_SAMPLE_RATE / 1000 * CFG_TUD_AUDIO_FUNC_1_FORMAT_1_N_BYTES_PER_SAMPLE_RX * CFG_TUD_AUDIO_FUNC_1_N_CHANNELS_RX) + 4)
+#define CFG_TUD_AUDIO_FUNC_1_FORMAT_1_EP_SZ_IN    UAC_EP_SZ(CFG_TUD_AUDIO_FUNC_1_N_CHANNELS_RX, CFG_TUD_AUDIO_FUNC_1_FORMAT_1_N_BYTES_PER_SAMPLE_RX)
 
-#define CFG_TUD_AUDIO_FUNC_1_EP_IN_SW_BUF_SZ      CFG_TUD_AUDIO_FUNC_1_FORMAT_1_EP_SZ_IN * (MIC_INTERVAL_MS + 1)
+// One packet is loaded per service interval by tud_audio_tx_done_pre_load_cb, sized from the capture rate,
+// so the FIFO only holds the packet in flight and the driver must send exactly what was loaded
+#define CFG_TUD_AUDIO_FUNC_1_EP_IN_SW_BUF_SZ      CFG_TUD_AUDIO_FUNC_1_FORMAT_1_EP_SZ_IN * 2
+#define CFG_TUD_AUDIO_EP_IN_FLOW_CONTROL          0
 #define CFG_TUD_AUDIO_FUNC_1_EP_IN_SZ_MAX         CFG_TUD_AUDIO_FUNC_1_FORMAT_1_EP_SZ_IN  // Maximum EP IN size for all AS alternate settings used
 
 // EP and buffer size - for isochronous EP´s, the buffer and EP size are equal (different sizes would not make sense)
 #define CFG_TUD_AUDIO_ENABLE_EP_OUT               1
 
-// SPK +4 for audio feedback
-#define CFG_TUD_AUDIO_FUNC_1_FORMAT_1_EP_SZ_OUT   ((CFG_TUD_AUDIO_FUNC_1_MAX_SAMPLE_RATE / 1000 * CFG_TUD_AUDIO_FUNC_1_FORMAT_1_N_BYTES_PER_SAMPLE_TX * CFG_TUD_AUDIO_FUNC_1_N_CHANNELS_TX) + 4)
+// SPK
+#define CFG_TUD_AUDIO_FUNC_1_FORMAT_1_EP_SZ_OUT   UAC_EP_SZ(CFG_TUD_AUDIO_FUNC_1_N_CHANNELS_TX, CFG_TUD_AUDIO_FUNC_1_FORMAT_1_N_BYTES_PER_SAMPLE_TX)
 
 #define CFG_TUD_AUDIO_FUNC_1_EP_OUT_SW_BUF_SZ     CFG_TUD_AUDIO_FUNC_1_FORMAT_1_EP_SZ_OUT * (SPK_INTERVAL_MS + 1)
-#define CFG_TUD_AUDIO_FUNC_1_EP_OUT_SZ_MAX        CFG_TUD_AUDIO_FUNC_1_FORMAT_1_EP_SZ_OUT // Maximum EP IN size for all AS alternate settings used
+#define CFG_TUD_AUDIO_FUNC_1_EP_OUT_SZ_MAX        CFG_TUD_AUDIO_FUNC_1_FORMAT_1_EP_SZ_OUT // Maximum EP OUT size for all AS alternate settings used
 
 // Number of Standard AS Interface Descriptors (4.9.1) defined per audio function - this is required to be able to remember the current alternate settings of these interfaces - We restrict us here to have a constant number for all audio functions (which means this has to be the maximum number of AS interfaces an audio function has and a second audio function with less AS interfaces just wastes a few bytes)
 #define CFG_TUD_AUDIO_FUNC_1_N_AS_INT             1
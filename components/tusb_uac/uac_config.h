@@ -17,43 +17,23 @@ extern "C" {
 #define SPK_INTERVAL_MS      CONFIG_UAC_SPK_INTERVAL_MS      /*!< READ INTERVAL in ms*/
 #define MIC_INTERVAL_MS      CONFIG_UAC_MIC_INTERVAL_MS      /*!< WRITE INTERVAL in ms*/
 
-#define IN_CTRL_CH_VALUE U32_TO_U8S_LE(AUDIO_CTRL_RW << AUDIO_FEATURE_UNIT_CTRL_MUTE_POS | AUDIO_CTRL_RW << AUDIO_FEATURE_UNIT_CTRL_VOLUME_POS)
-
-#if SPEAK_CHANNEL_NUM == 1
-#define INPUT_CTRL      IN_CTRL_CH_VALUE, IN_CTRL_CH_VALUE
-#elif SPEAK_CHANNEL_NUM == 2
-#define INPUT_CTRL      IN_CTRL_CH_VALUE, IN_CTRL_CH_VALUE, IN_CTRL_CH_VALUE
-#elif SPEAK_CHANNEL_NUM == 3
-#define INPUT_CTRL      IN_CTRL_CH_VALUE, IN_CTRL_CH_VALUE, IN_CTRL_CH_VALUE, IN_CTRL_CH_VALUE
-#elif SPEAK_CHANNEL_NUM == 4
-#define INPUT_CTRL      IN_CTRL_CH_VALUE, IN_CTRL_CH_VALUE, IN_CTRL_CH_VALUE, IN_CTRL_CH_VALUE, IN_CTRL_CH_VALUE
-#elif SPEAK_CHANNEL_NUM == 5
-#define INPUT_CTRL      IN_CTRL_CH_VALUE, IN_CTRL_CH_VALUE, IN_CTRL_CH_VALUE, IN_CTRL_CH_VALUE, IN_CTRL_CH_VALUE, IN_CTRL_CH_VALUE
-#elif SPEAK_CHANNEL_NUM == 6
-#define INPUT_CTRL      IN_CTRL_CH_VALUE, IN_CTRL_CH_VALUE, IN_CTRL_CH_VALUE, IN_CTRL_CH_VALUE, IN_CTRL_CH_VALUE, IN_CTRL_CH_VALUE, IN_CTRL_CH_VALUE
-#elif SPEAK_CHANNEL_NUM == 7
-#define INPUT_CTRL      IN_CTRL_CH_VALUE, IN_CTRL_CH_VALUE, IN_CTRL_CH_VALUE, IN_CTRL_CH_VALUE, IN_CTRL_CH_VALUE, IN_CTRL_CH_VALUE, IN_CTRL_CH_VALUE, IN_CTRL_CH_VALUE
-#elif SPEAK_CHANNEL_NUM == 8
-#define INPUT_CTRL      IN_CTRL_CH_VALUE, IN_CTRL_CH_VALUE, IN_CTRL_CH_VALUE, IN_CTRL_CH_VALUE, IN_CTRL_CH_VALUE, IN_CTRL_CH_VALUE, IN_CTRL_CH_VALUE, IN_CTRL_CH_VALUE, IN_CTRL_CH_VALUE
-#endif
-
-#if MIC_CHANNEL_NUM == 1
-#define MIC_CTRL      IN_CTRL_CH_VALUE, IN_CTRL_CH_VALUE
-#elif MIC_CHANNEL_NUM == 2
-#define MIC_CTRL      IN_CTRL_CH_VALUE, IN_CTRL_CH_VALUE, IN_CTRL_CH_VALUE
-#elif MIC_CHANNEL_NUM == 3
-#define MIC_CTRL      IN_CTRL_CH_VALUE, IN_CTRL_CH_VALUE, IN_CTRL_CH_VALUE, IN_CTRL_CH_VALUE
-#elif MIC_CHANNEL_NUM == 4
-#define MIC_CTRL      IN_CTRL_CH_VALUE, IN_CTRL_CH_VALUE, IN_CTRL_CH_VALUE, IN_CTRL_CH_VALUE, IN_CTRL_CH_VALUE
-#elif MIC_CHANNEL_NUM == 5
-#define MIC_CTRL      IN_CTRL_CH_VALUE, IN_CTRL_CH_VALUE, IN_CTRL_CH_VALUE, IN_CTRL_CH_VALUE, IN_CTRL_CH_VALUE, IN_CTRL_CH_VALUE
-#elif MIC_CHANNEL_NUM == 6
-#define MIC_CTRL      IN_CTRL_CH_VALUE, IN_CTRL_CH_VALUE, IN_CTRL_CH_VALUE, IN_CTRL_CH_VALUE, IN_CTRL_CH_VALUE, IN_CTRL_CH_VALUE, IN_CTRL_CH_VALUE
-#elif MIC_CHANNEL_NUM == 7
-#define MIC_CTRL      IN_CTRL_CH_VALUE, IN_CTRL_CH_VALUE, IN_CTRL_CH_VALUE, IN_CTRL_CH_VALUE, IN_CTRL_CH_VALUE, IN_CTRL_CH_VALUE, IN_CTRL_CH_VALUE, IN_CTRL_CH_VALUE
-#elif MIC_CHANNEL_NUM == 8
-#define MIC_CTRL      IN_CTRL_CH_VALUE, IN_CTRL_CH_VALUE, IN_CTRL_CH_VALUE, IN_CTRL_CH_VALUE, IN_CTRL_CH_VALUE, IN_CTRL_CH_VALUE, IN_CTRL_CH_VALUE, IN_CTRL_CH_VALUE, IN_CTRL_CH_VALUE
-#endif
+#define IN_CTRL_CH_VALUE U32_TO_U8S_LE(AUDIO_CTRL_RW << AUDIO_FEATURE_UNIT_CTRL_MUTE_POS | AUDIO_CTRL_RW << AUDIO_FEATURE_UNIT_CTRL_VOLUME_POS | \
+                                       AUDIO_CTRL_RW << AUDIO_FEATURE_UNIT_CTRL_AGC_POS)
+
+// Feature unit bmaControls: the master entry followed by one per channel, UAC_FU_CTRLS(channels, control)
+#define UAC_FU_CTRLS_1(...)  __VA_ARGS__, __VA_ARGS__
+#define UAC_FU_CTRLS_2(...)  UAC_FU_CTRLS_1(__VA_ARGS__), __VA_ARGS__
+#define UAC_FU_CTRLS_3(...)  UAC_FU_CTRLS_2(__VA_ARGS__), __VA_ARGS__
+#define UAC_FU_CTRLS_4(...)  UAC_FU_CTRLS_3(__VA_ARGS__), __VA_ARGS__
+#define UAC_FU_CTRLS_5(...)  UAC_FU_CTRLS_4(__VA_ARGS__), __VA_ARGS__
+#define UAC_FU_CTRLS_6(...)  UAC_FU_CTRLS_5(__VA_ARGS__), __VA_ARGS__
+#define UAC_FU_CTRLS_7(...)  UAC_FU_CTRLS_6(__VA_ARGS__), __VA_ARGS__
+#define UAC_FU_CTRLS_8(...)  UAC_FU_CTRLS_7(__VA_ARGS__), __VA_ARGS__
+#define UAC_FU_CTRLS_(_n, ...)   UAC_FU_CTRLS_##_n(__VA_ARGS__)
+#define UAC_FU_CTRLS(_n, ...)    UAC_FU_CTRLS_(_n, __VA_ARGS__)
+
+#define INPUT_CTRL      UAC_FU_CTRLS(SPEAK_CHANNEL_NUM, IN_CTRL_CH_VALUE)
+#define MIC_CTRL        UAC_FU_CTRLS(MIC_CHANNEL_NUM, IN_CTRL_CH_VALUE)
 
 /* Feature Unit Descriptor(4.7.2.8) */
 // N - Channels
@@ -62,6 +42,17 @@ extern "C" {
 #define TUD_AUDIO_DESC_FEATURE_UNIT_N_CHANNEL(_length ,_unitid, _srcid, _stridx, ...) \
   _length, TUSB_DESC_CS_INTERFACE, AUDIO_CS_AC_INTERFACE_FEATURE_UNIT, _unitid, _srcid, __VA_ARGS__, _stridx
 
+/* Mixer Unit Descriptor(4.7.2.6) */
+// 2 input pins, bmMixerControls fits in one byte
+#define TUD_AUDIO_DESC_MIXER_UNIT_2_PIN_LEN   (13+2+1)
+#define TUD_AUDIO_DESC_MIXER_UNIT_2_PIN(_unitid, _srcid1, _srcid2, _nchannels, _mixerctrl, _stridx) \
+  TUD_AUDIO_DESC_MIXER_UNIT_2_PIN_LEN, TUSB_DESC_CS_INTERFACE, AUDIO_CS_AC_INTERFACE_MIXER_UNIT, _unitid, 2, _srcid1, _srcid2, _nchannels, \
+  U32_TO_U8S_LE(AUDIO_CHANNEL_CONFIG_NON_PREDEFINED), /*iChannelNames*/ 0x00, _mixerctrl, /*bmControls*/ 0x00, _stridx
+
+// Monitor mixer: inputs are speaker L/R followed by mic L/R, outputs speaker L/R.
+// Crosspoint (u, v) is bit (u - 1) * 2 + (v - 1), MSB first, only the mic crosspoints are programmable.
+#define MONITOR_MIXER_CTRL    0x0F
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,227 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_check.h"
+#include "esp_cpu.h"
+#include "esp_heap_caps.h"
+#include "esp_private/esp_clk.h"
+#include "uac_config.h"
+#include "uac_bench.h"
+#include "uac_ring_priv.h"
+#if CONFIG_UAC_MIC_RESAMPLER
+#include "uac_resampler_priv.h"
+#endif
+// The OUT endpoint FIFO is TinyUSB code, the host build of test/host times the portable kernels only
+#ifndef UAC_BENCH_TINYUSB
+#define UAC_BENCH_TINYUSB       1
+#endif
+#if UAC_BENCH_TINYUSB
+#include "tusb.h"
+#endif
+
+static const char *TAG = "uac_bench";
+
+// Nominal packet, largest packet, largest and nominal capture block at the default rate
+#define BENCH_MS_FRAMES         (DEFAULT_SAMPLE_RATE / 1000)
+#define BENCH_PACKET_FRAMES     (BENCH_MS_FRAMES + 1)
+#define BENCH_BLOCK_FRAMES      (MIC_INTERVAL_MS * BENCH_PACKET_FRAMES)
+#define BENCH_MIC_FRAMES        (MIC_INTERVAL_MS * BENCH_MS_FRAMES)
+#define BENCH_MAX_CHANNELS      (SPEAK_CHANNEL_NUM > MIC_CHANNEL_NUM ? SPEAK_CHANNEL_NUM : MIC_CHANNEL_NUM)
+// 32-bit samples, the largest format
+#define BENCH_BLOCK_BYTES       (BENCH_BLOCK_FRAMES * BENCH_MAX_CHANNELS * 4)
+// 16-bit samples, sized like the capture ring
+#define BENCH_MIC_FRAME_BYTES   (MIC_CHANNEL_NUM * 2)
+#define BENCH_RING_BYTES        (3 * BENCH_BLOCK_FRAMES * BENCH_MIC_FRAME_BYTES)
+// Sized like the OUT endpoint software buffer
+#define BENCH_SPK_FRAME_BYTES   (SPEAK_CHANNEL_NUM * 2)
+#define BENCH_FIFO_BYTES        ((SPK_INTERVAL_MS + 1) * BENCH_PACKET_FRAMES * BENCH_SPK_FRAME_BYTES)
+// 1.0005 input frames per output frame, near the servo range and the filter history stays bounded
+#define BENCH_RS_STEP_Q32       ((1ULL << 32) + (1ULL << 32) / 2000)
+
+typedef struct {
+    uint8_t *ring;
+    size_t size;
+    size_t pos;
+    uint8_t *buf;
+    size_t len;
+} bench_ring_t;
+
+#if UAC_BENCH_TINYUSB
+typedef struct {
+    tu_fifo_t ff;
+    const uint8_t *in;
+    uint8_t *out;
+    uint16_t len;
+} bench_fifo_t;
+#endif
+
+#if CONFIG_UAC_MIC_RESAMPLER
+typedef struct {
+    uac_resampler_t *rs;
+    const void *in;
+    void *out;
+} bench_resampler_t;
+#endif
+
+void uac_bench_fill(void *buf, size_t len, uint32_t *state)
+{
+    uint8_t *p = buf;
+    uint32_t x = *state ? *state : 1;
+    for (size_t i = 0; i < len; i++) {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        p[i] = (uint8_t)x;
+    }
+    *state = x;
+}
+
+static void bench_ring_write(void *ctx)
+{
+    bench_ring_t *r = ctx;
+    r->pos = uac_ring_write(r->ring, r->size, r->pos, r->buf, r->len);
+}
+
+static void bench_ring_read(void *ctx)
+{
+    bench_ring_t *r = ctx;
+    r->pos = uac_ring_read(r->ring, r->size, r->pos, r->buf, r->len);
+}
+
+#if UAC_BENCH_TINYUSB
+// what tud_audio_rx_done_pre_read_cb and tud_audio_read do with one OUT packet
+static void bench_fifo(void *ctx)
+{
+    bench_fifo_t *f = ctx;
+    tu_fifo_write_n(&f->ff, f->in, f->len);
+    tu_fifo_read_n(&f->ff, f->out, f->len);
+}
+#endif
+
+#if CONFIG_UAC_MIC_RESAMPLER
+static void bench_resampler(void *ctx)
+{
+    bench_resampler_t *r = ctx;
+    uac_resampler_process(r->rs, r->in, BENCH_MIC_FRAMES, r->out, BENCH_BLOCK_FRAMES, BENCH_RS_STEP_Q32, NULL);
+}
+#endif
+
+// Times one case and appends it to the report, returns the new report length
+static int report_case(char *json, size_t size, int n, const uac_bench_case_t *c, uint32_t iterations, uint32_t mhz)
+{
+    uint32_t min = UINT32_MAX;
+    uint64_t sum = 0;
+    c->run(c->ctx);                              // caches and branch predictors warm
+    for (uint32_t i = 0; i < iterations; i++) {
+        const uint32_t start = esp_cpu_get_cycle_count();
+        c->run(c->ctx);
+        const uint32_t cycles = esp_cpu_get_cycle_count() - start;
+        min = cycles < min ? cycles : min;
+        sum += cycles;
+    }
+    // the audio tasks are not held off by a long run, and the idle task gets to feed the watchdog
+    vTaskDelay(1);
+
+    const uint32_t frames = c->frames ? c->frames : 1;
+    min = min ? min : 1;
+    const double ns_per_frame = (double)min * 1000.0 / mhz / frames;
+    const double ns_mean = (double)sum * 1000.0 / mhz / frames / iterations;
+    const double bytes_per_s = (double)c->bytes * mhz * 1e6 / min;
+    // past the end of json only the length is counted, the caller reports the size needed
+    const bool room = n < (int)size;
+    n += snprintf(room ? json + n : NULL, room ? size - n : 0,
+                  "%s\"%s\": {\"frames\": %lu, \"bytes\": %lu, \"ns_per_frame\": %.2f, \"ns_per_frame_mean\": %.2f, "
+                  "\"bytes_per_s\": %.0f}", room && json[n - 1] == '{' ? "" : ", ", c->name, (unsigned long)c->frames,
+                  (unsigned long)c->bytes, ns_per_frame, ns_mean, bytes_per_s);
+    return n;
+}
+
+esp_err_t uac_bench_run(const uac_bench_case_t *cases, size_t num_cases, uint32_t iterations, uint32_t seed,
+                        char *json, size_t size)
+{
+    ESP_RETURN_ON_FALSE(iterations > 0, ESP_ERR_INVALID_ARG, TAG, "iterations is 0");
+    ESP_RETURN_ON_FALSE(json != NULL && size > 0, ESP_ERR_INVALID_ARG, TAG, "json is NULL");
+    ESP_RETURN_ON_FALSE(cases != NULL || num_cases == 0, ESP_ERR_INVALID_ARG, TAG, "cases is NULL");
+
+    // internal RAM like the buffers of the audio path, PSRAM would measure the cache instead
+    uint8_t *src = heap_caps_malloc(BENCH_BLOCK_BYTES, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    uint8_t *dst = heap_caps_malloc(BENCH_BLOCK_BYTES, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    uint8_t *ring = heap_caps_malloc(BENCH_RING_BYTES + BENCH_FIFO_BYTES, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+#if CONFIG_UAC_MIC_RESAMPLER
+    // a filter state of its own, the one of the IN stream is never touched
+    uac_resampler_t *rs = heap_caps_malloc(sizeof(uac_resampler_t), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+#endif
+    esp_err_t ret = ESP_OK;
+    ESP_GOTO_ON_FALSE(src != NULL && dst != NULL && ring != NULL, ESP_ERR_NO_MEM, err, TAG, "no memory for the buffers");
+#if CONFIG_UAC_MIC_RESAMPLER
+    ESP_GOTO_ON_FALSE(rs != NULL, ESP_ERR_NO_MEM, err, TAG, "no memory for the resampler");
+#endif
+    uint32_t state = seed;
+    uac_bench_fill(src, BENCH_BLOCK_BYTES, &state);
+    uac_bench_fill(ring, BENCH_RING_BYTES + BENCH_FIFO_BYTES, &state);
+
+    const uint32_t mhz = esp_clk_cpu_freq() / 1000000;
+    int n = snprintf(json, size, "{\"cpu_mhz\": %lu, \"iterations\": %lu, \"seed\": %lu, \"kernels\": {",
+                     (unsigned long)mhz, (unsigned long)iterations, (unsigned long)seed);
+
+#if MIC_CHANNEL_NUM
+    // one capture block in, one packet out, the positions drift through the ring so the copies wrap
+    bench_ring_t rw = {ring, BENCH_RING_BYTES, 0, src, BENCH_MIC_FRAMES * BENCH_MIC_FRAME_BYTES};
+    bench_ring_t rr = {ring, BENCH_RING_BYTES, 0, dst, BENCH_MS_FRAMES * BENCH_MIC_FRAME_BYTES};
+    const uac_bench_case_t ring_cases[] = {
+        {"ring_write", bench_ring_write, &rw, BENCH_MIC_FRAMES, 2 * rw.len},
+        {"ring_read", bench_ring_read, &rr, BENCH_MS_FRAMES, 2 * rr.len},
+    };
+    for (size_t i = 0; i < sizeof(ring_cases) / sizeof(ring_cases[0]); i++) {
+        n = report_case(json, size, n, &ring_cases[i], iterations, mhz);
+    }
+#endif
+
+#if SPEAK_CHANNEL_NUM && UAC_BENCH_TINYUSB
+    // nominal packets through the OUT endpoint buffer, sized for the largest ones
+    bench_fifo_t fifo = {.in = src, .out = dst, .len = BENCH_MS_FRAMES * BENCH_SPK_FRAME_BYTES};
+    tu_fifo_config(&fifo.ff, ring + BENCH_RING_BYTES, BENCH_FIFO_BYTES, 1, false);
+    const uac_bench_case_t fifo_case = {"ep_out_fifo", bench_fifo, &fifo, BENCH_MS_FRAMES, 4 * fifo.len};
+    n = report_case(json, size, n, &fifo_case, iterations, mhz);
+#endif
+
+#if CONFIG_UAC_MIC_RESAMPLER
+    static const uint8_t bits[] = {16, 32};
+    static const char *names[] = {"resampler_s16", "resampler_s32"};
+    bench_resampler_t rs_ctx = {rs, src, dst};
+    for (size_t i = 0; i < sizeof(bits); i++) {
+        const uac_format_t format = {
+            .sample_rate = DEFAULT_SAMPLE_RATE,
+            .channels = MIC_CHANNEL_NUM,
+            .bits_per_sample = bits[i],
+            .bytes_per_frame = MIC_CHANNEL_NUM * bits[i] / 8,
+        };
+        uac_resampler_reset(rs, &format);
+        const uac_bench_case_t rs_case = {names[i], bench_resampler, &rs_ctx, BENCH_MIC_FRAMES,
+                                          2 * BENCH_MIC_FRAMES * format.bytes_per_frame};
+        n = report_case(json, size, n, &rs_case, iterations, mhz);
+    }
+#endif
+
+    for (size_t i = 0; i < num_cases; i++) {
+        n = report_case(json, size, n, &cases[i], iterations, mhz);
+    }
+    n += snprintf(n < (int)size ? json + n : NULL, n < (int)size ? size - n : 0, "}}");
+    ESP_GOTO_ON_FALSE(n < (int)size, ESP_ERR_INVALID_SIZE, err, TAG, "report needs %d bytes", n + 1);
+
+err:
+    free(src);
+    free(dst);
+    free(ring);
+#if CONFIG_UAC_MIC_RESAMPLER
+    free(rs);
+#endif
+    return ret;
+}
@@ -0,0 +1,311 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string.h>
+#include <inttypes.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_check.h"
+#include "esp_err.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "uac_flight_recorder_priv.h"
+#include "uac_mem.h"
+#include "uac_rt_profile.h"
+
+static const char *TAG = "uac_recorder";
+
+// Blocks are staged in internal RAM and copied to PSRAM in large sequential bursts by a low priority task,
+// so the audio tasks only ever pay for a short copy into internal RAM
+#define RECORDER_STAGE_BYTES    4096
+#define RECORDER_TASK_PRIORITY  UAC_BACKGROUND_TASK_PRIORITY
+#define RECORDER_TASK_CORE      UAC_CONTROL_TASK_CORE
+
+typedef enum {
+    REC_RUNNING = 0,
+    REC_TRIGGERED,                                // staged data is being flushed, audio tasks stop writing
+    REC_FROZEN,
+} rec_state_t;
+
+typedef struct {
+    uint8_t *ring;                                // PSRAM ring, size is a multiple of the frame size
+    uint32_t size;
+    uint64_t written;                             // Bytes copied to the ring since the last rearm
+    uint8_t stage[2][RECORDER_STAGE_BYTES];       // Double buffer, filled by the audio task
+    uint32_t stage_len[2];
+    bool ready[2];                                // Stage is full and waits for the writer task
+    uint8_t cur;                                  // Stage being filled
+    uint32_t fill;
+    uac_format_t format;
+    uint64_t end_sample_pos;                      // Sample position after the last staged frame
+    uint32_t lost_bytes;
+} rec_stream_t;
+
+typedef struct {
+    rec_stream_t stream[UAC_RECORDER_STREAM_NUM];
+    volatile rec_state_t state;
+    uint32_t readers;                             // open reads of the frozen recording, rearm waits for none
+    uint32_t reason;
+    int64_t trigger_time_us;
+    TaskHandle_t task_handle;
+} uac_recorder_t;
+
+static uac_recorder_t *s_rec = NULL;
+static portMUX_TYPE s_rec_mux = portMUX_INITIALIZER_UNLOCKED;
+#define REC_ENTER_CRITICAL()    portENTER_CRITICAL(&s_rec_mux)
+#define REC_EXIT_CRITICAL()     portEXIT_CRITICAL(&s_rec_mux)
+
+static void ring_write(rec_stream_t *st, const uint8_t *src, uint32_t len)
+{
+    uint32_t head = st->written % st->size;
+    uint32_t first = len < st->size - head ? len : st->size - head;
+    memcpy(st->ring + head, src, first);
+    memcpy(st->ring, src + first, len - first);
+    st->written += len;
+}
+
+// Copy the ready stages to PSRAM, the older one first
+static void drain_stages(rec_stream_t *st)
+{
+    REC_ENTER_CRITICAL();
+    const uint8_t order[2] = {st->cur, st->cur ^ 1};
+    REC_EXIT_CRITICAL();
+    for (int i = 0; i < 2; i++) {
+        const uint8_t idx = order[i];
+        if (!st->ready[idx]) {
+            continue;
+        }
+        ring_write(st, st->stage[idx], st->stage_len[idx]);
+        REC_ENTER_CRITICAL();
+        st->ready[idx] = false;
+        REC_EXIT_CRITICAL();
+    }
+}
+
+static void recorder_task(void *arg)
+{
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        for (int s = 0; s < UAC_RECORDER_STREAM_NUM; s++) {
+            if (s_rec->stream[s].ring) {
+                drain_stages(&s_rec->stream[s]);
+            }
+        }
+        if (s_rec->state != REC_TRIGGERED) {
+            continue;
+        }
+        // the audio tasks have stopped writing, push out the partially filled stages
+        for (int s = 0; s < UAC_RECORDER_STREAM_NUM; s++) {
+            rec_stream_t *st = &s_rec->stream[s];
+            if (st->ring == NULL) {
+                continue;
+            }
+            REC_ENTER_CRITICAL();
+            if (st->fill > 0 && !st->ready[st->cur]) {
+                st->stage_len[st->cur] = st->fill;
+                st->ready[st->cur] = true;
+                st->cur ^= 1;
+                st->fill = 0;
+            }
+            REC_EXIT_CRITICAL();
+            drain_stages(st);
+        }
+        REC_ENTER_CRITICAL();
+        s_rec->state = REC_FROZEN;
+        REC_EXIT_CRITICAL();
+        ESP_LOGI(TAG, "Frozen, reason %"PRIu32", OUT %"PRIu64" bytes, IN %"PRIu64" bytes", s_rec->reason,
+                 s_rec->stream[UAC_RECORDER_OUT].written, s_rec->stream[UAC_RECORDER_IN].written);
+    }
+}
+
+void uac_recorder_write(uac_recorder_stream_t stream, const uac_format_t *format, const void *data, size_t bytes, uint64_t sample_pos)
+{
+    if (s_rec == NULL || s_rec->stream[stream].ring == NULL || bytes == 0) {
+        return;
+    }
+    rec_stream_t *st = &s_rec->stream[stream];
+    const uint8_t *src = data;
+    bool notify = false;
+
+    REC_ENTER_CRITICAL();
+    if (s_rec->state != REC_RUNNING) {
+        REC_EXIT_CRITICAL();
+        return;
+    }
+    st->format = *format;
+    st->end_sample_pos = sample_pos + bytes / format->bytes_per_frame;
+    // keep the ring frame aligned, a block is either staged completely or not at all
+    uint32_t space = st->ready[st->cur] ? 0 : RECORDER_STAGE_BYTES - st->fill;
+    if (!st->ready[st->cur ^ 1]) {
+        space += RECORDER_STAGE_BYTES;
+    }
+    if (bytes > space) {
+        st->lost_bytes += bytes;
+        bytes = 0;
+    }
+    while (bytes > 0) {
+        uint32_t n = bytes < RECORDER_STAGE_BYTES - st->fill ? bytes : RECORDER_STAGE_BYTES - st->fill;
+        memcpy(&st->stage[st->cur][st->fill], src, n);
+        st->fill += n;
+        src += n;
+        bytes -= n;
+        if (st->fill == RECORDER_STAGE_BYTES) {
+            st->stage_len[st->cur] = RECORDER_STAGE_BYTES;
+            st->ready[st->cur] = true;
+            st->cur ^= 1;
+            st->fill = 0;
+            notify = true;
+        }
+    }
+    REC_EXIT_CRITICAL();
+
+    if (notify) {
+        xTaskNotifyGive(s_rec->task_handle);
+    }
+}
+
+esp_err_t uac_recorder_init(uint32_t out_bytes_per_sec, uint32_t in_bytes_per_sec)
+{
+    ESP_RETURN_ON_FALSE(s_rec == NULL, ESP_ERR_INVALID_STATE, TAG, "recorder already initialized");
+    // the stages are on the hot path, keep them out of PSRAM
+    s_rec = heap_caps_calloc(1, sizeof(uac_recorder_t), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    ESP_RETURN_ON_FALSE(s_rec != NULL, ESP_ERR_NO_MEM, TAG, "Failed to allocate recorder");
+
+    const uint32_t rates[UAC_RECORDER_STREAM_NUM] = {out_bytes_per_sec, in_bytes_per_sec};
+    for (int s = 0; s < UAC_RECORDER_STREAM_NUM; s++) {
+        if (rates[s] == 0) {
+            continue;
+        }
+        rec_stream_t *st = &s_rec->stream[s];
+        st->size = rates[s] * CONFIG_UAC_FLIGHT_RECORDER_SECONDS;
+        // cache line aligned, so the bursts from the writer task fill whole lines
+        st->ring = heap_caps_aligned_alloc(64, st->size, MALLOC_CAP_SPIRAM);
+        ESP_RETURN_ON_FALSE(st->ring != NULL, ESP_ERR_NO_MEM, TAG, "Failed to allocate %"PRIu32" bytes of PSRAM", st->size);
+        uac_mem_note(s == UAC_RECORDER_OUT ? "recorder OUT" : "recorder IN", st->ring, st->size);
+    }
+
+    BaseType_t ret_val = xTaskCreatePinnedToCore(recorder_task, "uac_recorder", 3072, NULL, RECORDER_TASK_PRIORITY,
+                                                 &s_rec->task_handle, RECORDER_TASK_CORE);
+    ESP_RETURN_ON_FALSE(ret_val == pdPASS, ESP_FAIL, TAG, "Failed to create recorder task");
+    ESP_LOGI(TAG, "Recording last %d s, OUT %"PRIu32" bytes, IN %"PRIu32" bytes", CONFIG_UAC_FLIGHT_RECORDER_SECONDS,
+             s_rec->stream[UAC_RECORDER_OUT].size, s_rec->stream[UAC_RECORDER_IN].size);
+    return ESP_OK;
+}
+
+esp_err_t uac_recorder_trigger(uint32_t reason)
+{
+    ESP_RETURN_ON_FALSE(s_rec != NULL, ESP_ERR_INVALID_STATE, TAG, "recorder not initialized");
+
+    bool triggered = false;
+    REC_ENTER_CRITICAL();
+    if (s_rec->state == REC_RUNNING) {
+        s_rec->state = REC_TRIGGERED;
+        s_rec->reason = reason;
+        s_rec->trigger_time_us = esp_timer_get_time();
+        triggered = true;
+    }
+    REC_EXIT_CRITICAL();
+    if (triggered) {
+        xTaskNotifyGive(s_rec->task_handle);
+    }
+    return ESP_OK;
+}
+
+esp_err_t uac_recorder_rearm(void)
+{
+    ESP_RETURN_ON_FALSE(s_rec != NULL, ESP_ERR_INVALID_STATE, TAG, "recorder not initialized");
+
+    // the audio tasks write as soon as the state is running, so the reset has to happen under the same lock
+    REC_ENTER_CRITICAL();
+    const bool frozen = s_rec->state == REC_FROZEN;
+    const uint32_t readers = s_rec->readers;
+    if (frozen && readers == 0) {
+        for (int s = 0; s < UAC_RECORDER_STREAM_NUM; s++) {
+            rec_stream_t *st = &s_rec->stream[s];
+            st->written = 0;
+            st->fill = 0;
+            st->cur = 0;
+            st->ready[0] = st->ready[1] = false;
+            st->lost_bytes = 0;
+        }
+        s_rec->state = REC_RUNNING;
+    }
+    REC_EXIT_CRITICAL();
+    ESP_RETURN_ON_FALSE(frozen, ESP_ERR_INVALID_STATE, TAG, "recorder is not frozen");
+    ESP_RETURN_ON_FALSE(readers == 0, ESP_ERR_INVALID_STATE, TAG, "recording is being read");
+    return ESP_OK;
+}
+
+esp_err_t uac_recorder_get_info(uac_recorder_info_t *info)
+{
+    ESP_RETURN_ON_FALSE(info != NULL, ESP_ERR_INVALID_ARG, TAG, "info is NULL");
+    ESP_RETURN_ON_FALSE(s_rec != NULL, ESP_ERR_INVALID_STATE, TAG, "recorder not initialized");
+
+    memset(info, 0, sizeof(*info));
+    info->frozen = s_rec->state == REC_FROZEN;
+    info->reason = s_rec->reason;
+    info->trigger_time_us = s_rec->trigger_time_us;
+    for (int s = 0; s < UAC_RECORDER_STREAM_NUM; s++) {
+        const rec_stream_t *st = &s_rec->stream[s];
+        uac_recorder_stream_info_t *si = &info->stream[s];
+        si->format = st->format;
+        si->bytes = st->written < st->size ? (uint32_t)st->written : st->size;
+        si->lost_bytes = st->lost_bytes;
+        if (st->format.bytes_per_frame) {
+            // exact as long as nothing was lost inside the recorded window
+            const uint64_t frames = si->bytes / st->format.bytes_per_frame;
+            si->first_sample_pos = st->end_sample_pos > frames ? st->end_sample_pos - frames : 0;
+        }
+    }
+    return ESP_OK;
+}
+
+esp_err_t uac_recorder_read_begin(void)
+{
+    ESP_RETURN_ON_FALSE(s_rec != NULL, ESP_ERR_INVALID_STATE, TAG, "recorder not initialized");
+
+    REC_ENTER_CRITICAL();
+    const bool frozen = s_rec->state == REC_FROZEN;
+    if (frozen) {
+        s_rec->readers++;
+    }
+    REC_EXIT_CRITICAL();
+    return frozen ? ESP_OK : ESP_ERR_INVALID_STATE;
+}
+
+void uac_recorder_read_end(void)
+{
+    REC_ENTER_CRITICAL();
+    s_rec->readers--;
+    REC_EXIT_CRITICAL();
+}
+
+esp_err_t uac_recorder_read(uac_recorder_stream_t stream, uint32_t offset, void *buf, size_t len, size_t *bytes_read)
+{
+    ESP_RETURN_ON_FALSE(stream < UAC_RECORDER_STREAM_NUM && buf != NULL && bytes_read != NULL, ESP_ERR_INVALID_ARG, TAG, "invalid argument");
+    ESP_RETURN_ON_FALSE(uac_recorder_read_begin() == ESP_OK, ESP_ERR_INVALID_STATE, TAG, "recorder is not frozen");
+
+    const rec_stream_t *st = &s_rec->stream[stream];
+    const uint32_t avail = st->written < st->size ? (uint32_t)st->written : st->size;
+    *bytes_read = 0;
+    if (offset >= avail) {
+        uac_recorder_read_end();
+        return ESP_OK;
+    }
+    if (len > avail - offset) {
+        len = avail - offset;
+    }
+    // the oldest byte sits at the write position once the ring has wrapped
+    const uint32_t oldest = st->written < st->size ? 0 : st->written % st->size;
+    const uint32_t start = (oldest + offset) % st->size;
+    const uint32_t first = len < st->size - start ? len : st->size - start;
+    memcpy(buf, st->ring + start, first);
+    memcpy((uint8_t *)buf + first, st->ring, len - first);
+    *bytes_read = len;
+    uac_recorder_read_end();
+    return ESP_OK;
+}
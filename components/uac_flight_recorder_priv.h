@@ -0,0 +1,31 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include "uac_flight_recorder.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Allocate the PSRAM rings and start the writer task.
+ *
+ * @param out_bytes_per_sec Playback data rate, 0 if there is no playback stream
+ * @param in_bytes_per_sec Capture data rate, 0 if there is no capture stream
+ */
+esp_err_t uac_recorder_init(uint32_t out_bytes_per_sec, uint32_t in_bytes_per_sec);
+
+/**
+ * @brief Stage a block from the audio tasks, never blocks. Whole blocks are skipped and counted
+ *        as lost when the writer task has not caught up.
+ */
+void uac_recorder_write(uac_recorder_stream_t stream, const uac_format_t *format, const void *data, size_t bytes, uint64_t sample_pos);
+
+#ifdef __cplusplus
+}
+#endif
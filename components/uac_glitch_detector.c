@@ -0,0 +1,196 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string.h>
+#include <stdatomic.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_timer.h"
+#include "uac_glitch_detector_priv.h"
+#if CONFIG_UAC_GLITCH_TRIGGER_RECORDER
+#include "uac_flight_recorder.h"
+#endif
+
+#define GLITCH_LOG_MASK         (CONFIG_UAC_GLITCH_LOG_LEN - 1)
+#define GLITCH_MAX_CHANNELS     8
+// exact silence shorter than this inside running audio is a dropout, longer runs are taken as a pause
+#define GLITCH_ZERO_RUN_MAX_MS  100
+// frames OR-ed together before looking at single frames, long runs of audio or silence skip the per frame scan
+#define GLITCH_SCAN_FRAMES      8
+
+_Static_assert((CONFIG_UAC_GLITCH_LOG_LEN & GLITCH_LOG_MASK) == 0, "CONFIG_UAC_GLITCH_LOG_LEN must be a power of two");
+
+typedef struct {
+    int16_t prev[GLITCH_MAX_CHANNELS];            // Last frame of the previous block
+    bool prev_valid;
+    bool in_audio;                                // Non-zero audio seen since the stream (re)started
+    uint32_t zero_run;                            // Current run of all-zero frames
+} glitch_stream_t;
+
+// Seqlock per slot: commit is 0 while the slot is written and seq + 1 once the event is complete
+static uac_glitch_event_t s_log[CONFIG_UAC_GLITCH_LOG_LEN];
+static atomic_uint s_log_commit[CONFIG_UAC_GLITCH_LOG_LEN];
+static atomic_uint s_log_head;
+static atomic_uint s_counts[UAC_GLITCH_TYPE_NUM][UAC_GLITCH_STREAM_NUM];
+static glitch_stream_t s_stream[UAC_GLITCH_STREAM_NUM];
+
+static void log_event(int stream, uac_glitch_type_t type, uint16_t channel, uint64_t sample_pos, uint32_t sof_frame, int32_t value)
+{
+    uac_glitch_event_t ev = {
+        .type = type,
+        .stream = stream,
+        .channel = channel,
+        .sof_frame = sof_frame,
+        .timestamp_us = esp_timer_get_time(),
+        .sample_pos = sample_pos,
+        .value = value,
+    };
+    const uint32_t seq = atomic_fetch_add_explicit(&s_log_head, 1, memory_order_relaxed);
+    const uint32_t slot = seq & GLITCH_LOG_MASK;
+    ev.seq = seq;
+    atomic_store_explicit(&s_log_commit[slot], 0, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    s_log[slot] = ev;
+    atomic_store_explicit(&s_log_commit[slot], seq + 1, memory_order_release);
+    atomic_fetch_add_explicit(&s_counts[type][stream], 1, memory_order_relaxed);
+
+#if CONFIG_UAC_GLITCH_TRIGGER_RECORDER
+    if (CONFIG_UAC_GLITCH_TRIGGER_MASK & (1u << type)) {
+        uac_recorder_trigger(0x100 | type);
+    }
+#endif
+}
+
+void uac_glitch_report(int stream, uac_glitch_type_t type, uint64_t sample_pos, uint32_t sof_frame, int32_t value)
+{
+    log_event(stream, type, 0, sample_pos, sof_frame, value);
+}
+
+size_t uac_glitch_read(uint32_t *cursor, uac_glitch_event_t *events, size_t max_events)
+{
+    const uint32_t head = atomic_load_explicit(&s_log_head, memory_order_acquire);
+    uint32_t seq = *cursor;
+    // the writers may have lapped the reader, continue with the oldest event still in the log
+    if (head - seq > CONFIG_UAC_GLITCH_LOG_LEN) {
+        seq = head - CONFIG_UAC_GLITCH_LOG_LEN;
+    }
+    size_t n = 0;
+    for (; seq != head && n < max_events; seq++) {
+        const uint32_t slot = seq & GLITCH_LOG_MASK;
+        if (atomic_load_explicit(&s_log_commit[slot], memory_order_acquire) != seq + 1) {
+            // still being written, or already reused by a newer event
+            break;
+        }
+        events[n] = s_log[slot];
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&s_log_commit[slot], memory_order_relaxed) != seq + 1) {
+            break;
+        }
+        n++;
+    }
+    *cursor = seq;
+    return n;
+}
+
+void uac_glitch_get_counts(uint32_t counts[UAC_GLITCH_TYPE_NUM][UAC_GLITCH_STREAM_NUM])
+{
+    for (int t = 0; t < UAC_GLITCH_TYPE_NUM; t++) {
+        for (int s = 0; s < UAC_GLITCH_STREAM_NUM; s++) {
+            counts[t][s] = atomic_load_explicit(&s_counts[t][s], memory_order_relaxed);
+        }
+    }
+}
+
+/**
+ * @brief Largest step between a sample and the same channel one frame earlier. Written as a single flat loop
+ *        over a constant offset without branches, so it runs at the load rate and maps onto SIMD where available.
+ */
+static uint32_t max_step(const int16_t *x, size_t samples, size_t offset)
+{
+    uint32_t m = 0;
+    for (size_t i = offset; i < samples; i++) {
+        int32_t d = (int32_t)x[i] - x[i - offset];
+        uint32_t a = d < 0 ? -d : d;
+        m = a > m ? a : m;
+    }
+    return m;
+}
+
+static void report_jump(int stream, const int16_t *x, size_t samples, size_t channels, const int16_t *prev,
+                        uint64_t sample_pos, uint32_t sof_frame)
+{
+    // rare path, find the first offending sample for the event
+    for (size_t i = 0; i < samples; i++) {
+        const int32_t before = i < channels ? prev[i] : x[i - channels];
+        int32_t d = (int32_t)x[i] - before;
+        d = d < 0 ? -d : d;
+        if (d > CONFIG_UAC_GLITCH_JUMP_THRESHOLD) {
+            log_event(stream, UAC_GLITCH_JUMP, i % channels, sample_pos + i / channels, sof_frame, d);
+            return;
+        }
+    }
+}
+
+void uac_glitch_check_block(int stream, const uac_format_t *format, const void *data, size_t frames,
+                            uint64_t sample_pos, uint32_t sof_frame, bool discontinuity)
+{
+    glitch_stream_t *st = &s_stream[stream];
+    const size_t ch = format->channels;
+    if (format->bits_per_sample != 16 || ch == 0 || ch > GLITCH_MAX_CHANNELS || frames == 0) {
+        return;
+    }
+    if (discontinuity) {
+        st->prev_valid = false;
+        st->in_audio = false;
+        st->zero_run = 0;
+    }
+    const int16_t *x = (const int16_t *)data;
+    const size_t samples = frames * ch;
+
+    // sample jumps, the first frame is compared against the end of the previous block
+    uint32_t step = max_step(x, samples, ch);
+    if (st->prev_valid) {
+        for (size_t c = 0; c < ch; c++) {
+            int32_t d = (int32_t)x[c] - st->prev[c];
+            uint32_t a = d < 0 ? -d : d;
+            step = a > step ? a : step;
+        }
+    }
+    if (step > CONFIG_UAC_GLITCH_JUMP_THRESHOLD) {
+        report_jump(stream, x, samples, ch, st->prev_valid ? st->prev : x, sample_pos, sof_frame);
+    }
+    memcpy(st->prev, &x[samples - ch], ch * sizeof(int16_t));
+    st->prev_valid = true;
+
+    // zero runs inside running audio
+    const uint32_t run_max = format->sample_rate / 1000 * GLITCH_ZERO_RUN_MAX_MS;
+    for (size_t f = 0; f < frames; f += GLITCH_SCAN_FRAMES) {
+        const size_t n = frames - f < GLITCH_SCAN_FRAMES ? frames - f : GLITCH_SCAN_FRAMES;
+        const int16_t *chunk = &x[f * ch];
+        int16_t acc = 0;
+        for (size_t i = 0; i < n * ch; i++) {
+            acc |= chunk[i];
+        }
+        if (acc == 0) {
+            st->zero_run += n;
+            continue;
+        }
+        for (size_t k = 0; k < n; k++) {
+            int16_t frame = 0;
+            for (size_t c = 0; c < ch; c++) {
+                frame |= chunk[k * ch + c];
+            }
+            if (frame == 0) {
+                st->zero_run++;
+                continue;
+            }
+            if (st->in_audio && st->zero_run >= CONFIG_UAC_GLITCH_ZERO_RUN_FRAMES && st->zero_run <= run_max) {
+                log_event(stream, UAC_GLITCH_ZERO_RUN, 0, sample_pos + f + k - st->zero_run, sof_frame, (int32_t)st->zero_run);
+            }
+            st->zero_run = 0;
+            st->in_audio = true;
+        }
+    }
+}
@@ -0,0 +1,32 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include "usb_device_uac.h"
+#include "uac_glitch_detector.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Log a transport event from the USB callbacks or the audio tasks.
+ */
+void uac_glitch_report(int stream, uac_glitch_type_t type, uint64_t sample_pos, uint32_t sof_frame, int32_t value);
+
+/**
+ * @brief Scan a block for zero runs and sample jumps. 16-bit streams only, other formats are ignored.
+ *
+ * @param discontinuity The block does not continue the previous one, the cross-block state is reset
+ */
+void uac_glitch_check_block(int stream, const uac_format_t *format, const void *data, size_t frames,
+                            uint64_t sample_pos, uint32_t sof_frame, bool discontinuity);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,154 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string.h>
+#include <inttypes.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_check.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_memory_utils.h"
+#include "soc/soc_caps.h"
+#if SOC_CACHE_INTERNAL_MEM_VIA_L1CACHE
+#include "esp_cache.h"
+#endif
+#include "uac_mem.h"
+
+static const char *TAG = "uac_mem";
+
+#define UAC_MEM_MAX_ENTRIES     24
+#define ALIGN_UP(x)             (((x) + UAC_MEM_ALIGN - 1) & ~(size_t)(UAC_MEM_ALIGN - 1))
+
+typedef struct {
+    const char *name;
+    const void *ptr;
+    size_t size;
+    bool arena;
+} mem_entry_t;
+
+// .bss stays in internal RAM as long as CONFIG_SPIRAM_ALLOW_BSS_SEG_EXTERNAL_MEMORY is off
+#if CONFIG_SPIRAM_ALLOW_BSS_SEG_EXTERNAL_MEMORY
+#error "the hot arena must not be placed in PSRAM"
+#endif
+static uint8_t s_arena[CONFIG_UAC_HOT_ARENA_SIZE] __attribute__((aligned(UAC_MEM_ALIGN)));
+static size_t s_arena_used;
+static size_t s_arena_missed;                       // Bytes that did not fit and came from the heap
+static mem_entry_t s_entries[UAC_MEM_MAX_ENTRIES];
+static int s_num_entries;
+static portMUX_TYPE s_mem_mux = portMUX_INITIALIZER_UNLOCKED;
+
+static void add_entry(const char *name, const void *ptr, size_t size, bool arena)
+{
+    portENTER_CRITICAL(&s_mem_mux);
+    if (s_num_entries < UAC_MEM_MAX_ENTRIES) {
+        s_entries[s_num_entries++] = (mem_entry_t) {
+            .name = name, .ptr = ptr, .size = size, .arena = arena,
+        };
+    }
+    portEXIT_CRITICAL(&s_mem_mux);
+}
+
+static void *arena_take(size_t size)
+{
+    void *ptr = NULL;
+    size = ALIGN_UP(size);
+    portENTER_CRITICAL(&s_mem_mux);
+    if (size <= sizeof(s_arena) - s_arena_used) {
+        ptr = &s_arena[s_arena_used];
+        s_arena_used += size;
+    } else {
+        s_arena_missed += size;
+    }
+    portEXIT_CRITICAL(&s_mem_mux);
+    return ptr;
+}
+
+void *uac_mem_alloc(const char *name, size_t size)
+{
+    void *ptr = arena_take(size);
+    bool arena = ptr != NULL;
+    if (arena) {
+        memset(ptr, 0, size);
+    } else {
+        ESP_LOGW(TAG, "Arena full, %s (%u bytes) from the internal heap", name, (unsigned)size);
+        ptr = heap_caps_aligned_calloc(UAC_MEM_ALIGN, 1, ALIGN_UP(size), MALLOC_CAP_INTERNAL | MALLOC_CAP_DMA);
+        if (ptr == NULL) {
+            return NULL;
+        }
+    }
+    add_entry(name, ptr, size, arena);
+    return ptr;
+}
+
+esp_err_t uac_mem_create_task(TaskFunction_t fn, const char *name, uint32_t stack_size, void *arg,
+                              UBaseType_t priority, TaskHandle_t *handle, BaseType_t core)
+{
+    StackType_t *stack = uac_mem_alloc(name, stack_size);
+    // the TCB is not worth a report line of its own
+    StaticTask_t *tcb = arena_take(sizeof(StaticTask_t));
+    if (tcb == NULL) {
+        tcb = heap_caps_calloc(1, sizeof(StaticTask_t), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    }
+    ESP_RETURN_ON_FALSE(stack != NULL && tcb != NULL, ESP_ERR_NO_MEM, TAG, "No internal memory for task %s", name);
+    TaskHandle_t task = xTaskCreateStaticPinnedToCore(fn, name, stack_size, arg, priority, stack, tcb, core);
+    ESP_RETURN_ON_FALSE(task != NULL, ESP_FAIL, TAG, "Failed to create task %s", name);
+    if (handle) {
+        *handle = task;
+    }
+    return ESP_OK;
+}
+
+void uac_mem_note(const char *name, const void *ptr, size_t size)
+{
+    add_entry(name, ptr, size, false);
+}
+
+esp_err_t uac_mem_sync_for_device(void *ptr, size_t size)
+{
+#if SOC_CACHE_INTERNAL_MEM_VIA_L1CACHE
+    return esp_cache_msync(ptr, ALIGN_UP(size), ESP_CACHE_MSYNC_FLAG_DIR_C2M);
+#else
+    return ESP_OK;
+#endif
+}
+
+esp_err_t uac_mem_sync_for_cpu(void *ptr, size_t size)
+{
+#if SOC_CACHE_INTERNAL_MEM_VIA_L1CACHE
+    return esp_cache_msync(ptr, ALIGN_UP(size), ESP_CACHE_MSYNC_FLAG_DIR_M2C);
+#else
+    return ESP_OK;
+#endif
+}
+
+static const char *region_name(const void *ptr)
+{
+#if SOC_MEM_TCM_SUPPORTED
+    if (esp_ptr_in_tcm(ptr)) {
+        return "TCM";
+    }
+#endif
+    if (esp_ptr_external_ram(ptr)) {
+        return "PSRAM";
+    }
+    if (esp_ptr_internal(ptr)) {
+        return esp_ptr_dma_capable(ptr) ? "SRAM/DMA" : "SRAM";
+    }
+    return "other";
+}
+
+void uac_mem_report(void)
+{
+    ESP_LOGI(TAG, "Hot arena %u/%u bytes used at %p, %u bytes did not fit", (unsigned)s_arena_used,
+             (unsigned)sizeof(s_arena), s_arena, (unsigned)s_arena_missed);
+    for (int i = 0; i < s_num_entries; i++) {
+        const mem_entry_t *e = &s_entries[i];
+        const bool aligned = ((uintptr_t)e->ptr & (UAC_MEM_ALIGN - 1)) == 0;
+        ESP_LOGI(TAG, "  %-16s %p %6u bytes %-8s %s%s", e->name, e->ptr, (unsigned)e->size, region_name(e->ptr),
+                 e->arena ? "arena" : "heap/static", aligned ? "" : ", not cache line aligned");
+    }
+}
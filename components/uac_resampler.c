@@ -0,0 +1,153 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string.h>
+#include <math.h>
+#include "uac_config.h"
+#include "uac_resampler_priv.h"
+
+#define RS_TAPS             UAC_RESAMPLER_TAPS
+#define RS_CENTER           (RS_TAPS / 2 - 1)           // Tap just before the output instant
+#define RS_PHASE_BITS       6
+#define RS_PHASES           (1 << RS_PHASE_BITS)
+#define RS_FRAC_BITS        (32 - RS_PHASE_BITS)
+// the ratio stays within a few percent of 1, no anti-alias scaling of the cutoff is needed.
+// At half the sample rate phase 0 is a pure delay, the stream passes unchanged while the clocks agree
+#define RS_CUTOFF           0.5f
+#define RS_BUF_FRAMES       UAC_RESAMPLER_BUF_FRAMES
+
+// One row per phase, the extra row is phase 0 of the next input frame for the interpolation between phases
+static float s_coef[RS_PHASES + 1][RS_TAPS];
+static bool s_coef_ready;
+
+// Blackman windowed sinc, row sums normalized so DC passes at unity gain for every phase
+void uac_resampler_init(void)
+{
+    if (s_coef_ready) {
+        return;
+    }
+    for (int p = 0; p <= RS_PHASES; p++) {
+        const float mu = (float)p / RS_PHASES;
+        float sum = 0;
+        for (int k = 0; k < RS_TAPS; k++) {
+            const float t = k - RS_CENTER - mu;
+            const float x = 2 * RS_CUTOFF * t;
+            const float sinc = fabsf(x) < 1e-6f ? 1.0f : sinf((float)M_PI * x) / ((float)M_PI * x);
+            const float w = 0.42f + 0.5f * cosf((float)M_PI * t / (RS_TAPS / 2)) + 0.08f * cosf(2 * (float)M_PI * t / (RS_TAPS / 2));
+            s_coef[p][k] = sinc * w;
+            sum += s_coef[p][k];
+        }
+        for (int k = 0; k < RS_TAPS; k++) {
+            s_coef[p][k] /= sum;
+        }
+    }
+    s_coef_ready = true;
+}
+
+bool uac_resampler_reset(uac_resampler_t *rs, const uac_format_t *format)
+{
+    uac_resampler_init();
+    const uint32_t bytes = format->bytes_per_frame / format->channels;
+    const bool supported = (bytes == 2 || bytes == 4) && format->channels <= MIC_CHANNEL_NUM;
+    rs->bytes = supported ? bytes : 0;
+    rs->channels = format->channels;
+    rs->frame_bytes = format->bytes_per_frame;
+    // silence ahead of the first frame, so the first output lands on it
+    rs->frames = RS_CENTER;
+    memset(rs->buf, 0, sizeof(float) * RS_CENTER * MIC_CHANNEL_NUM);
+    rs->pos = 0;
+    return supported;
+}
+
+static void append_input(uac_resampler_t *rs, const void *in, size_t frames)
+{
+    const size_t n = frames * rs->channels;
+    float *dst = &rs->buf[rs->frames * rs->channels];
+    if (rs->bytes == 2) {
+        const int16_t *src = in;
+        for (size_t i = 0; i < n; i++) {
+            dst[i] = src[i];
+        }
+    } else {
+        const int32_t *src = in;
+        for (size_t i = 0; i < n; i++) {
+            dst[i] = src[i];
+        }
+    }
+    rs->frames += frames;
+}
+
+static inline void store_frame(const uac_resampler_t *rs, void *out, size_t frame, const float *acc)
+{
+    if (rs->bytes == 2) {
+        int16_t *dst = (int16_t *)out + frame * rs->channels;
+        for (uint32_t c = 0; c < rs->channels; c++) {
+            const long v = lrintf(acc[c]);
+            dst[c] = v > INT16_MAX ? INT16_MAX : (v < INT16_MIN ? INT16_MIN : (int16_t)v);
+        }
+    } else {
+        int32_t *dst = (int32_t *)out + frame * rs->channels;
+        for (uint32_t c = 0; c < rs->channels; c++) {
+            // float cannot hold INT32_MAX, clamp before converting
+            const float v = acc[c];
+            dst[c] = v >= 2147483520.0f ? INT32_MAX : (v <= -2147483648.0f ? INT32_MIN : (int32_t)lrintf(v));
+        }
+    }
+}
+
+size_t uac_resampler_process(uac_resampler_t *rs, const void *in, size_t in_frames, void *out, size_t max_out_frames,
+                             uint64_t step_q32, uint32_t *dropped)
+{
+    if (rs->bytes == 0) {
+        const size_t n = in_frames < max_out_frames ? in_frames : max_out_frames;
+        memcpy(out, in, n * rs->frame_bytes);
+        return n;
+    }
+    const size_t room = RS_BUF_FRAMES - rs->frames;
+    if (in_frames > room) {
+        if (dropped) {
+            *dropped += in_frames - room;
+        }
+        in_frames = room;
+    }
+    append_input(rs, in, in_frames);
+
+    const uint32_t ch = rs->channels;
+    size_t n_out = 0;
+    while (n_out < max_out_frames) {
+        const size_t i = rs->pos >> 32;
+        if (i + RS_TAPS > rs->frames) {
+            break;
+        }
+        // the fraction selects two neighbouring phases and the weight between them
+        const uint32_t frac = (uint32_t)rs->pos;
+        const float *h0 = s_coef[frac >> RS_FRAC_BITS];
+        const float *h1 = h0 + RS_TAPS;
+        const float f = (float)(frac & ((1u << RS_FRAC_BITS) - 1)) * (1.0f / (1u << RS_FRAC_BITS));
+        float h[RS_TAPS];
+        for (int k = 0; k < RS_TAPS; k++) {
+            h[k] = h0[k] + f * (h1[k] - h0[k]);
+        }
+        // channels innermost, the taps walk the interleaved buffer in order
+        float acc[MIC_CHANNEL_NUM] = { 0 };
+        const float *x = &rs->buf[i * ch];
+        for (int k = 0; k < RS_TAPS; k++, x += ch) {
+            for (uint32_t c = 0; c < ch; c++) {
+                acc[c] += h[k] * x[c];
+            }
+        }
+        store_frame(rs, out, n_out++, acc);
+        rs->pos += step_q32;
+    }
+
+    // keep the frames from the next output position on
+    size_t drop = rs->pos >> 32;
+    drop = drop < rs->frames ? drop : rs->frames;
+    memmove(rs->buf, &rs->buf[drop * ch], (rs->frames - drop) * ch * sizeof(float));
+    rs->frames -= drop;
+    rs->pos -= (uint64_t)drop << 32;
+    return n_out;
+}
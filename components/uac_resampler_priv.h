@@ -0,0 +1,80 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "usb_device_uac.h"
+#include "uac_config.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Frames the resampler delays the stream by, half its filter length.
+ */
+#define UAC_RESAMPLER_DELAY_FRAMES  12
+#define UAC_RESAMPLER_TAPS          (2 * UAC_RESAMPLER_DELAY_FRAMES)
+/**
+ * @brief Largest capture block, MIC_INTERVAL_MS worth at the highest rate.
+ */
+#define UAC_RESAMPLER_MAX_IN_FRAMES (MIC_INTERVAL_MS * (DEFAULT_SAMPLE_RATE / 1000 + 1))
+// history plus one block, and room for a block left over when the output buffer was full
+#define UAC_RESAMPLER_BUF_FRAMES    (UAC_RESAMPLER_TAPS + 2 * UAC_RESAMPLER_MAX_IN_FRAMES)
+
+/**
+ * @brief Filter state of one stream, the members are private to uac_resampler.c.
+ *
+ * Every stream, or benchmark, has its own, only the filter coefficients are shared.
+ */
+typedef struct {
+    float buf[UAC_RESAMPLER_BUF_FRAMES * MIC_CHANNEL_NUM];  /*!< interleaved input converted to float */
+    size_t frames;                                          /*!< frames in buf */
+    uint64_t pos;                                           /*!< position of the first tap of the next output, 32.32 */
+    uint32_t channels;
+    uint32_t bytes;                                         /*!< bytes per sample, 0 when the format is not supported */
+    uint32_t frame_bytes;
+} uac_resampler_t;
+
+/**
+ * @brief Compute the shared filter coefficients. Call it once before the first stream starts,
+ *        uac_resampler_reset calls it as well, so only the first reset must not race another stream.
+ */
+void uac_resampler_init(void);
+
+/**
+ * @brief Start a new stream, the filter history is cleared.
+ *
+ * @param rs Filter state of the stream
+ * @param format Format of the capture stream, only 16-bit and 32-bit samples are resampled
+ * @return true if the format is supported, otherwise uac_resampler_process copies the data unchanged
+ */
+bool uac_resampler_reset(uac_resampler_t *rs, const uac_format_t *format);
+
+/**
+ * @brief Resample one capture block with a polyphase windowed sinc filter.
+ *
+ * The input is consumed completely, frames the filter still needs are kept for the next call. Input that does not
+ * fit the history buffer, after a few calls with too little room in out, is discarded and counted in dropped.
+ *
+ * @param rs Filter state of the stream, set up by uac_resampler_reset
+ * @param in Input frames at the capture rate
+ * @param in_frames Frames in in, at most UAC_RESAMPLER_MAX_IN_FRAMES
+ * @param out Output buffer
+ * @param max_out_frames Room in out
+ * @param step_q32 Input frames per output frame, 32.32 fixed point, within a few percent of 1.0
+ * @param dropped Incremented by the input frames discarded, may be NULL
+ * @return Frames written to out
+ */
+size_t uac_resampler_process(uac_resampler_t *rs, const void *in, size_t in_frames, void *out, size_t max_out_frames,
+                             uint64_t step_q32, uint32_t *dropped);
+
+#ifdef __cplusplus
+}
+#endif
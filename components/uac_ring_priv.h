@@ -0,0 +1,52 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Copy into a byte ring, wrapping at the end. The caller checked the free space.
+ *
+ * @param ring Ring buffer
+ * @param size Ring size in bytes
+ * @param pos Write position, below size
+ * @param src Data to append
+ * @param len Bytes to append, at most size
+ * @return Write position after the data
+ */
+static inline size_t uac_ring_write(uint8_t *ring, size_t size, size_t pos, const void *src, size_t len)
+{
+    size_t first = size - pos;
+    first = len < first ? len : first;
+    memcpy(ring + pos, src, first);
+    memcpy(ring, (const uint8_t *)src + first, len - first);
+    return (pos + len) % size;
+}
+
+/**
+ * @brief Copy out of a byte ring, wrapping at the end. The caller checked the fill.
+ *
+ * @return Read position after the data
+ */
+static inline size_t uac_ring_read(const uint8_t *ring, size_t size, size_t pos, void *dst, size_t len)
+{
+    size_t first = size - pos;
+    first = len < first ? len : first;
+    memcpy(dst, ring + pos, first);
+    memcpy((uint8_t *)dst + first, ring, len - first);
+    return (pos + len) % size;
+}
+
+#ifdef __cplusplus
+}
+#endif
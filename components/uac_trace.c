@@ -0,0 +1,142 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string.h>
+#include <stdatomic.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_attr.h"
+#include "esp_check.h"
+#include "esp_cpu.h"
+#include "esp_timer.h"
+#include "esp_private/esp_clk.h"
+#if CONFIG_FREERTOS_NUMBER_OF_CORES > 1
+#include "esp_ipc.h"
+#endif
+#include "uac_trace.h"
+
+static const char *TAG = "uac_trace";
+
+#define TRACE_CORES         CONFIG_FREERTOS_NUMBER_OF_CORES
+#define TRACE_MASK          (CONFIG_UAC_TRACE_RECORDS - 1)
+
+_Static_assert((CONFIG_UAC_TRACE_RECORDS & TRACE_MASK) == 0, "CONFIG_UAC_TRACE_RECORDS must be a power of two");
+_Static_assert(TRACE_CORES <= UAC_TRACE_MAX_CORES, "more cores than the dump header holds");
+
+// Each core writes its own ring, the head is atomic so tasks and ISRs interrupting each other on one core get distinct slots
+static uac_trace_record_t s_ring[TRACE_CORES][CONFIG_UAC_TRACE_RECORDS];
+static atomic_uint s_head[TRACE_CORES];
+static volatile bool s_frozen;
+static uac_trace_dump_header_t s_dump;
+static uint32_t s_first[TRACE_CORES];                 // Sequence number of the oldest record in the dump
+
+void IRAM_ATTR uac_trace_record(uac_trace_id_t id, uac_trace_phase_t phase, uint16_t arg)
+{
+    if (s_frozen) {
+        return;
+    }
+    int core;
+    uint32_t cycles;
+    // the cycle counter is per core, retry if the task migrated in between
+    do {
+        core = esp_cpu_get_core_id();
+        cycles = esp_cpu_get_cycle_count();
+    } while (core != esp_cpu_get_core_id());
+    const uint32_t seq = atomic_fetch_add_explicit(&s_head[core], 1, memory_order_relaxed);
+    s_ring[core][seq & TRACE_MASK] = (uac_trace_record_t) {
+        .cycles = cycles,
+        .id = id,
+        .phase = phase,
+        .arg = arg,
+    };
+}
+
+// runs on the core being anchored
+static void take_anchor(void *arg)
+{
+    uac_trace_core_info_t *info = arg;
+    info->anchor_us = esp_timer_get_time();
+    info->anchor_cycles = esp_cpu_get_cycle_count();
+}
+
+esp_err_t uac_trace_freeze(size_t *dump_size)
+{
+    ESP_RETURN_ON_FALSE(dump_size != NULL, ESP_ERR_INVALID_ARG, TAG, "dump_size is NULL");
+
+    s_frozen = true;
+    // let writers that passed the check before the freeze finish their record
+    vTaskDelay(1);
+
+    memset(&s_dump, 0, sizeof(s_dump));
+    s_dump.magic = UAC_TRACE_DUMP_MAGIC;
+    s_dump.version = UAC_TRACE_DUMP_VERSION;
+    s_dump.num_cores = TRACE_CORES;
+    s_dump.cpu_hz = esp_clk_cpu_freq();
+    size_t size = sizeof(s_dump);
+    for (int c = 0; c < TRACE_CORES; c++) {
+        uac_trace_core_info_t *info = &s_dump.core[c];
+#if CONFIG_FREERTOS_NUMBER_OF_CORES > 1
+        ESP_RETURN_ON_ERROR(esp_ipc_call_blocking(c, take_anchor, info), TAG, "Failed to anchor core %d", c);
+#else
+        take_anchor(info);
+#endif
+        const uint32_t head = atomic_load_explicit(&s_head[c], memory_order_relaxed);
+        info->records = head < CONFIG_UAC_TRACE_RECORDS ? head : CONFIG_UAC_TRACE_RECORDS;
+        info->lost = head - info->records;
+        s_first[c] = head - info->records;
+        size += info->records * sizeof(uac_trace_record_t);
+    }
+    *dump_size = size;
+    return ESP_OK;
+}
+
+esp_err_t uac_trace_read(uint32_t offset, void *buf, size_t len, size_t *bytes_read)
+{
+    ESP_RETURN_ON_FALSE(buf != NULL && bytes_read != NULL, ESP_ERR_INVALID_ARG, TAG, "invalid argument");
+    ESP_RETURN_ON_FALSE(s_frozen && s_dump.magic == UAC_TRACE_DUMP_MAGIC, ESP_ERR_INVALID_STATE, TAG, "trace is not frozen");
+
+    uint8_t *dst = buf;
+    *bytes_read = 0;
+    while (len > 0) {
+        size_t n;
+        if (offset < sizeof(s_dump)) {
+            n = sizeof(s_dump) - offset;
+            n = len < n ? len : n;
+            memcpy(dst, (const uint8_t *)&s_dump + offset, n);
+        } else {
+            // locate the record, the rings are unrolled oldest first, one core after the other
+            uint32_t pos = offset - sizeof(s_dump);
+            int c = 0;
+            while (c < TRACE_CORES && pos >= s_dump.core[c].records * sizeof(uac_trace_record_t)) {
+                pos -= s_dump.core[c].records * sizeof(uac_trace_record_t);
+                c++;
+            }
+            if (c == TRACE_CORES) {
+                break;
+            }
+            const uint32_t idx = (s_first[c] + pos / sizeof(uac_trace_record_t)) & TRACE_MASK;
+            const uint32_t in = pos % sizeof(uac_trace_record_t);
+            n = sizeof(uac_trace_record_t) - in;
+            n = len < n ? len : n;
+            memcpy(dst, (const uint8_t *)&s_ring[c][idx] + in, n);
+        }
+        dst += n;
+        offset += n;
+        len -= n;
+        *bytes_read += n;
+    }
+    return ESP_OK;
+}
+
+esp_err_t uac_trace_resume(void)
+{
+    for (int c = 0; c < TRACE_CORES; c++) {
+        atomic_store_explicit(&s_head[c], 0, memory_order_relaxed);
+    }
+    s_dump.magic = 0;
+    s_frozen = false;
+    return ESP_OK;
+}
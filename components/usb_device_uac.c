@@ -8,6 +8,9 @@
 #include <inttypes.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "esp_heap_caps.h"
 #include "esp_check.h"
 #include "esp_err.h"
 #include "esp_private/usb_phy.h"
@@ -16,6 +19,22 @@
 #include "uac_config.h"
 #include "usb_device_uac.h"
 #include "uac_descriptors.h"
+#include "uac_trace.h"
+#include "uac_mem.h"
+#include "uac_rt_profile.h"
+#include "uac_ring_priv.h"
+#if CONFIG_UAC_FLIGHT_RECORDER
+#include "uac_flight_recorder_priv.h"
+#endif
+#if CONFIG_UAC_GLITCH_DETECTOR
+#include "uac_glitch_detector_priv.h"
+#endif
+#if CONFIG_UAC_LOOPBACK
+#include "esp_rom_crc.h"
+#endif
+#if CONFIG_UAC_MIC_RESAMPLER
+#include "uac_resampler_priv.h"
+#endif
 
 static const char *TAG = "usbd_uac";
 
@@ -38,22 +57,77 @@ enum {
     VOLUME_CTRL_SILENCE = 0x8000,
 };
 
-// Resolution per format
-const uint8_t spk_resolutions_per_format[CFG_TUD_AUDIO_FUNC_1_N_FORMATS] = {CFG_TUD_AUDIO_FUNC_1_FORMAT_1_RESOLUTION_RX};
-const uint8_t mic_resolutions_per_format[CFG_TUD_AUDIO_FUNC_1_N_FORMATS] = {CFG_TUD_AUDIO_FUNC_1_FORMAT_1_RESOLUTION_TX};
+// Resolution and bytes per sample of each format, indexed by alternate setting - 1
+#define UAC_FORMAT_RESOLUTION_X(_alt, _bytes, _bits, ...)   [(_alt) - 1] = (_bits),
+#define UAC_FORMAT_BYTES_X(_alt, _bytes, _bits, ...)        [(_alt) - 1] = (_bytes),
+#define UAC_FORMAT_FITS_X(_alt, _bytes, _bits, _widest)     _Static_assert((_bytes) <= (_widest), "format 1 must be the widest, the buffers are sized from it");
+const uint8_t spk_resolutions_per_format[CFG_TUD_AUDIO_FUNC_1_N_FORMATS] = {UAC_SPK_FORMATS(UAC_FORMAT_RESOLUTION_X, 0)};
+const uint8_t mic_resolutions_per_format[CFG_TUD_AUDIO_FUNC_1_N_FORMATS] = {UAC_MIC_FORMATS(UAC_FORMAT_RESOLUTION_X, 0)};
+static const uint8_t spk_bytes_per_format[CFG_TUD_AUDIO_FUNC_1_N_FORMATS] = {UAC_SPK_FORMATS(UAC_FORMAT_BYTES_X, 0)};
+static const uint8_t mic_bytes_per_format[CFG_TUD_AUDIO_FUNC_1_N_FORMATS] = {UAC_MIC_FORMATS(UAC_FORMAT_BYTES_X, 0)};
+UAC_SPK_FORMATS(UAC_FORMAT_FITS_X, CFG_TUD_AUDIO_FUNC_1_FORMAT_1_N_BYTES_PER_SAMPLE_TX)
+UAC_MIC_FORMATS(UAC_FORMAT_FITS_X, CFG_TUD_AUDIO_FUNC_1_FORMAT_1_N_BYTES_PER_SAMPLE_RX)
+
+/**
+ * @brief Playback block shared by the output callback and the subscribers. The block is free
+ *        when refs drops to 0, the pool is sized so that allocation never waits for a reader.
+ */
+typedef struct {
+    uac_block_t block;                                           // Must stay first, subscribers get &block
+    uint32_t refs;                                               // Readers holding the block
+    int16_t data[CFG_TUD_AUDIO_FUNC_1_EP_OUT_SW_BUF_SZ / 2];
+} uac_pool_block_t;
+
+#if CFG_TUD_AUDIO_FUNC_1_N_CHANNELS_RX
+// Capture data waiting for the IN packets, three capture periods at the largest packet size
+#define UAC_MIC_RING_SZ         (3 * MIC_INTERVAL_MS * (CFG_TUD_AUDIO_FUNC_1_MAX_SAMPLE_RATE / 1000 + 1) * \
+                                 CFG_TUD_AUDIO_FUNC_1_N_CHANNELS_RX * CFG_TUD_AUDIO_FUNC_1_FORMAT_1_N_BYTES_PER_SAMPLE_RX)
+// Silence sent ahead of the first capture period, the lowest ring fill once the servo has settled.
+// Every underrun adds 1 ms, so a producer with more jitter than expected settles at a margin that covers it
+#define UAC_MIC_MARGIN_MS       2
+#define UAC_MIC_MARGIN_MAX_MS   MIC_INTERVAL_MS
+// Ring fill servo, updated once per capture period: natural frequency 0.3 rad/s, damping about 0.8.
+// The integral term is the rate error and is held within 0.1 frame per packet, 2000 ppm
+#define UAC_MIC_SERVO_KP_DIV    2000
+#define UAC_MIC_SERVO_KI_DIV    1000000
+#define UAC_MIC_SERVO_INTEG_MAX (UAC_MIC_SERVO_KI_DIV / 10)
+#if CONFIG_UAC_MIC_RESAMPLER
+// Resampled capture block, the servo ratio never goes below 47/48 at 48 kHz
+#define UAC_MIC_RS_MAX_FRAMES   (MIC_INTERVAL_MS * (CFG_TUD_AUDIO_FUNC_1_MAX_SAMPLE_RATE / 1000 + 2))
+#endif
+#endif
+
+#if CONFIG_UAC_LOOPBACK
+// OUT data waiting for the IN stream, three capture periods in the IN frame layout
+#define UAC_LOOPBACK_RING_SZ    (3 * MIC_INTERVAL_MS * (CFG_TUD_AUDIO_FUNC_1_MAX_SAMPLE_RATE / 1000 + 1) * \
+                                 CFG_TUD_AUDIO_FUNC_1_N_CHANNELS_RX * CFG_TUD_AUDIO_FUNC_1_FORMAT_1_N_BYTES_PER_SAMPLE_RX)
+#endif
+
+// Blocks used by the device itself: the playback queue, the block in output_cb and the block being filled
+#define UAC_SPK_QUEUE_LEN       2
+#define UAC_SPK_POOL_RESERVED   (UAC_SPK_QUEUE_LEN + 2)
+// One SOF timestamp per window, see uac_device_get_sof_time
+#define UAC_SOF_WINDOW_US       32000
+#define UAC_FU_MAX_CHANNELS     (SPEAK_CHANNEL_NUM > MIC_CHANNEL_NUM ? SPEAK_CHANNEL_NUM : MIC_CHANNEL_NUM)
+
+struct uac_subscriber_s {
+    QueueHandle_t queue;
+    uint32_t depth;                                              // Maximum blocks queued or held
+    uint32_t outstanding;                                        // Blocks queued or held right now
+    uint32_t dropped;                                            // Blocks skipped since the last receive
+    bool in_use;                                                 // Under s_mux, spk_publish delivers only then
+    bool publishing;                                             // spk_publish is sending to queue, under s_mux
+};
 
 typedef struct {
     usb_phy_handle_t phy_hdl;
     uac_device_config_t user_cfg;
-    int8_t mute[CFG_TUD_AUDIO_FUNC_1_N_CHANNELS_TX + 1];         // +1 for master channel 0
-    int16_t volume[CFG_TUD_AUDIO_FUNC_1_N_CHANNELS_TX + 1];      // +1 for master channel 0
-    int16_t mic_buf1[CFG_TUD_AUDIO_FUNC_1_EP_IN_SW_BUF_SZ / 2];  // Buffer for microphone data
-    int16_t mic_buf2[CFG_TUD_AUDIO_FUNC_1_EP_IN_SW_BUF_SZ / 2];  // Buffer for microphone data
-    int16_t spk_buf[CFG_TUD_AUDIO_FUNC_1_EP_OUT_SW_BUF_SZ / 2];  // Buffer for speaker data
-    int16_t *mic_buf_write;                                      // Pointer to the buffer to write to
-    int16_t *mic_buf_read;                                       // Pointer to the buffer to read from
-    int spk_data_size;                                           // Speaker data size received in the last frame
-    int mic_data_size;
+    // per feature unit, +1 for master channel 0
+    int8_t mute[UAC_FEATURE_UNIT_NUM][UAC_FU_MAX_CHANNELS + 1];
+    int16_t volume[UAC_FEATURE_UNIT_NUM][UAC_FU_MAX_CHANNELS + 1];
+    int8_t agc[UAC_FEATURE_UNIT_NUM][UAC_FU_MAX_CHANNELS + 1];
+    uac_volume_range_t volume_range[UAC_FEATURE_UNIT_NUM];
+    int16_t *mic_buf;                                            // Capture block being filled, in the hot arena
     int spk_itf_num;
     int mic_itf_num;
     uint8_t spk_resolution;
@@ -63,6 +137,68 @@ typedef struct {
     TaskHandle_t spk_task_handle;
     size_t spk_bytes_per_ms;
     size_t mic_bytes_per_ms;
+    uint32_t spk_path_latency;                                   // Frames behind output_cb, set by the application
+    uint32_t mic_path_latency;                                   // Frames ahead of input_cb, set by the application
+#if CONFIG_UAC_MONITOR_MIXER_UNIT
+    int16_t monitor_gain[MIC_CHANNEL_NUM][SPEAK_CHANNEL_NUM];    // Mic to speaker crosspoints of the monitor mixer
+#endif
+    uac_format_t spk_format;                                     // Format of the open speaker alt setting
+    uac_format_t mic_format;                                     // Format of the open mic alt setting
+#if CFG_TUD_AUDIO_FUNC_1_N_CHANNELS_TX
+    uac_pool_block_t *spk_pool;                                  // CONFIG_UAC_SPK_POOL_BLOCKS blocks in the hot arena
+    QueueHandle_t spk_queue;                                     // Blocks waiting for the output callback
+    SemaphoreHandle_t sub_lock;                                  // Serializes subscribe and unsubscribe, never taken by spk_publish
+    struct uac_subscriber_s subscribers[CONFIG_UAC_SPK_MAX_SUBSCRIBERS];
+    uint32_t sub_reserved;                                       // Pool blocks reserved by subscribers
+    uint32_t spk_overruns;                                       // Blocks replaced because output_cb fell behind
+#endif
+    uint64_t spk_sample_pos;                                     // Frames received so far
+    uint64_t mic_sample_pos;                                     // Frames taken from the input callback so far
+    uint32_t spk_flags;                                          // Flags for the next speaker block
+    uint32_t mic_flags;                                          // Flags for the next mic block
+    volatile uint32_t sof_count;                                 // Updated from tud_sof_cb
+    uint32_t sof_period_us;                                      // Fields below are owned by tud_sof_cb
+    uint32_t sof_frames;                                         // SOF periods since the epoch began
+    uint32_t sof_window_n;
+    uac_sof_time_t sof_window;                                   // Earliest callback of the open window
+    uac_sof_time_t sof_time;                                     // Last closed window, guarded by s_mux
+    uac_task_latency_t task_latency[UAC_TASK_NUM];               // Written by the measured task only
+    uint64_t task_latency_sum[UAC_TASK_NUM];
+#if CFG_TUD_AUDIO_FUNC_1_N_CHANNELS_RX
+    uint8_t *mic_ring;                                           // UAC_MIC_RING_SZ bytes, written by usb_mic_task, read per IN packet
+    size_t mic_ring_write;                                       // Guarded by s_mux together with mic_ring_fill
+    size_t mic_ring_read;                                        // Owned by the TinyUSB task, as are the fields below
+    size_t mic_ring_fill;
+    bool mic_started;                                            // The first capture period has arrived
+    bool mic_primed;                                             // Packets are taken from the ring
+    uint32_t mic_margin_ms;                                      // Ring fill kept ahead of the capture period
+    uint32_t mic_preroll;                                        // Silent packets still to send before the ring is read
+    uint32_t mic_rate_q16;                                       // Frames per IN packet, 16.16
+    uint32_t mic_nominal_q16;                                    // Frames per IN packet at the nominal rate, 16.16
+    uint32_t mic_rate_frac;                                      // Fraction of a frame carried to the next packet
+    int32_t mic_servo_integ;
+    uint32_t mic_fill_sum;
+    uint32_t mic_fill_count;
+    uac_mic_stats_t mic_stats;
+#if CONFIG_UAC_MIC_RESAMPLER
+    uint8_t *mic_rs_buf;                                         // UAC_MIC_RS_MAX_FRAMES frames, in the hot arena
+    uac_resampler_t *mic_rs;                                     // Filter state, in the hot arena, owned by usb_mic_task
+    bool mic_rs_supported;                                       // Owned by usb_mic_task
+#endif
+    volatile bool mic_resample;                                  // The ring holds resampled data, packets have the nominal size
+#endif
+#if CONFIG_UAC_LOOPBACK
+    volatile uac_loopback_mode_t loopback;
+    uint8_t *lb_ring;                                            // UAC_LOOPBACK_RING_SZ bytes, written by usb_spk_task, read by usb_mic_task
+    size_t lb_write;                                             // Guarded by s_mux together with lb_fill
+    size_t lb_read;                                              // Owned by usb_mic_task
+    size_t lb_fill;
+    volatile bool lb_flush;                                      // Drop the ring content before the next read
+    int64_t lb_last_arrival_us;                                  // Arrival of the newest OUT block in the ring
+    uac_loopback_stats_t lb_stats;
+    uint64_t lb_latency_sum;
+    uint32_t lb_latency_count;
+#endif
     bool spk_active;
     bool mic_active;
 } uac_device_t;
@@ -72,6 +208,18 @@ static portMUX_TYPE s_mux = portMUX_INITIALIZER_UNLOCKED;
 #define UAC_ENTER_CRITICAL()    portENTER_CRITICAL(&s_mux)
 #define UAC_EXIT_CRITICAL()     portEXIT_CRITICAL(&s_mux)
 
+static void task_latency_record(uac_task_id_t task, int64_t latency_us)
+{
+    uac_task_latency_t *st = &s_uac_device->task_latency[task];
+    const uint32_t us = latency_us < 0 ? 0 : (uint32_t)latency_us;
+    st->wakeups++;
+    s_uac_device->task_latency_sum[task] += us;
+    st->max_us = us > st->max_us ? us : st->max_us;
+    if (us > UAC_TASK_LATE_US) {
+        st->late++;
+    }
+}
+
 static void usb_phy_init(void)
 {
     // Configure USB PHY
@@ -124,6 +272,53 @@ void tud_resume_cb(void)
 {
     ESP_LOGI(TAG, "USB resumed");
 }
+
+// Timestamp one SOF per window for uac_device_get_sof_time. The window is kept short so that the drift
+// between the host and the local clock within it, at most a few microseconds, does not bias the minimum
+static void sof_clock_update(uint32_t frame_count, uint32_t period_us, uint32_t mask, int64_t now, int64_t last_sof_us)
+{
+    uac_device_t *dev = s_uac_device;
+    const uint32_t delta = (frame_count - dev->sof_count) & mask;
+    // a gap the counter may have wrapped in starts a new epoch
+    if (period_us != dev->sof_period_us || now - last_sof_us > (int64_t)(mask / 2) * period_us) {
+        dev->sof_period_us = period_us;
+        dev->sof_frames = 0;
+        dev->sof_window_n = 0;
+        dev->sof_window.epoch++;
+    } else {
+        dev->sof_frames += delta;
+    }
+    // late callbacks are further from the count line, the earliest one of the window is closest to its SOF
+    const int64_t base = now - (int64_t)dev->sof_frames * period_us;
+    if (dev->sof_window_n == 0 || base < dev->sof_window.time_us - (int64_t)dev->sof_window.frames * period_us) {
+        dev->sof_window.frames = dev->sof_frames;
+        dev->sof_window.time_us = now;
+        dev->sof_window.period_us = period_us;
+    }
+    if (++dev->sof_window_n >= UAC_SOF_WINDOW_US / period_us) {
+        UAC_ENTER_CRITICAL();
+        dev->sof_time = dev->sof_window;
+        UAC_EXIT_CRITICAL();
+        dev->sof_window_n = 0;
+    }
+}
+
+// Invoked on every SOF, frame_count is the 11-bit frame number at full speed and the 14-bit microframe number at high speed
+void tud_sof_cb(uint32_t frame_count)
+{
+    static int64_t last_sof_us = 0;
+    const int64_t now = esp_timer_get_time();
+    const bool high_speed = tud_speed_get() == TUSB_SPEED_HIGH;
+    const uint32_t period_us = high_speed ? 125 : 1000;
+    const uint32_t mask = high_speed ? 0x3FFF : 0x7FF;
+    // the SOF callback is deferred to the TinyUSB task, a gap beyond one period is time the task was not served
+    if (((s_uac_device->sof_count + 1) & mask) == frame_count && (s_uac_device->spk_active || s_uac_device->mic_active)) {
+        task_latency_record(UAC_TASK_TINYUSB, now - last_sof_us - period_us);
+    }
+    sof_clock_update(frame_count, period_us, mask, now, last_sof_us);
+    last_sof_us = now;
+    s_uac_device->sof_count = frame_count;
+}
 #endif
 
 // Helper for clock get requests
@@ -200,31 +395,84 @@ void tud_audio_feedback_params_cb(uint8_t func_id, uint8_t alt_itf, audio_feedba
     ESP_LOGD(TAG, "Feedback method: %d, sample freq: %"PRIu32"", feedback_param->method, feedback_param->sample_freq);
 }
 
+// Feature unit and channel count of an entity, false if the entity is no feature unit of this device
+static bool feature_unit_of(uint8_t entity, uac_feature_unit_t *unit, uint8_t *channels)
+{
+#if SPEAK_CHANNEL_NUM
+    if (entity == UAC2_ENTITY_SPK_FEATURE_UNIT) {
+        *unit = UAC_FEATURE_UNIT_SPK;
+        *channels = SPEAK_CHANNEL_NUM;
+        return true;
+    }
+#endif
+#if MIC_CHANNEL_NUM
+    if (entity == UAC2_ENTITY_MIC_FEATURE_TERMINAL) {
+        *unit = UAC_FEATURE_UNIT_MIC;
+        *channels = MIC_CHANNEL_NUM;
+        return true;
+    }
+#endif
+    return false;
+}
+
+// Mute of a feature unit channel to the application, the speaker unit goes to the v1 callback if it is set
+static void report_mute(uac_feature_unit_t unit, uint8_t channel, bool mute)
+{
+    if (unit == UAC_FEATURE_UNIT_SPK && s_uac_device->user_cfg.set_mute_cb) {
+        s_uac_device->user_cfg.set_mute_cb(mute, s_uac_device->user_cfg.cb_ctx);
+    } else if (s_uac_device->user_cfg.set_fu_mute_cb) {
+        s_uac_device->user_cfg.set_fu_mute_cb(unit, channel, mute, s_uac_device->user_cfg.cb_ctx);
+    }
+}
+
+static void report_volume(uac_feature_unit_t unit, uint8_t channel, int16_t volume)
+{
+    if (unit == UAC_FEATURE_UNIT_SPK && s_uac_device->user_cfg.set_volume_cb) {
+        // position in the range, rounded to the nearest percent
+        const uac_volume_range_t *range = &s_uac_device->volume_range[unit];
+        const int32_t span = range->max - range->min;
+        const uint32_t percent = span > 0 ? ((volume - range->min) * 100 + span / 2) / span : 100;
+        s_uac_device->user_cfg.set_volume_cb(percent, s_uac_device->user_cfg.cb_ctx);
+    } else if (s_uac_device->user_cfg.set_fu_volume_cb) {
+        s_uac_device->user_cfg.set_fu_volume_cb(unit, channel, volume, s_uac_device->user_cfg.cb_ctx);
+    }
+}
+
 // Helper for feature unit get requests
 static bool tud_audio_feature_unit_get_request(uint8_t rhport, audio_control_request_t const *request)
 {
-    TU_ASSERT(request->bEntityID == UAC2_ENTITY_SPK_FEATURE_UNIT);
-
-    if (request->bControlSelector == AUDIO_FU_CTRL_MUTE && request->bRequest == AUDIO_CS_REQ_CUR) {
+    uac_feature_unit_t unit;
+    uint8_t channels;
+    TU_ASSERT(feature_unit_of(request->bEntityID, &unit, &channels));
+    TU_VERIFY(request->bChannelNumber <= channels);
+
+    if (request->bControlSelector == AUDIO_FU_CTRL_AGC && request->bRequest == AUDIO_CS_REQ_CUR) {
+        audio_control_cur_1_t agc1 = {
+            .bCur = s_uac_device->agc[unit][request->bChannelNumber]
+        };
+        TU_LOG1("Get unit %u channel %u AGC %d\r\n", request->bEntityID, request->bChannelNumber, agc1.bCur);
+        return tud_audio_buffer_and_schedule_control_xfer(rhport, (tusb_control_request_t const *)request, &agc1, sizeof(agc1));
+    } else if (request->bControlSelector == AUDIO_FU_CTRL_MUTE && request->bRequest == AUDIO_CS_REQ_CUR) {
         audio_control_cur_1_t mute1 = {
-            .bCur = s_uac_device->mute[request->bChannelNumber]
+            .bCur = s_uac_device->mute[unit][request->bChannelNumber]
         };
-        TU_LOG1("Get channel %u mute %d\r\n", request->bChannelNumber, mute1.bCur);
+        TU_LOG1("Get unit %u channel %u mute %d\r\n", request->bEntityID, request->bChannelNumber, mute1.bCur);
         return tud_audio_buffer_and_schedule_control_xfer(rhport, (tusb_control_request_t const *)request, &mute1, sizeof(mute1));
-    } else if (UAC2_ENTITY_SPK_FEATURE_UNIT && request->bControlSelector == AUDIO_FU_CTRL_VOLUME) {
+    } else if (request->bControlSelector == AUDIO_FU_CTRL_VOLUME) {
         if (request->bRequest == AUDIO_CS_REQ_RANGE) {
+            const uac_volume_range_t *range = &s_uac_device->volume_range[unit];
             audio_control_range_2_n_t(1) range_vol = {
                 .wNumSubRanges = tu_htole16(1),
-                .subrange[0] = { .bMin = tu_htole16(-VOLUME_CTRL_50_DB), tu_htole16(VOLUME_CTRL_0_DB), tu_htole16(256) }
+                .subrange[0] = { .bMin = tu_htole16(range->min), tu_htole16(range->max), tu_htole16(range->res) }
             };
-            TU_LOG1("Get channel %u volume range (%d, %d, %u) dB\r\n", request->bChannelNumber,
-                    range_vol.subrange[0].bMin / 256, range_vol.subrange[0].bMax / 256, range_vol.subrange[0].bRes / 256);
+            TU_LOG1("Get unit %u channel %u volume range (%d, %d, %u) dB/256\r\n", request->bEntityID, request->bChannelNumber,
+                    range_vol.subrange[0].bMin, range_vol.subrange[0].bMax, range_vol.subrange[0].bRes);
             return tud_audio_buffer_and_schedule_control_xfer(rhport, (tusb_control_request_t const *)request, &range_vol, sizeof(range_vol));
         } else if (request->bRequest == AUDIO_CS_REQ_CUR) {
             audio_control_cur_2_t cur_vol = {
-                .bCur = tu_htole16(s_uac_device->volume[request->bChannelNumber])
+                .bCur = tu_htole16(s_uac_device->volume[unit][request->bChannelNumber])
             };
-            TU_LOG1("Get channel %u volume %d dB\r\n", request->bChannelNumber, cur_vol.bCur / 256);
+            TU_LOG1("Get unit %u channel %u volume %d dB\r\n", request->bEntityID, request->bChannelNumber, cur_vol.bCur / 256);
             return tud_audio_buffer_and_schedule_control_xfer(rhport, (tusb_control_request_t const *)request, &cur_vol, sizeof(cur_vol));
         }
     }
@@ -238,27 +486,34 @@ static bool tud_audio_feature_unit_set_request(uint8_t rhport, audio_control_req
 {
     (void)rhport;
 
-    TU_ASSERT(request->bEntityID == UAC2_ENTITY_SPK_FEATURE_UNIT);
+    uac_feature_unit_t unit;
+    uint8_t channels;
+    TU_ASSERT(feature_unit_of(request->bEntityID, &unit, &channels));
     TU_VERIFY(request->bRequest == AUDIO_CS_REQ_CUR);
+    TU_VERIFY(request->bChannelNumber <= channels);
 
-    if (request->bControlSelector == AUDIO_FU_CTRL_MUTE) {
+    if (request->bControlSelector == AUDIO_FU_CTRL_AGC) {
         TU_VERIFY(request->wLength == sizeof(audio_control_cur_1_t));
-        s_uac_device->mute[request->bChannelNumber] = ((audio_control_cur_1_t const *)buf)->bCur;
-        TU_LOG1("Set speaker channel %d Mute: %d\r\n", request->bChannelNumber, s_uac_device->mute[request->bChannelNumber]);
-        if (s_uac_device->user_cfg.set_mute_cb) {
-            s_uac_device->user_cfg.set_mute_cb(s_uac_device->mute[request->bChannelNumber], s_uac_device->user_cfg.cb_ctx);
+        s_uac_device->agc[unit][request->bChannelNumber] = ((audio_control_cur_1_t const *)buf)->bCur;
+        TU_LOG1("Set unit %u channel %d AGC: %d\r\n", request->bEntityID, request->bChannelNumber, s_uac_device->agc[unit][request->bChannelNumber]);
+        if (s_uac_device->user_cfg.set_agc_cb) {
+            s_uac_device->user_cfg.set_agc_cb(unit, request->bChannelNumber, s_uac_device->agc[unit][request->bChannelNumber] != 0,
+                                              s_uac_device->user_cfg.cb_ctx);
         }
-
+        return true;
+    } else if (request->bControlSelector == AUDIO_FU_CTRL_MUTE) {
+        TU_VERIFY(request->wLength == sizeof(audio_control_cur_1_t));
+        s_uac_device->mute[unit][request->bChannelNumber] = ((audio_control_cur_1_t const *)buf)->bCur;
+        TU_LOG1("Set unit %u channel %d Mute: %d\r\n", request->bEntityID, request->bChannelNumber, s_uac_device->mute[unit][request->bChannelNumber]);
+        report_mute(unit, request->bChannelNumber, s_uac_device->mute[unit][request->bChannelNumber] != 0);
         return true;
     } else if (request->bControlSelector == AUDIO_FU_CTRL_VOLUME) {
         TU_VERIFY(request->wLength == sizeof(audio_control_cur_2_t));
-        s_uac_device->volume[request->bChannelNumber] = ((audio_control_cur_2_t const *)buf)->bCur;
-        int volume_db = s_uac_device->volume[request->bChannelNumber] / 256; // Convert to dB
-        int volume = (volume_db + 50) * 2; // Map to range 0 to 100
-        TU_LOG1("Set speaker channel %d volume: %d dB (%d)\r\n", request->bChannelNumber, volume_db, volume);
-        if (s_uac_device->user_cfg.set_volume_cb) {
-            s_uac_device->user_cfg.set_volume_cb(volume, s_uac_device->user_cfg.cb_ctx);
-        }
+        const uac_volume_range_t *range = &s_uac_device->volume_range[unit];
+        const int16_t volume = ((audio_control_cur_2_t const *)buf)->bCur;
+        s_uac_device->volume[unit][request->bChannelNumber] = volume < range->min ? range->min : volume > range->max ? range->max : volume;
+        TU_LOG1("Set unit %u channel %d volume: %d dB/256\r\n", request->bEntityID, request->bChannelNumber, s_uac_device->volume[unit][request->bChannelNumber]);
+        report_volume(unit, request->bChannelNumber, s_uac_device->volume[unit][request->bChannelNumber]);
         return true;
     } else {
         TU_LOG1("Feature unit set request not supported, entity = %u, selector = %u, request = %u\r\n",
@@ -267,6 +522,133 @@ static bool tud_audio_feature_unit_set_request(uint8_t rhport, audio_control_req
     }
 }
 
+#if CONFIG_UAC_MONITOR_MIXER_UNIT
+/**
+ * @brief Mixer control number to crosspoint. Input channels are speaker L/R followed by mic L/R,
+ *        MCN = (u - 1) * m + v with u the input and v the output channel, both 1-based.
+ */
+static bool monitor_crosspoint(uint8_t mcn, uint8_t *in_ch, uint8_t *out_ch)
+{
+    if (mcn == 0 || mcn > (SPEAK_CHANNEL_NUM + MIC_CHANNEL_NUM) * SPEAK_CHANNEL_NUM) {
+        return false;
+    }
+    *in_ch = (mcn - 1) / SPEAK_CHANNEL_NUM;
+    *out_ch = (mcn - 1) % SPEAK_CHANNEL_NUM;
+    return true;
+}
+
+// Helper for mixer unit get requests
+static bool tud_audio_mixer_unit_get_request(uint8_t rhport, audio_control_request_t const *request)
+{
+    uint8_t in_ch, out_ch;
+    TU_VERIFY(request->bControlSelector == AUDIO_MU_CTRL_MIXER);
+    TU_VERIFY(monitor_crosspoint(request->bChannelNumber, &in_ch, &out_ch));
+
+    if (request->bRequest == AUDIO_CS_REQ_RANGE) {
+        audio_control_range_2_n_t(1) range_gain = {
+            .wNumSubRanges = tu_htole16(1),
+            .subrange[0] = { .bMin = tu_htole16(-VOLUME_CTRL_60_DB), tu_htole16(VOLUME_CTRL_0_DB), tu_htole16(128) }
+        };
+        return tud_audio_buffer_and_schedule_control_xfer(rhport, (tusb_control_request_t const *)request, &range_gain, sizeof(range_gain));
+    } else if (request->bRequest == AUDIO_CS_REQ_CUR) {
+        int16_t gain;
+        if (in_ch < SPEAK_CHANNEL_NUM) {
+            // Playback passes straight through
+            gain = in_ch == out_ch ? VOLUME_CTRL_0_DB : (int16_t)VOLUME_CTRL_SILENCE;
+        } else {
+            gain = s_uac_device->monitor_gain[in_ch - SPEAK_CHANNEL_NUM][out_ch];
+        }
+        audio_control_cur_2_t cur_gain = {
+            .bCur = tu_htole16(gain)
+        };
+        TU_LOG1("Get mixer crosspoint %u gain %d dB\r\n", request->bChannelNumber, cur_gain.bCur / 256);
+        return tud_audio_buffer_and_schedule_control_xfer(rhport, (tusb_control_request_t const *)request, &cur_gain, sizeof(cur_gain));
+    }
+    TU_LOG1("Mixer unit get request not supported, entity = %u, selector = %u, request = %u\r\n",
+            request->bEntityID, request->bControlSelector, request->bRequest);
+
+    return false;
+}
+
+static bool tud_audio_mixer_unit_set_request(uint8_t rhport, audio_control_request_t const *request, uint8_t const *buf)
+{
+    (void)rhport;
+    uint8_t in_ch, out_ch;
+
+    TU_VERIFY(request->bRequest == AUDIO_CS_REQ_CUR && request->bControlSelector == AUDIO_MU_CTRL_MIXER);
+    TU_VERIFY(request->wLength == sizeof(audio_control_cur_2_t));
+    TU_VERIFY(monitor_crosspoint(request->bChannelNumber, &in_ch, &out_ch));
+    // Only the mic crosspoints are programmable, see MONITOR_MIXER_CTRL
+    TU_VERIFY(in_ch >= SPEAK_CHANNEL_NUM);
+    in_ch -= SPEAK_CHANNEL_NUM;
+
+    int16_t gain = ((audio_control_cur_2_t const *)buf)->bCur;
+    s_uac_device->monitor_gain[in_ch][out_ch] = gain;
+    TU_LOG1("Set monitor mic %u to speaker %u: %d dB\r\n", in_ch, out_ch, gain / 256);
+    if (s_uac_device->user_cfg.set_monitor_cb) {
+        s_uac_device->user_cfg.set_monitor_cb(in_ch, out_ch, gain, s_uac_device->user_cfg.cb_ctx);
+    }
+    return true;
+}
+#endif
+
+static uint32_t frames_to_ns(uint32_t frames)
+{
+    return (uint32_t)((uint64_t)frames * 1000000000ULL / s_uac_device->current_sample_rate);
+}
+
+/**
+ * @brief Playback latency: the FIFO is pre-filled to half of SPK_INTERVAL_MS on a new play and
+ *        one more 1 ms packet waits in the playback queue before output_cb, followed by the application path.
+ */
+static uint32_t spk_latency_ns(void)
+{
+    uint32_t usb_frames = s_uac_device->current_sample_rate * (SPK_INTERVAL_MS / 2 + 1) / 1000;
+    return frames_to_ns(usb_frames + s_uac_device->spk_path_latency);
+}
+
+/**
+ * @brief Capture latency: input_cb fills a whole MIC_INTERVAL_MS chunk before it is queued, the servo keeps
+ *        the margin in the ring ahead of it and one packet is in flight, preceded by the application path.
+ */
+static uint32_t mic_latency_ns(void)
+{
+#if CFG_TUD_AUDIO_FUNC_1_N_CHANNELS_RX
+    const uint32_t margin_ms = s_uac_device->mic_margin_ms;
+#else
+    const uint32_t margin_ms = 0;
+#endif
+    uint32_t usb_frames = s_uac_device->current_sample_rate * (MIC_INTERVAL_MS + margin_ms + 1) / 1000;
+#if CONFIG_UAC_MIC_RESAMPLER
+    usb_frames += s_uac_device->mic_resample ? UAC_RESAMPLER_DELAY_FRAMES : 0;
+#endif
+    return frames_to_ns(usb_frames + s_uac_device->mic_path_latency);
+}
+
+// Helper for terminal get requests
+static bool tud_audio_terminal_get_request(uint8_t rhport, audio_control_request_t const *request)
+{
+    if (request->bControlSelector == AUDIO_TE_CTRL_LATENCY && request->bRequest == AUDIO_CS_REQ_CUR) {
+        audio_control_cur_4_t cur_latency = { 0 };
+#if SPEAK_CHANNEL_NUM
+        if (request->bEntityID == UAC2_ENTITY_SPK_OUTPUT_TERMINAL) {
+            cur_latency.bCur = (int32_t) tu_htole32(spk_latency_ns());
+        }
+#endif
+#if MIC_CHANNEL_NUM
+        if (request->bEntityID == UAC2_ENTITY_MIC_INPUT_TERMINAL) {
+            cur_latency.bCur = (int32_t) tu_htole32(mic_latency_ns());
+        }
+#endif
+        TU_LOG1("Get terminal %u latency %ld ns\r\n", request->bEntityID, cur_latency.bCur);
+        return tud_audio_buffer_and_schedule_control_xfer(rhport, (tusb_control_request_t const *)request, &cur_latency, sizeof(cur_latency));
+    }
+    TU_LOG1("Terminal get request not supported, entity = %u, selector = %u, request = %u\r\n",
+            request->bEntityID, request->bControlSelector, request->bRequest);
+
+    return false;
+}
+
 //--------------------------------------------------------------------+
 // Application Callback API Implementations
 //--------------------------------------------------------------------+
@@ -279,7 +661,22 @@ bool tud_audio_get_req_entity_cb(uint8_t rhport, tusb_control_request_t const *p
     if (request->bEntityID == UAC2_ENTITY_CLOCK) {
         return tud_audio_clock_get_request(rhport, request);
     }
-    if (request->bEntityID == UAC2_ENTITY_SPK_FEATURE_UNIT) {
+#if SPEAK_CHANNEL_NUM
+    if (request->bEntityID == UAC2_ENTITY_SPK_OUTPUT_TERMINAL) {
+        return tud_audio_terminal_get_request(rhport, request);
+    }
+#endif
+#if MIC_CHANNEL_NUM
+    if (request->bEntityID == UAC2_ENTITY_MIC_INPUT_TERMINAL) {
+        return tud_audio_terminal_get_request(rhport, request);
+    }
+#endif
+#if CONFIG_UAC_MONITOR_MIXER_UNIT
+    if (request->bEntityID == UAC2_ENTITY_MONITOR_MIXER_UNIT) {
+        return tud_audio_mixer_unit_get_request(rhport, request);
+    }
+#endif
+    if (request->bEntityID == UAC2_ENTITY_SPK_FEATURE_UNIT || request->bEntityID == UAC2_ENTITY_MIC_FEATURE_TERMINAL) {
         return tud_audio_feature_unit_get_request(rhport, request);
     } else {
         TU_LOG1("Get request not handled, entity = %d, selector = %d, request = %d\r\n",
@@ -293,18 +690,390 @@ bool tud_audio_set_req_entity_cb(uint8_t rhport, tusb_control_request_t const *p
 {
     audio_control_request_t const *request = (audio_control_request_t const *)p_request;
 
-    if (request->bEntityID == UAC2_ENTITY_SPK_FEATURE_UNIT) {
+    if (request->bEntityID == UAC2_ENTITY_SPK_FEATURE_UNIT || request->bEntityID == UAC2_ENTITY_MIC_FEATURE_TERMINAL) {
         return tud_audio_feature_unit_set_request(rhport, request, buf);
     }
     if (request->bEntityID == UAC2_ENTITY_CLOCK) {
         return tud_audio_clock_set_request(rhport, request, buf);
     }
+#if CONFIG_UAC_MONITOR_MIXER_UNIT
+    if (request->bEntityID == UAC2_ENTITY_MONITOR_MIXER_UNIT) {
+        return tud_audio_mixer_unit_set_request(rhport, request, buf);
+    }
+#endif
     TU_LOG1("Set request not handled, entity = %d, selector = %d, request = %d\r\n",
             request->bEntityID, request->bControlSelector, request->bRequest);
 
     return false;
 }
 
+#if CFG_TUD_AUDIO_FUNC_1_N_CHANNELS_TX
+static uac_pool_block_t *spk_pool_alloc(void)
+{
+    uac_pool_block_t *pb = NULL;
+    UAC_ENTER_CRITICAL();
+    for (int i = 0; i < CONFIG_UAC_SPK_POOL_BLOCKS; i++) {
+        if (s_uac_device->spk_pool[i].refs == 0) {
+            pb = &s_uac_device->spk_pool[i];
+            pb->refs = 1;
+            break;
+        }
+    }
+    UAC_EXIT_CRITICAL();
+    return pb;
+}
+
+static void spk_pool_release(uac_pool_block_t *pb)
+{
+    UAC_ENTER_CRITICAL();
+    pb->refs--;
+    UAC_EXIT_CRITICAL();
+}
+
+static void spk_queue_flush(void)
+{
+    uac_pool_block_t *pb;
+    while (xQueueReceive(s_uac_device->spk_queue, &pb, 0) == pdTRUE) {
+        spk_pool_release(pb);
+    }
+}
+
+/**
+ * @brief Hand a filled block to the subscribers and the output callback. The caller's reference
+ *        is passed on to the playback queue. Nothing here waits for a reader: a subscriber at its
+ *        depth misses the block, a full playback queue loses its oldest block.
+ */
+static void spk_publish(uac_pool_block_t *pb)
+{
+    for (int i = 0; i < CONFIG_UAC_SPK_MAX_SUBSCRIBERS; i++) {
+        struct uac_subscriber_s *sub = &s_uac_device->subscribers[i];
+        QueueHandle_t queue = NULL;
+        // the subscriber is taken under the spinlock, unsubscribe waits for publishing to clear
+        UAC_ENTER_CRITICAL();
+        if (sub->in_use) {
+            if (sub->outstanding < sub->depth) {
+                sub->outstanding++;
+                pb->refs++;
+                sub->publishing = true;
+                queue = sub->queue;
+            } else {
+                sub->dropped++;
+            }
+        }
+        UAC_EXIT_CRITICAL();
+        if (queue) {
+            // outstanding never exceeds the queue length, this can not fail
+            xQueueSend(queue, &pb, 0);
+            UAC_ENTER_CRITICAL();
+            sub->publishing = false;
+            UAC_EXIT_CRITICAL();
+        }
+    }
+
+    if (xQueueSend(s_uac_device->spk_queue, &pb, 0) != pdTRUE) {
+        uac_pool_block_t *oldest;
+        if (xQueueReceive(s_uac_device->spk_queue, &oldest, 0) == pdTRUE) {
+            spk_pool_release(oldest);
+            s_uac_device->spk_overruns++;
+#if CONFIG_UAC_GLITCH_DETECTOR
+            uac_glitch_report(UAC_GLITCH_STREAM_OUT, UAC_GLITCH_OVERRUN, oldest->block.sample_pos, s_uac_device->sof_count, 0);
+#endif
+        }
+        xQueueSend(s_uac_device->spk_queue, &pb, 0);
+    }
+}
+#endif
+
+#if CONFIG_UAC_LOOPBACK
+/**
+ * @brief Queue an OUT block for the IN stream, called by usb_spk_task instead of the output callback.
+ *        The ring holds whole frames in the IN layout, so a frame never wraps.
+ */
+static void loopback_push(const uac_block_t *block)
+{
+    uac_loopback_stats_t *st = &s_uac_device->lb_stats;
+    const uac_format_t *out = block->format;
+    const uac_format_t *in = &s_uac_device->mic_format;
+    if (!s_uac_device->mic_active) {
+        return;
+    }
+    if (out->bits_per_sample != in->bits_per_sample) {
+        st->format_mismatch++;
+        return;
+    }
+    const size_t len = block->frames * in->bytes_per_frame;
+    if (len > UAC_LOOPBACK_RING_SZ - s_uac_device->lb_fill) {
+        st->overruns++;
+        return;
+    }
+    if (s_uac_device->lb_last_arrival_us != 0 && !(block->flags & UAC_BLOCK_FLAG_DISCONTINUITY)) {
+        const int64_t nominal = (int64_t)block->frames * 1000000 / out->sample_rate;
+        int64_t jitter = block->timestamp_us - s_uac_device->lb_last_arrival_us - nominal;
+        jitter = jitter < 0 ? -jitter : jitter;
+        st->jitter_max_us = jitter > st->jitter_max_us ? (uint32_t)jitter : st->jitter_max_us;
+    }
+
+    // the reader only looks past lb_write once it is published together with lb_fill
+    size_t pos = s_uac_device->lb_write;
+    if (out->bytes_per_frame == in->bytes_per_frame) {
+        pos = uac_ring_write(s_uac_device->lb_ring, UAC_LOOPBACK_RING_SZ, pos, block->data, len);
+    } else {
+        // common channels are copied, missing IN channels stay zero
+        const size_t common = (out->channels < in->channels ? out->channels : in->channels) * (in->bits_per_sample / 8);
+        const uint8_t *src = block->data;
+        for (size_t f = 0; f < block->frames; f++) {
+            uint8_t *dst = s_uac_device->lb_ring + pos;
+            memcpy(dst, src + f * out->bytes_per_frame, common);
+            memset(dst + common, 0, in->bytes_per_frame - common);
+            pos = (pos + in->bytes_per_frame) % UAC_LOOPBACK_RING_SZ;
+        }
+    }
+    UAC_ENTER_CRITICAL();
+    s_uac_device->lb_write = pos;
+    s_uac_device->lb_fill += len;
+    s_uac_device->lb_last_arrival_us = block->timestamp_us;
+    UAC_EXIT_CRITICAL();
+    st->blocks++;
+    st->bytes += len;
+}
+
+/**
+ * @brief Fill a capture chunk from the ring, called by usb_mic_task instead of the input callback.
+ *        A chunk is taken whole or not at all, so the IN stream stays frame aligned with the OUT stream.
+ */
+static size_t loopback_pull(uint8_t *buf, size_t len)
+{
+    uac_loopback_stats_t *st = &s_uac_device->lb_stats;
+    UAC_ENTER_CRITICAL();
+    if (s_uac_device->lb_flush) {
+        s_uac_device->lb_read = s_uac_device->lb_write;
+        s_uac_device->lb_fill = 0;
+        s_uac_device->lb_last_arrival_us = 0;
+        s_uac_device->lb_flush = false;
+    }
+    const size_t fill = s_uac_device->lb_fill;
+    const int64_t last_arrival_us = s_uac_device->lb_last_arrival_us;
+    UAC_EXIT_CRITICAL();
+    if (fill < len) {
+        memset(buf, 0, len);
+        if (st->blocks > 0) {
+            st->underruns++;
+        }
+        return len;
+    }
+    s_uac_device->lb_read = uac_ring_read(s_uac_device->lb_ring, UAC_LOOPBACK_RING_SZ, s_uac_device->lb_read, buf, len);
+    UAC_ENTER_CRITICAL();
+    s_uac_device->lb_fill -= len;
+    UAC_EXIT_CRITICAL();
+
+    // the oldest byte taken sits fill bytes behind the newest block, which holds about 1 ms
+    const size_t bytes_per_ms = s_uac_device->mic_bytes_per_ms;
+    int64_t latency = esp_timer_get_time() - last_arrival_us + (int64_t)(fill - bytes_per_ms) * 1000 / bytes_per_ms;
+    latency = latency < 0 ? 0 : latency;
+    s_uac_device->lb_latency_sum += latency;
+    s_uac_device->lb_latency_count++;
+    st->latency_max_us = latency > st->latency_max_us ? (uint32_t)latency : st->latency_max_us;
+
+    if (s_uac_device->loopback == UAC_LOOPBACK_CRC) {
+        // tag every millisecond of the stream, the IN packet boundaries move with the servo
+        const size_t frame = s_uac_device->mic_format.bytes_per_frame;
+        for (size_t off = 0; off + bytes_per_ms <= len; off += bytes_per_ms) {
+            uint8_t *tag = buf + off + bytes_per_ms - frame;
+            const uint32_t crc = esp_rom_crc32_le(0, buf + off, bytes_per_ms - frame);
+            memset(tag, 0, frame);
+            memcpy(tag, &crc, frame < sizeof(crc) ? frame : sizeof(crc));
+        }
+    }
+    return len;
+}
+
+#if !CONFIG_USB_DEVICE_UAC_AS_PART
+// Vendor requests to the device, they never reach the audio class driver
+bool tud_vendor_control_xfer_cb(uint8_t rhport, uint8_t stage, tusb_control_request_t const *request)
+{
+    static uac_loopback_stats_t stats;
+    if (stage != CONTROL_STAGE_SETUP) {
+        return true;
+    }
+    TU_VERIFY(request->bmRequestType_bit.recipient == TUSB_REQ_RCPT_DEVICE && request->bRequest == UAC_VENDOR_REQ_LOOPBACK);
+    if (request->bmRequestType_bit.direction == TUSB_DIR_OUT) {
+        TU_VERIFY(uac_device_set_loopback((uac_loopback_mode_t)tu_le16toh(request->wValue)) == ESP_OK);
+        return tud_control_status(rhport, request);
+    }
+    uac_device_get_loopback_stats(&stats, tu_le16toh(request->wValue) != 0);
+    return tud_control_xfer(rhport, request, &stats, TU_MIN(sizeof(stats), tu_le16toh(request->wLength)));
+}
+#endif
+#endif
+
+#if CFG_TUD_AUDIO_FUNC_1_N_CHANNELS_RX
+static uint8_t s_mic_silence[CFG_TUD_AUDIO_FUNC_1_EP_IN_SZ_MAX];
+
+/**
+ * @brief Start a new capture stream, called from the TinyUSB task when the mic interface opens.
+ */
+static void mic_stream_reset(void)
+{
+    UAC_ENTER_CRITICAL();
+    s_uac_device->mic_ring_read = s_uac_device->mic_ring_write;
+    s_uac_device->mic_ring_fill = 0;
+    UAC_EXIT_CRITICAL();
+    s_uac_device->mic_started = false;
+    s_uac_device->mic_primed = false;
+    s_uac_device->mic_margin_ms = UAC_MIC_MARGIN_MS;
+    s_uac_device->mic_nominal_q16 = (uint64_t)s_uac_device->current_sample_rate * 65536 / 1000;
+    s_uac_device->mic_rate_q16 = s_uac_device->mic_nominal_q16;
+    s_uac_device->mic_rate_frac = 0;
+    s_uac_device->mic_servo_integ = 0;
+    s_uac_device->mic_fill_sum = 0;
+    s_uac_device->mic_fill_count = 0;
+    memset(&s_uac_device->mic_stats, 0, sizeof(s_uac_device->mic_stats));
+}
+
+/**
+ * @brief Steer the packet size so the mean ring fill stays at half a capture period plus the margin.
+ *        The integral term settles at the capture rate measured against the USB frame clock.
+ *        While resampling, the same value sets the resampling ratio and the packets keep the nominal size.
+ */
+static void mic_servo_update(uint32_t fill_frames)
+{
+    s_uac_device->mic_fill_sum += fill_frames;
+    if (++s_uac_device->mic_fill_count < MIC_INTERVAL_MS) {
+        return;
+    }
+    // the producer adds a whole period at once, the mean over one period does not see the sawtooth
+    const uint32_t rate = s_uac_device->current_sample_rate;
+    const uint32_t mean = s_uac_device->mic_fill_sum / MIC_INTERVAL_MS;
+    const int32_t err = (int32_t)mean - (int32_t)((MIC_INTERVAL_MS / 2 + s_uac_device->mic_margin_ms) * rate / 1000);
+    s_uac_device->mic_fill_sum = 0;
+    s_uac_device->mic_fill_count = 0;
+
+    int32_t integ = s_uac_device->mic_servo_integ + err;
+    integ = integ > UAC_MIC_SERVO_INTEG_MAX ? UAC_MIC_SERVO_INTEG_MAX : integ;
+    integ = integ < -UAC_MIC_SERVO_INTEG_MAX ? -UAC_MIC_SERVO_INTEG_MAX : integ;
+    s_uac_device->mic_servo_integ = integ;
+    const int64_t measured = (int64_t)rate * 65536 / 1000 + (int64_t)integ * 65536 / UAC_MIC_SERVO_KI_DIV;
+    int64_t q16 = measured + (int64_t)err * 65536 / UAC_MIC_SERVO_KP_DIV;
+
+    // one frame either side of nominal, e.g. 47 to 49 frames at 48 kHz, and never more than the endpoint holds
+    const int64_t lo = (int64_t)(rate / 1000 - 1) << 16;
+    int64_t hi = (int64_t)((rate + 999) / 1000 + 1) << 16;
+    const int64_t ep_max = (int64_t)(CFG_TUD_AUDIO_FUNC_1_EP_IN_SZ_MAX / s_uac_device->mic_format.bytes_per_frame) << 16;
+    hi = hi < ep_max ? hi : ep_max;
+    q16 = q16 < lo ? lo : (q16 > hi ? hi : q16);
+    s_uac_device->mic_rate_q16 = (uint32_t)q16;
+    s_uac_device->mic_stats.rate_mhz = (uint32_t)(measured * 1000000 / 65536);
+    s_uac_device->mic_stats.fill_frames = mean;
+    s_uac_device->mic_stats.margin_ms = s_uac_device->mic_margin_ms;
+    s_uac_device->mic_stats.resampling = s_uac_device->mic_resample;
+}
+
+/**
+ * @brief Load the next IN packet into the FIFO: the frames of one service interval, sized by the servo.
+ *        Empty or short packets are only sent while priming and when the ring ran dry.
+ */
+static void mic_load_packet(void)
+{
+    uac_mic_stats_t *st = &s_uac_device->mic_stats;
+    const size_t frame = s_uac_device->mic_format.bytes_per_frame;
+    UAC_ENTER_CRITICAL();
+    size_t fill = s_uac_device->mic_ring_fill;
+    UAC_EXIT_CRITICAL();
+    uint32_t fill_frames = fill / frame;
+
+    if (!s_uac_device->mic_primed) {
+        // wait for a whole capture period, the margin then goes out as silence ahead of it
+        const size_t period = MIC_INTERVAL_MS * s_uac_device->current_sample_rate / 1000 * frame;
+        if (fill < period) {
+            if (s_uac_device->mic_started) {
+                st->packets++;
+                st->short_packets++;
+            }
+            return;
+        }
+        // start from exactly one period, anything older would only add latency
+        const size_t excess = fill - period;
+        s_uac_device->mic_ring_read = (s_uac_device->mic_ring_read + excess) % UAC_MIC_RING_SZ;
+        UAC_ENTER_CRITICAL();
+        s_uac_device->mic_ring_fill -= excess;
+        UAC_EXIT_CRITICAL();
+        fill = period;
+        fill_frames = fill / frame;
+        s_uac_device->mic_started = true;
+        s_uac_device->mic_primed = true;
+        s_uac_device->mic_preroll = s_uac_device->mic_margin_ms;
+        s_uac_device->mic_fill_sum = 0;
+        s_uac_device->mic_fill_count = 0;
+    }
+
+    s_uac_device->mic_rate_frac += s_uac_device->mic_resample ? s_uac_device->mic_nominal_q16 : s_uac_device->mic_rate_q16;
+    const uint32_t frames = s_uac_device->mic_rate_frac >> 16;
+    s_uac_device->mic_rate_frac &= 0xFFFF;
+    st->packets++;
+    if (s_uac_device->mic_preroll > 0) {
+        s_uac_device->mic_preroll--;
+        tud_audio_write(s_mic_silence, frames * frame);
+        return;
+    }
+    mic_servo_update(fill_frames);
+
+    size_t len = frames * frame;
+    if (fill < len) {
+        // the ring ran dry, send what is left and prime again with a wider margin
+        len = fill_frames * frame;
+        st->short_packets++;
+        st->underruns++;
+        s_uac_device->mic_primed = false;
+        if (s_uac_device->mic_margin_ms < UAC_MIC_MARGIN_MAX_MS) {
+            s_uac_device->mic_margin_ms++;
+        }
+#if CONFIG_UAC_GLITCH_DETECTOR
+        uac_glitch_report(UAC_GLITCH_STREAM_IN, UAC_GLITCH_SHORT_PACKET, s_uac_device->mic_sample_pos - fill_frames,
+                          s_uac_device->sof_count, frames * frame - len);
+#endif
+    } else {
+        st->frames_min = (st->frames_min == 0 || frames < st->frames_min) ? frames : st->frames_min;
+        st->frames_max = frames > st->frames_max ? frames : st->frames_max;
+    }
+    if (len == 0) {
+        return;
+    }
+    size_t first = UAC_MIC_RING_SZ - s_uac_device->mic_ring_read;
+    first = len < first ? len : first;
+    tud_audio_write(s_uac_device->mic_ring + s_uac_device->mic_ring_read, first);
+    if (len > first) {
+        tud_audio_write(s_uac_device->mic_ring, len - first);
+    }
+    s_uac_device->mic_ring_read = (s_uac_device->mic_ring_read + len) % UAC_MIC_RING_SZ;
+    UAC_ENTER_CRITICAL();
+    s_uac_device->mic_ring_fill -= len;
+    UAC_EXIT_CRITICAL();
+}
+
+/**
+ * @brief Append a capture block to the ring, called by usb_mic_task.
+ * @return false if the ring is full and the block was dropped
+ */
+static bool mic_ring_push(const uint8_t *data, size_t len)
+{
+    UAC_ENTER_CRITICAL();
+    const size_t space = UAC_MIC_RING_SZ - s_uac_device->mic_ring_fill;
+    const size_t pos = s_uac_device->mic_ring_write;
+    UAC_EXIT_CRITICAL();
+    if (len > space) {
+        s_uac_device->mic_stats.overruns++;
+        return false;
+    }
+    const size_t next = uac_ring_write(s_uac_device->mic_ring, UAC_MIC_RING_SZ, pos, data, len);
+    UAC_ENTER_CRITICAL();
+    // a stream reset in between moved the read position here, the block still lands at the head
+    s_uac_device->mic_ring_write = next;
+    s_uac_device->mic_ring_fill += len;
+    UAC_EXIT_CRITICAL();
+    return true;
+}
+#endif
+
 bool tud_audio_set_itf_close_EP_cb(uint8_t rhport, tusb_control_request_t const *p_request)
 {
     (void)rhport;
@@ -315,15 +1084,14 @@ bool tud_audio_set_itf_close_EP_cb(uint8_t rhport, tusb_control_request_t const
 #if CFG_TUD_AUDIO_FUNC_1_N_CHANNELS_TX
     if (s_uac_device->spk_itf_num == itf && alt == 0) {
         TU_LOG2("Speaker interface closed");
-        s_uac_device->spk_data_size = 0;
         s_uac_device->spk_active = false;
+        spk_queue_flush();
     }
 #endif
 
 #if CFG_TUD_AUDIO_FUNC_1_N_CHANNELS_RX
     if (s_uac_device->mic_itf_num == itf && alt == 0) {
         TU_LOG2("Microphone interface closed");
-        s_uac_device->mic_data_size = 0;
         s_uac_device->mic_active = false;
     }
 #endif
@@ -341,10 +1109,18 @@ bool tud_audio_set_itf_cb(uint8_t rhport, tusb_control_request_t const *p_reques
 
 #if CFG_TUD_AUDIO_FUNC_1_N_CHANNELS_TX
     if (s_uac_device->spk_itf_num == itf && alt != 0) {
-        s_uac_device->spk_data_size = 0;
+        spk_queue_flush();
         s_uac_device->spk_resolution = spk_resolutions_per_format[alt - 1];
+        const uint32_t spk_bytes = spk_bytes_per_format[alt - 1];
         s_uac_device->spk_active = true;
-        s_uac_device->spk_bytes_per_ms = s_uac_device->current_sample_rate / 1000 * SPEAK_CHANNEL_NUM * s_uac_device->spk_resolution / 8;
+        s_uac_device->spk_bytes_per_ms = s_uac_device->current_sample_rate / 1000 * SPEAK_CHANNEL_NUM * spk_bytes;
+        s_uac_device->spk_format = (uac_format_t) {
+            .sample_rate = s_uac_device->current_sample_rate,
+            .channels = SPEAK_CHANNEL_NUM,
+            .bits_per_sample = s_uac_device->spk_resolution,
+            .bytes_per_frame = SPEAK_CHANNEL_NUM * spk_bytes,
+        };
+        s_uac_device->spk_flags = UAC_BLOCK_FLAG_DISCONTINUITY;
         xTaskNotifyGive(s_uac_device->spk_task_handle);
         TU_LOG1("Speaker interface %d-%d opened", itf, alt);
         printf("Speaker interface %d-%d opened\n", itf, alt);
@@ -353,10 +1129,21 @@ bool tud_audio_set_itf_cb(uint8_t rhport, tusb_control_request_t const *p_reques
 
 #if CFG_TUD_AUDIO_FUNC_1_N_CHANNELS_RX
     if (s_uac_device->mic_itf_num == itf && alt != 0) {
-        s_uac_device->mic_data_size = 0;
+#if CONFIG_UAC_LOOPBACK
+        s_uac_device->lb_flush = true;
+#endif
         s_uac_device->mic_resolution = mic_resolutions_per_format[alt - 1];
+        const uint32_t mic_bytes = mic_bytes_per_format[alt - 1];
         s_uac_device->mic_active = true;
-        s_uac_device->mic_bytes_per_ms = s_uac_device->current_sample_rate / 1000 * MIC_CHANNEL_NUM * s_uac_device->mic_resolution / 8;
+        s_uac_device->mic_bytes_per_ms = s_uac_device->current_sample_rate / 1000 * MIC_CHANNEL_NUM * mic_bytes;
+        s_uac_device->mic_format = (uac_format_t) {
+            .sample_rate = s_uac_device->current_sample_rate,
+            .channels = MIC_CHANNEL_NUM,
+            .bits_per_sample = s_uac_device->mic_resolution,
+            .bytes_per_frame = MIC_CHANNEL_NUM * mic_bytes,
+        };
+        s_uac_device->mic_flags = UAC_BLOCK_FLAG_DISCONTINUITY;
+        mic_stream_reset();
         xTaskNotifyGive(s_uac_device->mic_task_handle);
         TU_LOG1("Microphone interface %d-%d opened", itf, alt);
         printf("Microphone interface %d-%d opened\n", itf, alt);
@@ -366,12 +1153,14 @@ bool tud_audio_set_itf_cb(uint8_t rhport, tusb_control_request_t const *p_reques
     return true;
 }
 
+#if CFG_TUD_AUDIO_FUNC_1_N_CHANNELS_TX
 bool tud_audio_rx_done_post_read_cb(uint8_t rhport, uint16_t n_bytes_received, uint8_t func_id, uint8_t ep_out, uint8_t cur_alt_setting)
 {
     (void)rhport;
     (void)func_id;
     (void)ep_out;
     (void)cur_alt_setting;
+    UAC_TRACE_BEGIN(UAC_TRACE_SPK_RX_CB, n_bytes_received);
 
     static bool new_play = false;
     static int64_t last_time = 0;
@@ -383,9 +1172,21 @@ bool tud_audio_rx_done_post_read_cb(uint8_t rhport, uint16_t n_bytes_received, u
      *        of data is buffered in the I2S.
      */
     if (now - last_time > 100 * CONFIG_UAC_SPK_NEW_PLAY_INTERVAL) {
+#if CONFIG_UAC_GLITCH_DETECTOR
+        // a gap below a second without an interface change is a dropout rather than a new stream
+        if (!(s_uac_device->spk_flags & UAC_BLOCK_FLAG_DISCONTINUITY) && now - last_time < 1000000) {
+            uac_glitch_report(UAC_GLITCH_STREAM_OUT, UAC_GLITCH_FIFO_FLUSH, s_uac_device->spk_sample_pos, s_uac_device->sof_count, now - last_time);
+        }
+#endif
         new_play = true;
         tud_audio_clear_ep_out_ff();
+        s_uac_device->spk_flags |= UAC_BLOCK_FLAG_DISCONTINUITY;
+    }
+#if CONFIG_UAC_GLITCH_DETECTOR
+    else if (!new_play && now - last_time > 1500) {
+        uac_glitch_report(UAC_GLITCH_STREAM_OUT, UAC_GLITCH_LATE_PACKET, s_uac_device->spk_sample_pos, s_uac_device->sof_count, now - last_time);
     }
+#endif
     last_time = now;
 
     int bytes_remained = tud_audio_available();
@@ -396,15 +1197,41 @@ bool tud_audio_rx_done_post_read_cb(uint8_t rhport, uint16_t n_bytes_received, u
         /*!< Buffer a segment of data in the I2S and control the data size to be half of the UAC FIFO size. */
         bytes_require = SPK_INTERVAL_MS * s_uac_device->spk_bytes_per_ms / 2;
         if (bytes_remained < bytes_require) {
+            UAC_TRACE_END(UAC_TRACE_SPK_RX_CB, 0);
             return true;
         }
         new_play = false;
     }
 
-    s_uac_device->spk_data_size = tud_audio_read(s_uac_device->spk_buf, bytes_require);
-    xTaskNotifyGive(s_uac_device->spk_task_handle);
+    uac_pool_block_t *pb = spk_pool_alloc();
+    if (pb == NULL) {
+        // only possible if a reader releases blocks it does not own
+        ESP_LOGE(TAG, "Playback block pool exhausted");
+        UAC_TRACE_END(UAC_TRACE_SPK_RX_CB, 0);
+        return true;
+    }
+    size_t bytes_read = tud_audio_read(pb->data, bytes_require);
+#if CONFIG_UAC_GLITCH_DETECTOR
+    if (bytes_read < bytes_require) {
+        uac_glitch_report(UAC_GLITCH_STREAM_OUT, UAC_GLITCH_SHORT_PACKET, s_uac_device->spk_sample_pos, s_uac_device->sof_count, bytes_require - bytes_read);
+    }
+#endif
+    pb->block = (uac_block_t) {
+        .format = &s_uac_device->spk_format,
+        .data = pb->data,
+        .frames = bytes_read / s_uac_device->spk_format.bytes_per_frame,
+        .sample_pos = s_uac_device->spk_sample_pos,
+        .sof_frame = s_uac_device->sof_count,
+        .timestamp_us = now,
+        .flags = s_uac_device->spk_flags,
+    };
+    s_uac_device->spk_sample_pos += pb->block.frames;
+    s_uac_device->spk_flags = 0;
+    spk_publish(pb);
+    UAC_TRACE_END(UAC_TRACE_SPK_RX_CB, bytes_read);
     return true;
 }
+#endif
 
 bool tud_audio_tx_done_pre_load_cb(uint8_t rhport, uint8_t itf, uint8_t ep_in, uint8_t cur_alt_setting)
 {
@@ -412,22 +1239,15 @@ bool tud_audio_tx_done_pre_load_cb(uint8_t rhport, uint8_t itf, uint8_t ep_in, u
     (void)itf;
     (void)ep_in;
     (void)cur_alt_setting;
-    size_t bytes_require = MIC_INTERVAL_MS * s_uac_device->mic_bytes_per_ms;
-
-    tu_fifo_t *sw_in_fifo = tud_audio_get_ep_in_ff();
-    uint16_t fifo_remained = tu_fifo_remaining(sw_in_fifo);
-    if (fifo_remained < bytes_require) {
+#if CFG_TUD_AUDIO_FUNC_1_N_CHANNELS_RX
+    // the previous packet has left the FIFO, a packet still waiting means the host skipped a poll
+    if (!s_uac_device->mic_active || tu_fifo_count(tud_audio_get_ep_in_ff()) > 0) {
         return true;
     }
-
-    // load data chunk by chunk
-    UAC_ENTER_CRITICAL();
-    if (s_uac_device->mic_data_size > 0) {
-        tud_audio_write((void *)s_uac_device->mic_buf_read, s_uac_device->mic_data_size);
-        s_uac_device->mic_data_size = 0;
-    }
-    UAC_EXIT_CRITICAL();
-
+    UAC_TRACE_BEGIN(UAC_TRACE_MIC_TX_CB, 0);
+    mic_load_packet();
+    UAC_TRACE_END(UAC_TRACE_MIC_TX_CB, tu_fifo_count(tud_audio_get_ep_in_ff()));
+#endif
     return true;
 }
 
@@ -439,16 +1259,36 @@ static void usb_spk_task(void *pvParam)
             ulTaskNotifyTake(pdFAIL, portMAX_DELAY);
             continue;
         }
-        // clear the notification
-        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
-        if (s_uac_device->spk_data_size == 0) {
+        uac_pool_block_t *pb;
+        // only a wait on an empty queue measures how fast the task is scheduled
+        const bool waited = uxQueueMessagesWaiting(s_uac_device->spk_queue) == 0;
+        if (xQueueReceive(s_uac_device->spk_queue, &pb, portMAX_DELAY) != pdTRUE) {
             continue;
         }
-        // playback the data from the ring buffer chunk by chunk
-        if (s_uac_device->user_cfg.output_cb) {
-            s_uac_device->user_cfg.output_cb((uint8_t *)s_uac_device->spk_buf, s_uac_device->spk_data_size, s_uac_device->user_cfg.cb_ctx);
+        if (waited) {
+            task_latency_record(UAC_TASK_SPK, esp_timer_get_time() - pb->block.timestamp_us);
         }
-        s_uac_device->spk_data_size = 0;
+        UAC_TRACE_BEGIN(UAC_TRACE_SPK_TASK, pb->block.frames);
+        // playback the data from the block pool chunk by chunk
+#if CONFIG_UAC_LOOPBACK
+        if (s_uac_device->loopback != UAC_LOOPBACK_OFF) {
+            loopback_push(&pb->block);
+        } else
+#endif
+        if (s_uac_device->user_cfg.output_block_cb) {
+            s_uac_device->user_cfg.output_block_cb(&pb->block, s_uac_device->user_cfg.cb_ctx);
+        } else if (s_uac_device->user_cfg.output_cb) {
+            s_uac_device->user_cfg.output_cb((uint8_t *)pb->data, pb->block.frames * pb->block.format->bytes_per_frame, s_uac_device->user_cfg.cb_ctx);
+        }
+#if CONFIG_UAC_FLIGHT_RECORDER
+        uac_recorder_write(UAC_RECORDER_OUT, pb->block.format, pb->data, pb->block.frames * pb->block.format->bytes_per_frame, pb->block.sample_pos);
+#endif
+#if CONFIG_UAC_GLITCH_DETECTOR
+        uac_glitch_check_block(UAC_GLITCH_STREAM_OUT, pb->block.format, pb->data, pb->block.frames, pb->block.sample_pos,
+                               pb->block.sof_frame, pb->block.flags & UAC_BLOCK_FLAG_DISCONTINUITY);
+#endif
+        spk_pool_release(pb);
+        UAC_TRACE_END(UAC_TRACE_SPK_TASK, 0);
     }
 }
 #endif
@@ -457,29 +1297,116 @@ static void usb_spk_task(void *pvParam)
 static void usb_mic_task(void *pvParam)
 {
     TickType_t xLastWakeTime = xTaskGetTickCount();
+    int64_t next_wake_us = 0;
+#if CONFIG_UAC_GLITCH_DETECTOR
+    int64_t last_block_time = 0;
+#endif
     while (1) {
         if (s_uac_device->mic_active == false) {
             // clear the notification
             ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
             xLastWakeTime = xTaskGetTickCount();
+            next_wake_us = 0;
             continue;
         }
+        // the tick and esp_timer both run from the system timer, so the period schedule can be kept in us
+        const int64_t wake_us = esp_timer_get_time();
+        if (next_wake_us != 0) {
+            task_latency_record(UAC_TASK_MIC, wake_us - next_wake_us);
+        }
+        // more than a period behind, start a new schedule rather than counting every following wake up as late
+        if (wake_us - next_wake_us > MIC_INTERVAL_MS * 1000) {
+            next_wake_us = wake_us;
+        }
+        next_wake_us += MIC_INTERVAL_MS * 1000;
         // clear the notification
         // read data from the microphone chunk by chunk
         size_t bytes_require = MIC_INTERVAL_MS * s_uac_device->mic_bytes_per_ms;
-        if (s_uac_device->user_cfg.input_cb) {
+#if CONFIG_UAC_LOOPBACK
+        const bool loopback = s_uac_device->loopback != UAC_LOOPBACK_OFF;
+#else
+        const bool loopback = false;
+#endif
+        if (loopback || s_uac_device->user_cfg.input_block_cb || s_uac_device->user_cfg.input_cb) {
+            UAC_TRACE_BEGIN(UAC_TRACE_MIC_TASK, 0);
             size_t bytes_read = 0;
-            esp_err_t ret = s_uac_device->user_cfg.input_cb((uint8_t *)s_uac_device->mic_buf_write, bytes_require, &bytes_read, s_uac_device->user_cfg.cb_ctx);
+            esp_err_t ret = ESP_OK;
+            if (loopback) {
+#if CONFIG_UAC_LOOPBACK
+                bytes_read = loopback_pull((uint8_t *)s_uac_device->mic_buf, bytes_require);
+#endif
+            } else if (s_uac_device->user_cfg.input_block_cb) {
+                uac_block_t block = {
+                    .format = &s_uac_device->mic_format,
+                    .data = s_uac_device->mic_buf,
+                    .frames = bytes_require / s_uac_device->mic_format.bytes_per_frame,
+                    .sample_pos = s_uac_device->mic_sample_pos,
+                    .sof_frame = s_uac_device->sof_count,
+                    .timestamp_us = esp_timer_get_time(),
+                    .flags = s_uac_device->mic_flags,
+                };
+                size_t frames_read = 0;
+                ret = s_uac_device->user_cfg.input_block_cb(&block, &frames_read, s_uac_device->user_cfg.cb_ctx);
+                bytes_read = frames_read * s_uac_device->mic_format.bytes_per_frame;
+            } else {
+                ret = s_uac_device->user_cfg.input_cb((uint8_t *)s_uac_device->mic_buf, bytes_require, &bytes_read, s_uac_device->user_cfg.cb_ctx);
+            }
             if (ret != ESP_OK) {
                 ESP_LOGE(TAG, "Failed to read data from mic");
+                UAC_TRACE_END(UAC_TRACE_MIC_TASK, 0);
                 continue;
             }
-            int16_t *tmp_buf = s_uac_device->mic_buf_write;
-            UAC_ENTER_CRITICAL();
-            s_uac_device->mic_buf_write = s_uac_device->mic_buf_read;
-            s_uac_device->mic_buf_read = tmp_buf;
-            s_uac_device->mic_data_size = bytes_read;
-            UAC_EXIT_CRITICAL();
+            int16_t *tmp_buf = s_uac_device->mic_buf;
+#if CONFIG_UAC_MIC_RESAMPLER || CONFIG_UAC_GLITCH_DETECTOR
+            const bool restart = s_uac_device->mic_flags & UAC_BLOCK_FLAG_DISCONTINUITY;
+#endif
+            const uint8_t *block = (const uint8_t *)tmp_buf;
+            size_t block_len = bytes_read;
+#if CONFIG_UAC_MIC_RESAMPLER
+            if (restart) {
+                s_uac_device->mic_rs_supported = uac_resampler_reset(s_uac_device->mic_rs, &s_uac_device->mic_format);
+            }
+            // the loopback has to stay bit exact, it keeps steering the packet size instead
+            const bool resample = s_uac_device->mic_rs_supported && !loopback;
+            if (resample) {
+                const size_t frame = s_uac_device->mic_format.bytes_per_frame;
+                if (!restart && !s_uac_device->mic_resample) {
+                    // back from the loopback, the filter history is stale
+                    uac_resampler_reset(s_uac_device->mic_rs, &s_uac_device->mic_format);
+                }
+                const uint64_t step_q32 = ((uint64_t)s_uac_device->mic_rate_q16 << 32) / s_uac_device->mic_nominal_q16;
+                block_len = uac_resampler_process(s_uac_device->mic_rs, block, bytes_read / frame, s_uac_device->mic_rs_buf,
+                                                  UAC_MIC_RS_MAX_FRAMES, step_q32,
+                                                  &s_uac_device->mic_stats.resampler_dropped) * frame;
+                block = s_uac_device->mic_rs_buf;
+            }
+            s_uac_device->mic_resample = resample;
+#endif
+            // the IN packets drain the ring at the servo rate, it only fills up if the host stopped polling
+            const bool overrun = !mic_ring_push(block, block_len);
+            (void)overrun;
+#if CONFIG_UAC_GLITCH_DETECTOR
+            const int64_t now = esp_timer_get_time();
+            const uint32_t sof = s_uac_device->sof_count;
+            if (overrun && !restart) {
+                uac_glitch_report(UAC_GLITCH_STREAM_IN, UAC_GLITCH_OVERRUN, s_uac_device->mic_sample_pos, sof, 0);
+            }
+            if (!restart && now - last_block_time > MIC_INTERVAL_MS * 1500) {
+                uac_glitch_report(UAC_GLITCH_STREAM_IN, UAC_GLITCH_LATE_PACKET, s_uac_device->mic_sample_pos, sof, now - last_block_time);
+            }
+            if (bytes_read < bytes_require) {
+                uac_glitch_report(UAC_GLITCH_STREAM_IN, UAC_GLITCH_SHORT_PACKET, s_uac_device->mic_sample_pos, sof, bytes_require - bytes_read);
+            }
+            last_block_time = now;
+            uac_glitch_check_block(UAC_GLITCH_STREAM_IN, &s_uac_device->mic_format, tmp_buf,
+                                   bytes_read / s_uac_device->mic_format.bytes_per_frame, s_uac_device->mic_sample_pos, sof, restart);
+#endif
+#if CONFIG_UAC_FLIGHT_RECORDER
+            uac_recorder_write(UAC_RECORDER_IN, &s_uac_device->mic_format, tmp_buf, bytes_read, s_uac_device->mic_sample_pos);
+#endif
+            s_uac_device->mic_sample_pos += bytes_read / s_uac_device->mic_format.bytes_per_frame;
+            s_uac_device->mic_flags = 0;
+            UAC_TRACE_END(UAC_TRACE_MIC_TASK, bytes_read);
         }
 
         vTaskDelayUntil(&xLastWakeTime, pdMS_TO_TICKS(MIC_INTERVAL_MS));
@@ -494,16 +1421,66 @@ esp_err_t uac_device_init(uac_device_config_t *config)
         ESP_LOGW(TAG, "uac device already initialized");
         return ESP_OK;
     }
-    s_uac_device = calloc(1, sizeof(uac_device_t));
+    // read by every callback, never let the SPIRAM malloc settings move it out of internal RAM
+#if CONFIG_UAC_HOT_STATE_IN_TCM
+    s_uac_device = heap_caps_calloc(1, sizeof(uac_device_t), MALLOC_CAP_TCM);
+#endif
+    if (s_uac_device == NULL) {
+        s_uac_device = heap_caps_calloc(1, sizeof(uac_device_t), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    }
     ESP_RETURN_ON_FALSE(s_uac_device != NULL, ESP_ERR_NO_MEM, TAG, "Failed to allocate memory for uac device");
+    uac_mem_note("uac state", s_uac_device, sizeof(uac_device_t));
     s_uac_device->user_cfg.output_cb = config->output_cb;
     s_uac_device->user_cfg.input_cb = config->input_cb;
+    s_uac_device->user_cfg.output_block_cb = config->output_block_cb;
+    s_uac_device->user_cfg.input_block_cb = config->input_block_cb;
     s_uac_device->user_cfg.cb_ctx = config->cb_ctx;
     s_uac_device->user_cfg.set_mute_cb = config->set_mute_cb;
     s_uac_device->user_cfg.set_volume_cb = config->set_volume_cb;
+    s_uac_device->user_cfg.set_monitor_cb = config->set_monitor_cb;
+    s_uac_device->user_cfg.set_agc_cb = config->set_agc_cb;
+    s_uac_device->user_cfg.set_fu_mute_cb = config->set_fu_mute_cb;
+    s_uac_device->user_cfg.set_fu_volume_cb = config->set_fu_volume_cb;
+    const uac_volume_range_t default_range = { .min = -VOLUME_CTRL_50_DB, .max = VOLUME_CTRL_0_DB, .res = 256 };
+    const uac_volume_range_t *spk_range = &config->spk_volume_range;
+    const uac_volume_range_t *mic_range = &config->mic_volume_range;
+    s_uac_device->volume_range[UAC_FEATURE_UNIT_SPK] = spk_range->min || spk_range->max || spk_range->res ? *spk_range : default_range;
+    s_uac_device->volume_range[UAC_FEATURE_UNIT_MIC] = mic_range->min || mic_range->max || mic_range->res ? *mic_range : default_range;
+    for (int i = 0; i < UAC_FEATURE_UNIT_NUM; i++) {
+        // start at 0 dB, or the range limit nearest to it
+        const uac_volume_range_t *range = &s_uac_device->volume_range[i];
+        for (int ch = 0; ch <= UAC_FU_MAX_CHANNELS; ch++) {
+            s_uac_device->volume[i][ch] = range->min > 0 ? range->min : range->max < 0 ? range->max : 0;
+        }
+    }
+#if CONFIG_UAC_MONITOR_MIXER_UNIT
+    for (int i = 0; i < MIC_CHANNEL_NUM; i++) {
+        for (int j = 0; j < SPEAK_CHANNEL_NUM; j++) {
+            s_uac_device->monitor_gain[i][j] = (int16_t)VOLUME_CTRL_SILENCE;
+        }
+    }
+#endif
     s_uac_device->current_sample_rate = DEFAULT_SAMPLE_RATE;
-    s_uac_device->mic_buf_write = s_uac_device->mic_buf1;
-    s_uac_device->mic_buf_read = s_uac_device->mic_buf2;
+#if CFG_TUD_AUDIO_FUNC_1_N_CHANNELS_RX
+    s_uac_device->mic_buf = uac_mem_alloc("uac mic buf", MIC_INTERVAL_MS * CFG_TUD_AUDIO_FUNC_1_EP_IN_SZ_MAX);
+    s_uac_device->mic_ring = uac_mem_alloc("uac mic ring", UAC_MIC_RING_SZ);
+    ESP_RETURN_ON_FALSE(s_uac_device->mic_buf && s_uac_device->mic_ring, ESP_ERR_NO_MEM, TAG, "Failed to allocate microphone buffers");
+    s_uac_device->mic_margin_ms = UAC_MIC_MARGIN_MS;
+#if CONFIG_UAC_MIC_RESAMPLER
+    s_uac_device->mic_rs_buf = uac_mem_alloc("uac mic resample", UAC_MIC_RS_MAX_FRAMES * CFG_TUD_AUDIO_FUNC_1_N_CHANNELS_RX *
+                                             CFG_TUD_AUDIO_FUNC_1_FORMAT_1_N_BYTES_PER_SAMPLE_RX);
+    s_uac_device->mic_rs = uac_mem_alloc("uac mic resampler", sizeof(uac_resampler_t));
+    ESP_RETURN_ON_FALSE(s_uac_device->mic_rs_buf && s_uac_device->mic_rs, ESP_ERR_NO_MEM, TAG, "Failed to allocate resampler buffers");
+    // the filter table is shared with the benchmark, computed before either can start
+    uac_resampler_init();
+#endif
+#endif
+#if CONFIG_UAC_LOOPBACK
+    // only touched while the loopback test runs, no need for the hot arena
+    s_uac_device->lb_ring = heap_caps_malloc(UAC_LOOPBACK_RING_SZ, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    ESP_RETURN_ON_FALSE(s_uac_device->lb_ring != NULL, ESP_ERR_NO_MEM, TAG, "Failed to allocate loopback ring");
+    uac_mem_note("uac loopback", s_uac_device->lb_ring, UAC_LOOPBACK_RING_SZ);
+#endif
 
 #if CONFIG_USB_DEVICE_UAC_AS_PART
     s_uac_device->spk_itf_num = config->spk_itf_num;
@@ -517,7 +1494,6 @@ esp_err_t uac_device_init(uac_device_config_t *config)
 #endif
 #endif
 
-    BaseType_t ret_val;
     if (!config->skip_tinyusb_init) {
         usb_phy_init();
         bool usb_init = tusb_init();
@@ -525,23 +1501,278 @@ esp_err_t uac_device_init(uac_device_config_t *config)
             ESP_LOGE(TAG, "USB Device Stack Init Fail");
             return ESP_FAIL;
         }
-        ret_val = xTaskCreatePinnedToCore(tusb_device_task, "TinyUSB", 4096, NULL, CONFIG_UAC_TINYUSB_TASK_PRIORITY,
-                                          NULL, CONFIG_UAC_TINYUSB_TASK_CORE == -1 ? tskNO_AFFINITY : CONFIG_UAC_TINYUSB_TASK_CORE);
-        ESP_RETURN_ON_FALSE(ret_val == pdPASS, ESP_FAIL, TAG, "Failed to create TinyUSB task");
+        ESP_RETURN_ON_ERROR(uac_mem_create_task(tusb_device_task, "TinyUSB", 4096, NULL, UAC_TINYUSB_TASK_PRIORITY,
+                                                NULL, UAC_TINYUSB_TASK_CORE),
+                            TAG, "Failed to create TinyUSB task");
     }
+#if CONFIG_UAC_FLIGHT_RECORDER
+    ESP_RETURN_ON_ERROR(uac_recorder_init(DEFAULT_SAMPLE_RATE * SPEAK_CHANNEL_NUM * CFG_TUD_AUDIO_FUNC_1_FORMAT_1_N_BYTES_PER_SAMPLE_TX,
+                                          DEFAULT_SAMPLE_RATE * MIC_CHANNEL_NUM * CFG_TUD_AUDIO_FUNC_1_FORMAT_1_N_BYTES_PER_SAMPLE_RX),
+                        TAG, "Failed to start flight recorder");
+#endif
+
+#if !CONFIG_USB_DEVICE_UAC_AS_PART
+    // SOF frame count for the block timestamps
+    tud_sof_cb_enable(true);
+#endif
 
 #if CFG_TUD_AUDIO_FUNC_1_N_CHANNELS_RX
-    ret_val = xTaskCreatePinnedToCore(usb_mic_task, "usb_mic_task", 4096, NULL, CONFIG_UAC_MIC_TASK_PRIORITY,
-                                      &s_uac_device->mic_task_handle, CONFIG_UAC_MIC_TASK_CORE == -1 ? tskNO_AFFINITY : CONFIG_UAC_MIC_TASK_CORE);
-    ESP_RETURN_ON_FALSE(ret_val == pdPASS, ESP_FAIL, TAG, "Failed to create usb_mic task");
+    ESP_RETURN_ON_ERROR(uac_mem_create_task(usb_mic_task, "usb_mic_task", 4096, NULL, UAC_MIC_TASK_PRIORITY,
+                                            &s_uac_device->mic_task_handle, UAC_MIC_TASK_CORE),
+                        TAG, "Failed to create usb_mic task");
 #endif
 
 #if CFG_TUD_AUDIO_FUNC_1_N_CHANNELS_TX
-    ret_val = xTaskCreatePinnedToCore(usb_spk_task, "usb_spk_task", 4096, NULL, CONFIG_UAC_SPK_TASK_PRIORITY,
-                                      &s_uac_device->spk_task_handle, CONFIG_UAC_SPK_TASK_CORE == -1 ? tskNO_AFFINITY : CONFIG_UAC_SPK_TASK_CORE);
-    ESP_RETURN_ON_FALSE(ret_val == pdPASS, ESP_FAIL, TAG, "Failed to create usb_spk task");
+    // the pool is touched on every packet, keep it out of PSRAM
+    s_uac_device->spk_pool = uac_mem_alloc("uac spk pool", CONFIG_UAC_SPK_POOL_BLOCKS * sizeof(uac_pool_block_t));
+    ESP_RETURN_ON_FALSE(s_uac_device->spk_pool != NULL, ESP_ERR_NO_MEM, TAG, "Failed to allocate playback block pool");
+    s_uac_device->spk_queue = xQueueCreate(UAC_SPK_QUEUE_LEN, sizeof(uac_pool_block_t *));
+    s_uac_device->sub_lock = xSemaphoreCreateMutex();
+    ESP_RETURN_ON_FALSE(s_uac_device->spk_queue && s_uac_device->sub_lock, ESP_ERR_NO_MEM, TAG, "Failed to create playback queue");
+    ESP_RETURN_ON_ERROR(uac_mem_create_task(usb_spk_task, "usb_spk_task", 4096, NULL, UAC_SPK_TASK_PRIORITY,
+                                            &s_uac_device->spk_task_handle, UAC_SPK_TASK_CORE),
+                        TAG, "Failed to create usb_spk task");
 #endif
 
     ESP_LOGI(TAG, "UAC Device Start, Version: %d.%d.%d", 1, 1, 1);
     return ESP_OK;
 }
+
+esp_err_t uac_device_set_path_latency(uint32_t spk_frames, uint32_t mic_frames)
+{
+    ESP_RETURN_ON_FALSE(s_uac_device != NULL, ESP_ERR_INVALID_STATE, TAG, "uac device not initialized");
+    s_uac_device->spk_path_latency = spk_frames;
+    s_uac_device->mic_path_latency = mic_frames;
+    ESP_LOGI(TAG, "Latency spk: %"PRIu32" ns, mic: %"PRIu32" ns", spk_latency_ns(), mic_latency_ns());
+    return ESP_OK;
+}
+
+esp_err_t uac_device_set_fu_state(uac_feature_unit_t unit, uint8_t channel, bool mute, int16_t volume, bool agc)
+{
+    ESP_RETURN_ON_FALSE(unit < UAC_FEATURE_UNIT_NUM && channel <= UAC_FU_MAX_CHANNELS, ESP_ERR_INVALID_ARG, TAG, "invalid channel");
+    ESP_RETURN_ON_FALSE(s_uac_device != NULL, ESP_ERR_INVALID_STATE, TAG, "uac device not initialized");
+    const uac_volume_range_t *range = &s_uac_device->volume_range[unit];
+    s_uac_device->mute[unit][channel] = mute;
+    s_uac_device->volume[unit][channel] = volume < range->min ? range->min : volume > range->max ? range->max : volume;
+    s_uac_device->agc[unit][channel] = agc;
+    return ESP_OK;
+}
+
+esp_err_t uac_device_get_latency(uac_device_latency_t *latency)
+{
+    ESP_RETURN_ON_FALSE(latency != NULL, ESP_ERR_INVALID_ARG, TAG, "latency is NULL");
+    ESP_RETURN_ON_FALSE(s_uac_device != NULL, ESP_ERR_INVALID_STATE, TAG, "uac device not initialized");
+    latency->spk_latency_ns = spk_latency_ns();
+    latency->mic_latency_ns = mic_latency_ns();
+    return ESP_OK;
+}
+
+esp_err_t uac_device_get_task_latency(uac_task_latency_t stats[UAC_TASK_NUM], bool reset)
+{
+    ESP_RETURN_ON_FALSE(stats != NULL, ESP_ERR_INVALID_ARG, TAG, "stats is NULL");
+    ESP_RETURN_ON_FALSE(s_uac_device != NULL, ESP_ERR_INVALID_STATE, TAG, "uac device not initialized");
+    // the counters are written without a lock by their own task, a reading may be off by one wake up
+    for (int i = 0; i < UAC_TASK_NUM; i++) {
+        stats[i] = s_uac_device->task_latency[i];
+        stats[i].mean_us = stats[i].wakeups ? s_uac_device->task_latency_sum[i] / stats[i].wakeups : 0;
+        if (reset) {
+            memset(&s_uac_device->task_latency[i], 0, sizeof(uac_task_latency_t));
+            s_uac_device->task_latency_sum[i] = 0;
+        }
+    }
+    return ESP_OK;
+}
+
+esp_err_t uac_device_set_loopback(uac_loopback_mode_t mode)
+{
+#if CONFIG_UAC_LOOPBACK
+    ESP_RETURN_ON_FALSE(mode <= UAC_LOOPBACK_CRC, ESP_ERR_INVALID_ARG, TAG, "unknown loopback mode %d", mode);
+    ESP_RETURN_ON_FALSE(s_uac_device != NULL, ESP_ERR_INVALID_STATE, TAG, "uac device not initialized");
+    const bool was_on = s_uac_device->loopback != UAC_LOOPBACK_OFF;
+    s_uac_device->lb_flush = true;
+    memset(&s_uac_device->lb_stats, 0, sizeof(s_uac_device->lb_stats));
+    s_uac_device->lb_latency_sum = 0;
+    s_uac_device->lb_latency_count = 0;
+    s_uac_device->lb_stats.mode = mode;
+    // the output callback gets no data while looping back, keep whatever it played last from sounding
+    if (was_on != (mode != UAC_LOOPBACK_OFF)) {
+        report_mute(UAC_FEATURE_UNIT_SPK, 0, mode != UAC_LOOPBACK_OFF || s_uac_device->mute[UAC_FEATURE_UNIT_SPK][0]);
+    }
+    s_uac_device->loopback = mode;
+    ESP_LOGI(TAG, "Loopback %s", mode == UAC_LOOPBACK_CRC ? "on, CRC tagged" : mode == UAC_LOOPBACK_ON ? "on" : "off");
+    return ESP_OK;
+#else
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+esp_err_t uac_device_get_loopback_stats(uac_loopback_stats_t *stats, bool reset)
+{
+#if CONFIG_UAC_LOOPBACK
+    ESP_RETURN_ON_FALSE(stats != NULL, ESP_ERR_INVALID_ARG, TAG, "stats is NULL");
+    ESP_RETURN_ON_FALSE(s_uac_device != NULL, ESP_ERR_INVALID_STATE, TAG, "uac device not initialized");
+    // written without a lock by the two audio tasks, a reading may be off by one block
+    *stats = s_uac_device->lb_stats;
+    stats->latency_mean_us = s_uac_device->lb_latency_count ? s_uac_device->lb_latency_sum / s_uac_device->lb_latency_count : 0;
+    if (reset) {
+        memset(&s_uac_device->lb_stats, 0, sizeof(s_uac_device->lb_stats));
+        s_uac_device->lb_stats.mode = s_uac_device->loopback;
+        s_uac_device->lb_latency_sum = 0;
+        s_uac_device->lb_latency_count = 0;
+    }
+    return ESP_OK;
+#else
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+esp_err_t uac_device_get_sof_time(uac_sof_time_t *sof)
+{
+#if !CONFIG_USB_DEVICE_UAC_AS_PART
+    ESP_RETURN_ON_FALSE(sof != NULL, ESP_ERR_INVALID_ARG, TAG, "sof is NULL");
+    ESP_RETURN_ON_FALSE(s_uac_device != NULL, ESP_ERR_INVALID_STATE, TAG, "uac device not initialized");
+    UAC_ENTER_CRITICAL();
+    *sof = s_uac_device->sof_time;
+    UAC_EXIT_CRITICAL();
+    return sof->period_us != 0 ? ESP_OK : ESP_ERR_INVALID_STATE;
+#else
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+bool uac_device_is_streaming(void)
+{
+    return s_uac_device != NULL && (s_uac_device->spk_active || s_uac_device->mic_active);
+}
+
+esp_err_t uac_device_get_mic_stats(uac_mic_stats_t *stats, bool reset)
+{
+#if CFG_TUD_AUDIO_FUNC_1_N_CHANNELS_RX
+    ESP_RETURN_ON_FALSE(stats != NULL, ESP_ERR_INVALID_ARG, TAG, "stats is NULL");
+    ESP_RETURN_ON_FALSE(s_uac_device != NULL, ESP_ERR_INVALID_STATE, TAG, "uac device not initialized");
+    // written without a lock by the TinyUSB task and usb_mic_task, a reading may be off by one packet
+    *stats = s_uac_device->mic_stats;
+    if (reset) {
+        uac_mic_stats_t *st = &s_uac_device->mic_stats;
+        // the servo state is not a counter, keep it
+        *st = (uac_mic_stats_t) {
+            .rate_mhz = stats->rate_mhz,
+            .fill_frames = stats->fill_frames,
+            .margin_ms = stats->margin_ms,
+            .resampling = stats->resampling,
+        };
+    }
+    return ESP_OK;
+#else
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+#if CFG_TUD_AUDIO_FUNC_1_N_CHANNELS_TX
+esp_err_t uac_device_subscribe_output(uint32_t depth, uac_subscriber_handle_t *ret_sub)
+{
+    ESP_RETURN_ON_FALSE(ret_sub != NULL && depth > 0, ESP_ERR_INVALID_ARG, TAG, "invalid argument");
+    ESP_RETURN_ON_FALSE(s_uac_device != NULL, ESP_ERR_INVALID_STATE, TAG, "uac device not initialized");
+
+    // the heap is used outside the lock, a slot that is not in use is never touched by spk_publish
+    QueueHandle_t queue = xQueueCreate(depth, sizeof(uac_pool_block_t *));
+    ESP_RETURN_ON_FALSE(queue != NULL, ESP_ERR_NO_MEM, TAG, "Failed to create subscriber queue");
+
+    esp_err_t ret = ESP_OK;
+    xSemaphoreTake(s_uac_device->sub_lock, portMAX_DELAY);
+    struct uac_subscriber_s *sub = NULL;
+    for (int i = 0; i < CONFIG_UAC_SPK_MAX_SUBSCRIBERS; i++) {
+        if (!s_uac_device->subscribers[i].in_use) {
+            sub = &s_uac_device->subscribers[i];
+            break;
+        }
+    }
+    ESP_GOTO_ON_FALSE(sub != NULL, ESP_ERR_NO_MEM, err, TAG, "no free subscriber slot");
+    ESP_GOTO_ON_FALSE(s_uac_device->sub_reserved + depth <= CONFIG_UAC_SPK_POOL_BLOCKS - UAC_SPK_POOL_RESERVED,
+                      ESP_ERR_NO_MEM, err, TAG, "not enough pool blocks for depth %"PRIu32, depth);
+    // the queue of an earlier subscriber of the slot is deleted below
+    QueueHandle_t old = sub->queue;
+    sub->queue = queue;
+    queue = old;
+    sub->depth = depth;
+    sub->outstanding = 0;
+    sub->dropped = 0;
+    UAC_ENTER_CRITICAL();
+    sub->in_use = true;
+    UAC_EXIT_CRITICAL();
+    s_uac_device->sub_reserved += depth;
+    *ret_sub = sub;
+err:
+    xSemaphoreGive(s_uac_device->sub_lock);
+    if (queue) {
+        vQueueDelete(queue);
+    }
+    return ret;
+}
+
+esp_err_t uac_device_unsubscribe_output(uac_subscriber_handle_t sub)
+{
+    ESP_RETURN_ON_FALSE(sub != NULL, ESP_ERR_INVALID_ARG, TAG, "invalid subscriber");
+
+    esp_err_t ret = ESP_OK;
+    xSemaphoreTake(s_uac_device->sub_lock, portMAX_DELAY);
+    ESP_GOTO_ON_FALSE(sub->in_use, ESP_ERR_INVALID_ARG, err, TAG, "invalid subscriber");
+    // stop deliveries first, wait for a send in progress, then return the queued blocks to the pool
+    UAC_ENTER_CRITICAL();
+    sub->in_use = false;
+    bool publishing = sub->publishing;
+    UAC_EXIT_CRITICAL();
+    while (publishing) {
+        vTaskDelay(1);
+        UAC_ENTER_CRITICAL();
+        publishing = sub->publishing;
+        UAC_EXIT_CRITICAL();
+    }
+    uac_pool_block_t *pb;
+    while (xQueueReceive(sub->queue, &pb, 0) == pdTRUE) {
+        UAC_ENTER_CRITICAL();
+        sub->outstanding--;
+        pb->refs--;
+        UAC_EXIT_CRITICAL();
+    }
+    if (sub->outstanding != 0) {
+        UAC_ENTER_CRITICAL();
+        sub->in_use = true;
+        UAC_EXIT_CRITICAL();
+        ret = ESP_ERR_INVALID_STATE;
+        ESP_LOGE(TAG, "subscriber still holds %"PRIu32" blocks", sub->outstanding);
+    } else {
+        s_uac_device->sub_reserved -= sub->depth;
+    }
+err:
+    xSemaphoreGive(s_uac_device->sub_lock);
+    return ret;
+}
+
+esp_err_t uac_subscriber_receive(uac_subscriber_handle_t sub, const uac_block_t **block, uint32_t *dropped, uint32_t timeout_ms)
+{
+    ESP_RETURN_ON_FALSE(sub != NULL && block != NULL, ESP_ERR_INVALID_ARG, TAG, "invalid argument");
+
+    uac_pool_block_t *pb;
+    if (xQueueReceive(sub->queue, &pb, pdMS_TO_TICKS(timeout_ms)) != pdTRUE) {
+        return ESP_ERR_TIMEOUT;
+    }
+    UAC_ENTER_CRITICAL();
+    if (dropped) {
+        *dropped = sub->dropped;
+    }
+    sub->dropped = 0;
+    UAC_EXIT_CRITICAL();
+    *block = &pb->block;
+    return ESP_OK;
+}
+
+void uac_subscriber_release(uac_subscriber_handle_t sub, const uac_block_t *block)
+{
+    uac_pool_block_t *pb = (uac_pool_block_t *)block;
+    UAC_ENTER_CRITICAL();
+    sub->outstanding--;
+    pb->refs--;
+    UAC_EXIT_CRITICAL();
+}
+#endif
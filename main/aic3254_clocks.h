@@ -0,0 +1,87 @@
+/***************
+CTAG TBD >>to be determined<< is an open source eurorack synthesizer module.
+
+A project conceived within the Creative Technologies Arbeitsgruppe of
+Kiel University of Applied Sciences: https://www.creative-technologies.de
+
+(c) 2020 by Robert Manzke. All rights reserved.
+
+The CTAG TBD software is licensed under the GNU General Public License
+(GPL 3.0), available here: https://www.gnu.org/licenses/gpl-3.0.txt
+
+The CTAG TBD hardware design is released under the Creative Commons
+Attribution-NonCommercial-ShareAlike 4.0 International (CC BY-NC-SA 4.0).
+Details here: https://creativecommons.org/licenses/by-nc-sa/4.0/
+
+CTAG TBD is provided "as is" without any express or implied warranties.
+
+License and copyright details for specific submodules are included in their
+respective component folders / files if different from this license.
+***************/
+
+// Generated by tools/aic3254_clock_solver.py, do not edit. Check with: aic3254_clock_solver.py check
+
+#pragma once
+
+#include <stdint.h>
+
+// NDAC, MDAC, DOSR or NADC, MADC, AOSR, all zero if the filter can not run at this rate
+typedef struct {
+    uint8_t n;
+    uint8_t m;
+    uint16_t osr;
+} aic3254_dividers_t;
+
+typedef struct {
+    uint32_t mclk_hz;
+    uint32_t fs;
+    uint32_t codec_clkin_hz;
+    uint8_t pll_p;                  // 0: PLL off, CODEC_CLKIN = MCLK
+    uint8_t pll_r;
+    uint8_t pll_j;
+    uint16_t pll_d;
+    aic3254_dividers_t dac[3];      // interpolation filter A, B, C
+    aic3254_dividers_t adc[3];      // decimation filter A, B, C
+} aic3254_clock_cfg_t;
+
+static const aic3254_clock_cfg_t aic3254_clock_cfgs[] = {
+    {8192000, 32000, 8192000, 0, 0, 0, 0, {{1, 2, 128}, {1, 2, 128}, {1, 2, 128}}, {{1, 2, 128}, {2, 2, 64}, {2, 4, 32}}},
+    {12000000, 32000, 86016000, 1, 1, 7, 1680, {{8, 2, 168}, {8, 2, 168}, {14, 1, 192}}, {{7, 3, 128}, {21, 2, 64}, {28, 3, 32}}},
+    {12288000, 32000, 12288000, 0, 0, 0, 0, {{1, 2, 192}, {1, 2, 192}, {2, 1, 192}}, {{1, 3, 128}, {3, 2, 64}, {4, 3, 32}}},
+    {24000000, 32000, 86016000, 2, 1, 7, 1680, {{8, 2, 168}, {8, 2, 168}, {14, 1, 192}}, {{7, 3, 128}, {21, 2, 64}, {28, 3, 32}}},
+    {24576000, 32000, 24576000, 0, 0, 0, 0, {{3, 2, 128}, {3, 2, 128}, {4, 1, 192}}, {{3, 2, 128}, {6, 2, 64}, {8, 3, 32}}},
+    {11289600, 44100, 11289600, 0, 0, 0, 0, {{1, 2, 128}, {1, 2, 128}, {1, 2, 128}}, {{1, 2, 128}, {2, 2, 64}, {2, 4, 32}}},
+    {12000000, 44100, 84672000, 1, 1, 7, 560, {{6, 4, 80}, {6, 4, 80}, {10, 2, 96}}, {{5, 3, 128}, {15, 2, 64}, {20, 3, 32}}},
+    {12288000, 44100, 90316800, 1, 1, 7, 3500, {{8, 2, 128}, {8, 2, 128}, {8, 2, 128}}, {{8, 2, 128}, {16, 2, 64}, {16, 4, 32}}},
+    {22579200, 44100, 22579200, 0, 0, 0, 0, {{2, 2, 128}, {2, 2, 128}, {2, 2, 128}}, {{2, 2, 128}, {4, 2, 64}, {4, 4, 32}}},
+    {24000000, 44100, 84672000, 2, 1, 7, 560, {{6, 4, 80}, {6, 4, 80}, {10, 2, 96}}, {{5, 3, 128}, {15, 2, 64}, {20, 3, 32}}},
+    {24576000, 44100, 90316800, 2, 1, 7, 3500, {{8, 2, 128}, {8, 2, 128}, {8, 2, 128}}, {{8, 2, 128}, {16, 2, 64}, {16, 4, 32}}},
+    {11289600, 48000, 96768000, 7, 1, 60, 0, {{7, 3, 96}, {7, 3, 96}, {9, 2, 112}}, {{0, 0, 0}, {0, 0, 0}, {21, 3, 32}}},
+    {12000000, 48000, 86016000, 1, 1, 7, 1680, {{7, 2, 128}, {7, 2, 128}, {8, 2, 112}}, {{7, 2, 128}, {14, 2, 64}, {14, 4, 32}}},
+    {12288000, 48000, 12288000, 0, 0, 0, 0, {{1, 2, 128}, {1, 2, 128}, {1, 2, 128}}, {{1, 2, 128}, {2, 2, 64}, {2, 4, 32}}},
+    {22579200, 48000, 96768000, 7, 1, 30, 0, {{7, 3, 96}, {7, 3, 96}, {9, 2, 112}}, {{0, 0, 0}, {0, 0, 0}, {21, 3, 32}}},
+    {24000000, 48000, 86016000, 2, 1, 7, 1680, {{7, 2, 128}, {7, 2, 128}, {8, 2, 112}}, {{7, 2, 128}, {14, 2, 64}, {14, 4, 32}}},
+    {24576000, 48000, 24576000, 0, 0, 0, 0, {{2, 2, 128}, {2, 2, 128}, {2, 2, 128}}, {{2, 2, 128}, {4, 2, 64}, {4, 4, 32}}},
+    {11289600, 88200, 84672000, 1, 1, 7, 5000, {{0, 0, 0}, {3, 5, 64}, {5, 3, 64}}, {{0, 0, 0}, {5, 3, 64}, {10, 3, 32}}},
+    {12000000, 88200, 84672000, 1, 1, 7, 560, {{0, 0, 0}, {3, 5, 64}, {5, 3, 64}}, {{0, 0, 0}, {5, 3, 64}, {10, 3, 32}}},
+    {12288000, 88200, 90316800, 1, 1, 7, 3500, {{0, 0, 0}, {4, 4, 64}, {4, 4, 64}}, {{0, 0, 0}, {8, 2, 64}, {8, 4, 32}}},
+    {22579200, 88200, 22579200, 0, 0, 0, 0, {{0, 0, 0}, {1, 4, 64}, {1, 4, 64}}, {{0, 0, 0}, {2, 2, 64}, {2, 4, 32}}},
+    {24000000, 88200, 84672000, 2, 1, 7, 560, {{0, 0, 0}, {3, 5, 64}, {5, 3, 64}}, {{0, 0, 0}, {5, 3, 64}, {10, 3, 32}}},
+    {24576000, 88200, 90316800, 2, 1, 7, 3500, {{0, 0, 0}, {4, 4, 64}, {4, 4, 64}}, {{0, 0, 0}, {8, 2, 64}, {8, 4, 32}}},
+    {12000000, 96000, 86016000, 1, 1, 7, 1680, {{0, 0, 0}, {2, 7, 64}, {4, 4, 56}}, {{0, 0, 0}, {7, 2, 64}, {7, 4, 32}}},
+    {12288000, 96000, 86016000, 1, 1, 7, 0, {{0, 0, 0}, {2, 7, 64}, {4, 4, 56}}, {{0, 0, 0}, {7, 2, 64}, {7, 4, 32}}},
+    {24000000, 96000, 86016000, 2, 1, 7, 1680, {{0, 0, 0}, {2, 7, 64}, {4, 4, 56}}, {{0, 0, 0}, {7, 2, 64}, {7, 4, 32}}},
+    {24576000, 96000, 24576000, 0, 0, 0, 0, {{0, 0, 0}, {1, 4, 64}, {1, 4, 64}}, {{0, 0, 0}, {2, 2, 64}, {2, 4, 32}}},
+    {11289600, 176400, 84672000, 1, 1, 7, 5000, {{0, 0, 0}, {0, 0, 0}, {2, 8, 30}}, {{0, 0, 0}, {0, 0, 0}, {5, 3, 32}}},
+    {12000000, 176400, 84672000, 1, 1, 7, 560, {{0, 0, 0}, {0, 0, 0}, {2, 8, 30}}, {{0, 0, 0}, {0, 0, 0}, {5, 3, 32}}},
+    {12288000, 176400, 90316800, 1, 1, 7, 3500, {{0, 0, 0}, {0, 0, 0}, {2, 8, 32}}, {{0, 0, 0}, {0, 0, 0}, {4, 4, 32}}},
+    {22579200, 176400, 84672000, 2, 1, 7, 5000, {{0, 0, 0}, {0, 0, 0}, {2, 8, 30}}, {{0, 0, 0}, {0, 0, 0}, {5, 3, 32}}},
+    {24000000, 176400, 84672000, 2, 1, 7, 560, {{0, 0, 0}, {0, 0, 0}, {2, 8, 30}}, {{0, 0, 0}, {0, 0, 0}, {5, 3, 32}}},
+    {24576000, 176400, 90316800, 2, 1, 7, 3500, {{0, 0, 0}, {0, 0, 0}, {2, 8, 32}}, {{0, 0, 0}, {0, 0, 0}, {4, 4, 32}}},
+    {45158400, 176400, 45158400, 0, 0, 0, 0, {{0, 0, 0}, {0, 0, 0}, {1, 8, 32}}, {{0, 0, 0}, {0, 0, 0}, {2, 4, 32}}},
+    {12000000, 192000, 86016000, 1, 1, 7, 1680, {{0, 0, 0}, {0, 0, 0}, {2, 7, 32}}, {{0, 0, 0}, {0, 0, 0}, {2, 7, 32}}},
+    {12288000, 192000, 86016000, 1, 1, 7, 0, {{0, 0, 0}, {0, 0, 0}, {2, 7, 32}}, {{0, 0, 0}, {0, 0, 0}, {2, 7, 32}}},
+    {24000000, 192000, 86016000, 2, 1, 7, 1680, {{0, 0, 0}, {0, 0, 0}, {2, 7, 32}}, {{0, 0, 0}, {0, 0, 0}, {2, 7, 32}}},
+    {24576000, 192000, 86016000, 2, 1, 7, 0, {{0, 0, 0}, {0, 0, 0}, {2, 7, 32}}, {{0, 0, 0}, {0, 0, 0}, {2, 7, 32}}},
+    {49152000, 192000, 49152000, 0, 0, 0, 0, {{0, 0, 0}, {0, 0, 0}, {1, 8, 32}}, {{0, 0, 0}, {0, 0, 0}, {2, 4, 32}}},
+};
@@ -21,11 +21,28 @@ respective component folders / files if different from this license.
 
 #include "codec.h"
 
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
 #include <driver/i2s_std.h>
+#include <driver/i2s_tdm.h>
+#include "sdkconfig.h"
 #include "esp_log.h"
 #include "esp_attr.h"
+#include "uac_trace.h"
+#include "uac_mem.h"
+#include "uac_rt_profile.h"
+#include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
 #include "driver/i2c.h"
+#include "pcm_ops.h"
+#include "aic3254_clocks.h"
+#if CONFIG_UAC_SOF_CLOCK_LOCK
+#include "hal/clk_tree_ll.h"
+#include "usb_device_uac.h"
+#endif
 
 
 static i2s_chan_handle_t tx_handle = NULL;
@@ -44,8 +61,31 @@ static const char *TAG = "CODEC";
 #define I2S_WS GPIO_NUM_10
 #define I2S_DOUT GPIO_NUM_11
 #define I2S_DIN GPIO_NUM_9
+#define I2S_SAMPLE_RATE 48000
+#define I2S_MCLK_HZ (I2S_SAMPLE_RATE * 256) // I2S_MCLK_MULTIPLE_256
+
+// more than two USB channels switch the bus to 8 slot TDM, the AIC3254 occupies slots 0 and 1,
+// the remaining slots are free for expansion codecs on the same BCLK / WS / DIN / DOUT lines
+#define I2S_SPK_CHANNELS CONFIG_UAC_SPEAKER_CHANNEL_NUM
+#define I2S_MIC_CHANNELS CONFIG_UAC_MIC_CHANNEL_NUM
+#if I2S_SPK_CHANNELS > 2 || I2S_MIC_CHANNELS > 2
+#define I2S_TDM 1
+#define I2S_SLOT_NUM 8
+#define I2S_CODEC_SLOT 0
+// a DMA buffer is limited to 4092 bytes, keep about the same total buffering as in stereo mode
+#define I2S_DMA_DESC_NUM 8
+#define I2S_DMA_FRAME_NUM 240
+#else
+#define I2S_TDM 0
+#define I2S_SLOT_NUM 2
+#define I2S_CODEC_SLOT 0
+#define I2S_DMA_DESC_NUM 4
+#define I2S_DMA_FRAME_NUM 512
+#endif
 
 uint8_t page = 255;
+// the page select and the register access after it must not interleave between the SPI and control tasks
+static SemaphoreHandle_t i2c_lock;
 
 #define AIC3254_ADDR 0x18 // 0b0011000 (7-bit address)
 #define ACK_CHECK_EN 1
@@ -85,8 +125,18 @@ uint8_t page = 255;
 #define AIC32X4_DACMUTE        AIC32X4_REG(0, 64)
 #define AIC32X4_LDACVOL        AIC32X4_REG(0, 65)
 #define AIC32X4_RDACVOL        AIC32X4_REG(0, 66)
+#define AIC32X4_DRCCTL1        AIC32X4_REG(0, 68)
+#define AIC32X4_DRCCTL2        AIC32X4_REG(0, 69)
+#define AIC32X4_DRCCTL3        AIC32X4_REG(0, 70)
 #define AIC3254_BEEPCTL_L        AIC32X4_REG(0, 71)
 #define AIC3254_BEEPCTL_R        AIC32X4_REG(0, 72)
+#define AIC3254_BEEPLEN_MSB      AIC32X4_REG(0, 73)
+#define AIC3254_BEEPLEN_MID      AIC32X4_REG(0, 74)
+#define AIC3254_BEEPLEN_LSB      AIC32X4_REG(0, 75)
+#define AIC3254_BEEPSIN_MSB      AIC32X4_REG(0, 76)
+#define AIC3254_BEEPSIN_LSB      AIC32X4_REG(0, 77)
+#define AIC3254_BEEPCOS_MSB      AIC32X4_REG(0, 78)
+#define AIC3254_BEEPCOS_LSB      AIC32X4_REG(0, 79)
 #define AIC32X4_ADCSETUP    AIC32X4_REG(0, 81)
 #define    AIC32X4_ADCFGA        AIC32X4_REG(0, 82)
 #define AIC32X4_LADCVOL        AIC32X4_REG(0, 83)
@@ -98,6 +148,7 @@ uint8_t page = 255;
 #define AIC32X4_LAGC5        AIC32X4_REG(0, 90)
 #define AIC32X4_LAGC6        AIC32X4_REG(0, 91)
 #define AIC32X4_LAGC7        AIC32X4_REG(0, 92)
+#define AIC32X4_LAGCGAIN    AIC32X4_REG(0, 93)
 #define AIC32X4_RAGC1        AIC32X4_REG(0, 94)
 #define AIC32X4_RAGC2        AIC32X4_REG(0, 95)
 #define AIC32X4_RAGC3        AIC32X4_REG(0, 96)
@@ -105,6 +156,7 @@ uint8_t page = 255;
 #define AIC32X4_RAGC5        AIC32X4_REG(0, 98)
 #define AIC32X4_RAGC6        AIC32X4_REG(0, 99)
 #define AIC32X4_RAGC7        AIC32X4_REG(0, 100)
+#define AIC32X4_RAGCGAIN    AIC32X4_REG(0, 101)
 #define AIC32X4_PWRCFG        AIC32X4_REG(1, 1)
 #define AIC32X4_LDOCTL        AIC32X4_REG(1, 2)
 #define AIC32X4_LPLAYBACK    AIC32X4_REG(1, 3)
@@ -120,6 +172,8 @@ uint8_t page = 255;
 #define    AIC32X4_LOLGAIN        AIC32X4_REG(1, 18)
 #define    AIC32X4_LORGAIN        AIC32X4_REG(1, 19)
 #define AIC32X4_HEADSTART    AIC32X4_REG(1, 20)
+#define AIC32X4_LMALVOL        AIC32X4_REG(1, 24)
+#define AIC32X4_RMALVOL        AIC32X4_REG(1, 25)
 #define AIC32X4_MICBIAS        AIC32X4_REG(1, 51)
 #define AIC32X4_LMICPGAPIN    AIC32X4_REG(1, 52)
 #define AIC32X4_LMICPGANIN    AIC32X4_REG(1, 54)
@@ -206,18 +260,56 @@ static esp_err_t test_reg(uint8_t register_address, uint8_t expected_value) {
     }
 }
 
-static void write_AIC32X4_reg(uint8_t reg_add, uint8_t data) {
+static void select_page(uint8_t reg_add) {
     if((reg_add >> 7) != page) {
         page = reg_add >> 7;
         write_reg(AIC32X4_PSEL, page);
         //        ESP_LOGE("AIC3254", "WRITE: Switched to page %d", page);
     }
+}
+
+// explicit page switch of the datasheet sequences, under the lock so no other task's burst sees it
+static void set_page(uint8_t p) {
+    xSemaphoreTake(i2c_lock, portMAX_DELAY);
+    write_reg(AIC32X4_PSEL, p);
+    page = p;
+    xSemaphoreGive(i2c_lock);
+}
+
+static void write_AIC32X4_reg(uint8_t reg_add, uint8_t data) {
+    xSemaphoreTake(i2c_lock, portMAX_DELAY);
+    select_page(reg_add);
     uint8_t reg_add1 = reg_add & 0x7F;
     write_reg(reg_add1, data);
+    xSemaphoreGive(i2c_lock);
     //    uint8_t val = read_16bit_reg(reg_add);
     //    ESP_LOGE("AIC3254", "addr: 0x%02X val: 0x%02X,0x%02X", reg_add, data, val);
 }
 
+// consecutive registers of one page in a single transaction, the AIC3254 increments the register address itself
+static void write_AIC32X4_regs(uint8_t reg_add, const uint8_t *data, size_t len) {
+    xSemaphoreTake(i2c_lock, portMAX_DELAY);
+    select_page(reg_add);
+    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
+    i2c_master_start(cmd);
+    i2c_master_write_byte(cmd, (AIC3254_ADDR << 1) | I2C_MASTER_WRITE, ACK_CHECK_EN);
+    i2c_master_write_byte(cmd, reg_add & 0x7F, ACK_CHECK_EN);
+    i2c_master_write(cmd, data, len, ACK_CHECK_EN);
+    i2c_master_stop(cmd);
+    esp_err_t err = i2c_master_cmd_begin((i2c_port_t) I2C_PORT_NUM, cmd, 1000 / portTICK_PERIOD_MS);
+    i2c_cmd_link_delete(cmd);
+    xSemaphoreGive(i2c_lock);
+    ESP_ERROR_CHECK(err);
+}
+
+static uint8_t read_AIC32X4_reg(uint8_t reg_add) {
+    xSemaphoreTake(i2c_lock, portMAX_DELAY);
+    select_page(reg_add);
+    const uint8_t data = read_reg(reg_add & 0x7F);
+    xSemaphoreGive(i2c_lock);
+    return data;
+}
+
 
 static void identify() {
     write_AIC32X4_reg(AIC32X4_PSEL, 0);
@@ -231,179 +323,230 @@ static void identify() {
     }
 }
 
-// from pg. 26 of https://www.ti.com/lit/an/slaa408a/slaa408a.pdf?ts=1766827966822&ref_url=https%253A%252F%252Fwww.ti.com%252Fproduct%252FTLV320AIC3254
-// check this https://e2e.ti.com/cfs-file/__key/communityserver-discussions-components-files/6/Coefficients.png
-// and this https://e2e.ti.com/support/audio-group/audio/f/audio-forum/669437/tlv320aic3204-first-order-iir-filter-coefficients-for-adc as a reference
-static void ADCHighPassEnable() {
-    // Power down ADCs before changing coefficients
-    write_AIC32X4_reg(AIC32X4_ADCSETUP, 0b00000000);
+typedef struct {
+    uint8_t prb;                // PRB_Px number written to P0_R60
+    char filter;                // interpolation filter type
+    uint8_t group_delay;        // filter group delay in frames
+    uint8_t resource_class;     // instruction budget required, MDAC * DOSR / 32 must be at least this
+    uint8_t dosr_multiple;      // DOSR must be a multiple of this value
+    uint32_t max_fs;            // highest sample rate the filter is specified for
+} dac_prb_t;
+
+typedef struct {
+    uint8_t prb;                // PRB_Rx number written to P0_R61
+    char filter;                // decimation filter type
+    uint8_t group_delay;        // filter group delay in frames
+    uint8_t resource_class;     // instruction budget required, MADC * AOSR / 32 must be at least this
+    uint8_t aosr;               // AOSR the decimation filter requires
+    uint32_t max_fs;            // highest sample rate the filter is specified for
+    uint8_t iir_page_l;         // page of the first order IIR coefficients N0, N1, D1 (left)
+    uint8_t iir_reg_l;          // register of N0 (left), N1 and D1 follow in steps of 4
+    uint8_t iir_page_r;
+    uint8_t iir_reg_r;
+} adc_prb_t;
+
+// the filter limits below are mirrored in tools/aic3254_clock_solver.py, which solves the dividers for them
+// stereo PRBs with DRC, one per interpolation filter (datasheet table "DAC processing blocks")
+static const dac_prb_t dac_prbs[] = {
+    {.prb = 1, .filter = 'A', .group_delay = 21, .resource_class = 8, .dosr_multiple = 8, .max_fs = 48000},
+    {.prb = 8, .filter = 'B', .group_delay = 18, .resource_class = 8, .dosr_multiple = 4, .max_fs = 96000},
+    {.prb = 18, .filter = 'C', .group_delay = 13, .resource_class = 6, .dosr_multiple = 2, .max_fs = 192000},
+};
 
-    // Configure ADC to use PRB_R1 which includes IIR filter
-    write_AIC32X4_reg(AIC32X4_ADCPRB, 0x01);
-
-    // DC blocking filter (first-order HPF) at fc ≈ 3.7Hz, fs = 44100Hz
-    // Transfer function: H(z) = (1 - z^-1) / (1 - α·z^-1)
-    // α = exp(-2π·fc/fs) ≈ 0.999472
-    // N0 = +1.0 * 2^23 = 0x7FFFFF (8388607)
-    // N1 = -1.0 * 2^23 = 0x800001 (-8388607 in two's complement, 24-bit)
-    // D1 = α * 2^23 ≈ 0.999472 * 8388608 ≈ 0x7FB0FE (8384190)
-
-    // Switch to page 8 for left ADC channel coefficients
-    write_reg(AIC32X4_PSEL, 8);
-    page = 8;
-
-    // Left channel: C4 (N0) at Page 8, Reg 24,25,26
-    write_reg(24, 0x7F);  // N0 MSB
-    write_reg(25, 0xFF);  // N0 MID
-    write_reg(26, 0xFF);  // N0 LSB (0x7FFFFF = +8388607)
-
-    // Left channel: C5 (N1) at Page 8, Reg 28,29,30
-    write_reg(28, 0x80);  // N1 MSB
-    write_reg(29, 0x00);  // N1 MID
-    write_reg(30, 0x01);  // N1 LSB (0x800001 = -8388607)
-
-    // Left channel: C6 (D1) at Page 8, Reg 32,33,34
-    write_reg(32, 0x7F);  // D1 MSB
-    write_reg(33, 0xB0);  // D1 MID
-    write_reg(34, 0xFE);  // D1 LSB (0x7FB0FE ≈ 8384190)
-
-    // Switch to page 9 for right ADC channel coefficients
-    write_reg(AIC32X4_PSEL, 9);
-    page = 9;
-
-    // Right channel: C36 (N0) at Page 9, Reg 32,33,34
-    write_reg(32, 0x7F);  // N0 MSB
-    write_reg(33, 0xFF);  // N0 MID
-    write_reg(34, 0xFF);  // N0 LSB
-
-    // Right channel: C37 (N1) at Page 9, Reg 36,37,38
-    write_reg(36, 0x80);  // N1 MSB
-    write_reg(37, 0x00);  // N1 MID
-    write_reg(38, 0x01);  // N1 LSB
-
-    // Right channel: C38 (D1) at Page 9, Reg 40,41,42
-    write_reg(40, 0x7F);  // D1 MSB
-    write_reg(41, 0xB0);  // D1 MID
-    write_reg(42, 0xFE);  // D1 LSB
+// stereo PRBs with first order IIR and AGC, one per decimation filter (datasheet table "ADC processing blocks")
+// the first order IIR lives in C4..C6 (left) and C36..C38 (right) for all of them
+static const adc_prb_t adc_prbs[] = {
+    {.prb = 1, .filter = 'A', .group_delay = 17, .resource_class = 6, .aosr = 128, .max_fs = 48000,
+     .iir_page_l = 8, .iir_reg_l = 24, .iir_page_r = 9, .iir_reg_r = 32},
+    {.prb = 7, .filter = 'B', .group_delay = 11, .resource_class = 3, .aosr = 64, .max_fs = 96000,
+     .iir_page_l = 8, .iir_reg_l = 24, .iir_page_r = 9, .iir_reg_r = 32},
+    {.prb = 13, .filter = 'C', .group_delay = 11, .resource_class = 3, .aosr = 32, .max_fs = 192000,
+     .iir_page_l = 8, .iir_reg_l = 24, .iir_page_r = 9, .iir_reg_r = 32},
+};
 
-    // Switch back to page 0
-    write_reg(AIC32X4_PSEL, 0);
-    page = 0;
+// the beep generator only exists in this DAC processing block, interpolation filter A
+#define AIC3254_BEEP_PRB 25
+#define AIC3254_BEEP_FILTER 'A'
 
-    // Power up ADCs
-    write_AIC32X4_reg(AIC32X4_ADCSETUP, 0b11000000);
+static const dac_prb_t *dac_prb = &dac_prbs[0];
+static const adc_prb_t *adc_prb = &adc_prbs[0];
+static bool adc_hpf_enabled = true;
+static codec_latency_mode_t dac_latency_mode = CODEC_LATENCY_STANDARD;
+static codec_latency_mode_t adc_latency_mode = CODEC_LATENCY_STANDARD;
 
-    ESP_LOGI(TAG, "High-pass IIR filter enabled on ADC path (3.7Hz @ 44.1kHz)");
-}
+// clock tree for I2S_MCLK_HZ and I2S_SAMPLE_RATE from the table of tools/aic3254_clock_solver.py,
+// it holds the lowest power dividers of every filter, or zeros where the filter can not run at the rate
+static const aic3254_clock_cfg_t *clock_cfg;
 
+static const aic3254_clock_cfg_t *find_clock_cfg(uint32_t mclk_hz, uint32_t fs) {
+    for (size_t i = 0; i < sizeof(aic3254_clock_cfgs) / sizeof(aic3254_clock_cfgs[0]); i++) {
+        if (aic3254_clock_cfgs[i].mclk_hz == mclk_hz && aic3254_clock_cfgs[i].fs == fs) return &aic3254_clock_cfgs[i];
+    }
+    return NULL;
+}
 
+static const aic3254_dividers_t *dac_dividers(char filter) {
+    return &clock_cfg->dac[filter - 'A'];
+}
 
-static void ADCHighPassDisable() {
-    // power down l+r adcs
-    write_AIC32X4_reg(AIC32X4_ADCSETUP, 0b00000000); // (P0_R81) power down left and right ADCs
+static const aic3254_dividers_t *adc_dividers(char filter) {
+    return &clock_cfg->adc[filter - 'A'];
+}
 
-    // Configure ADC to use PRB_R1 (same as HPF enabled)
-    write_AIC32X4_reg(AIC32X4_ADCPRB, 0x01);
+static bool dac_prb_valid(const dac_prb_t *prb) {
+    return dac_dividers(prb->filter)->n != 0;
+}
 
-    // Switch to page 8 for left ADC channel coefficients
-    write_reg(AIC32X4_PSEL, 8);
-    page = 8;
+static bool adc_prb_valid(const adc_prb_t *prb) {
+    return adc_dividers(prb->filter)->n != 0;
+}
 
-    // Left channel: C4 (N0) at Page 8, Reg 24,25,26 - Default from Table 5-4: 0x7FFFFF00
-    write_reg(24, 0x7F);  // N0 MSB
-    write_reg(25, 0xFF);  // N0 MID
-    write_reg(26, 0xFF);  // N0 LSB - Changed to 0xFF (closer to unity gain in Q23)
+// standard: the first valid block, the tables are ordered by stopband attenuation; low: the least group delay
+static const dac_prb_t *select_dac_prb(codec_latency_mode_t mode) {
+    const dac_prb_t *best = NULL;
+    for (size_t i = 0; i < sizeof(dac_prbs) / sizeof(dac_prbs[0]); i++) {
+        if (!dac_prb_valid(&dac_prbs[i])) continue;
+        if (best == NULL) best = &dac_prbs[i];
+        if (mode == CODEC_LATENCY_STANDARD) break;
+        if (dac_prbs[i].group_delay < best->group_delay) best = &dac_prbs[i];
+    }
+    return best;
+}
 
-    // Left channel: C5 (N1) at Page 8, Reg 28,29,30 - Zero
-    write_reg(28, 0x00);  // N1 MSB
-    write_reg(29, 0x00);  // N1 MID
-    write_reg(30, 0x00);  // N1 LSB
+static const adc_prb_t *select_adc_prb(codec_latency_mode_t mode) {
+    const adc_prb_t *best = NULL;
+    for (size_t i = 0; i < sizeof(adc_prbs) / sizeof(adc_prbs[0]); i++) {
+        if (!adc_prb_valid(&adc_prbs[i])) continue;
+        if (best == NULL) best = &adc_prbs[i];
+        if (mode == CODEC_LATENCY_STANDARD) break;
+        if (adc_prbs[i].group_delay < best->group_delay) best = &adc_prbs[i];
+    }
+    return best;
+}
 
-    // Left channel: C6 (D1) at Page 8, Reg 32,33,34 - Zero
-    write_reg(32, 0x00);  // D1 MSB
-    write_reg(33, 0x00);  // D1 MID
-    write_reg(34, 0x00);  // D1 LSB
+// NDAC, MDAC and DOSR of the interpolation filter, the DAC must be powered down
+static void write_dac_dividers(char filter) {
+    const aic3254_dividers_t *div = dac_dividers(filter);
+    write_AIC32X4_reg(AIC32X4_NDAC, 0x80 | (div->n & 0x7F));     // 128 is written as 0
+    write_AIC32X4_reg(AIC32X4_MDAC, 0x80 | (div->m & 0x7F));
+    write_AIC32X4_reg(AIC32X4_DOSRMSB, (div->osr >> 8) & 0x03);  // 1024 is written as 0
+    write_AIC32X4_reg(AIC32X4_DOSRLSB, div->osr & 0xFF);
+}
 
-    // Switch to page 9 for right ADC channel coefficients
-    write_reg(AIC32X4_PSEL, 9);
-    page = 9;
+// writes a 24-bit coefficient to the adaptive filter memory, MSB first
+static void write_coeff(uint8_t coeff_page, uint8_t reg, int32_t value) {
+    xSemaphoreTake(i2c_lock, portMAX_DELAY);
+    if (page != coeff_page) {
+        write_reg(AIC32X4_PSEL, coeff_page);
+        page = coeff_page;
+    }
+    write_reg(reg, (value >> 16) & 0xFF);
+    write_reg(reg + 1, (value >> 8) & 0xFF);
+    write_reg(reg + 2, value & 0xFF);
+    xSemaphoreGive(i2c_lock);
+}
 
-    // Right channel: C36 (N0) at Page 9, Reg 32,33,34 - Default: 0x7FFFFF00
-    write_reg(32, 0x7F);  // N0 MSB
-    write_reg(33, 0xFF);  // N0 MID
-    write_reg(34, 0xFF);  // N0 LSB
+static void write_adc_iir(int32_t n0, int32_t n1, int32_t d1) {
+    write_coeff(adc_prb->iir_page_l, adc_prb->iir_reg_l, n0);
+    write_coeff(adc_prb->iir_page_l, adc_prb->iir_reg_l + 4, n1);
+    write_coeff(adc_prb->iir_page_l, adc_prb->iir_reg_l + 8, d1);
+    write_coeff(adc_prb->iir_page_r, adc_prb->iir_reg_r, n0);
+    write_coeff(adc_prb->iir_page_r, adc_prb->iir_reg_r + 4, n1);
+    write_coeff(adc_prb->iir_page_r, adc_prb->iir_reg_r + 8, d1);
 
-    // Right channel: C37 (N1) at Page 9, Reg 36,37,38 - Zero
-    write_reg(36, 0x00);  // N1 MSB
-    write_reg(37, 0x00);  // N1 MID
-    write_reg(38, 0x00);  // N1 LSB
+    // Switch back to page 0
+    set_page(0);
+}
 
-    // Right channel: C38 (D1) at Page 9, Reg 40,41,42 - Zero
-    write_reg(40, 0x00);  // D1 MSB
-    write_reg(41, 0x00);  // D1 MID
-    write_reg(42, 0x00);  // D1 LSB
+// from pg. 26 of https://www.ti.com/lit/an/slaa408a/slaa408a.pdf?ts=1766827966822&ref_url=https%253A%252F%252Fwww.ti.com%252Fproduct%252FTLV320AIC3254
+// check this https://e2e.ti.com/cfs-file/__key/communityserver-discussions-components-files/6/Coefficients.png
+// and this https://e2e.ti.com/support/audio-group/audio/f/audio-forum/669437/tlv320aic3204-first-order-iir-filter-coefficients-for-adc as a reference
+static void apply_adc_prb() {
+    // Power down ADCs before changing the processing block or coefficients
+    write_AIC32X4_reg(AIC32X4_ADCSETUP, 0b00000000);
 
-    // Switch back to page 0
-    write_reg(AIC32X4_PSEL, 0);
-    page = 0;
+    // Decimation filter B and C need a lower AOSR, NADC and MADC keep NADC * MADC * AOSR * fs = CODEC_CLKIN
+    const aic3254_dividers_t *div = adc_dividers(adc_prb->filter);
+    write_AIC32X4_reg(AIC32X4_NADC, 0x80 | (div->n & 0x7F));
+    write_AIC32X4_reg(AIC32X4_MADC, 0x80 | (div->m & 0x7F));
+    write_AIC32X4_reg(AIC32X4_AOSR, div->osr & 0xFF);           // 256 is written as 0
+    write_AIC32X4_reg(AIC32X4_ADCPRB, adc_prb->prb);
+
+    if (adc_hpf_enabled) {
+        // DC blocking filter (first-order HPF) at fc ≈ 3.7Hz
+        // Transfer function: H(z) = (1 - z^-1) / (1 - α·z^-1)
+        // α = exp(-2π·fc/fs), ≈ 0.999516 at 48kHz
+        // N0 = +1.0 * 2^23 = 0x7FFFFF (8388607)
+        // N1 = -1.0 * 2^23 = 0x800001 (-8388607 in two's complement, 24-bit)
+        // D1 = α * 2^23
+        const int32_t d1 = (int32_t)(expf(-2.0f * (float)M_PI * 3.7f / I2S_SAMPLE_RATE) * 8388608.0f);
+        write_adc_iir(0x7FFFFF, 0x800001, d1);
+        ESP_LOGI(TAG, "High-pass IIR filter enabled on ADC path (3.7Hz @ %dHz), PRB_R%d", I2S_SAMPLE_RATE, adc_prb->prb);
+    } else {
+        // all-pass: N0 close to unity gain in Q23, N1 = D1 = 0
+        write_adc_iir(0x7FFFFF, 0, 0);
+        ESP_LOGI(TAG, "High-pass filter disabled on ADC path (all-pass/bypass mode), PRB_R%d", adc_prb->prb);
+    }
 
-    write_AIC32X4_reg(AIC32X4_ADCSETUP, 0b11000000); // (P0_R81) power up left and right ADCs
+    // Power up ADCs
+    write_AIC32X4_reg(AIC32X4_ADCSETUP, 0b11000000);
+}
 
-    ESP_LOGI(TAG, "High-pass filter disabled on ADC path (all-pass/bypass mode)");
+void SetInputHighPass(uint32_t enable) {
+    adc_hpf_enabled = enable != 0;
+    // before bring-up only the state is kept, cfg_codec writes it
+    if (clock_cfg) apply_adc_prb();
 }
 
-static void cfg_codec(const bool use_pll) {
-    ESP_LOGI(TAG, "AIC3254 configuration");
+static void cfg_codec() {
+    ESP_LOGI(TAG, "AIC3254 configuration, CODEC_CLKIN %lu Hz, PLL %s", (unsigned long)clock_cfg->codec_clkin_hz,
+             clock_cfg->pll_p ? "on" : "off");
 
     // Step 1: Define starting point - Set register page to 0
-    write_reg(AIC32X4_PSEL, 0);
-    page = 0;
+    set_page(0);
 
     // Step 2: Initiate SW Reset
     write_AIC32X4_reg(AIC32X4_RESET, 0x01);
     vTaskDelay(10 / portTICK_PERIOD_MS);
 
-    if (use_pll){
+    if (clock_cfg->pll_p){
         // Step 3: Program Clock Settings
         // PLL_CLKIN = MCLK, CODEC_CLKIN = PLL_CLK
         write_AIC32X4_reg(AIC32X4_CLKMUX, 0x03);
 
-        // Step 4: Program PLL clock dividers (P=1, R=1, J=4, D=0)
-        write_AIC32X4_reg(AIC32X4_PLLPR, 0x11);      // PLL disabled, P=1, R=1
-        write_AIC32X4_reg(AIC32X4_PLLJ, 0x04);       // J = 4
-        write_AIC32X4_reg(AIC32X4_PLLDMSB, 0x00);    // D[13:8] = 0
-        write_AIC32X4_reg(AIC32X4_PLLDLSB, 0x00);    // D[7:0] = 0
+        // Step 4: Program PLL clock dividers, P = 8 is written as 0
+        const uint8_t pllpr = ((clock_cfg->pll_p & 0x07) << 4) | clock_cfg->pll_r;
+        write_AIC32X4_reg(AIC32X4_PLLPR, pllpr);     // PLL disabled
+        write_AIC32X4_reg(AIC32X4_PLLJ, clock_cfg->pll_j);
+        write_AIC32X4_reg(AIC32X4_PLLDMSB, clock_cfg->pll_d >> 8);
+        write_AIC32X4_reg(AIC32X4_PLLDLSB, clock_cfg->pll_d & 0xFF);
 
         // Step 5: Power up PLL
-        write_AIC32X4_reg(AIC32X4_PLLPR, 0x91);      // Power up PLL, P=1, R=1
+        write_AIC32X4_reg(AIC32X4_PLLPR, 0x80 | pllpr);
         vTaskDelay(10 / portTICK_PERIOD_MS);         // Wait for PLL lock
     }
-
-    // Step 3: Program Clock Settings default
-    // CODEC_CLKIN = MCLK
-
-    // Step 4: Program PLL clock dividers default
-
-    // Step 6: Program and power up NDAC
-    write_AIC32X4_reg(AIC32X4_NDAC, 0x81);       // Power up NDAC = 1
-
-    // Step 7: Program and power up MDAC
-    write_AIC32X4_reg(AIC32X4_MDAC, 0x82);       // Power up MDAC = 2
-
-    // Step 8: Program OSR value
-    write_AIC32X4_reg(AIC32X4_DOSRMSB, 0x00);
-    write_AIC32X4_reg(AIC32X4_DOSRLSB, 0x80);    // DOSR = 128
-
+    // without the PLL the reset default applies, CODEC_CLKIN = MCLK
+
+    // Step 6 - 8: Program and power up NDAC, MDAC, program DOSR
+    write_dac_dividers(dac_prb->filter);
+
+#if I2S_TDM
+    // Step 9: Program DSP mode (16-bit), data one BCLK after the WS pulse plus the slot offset,
+    // DOUT is released after the codec slots so other devices can drive the line
+    write_AIC32X4_reg(AIC32X4_IFACE1, 0b01000001);
+    write_AIC32X4_reg(AIC32X4_IFACE2, 1 + I2S_CODEC_SLOT * 16);
+    write_AIC32X4_reg(AIC32X4_IFACE3, 0b00001000); // DSP mode samples on the inverted BCLK
+#else
     // Step 9: Program I2S word length (16-bit)
     write_AIC32X4_reg(AIC32X4_IFACE1, 0b00000000);
     write_AIC32X4_reg(AIC32X4_IFACE2, 0x00);
+#endif
 
-    // Step 10: Program processing block (using defaults PRB_P1 and PRB_R1)
-    // Default values are already suitable
+    // Step 10: Program processing block, PRB_R is set together with the ADC clocks
+    write_AIC32X4_reg(AIC32X4_DACPRB, dac_prb->prb);
 
     // Step 11: Program Analog Blocks - Set register page to 1
-    write_reg(AIC32X4_PSEL, 1);
-    page = 1;
+    set_page(1);
 
     // Step 12: Disable coarse AVDD generation
     write_AIC32X4_reg(AIC32X4_PWRCFG, 0b00001000);
@@ -437,11 +580,10 @@ static void cfg_codec(const bool use_pll) {
     vTaskDelay(10 / portTICK_PERIOD_MS);
 
     // Step 22: Power Up DAC - Set register page to 0
-    write_reg(AIC32X4_PSEL, 0);
-    page = 0;
+    set_page(0);
 
     // Step 23: Power up DAC channels
-    write_AIC32X4_reg(AIC32X4_DACSETUP, 0b11010100);
+    write_AIC32X4_reg(AIC32X4_DACSETUP, 0b11010100); // soft-stepping of the volume, one step per frame
 
     // Step 24: Unmute digital volume control
     write_AIC32X4_reg(AIC32X4_DACMUTE, 0x00);
@@ -449,80 +591,756 @@ static void cfg_codec(const bool use_pll) {
     write_AIC32X4_reg(AIC32X4_RDACVOL, 0x00);    // Right DAC 0dB
 
     // ADC Configuration (similar sequence for recording path)
-    write_AIC32X4_reg(AIC32X4_NADC, 0x81);       // Power up NADC = 1
-    write_AIC32X4_reg(AIC32X4_MADC, 0x82);       // Power up MADC = 2
-    write_AIC32X4_reg(AIC32X4_AOSR, 0x80);       // AOSR = 128
+    // NADC, MADC and AOSR follow the PRB, see apply_adc_prb
 
     // ADC routing
-    write_reg(AIC32X4_PSEL, 1);
-    page = 1;
+    set_page(1);
     write_AIC32X4_reg(AIC32X4_LMICPGAPIN, 0b01000000);
     write_AIC32X4_reg(AIC32X4_RMICPGAPIN, 0b01000000);
     write_AIC32X4_reg(AIC32X4_LMICPGANIN, 0b01000000);
     write_AIC32X4_reg(AIC32X4_RMICPGANIN, 0b01000000);
-    write_AIC32X4_reg(AIC32X4_LMICPGAVOL, 0x80);
-    write_AIC32X4_reg(AIC32X4_RMICPGAVOL, 0x80);
 
-    write_reg(AIC32X4_PSEL, 0);
-    page = 0;
-    ADCHighPassEnable();
+    set_page(0);
+    apply_adc_prb();
     write_AIC32X4_reg(AIC32X4_ADCSETUP, 0b11000000);
     write_AIC32X4_reg(AIC32X4_ADCFGA, 0x00);
 }
 
+// control settings from the USB callbacks, written to the codec by control_task. Updates that arrive while
+// the task is busy are written once with their latest value, the USB task never waits for the I2C bus
+#define CTRL_INPUT_GAIN (1 << 0)
+#define CTRL_OUTPUT_VOLUME (1 << 1)
+#define CTRL_MONITOR (1 << 2)
+#define CTRL_AGC (1 << 3)
+#define CTRL_DRC (1 << 4)
 
-void SetOutputLevels(const uint32_t left, const uint32_t right) {
-    // incoming range expected 0..100 (percent)
-    // map 0..100 -> register range 0x81..0x0D (-63.5dB to +6.5dB)
-    // codec register: 0x81 = -63.5dB, ..., 0xFF = -0.5dB, 0x00 = 0dB, 0x01 = +0.5dB, ..., 0x0D = +6.5dB
-    // Total range: 0x81 (129) to 0x0D (13) wrapping through 0xFF->0x00
-    // Linear steps from -127 to +13 in two's complement = 140 steps total
+static TaskHandle_t control_task_handle;
+static portMUX_TYPE ctrl_mux = portMUX_INITIALIZER_UNLOCKED;
 
-    uint8_t left_reg = 0x81;
-    uint8_t right_reg = 0x81;
+static void request_control(uint32_t what) {
+    if (control_task_handle) xTaskNotify(control_task_handle, what, eSetBits);
+}
 
-    // clamp to 100
-    uint32_t left_clamped = left > 100 ? 100 : left;
-    uint32_t right_clamped = right > 100 ? 100 : right;
+// firmware monitor, the input is mixed in the RX DMA callback and added in front of the TX DMA
+#define MONITOR_RING_FRAMES (4 * I2S_DMA_FRAME_NUM)
+#define MONITOR_MAX_BACKLOG (2 * I2S_DMA_FRAME_NUM)
+// playback is considered stopped when i2s_write was not called for two DMA buffers
+#define MONITOR_IDLE_US (2 * I2S_DMA_FRAME_NUM * 1000000LL / I2S_SAMPLE_RATE)
+
+static monitor_mode_t monitor_mode = MONITOR_OFF;
+static int16_t monitor_gain[2][2] = {
+    {MONITOR_GAIN_SILENCE, MONITOR_GAIN_SILENCE},
+    {MONITOR_GAIN_SILENCE, MONITOR_GAIN_SILENCE},
+}; // [in][out] in 1/256 dB
+static int16_t monitor_q15[2][2];
+static int16_t monitor_ring[MONITOR_RING_FRAMES * 2];
+static volatile uint32_t monitor_head, monitor_tail; // frame counters, written by ISR / consumers
+static volatile int64_t last_write_us;
+static SemaphoreHandle_t monitor_lock;
+static TaskHandle_t monitor_task_handle;
+static int16_t mix_buf[I2S_DMA_FRAME_NUM * I2S_SLOT_NUM];
+static int16_t idle_buf[I2S_DMA_FRAME_NUM * I2S_SLOT_NUM];
+
+#if I2S_TDM
+// TDM slot of each USB channel
+static uint8_t spk_slot_map[I2S_SPK_CHANNELS];
+static uint8_t mic_slot_map[I2S_MIC_CHANNELS];
+static int16_t tdm_rx_buf[I2S_DMA_FRAME_NUM * I2S_SLOT_NUM];
+#endif
+
+// latency probe, a marker goes out on the codec left slot and is searched for on the codec left input.
+// Both ends are timestamped in the I2S DMA callbacks, frame k of a buffer of n frames passed the pins
+// (n - 1 - k) frames before the callback, the callback delay is the same for both directions and cancels
+#define PROBE_MARKER 16384          // +/- doublet at -6dBFS, the first frame is the reference
+#define PROBE_THRESHOLD 2048        // -24dBFS on the input
+#define PROBE_HOLD_FRAMES 96        // the marker peak is final after 2ms without a higher sample
+#define PROBE_TIMEOUT_MS 500
+#define PROBE_USB_IN_WAIT_MS 50     // capture blocks are handed out every 10ms
+#define PROBE_BEEP_FRAMES 96
+#define PROBE_BEEP_VOLUME 8         // -6dB, 0 is +2dB in 1dB steps
+#define PROBE_BEEP_COEFF 23170      // sin and cos of 2pi/8 in Q15, a tone at fs/8 rises within a frame
+#define FRAMES_TO_US(frames) ((int64_t)(frames) * 1000000 / I2S_SAMPLE_RATE)
+
+typedef enum {
+    PROBE_IDLE = 0,
+    PROBE_INJECT,   // the next output buffer carries the marker
+    PROBE_WAIT_TX,  // marker queued, searched for in the sent TX DMA buffers
+    PROBE_WAIT_RX,  // marker left, searched for in the received RX DMA buffers
+    PROBE_DONE,
+} probe_state_t;
+
+static volatile probe_state_t probe_state;
+static latency_probe_marker_t probe_marker;
+static int16_t probe_buf[I2S_DMA_FRAME_NUM * I2S_SLOT_NUM];
+static int64_t next_usb_out_us;          // USB hand-off of the block in the next i2s_write
+static int64_t probe_usb_out_us;         // USB hand-off of the block carrying the marker, 0 if the probe wrote it
+static volatile int64_t probe_tx_us;     // marker on the output pins
+static volatile int64_t probe_rx_us;     // marker peak on the input pins
+static volatile int64_t probe_usb_in_us; // capture block holding the peak handed to USB
+static volatile int32_t probe_peak;
+static volatile uint32_t probe_peak_frame; // RX DMA frame count of the peak
+static volatile uint32_t probe_usb_in_frame;
+static uint32_t probe_hold;
+static int16_t probe_tx_last;            // last codec slot sample of the previous TX buffer
+// RX DMA frames received and dropped on a full queue, frames handed out by i2s_read
+static volatile uint32_t rx_dma_frames, rx_dropped_frames;
+#if CONFIG_UAC_SOF_CLOCK_LOCK
+static volatile int64_t rx_dma_us; // esp_timer time of the last RX DMA interrupt, together with rx_dma_frames under lock_mux
+static portMUX_TYPE lock_mux = portMUX_INITIALIZER_UNLOCKED;
+#endif
+static uint32_t rx_read_frames;
+
+// places the marker at the start of an interleaved I2S buffer if one is due
+static void probe_inject(int16_t *buf, size_t frames, int64_t usb_us) {
+    if (probe_state != PROBE_INJECT || frames < 2) return;
+    buf[I2S_CODEC_SLOT] = PROBE_MARKER;
+    buf[I2S_SLOT_NUM + I2S_CODEC_SLOT] = -PROBE_MARKER;
+    probe_usb_out_us = usb_us;
+    probe_tx_last = 0;
+    probe_state = PROBE_WAIT_TX;
+}
 
-    // Map 0->0x81 (-63.5dB), 100->0x0D (+6.5dB)
-    // Convert to signed: 0x81=-127, 0xFF=-1, 0x00=0, 0x0D=+13
-    // Range: -127 to +13 = 140 steps
-    // Formula: signed_val = -127 + (input * 140 / 100)
-    int16_t left_signed = (int16_t)(-127 + (left_clamped * 140 / 100));
-    int16_t right_signed = (int16_t)(-127 + (right_clamped * 140 / 100));
+static IRAM_ATTR bool i2s_tx_sent_cb(i2s_chan_handle_t handle, i2s_event_data_t *event, void *user_ctx) {
+    if (probe_state != PROBE_WAIT_TX) return false;
+    const int64_t now = esp_timer_get_time();
+    const int16_t *src = (const int16_t *)event->dma_buf + I2S_CODEC_SLOT;
+    const size_t frames = event->size / (I2S_SLOT_NUM * sizeof(int16_t));
+    // the doublet may straddle two DMA buffers
+    int16_t prev = probe_tx_last;
+    for (size_t k = 0; k < frames; k++) {
+        const int16_t cur = src[k * I2S_SLOT_NUM];
+        if (prev == PROBE_MARKER && cur == -PROBE_MARKER) {
+            probe_tx_us = now - FRAMES_TO_US(frames - k);
+            probe_state = PROBE_WAIT_RX;
+            return false;
+        }
+        prev = cur;
+    }
+    probe_tx_last = prev;
+    return false;
+}
 
-    // Clamp to valid range
-    if (left_signed > 13) left_signed = 13;
-    if (left_signed < -127) left_signed = -127;
-    if (right_signed > 13) right_signed = 13;
-    if (right_signed < -127) right_signed = -127;
+static IRAM_ATTR void probe_scan_rx(const int16_t *src, size_t frames) {
+    const int64_t now = esp_timer_get_time();
+    const uint32_t first = rx_dma_frames - frames;
+    for (size_t k = 0; k < frames; k++) {
+        const int64_t t = now - FRAMES_TO_US(frames - 1 - k);
+        if (t < probe_tx_us) continue;
+        const int32_t v = src[k * I2S_SLOT_NUM] < 0 ? -src[k * I2S_SLOT_NUM] : src[k * I2S_SLOT_NUM];
+        if (v >= PROBE_THRESHOLD && v > probe_peak) {
+            probe_peak = v;
+            probe_peak_frame = first + k;
+            probe_rx_us = t;
+            probe_hold = 0;
+            // the beep is a tone, its onset is the reference rather than its peak
+            if (probe_marker == LATENCY_PROBE_BEEP) {
+                probe_state = PROBE_DONE;
+                return;
+            }
+        } else if (probe_peak != 0 && ++probe_hold >= PROBE_HOLD_FRAMES) {
+            probe_state = PROBE_DONE;
+            return;
+        }
+    }
+}
+
+static IRAM_ATTR bool i2s_rx_queue_ovf_cb(i2s_chan_handle_t handle, i2s_event_data_t *event, void *user_ctx) {
+    // the driver dropped the oldest unread buffer
+    rx_dropped_frames += I2S_DMA_FRAME_NUM;
+    return false;
+}
 
-    // Convert signed to register value (two's complement for negative)
-    left_reg = (uint8_t)(left_signed & 0xFF);
-    right_reg = (uint8_t)(right_signed & 0xFF);
+static IRAM_ATTR bool i2s_rx_done_cb(i2s_chan_handle_t handle, i2s_event_data_t *event, void *user_ctx) {
+    const int16_t *src = (const int16_t *)event->dma_buf + I2S_CODEC_SLOT;
+    const size_t frames = event->size / (I2S_SLOT_NUM * sizeof(int16_t));
+#if CONFIG_UAC_SOF_CLOCK_LOCK
+    const int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL_ISR(&lock_mux);
+    rx_dma_frames += frames;
+    rx_dma_us = now;
+    portEXIT_CRITICAL_ISR(&lock_mux);
+#else
+    rx_dma_frames += frames;
+#endif
+    if (probe_state == PROBE_WAIT_RX) probe_scan_rx(src, frames);
+    if (monitor_mode != MONITOR_FIRMWARE) return false;
+    const uint32_t head = monitor_head;
+    if (head - monitor_tail + frames > MONITOR_RING_FRAMES) return false; // consumers stalled, drop block
+    const size_t idx = head % MONITOR_RING_FRAMES;
+    const size_t first = frames < MONITOR_RING_FRAMES - idx ? frames : MONITOR_RING_FRAMES - idx;
+    pcm_mix_matrix_2x2(&monitor_ring[idx * 2], src, I2S_SLOT_NUM, first, monitor_q15);
+    pcm_mix_matrix_2x2(monitor_ring, src + first * I2S_SLOT_NUM, I2S_SLOT_NUM, frames - first, monitor_q15);
+    monitor_head = head + frames;
+
+    BaseType_t high_task_wakeup = pdFALSE;
+    vTaskNotifyGiveFromISR(monitor_task_handle, &high_task_wakeup);
+    return high_task_wakeup == pdTRUE;
+}
 
-    // No mute needed - full volume range is available
-    write_AIC32X4_reg(AIC32X4_DACMUTE, 0x00);
+// adds up to frames of monitor signal to the codec slots of the I2S frames in dst, returns the number of frames added
+static size_t monitor_pop(int16_t *dst, size_t frames) {
+    dst += I2S_CODEC_SLOT;
+    xSemaphoreTake(monitor_lock, portMAX_DELAY);
+    uint32_t tail = monitor_tail;
+    const uint32_t head = monitor_head;
+    if (head - tail > MONITOR_MAX_BACKLOG) tail = head - MONITOR_MAX_BACKLOG; // keep latency bounded
+    size_t n = head - tail < frames ? head - tail : frames;
+    for (size_t done = 0; done < n;) {
+        const size_t idx = (tail + done) % MONITOR_RING_FRAMES;
+        const size_t chunk = n - done < MONITOR_RING_FRAMES - idx ? n - done : MONITOR_RING_FRAMES - idx;
+        pcm_add_sat_stereo(dst + done * I2S_SLOT_NUM, I2S_SLOT_NUM, &monitor_ring[idx * 2], chunk);
+        done += chunk;
+    }
+    monitor_tail = tail + n;
+    xSemaphoreGive(monitor_lock);
+    return n;
+}
+
+// keeps the monitor audible while there is no playback stream
+static void monitor_task(void *pvParameters) {
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        if (monitor_mode != MONITOR_FIRMWARE || esp_timer_get_time() - last_write_us < MONITOR_IDLE_US) {
+            continue;
+        }
+        memset(idle_buf, 0, sizeof(idle_buf));
+        const size_t frames = monitor_pop(idle_buf, I2S_DMA_FRAME_NUM);
+        probe_inject(idle_buf, frames, 0);
+        size_t nb;
+        i2s_channel_write(tx_handle, idle_buf, frames * I2S_SLOT_NUM * sizeof(int16_t), &nb, portMAX_DELAY);
+    }
+}
+
+// MAL/MAR volume: 0x00 = 0dB down to 0x28 = -30.1dB in roughly 0.75dB steps
+static uint8_t mal_volume_reg(int16_t gain) {
+    int32_t step = (-(int32_t)gain + 96) / 192; // 0.75dB = 192/256dB
+    if (step < 0) step = 0;
+    if (step > 0x28) step = 0x28;
+    return (uint8_t)step;
+}
+
+// analog monitor, MicPGA -> mixer amplifier -> line out, summed with the DAC, written by control_task
+static void apply_codec_monitor() {
+    const bool left = monitor_mode == MONITOR_CODEC && monitor_gain[0][0] != MONITOR_GAIN_SILENCE;
+    const bool right = monitor_mode == MONITOR_CODEC && monitor_gain[1][1] != MONITOR_GAIN_SILENCE;
+    write_AIC32X4_reg(AIC32X4_LMALVOL, mal_volume_reg(monitor_gain[0][0]));
+    write_AIC32X4_reg(AIC32X4_RMALVOL, mal_volume_reg(monitor_gain[1][1]));
+    write_AIC32X4_reg(AIC32X4_LOLROUTE, left ? 0x0A : 0x08);   // Left DAC (+ MAL) to LOL
+    write_AIC32X4_reg(AIC32X4_LORROUTE, right ? 0x0A : 0x08);  // Right DAC (+ MAR) to LOR
+    // power up LOL, LOR and the mixer amplifiers in use
+    write_AIC32X4_reg(AIC32X4_OUTPWRCTL, 0b00001100 | (left ? 0b10 : 0) | (right ? 0b01 : 0));
+    set_page(0);
+}
+
+void SetMonitorMode(monitor_mode_t mode) {
+    monitor_mode = mode;
+    request_control(CTRL_MONITOR);
+    ESP_LOGI(TAG, "Direct monitor %s", mode == MONITOR_CODEC ? "codec" : mode == MONITOR_FIRMWARE ? "firmware" : "off");
+}
+
+void SetMonitorGain(uint8_t in_ch, uint8_t out_ch, int16_t gain) {
+    if (in_ch > 1 || out_ch > 1) return;
+    monitor_gain[in_ch][out_ch] = gain;
+    monitor_q15[in_ch][out_ch] = pcm_db256_to_q15(gain);
+    if (monitor_mode == MONITOR_CODEC) {
+        // the analog path has no cross feed, only the diagonal is used
+        request_control(CTRL_MONITOR);
+    }
+}
+
+void SetMonitorLevel(uint8_t in_ch, int16_t gain, int8_t pan) {
+    // constant power pan law, pan -100 (left) .. 100 (right)
+    if (pan < -100) pan = -100;
+    if (pan > 100) pan = 100;
+    const float theta = (float)(pan + 100) / 200.0f * (float)M_PI_2;
+    const float pan_gain[2] = {cosf(theta), sinf(theta)};
+    for (uint8_t out_ch = 0; out_ch < 2; out_ch++) {
+        int16_t g = MONITOR_GAIN_SILENCE;
+        if (gain != MONITOR_GAIN_SILENCE && pan_gain[out_ch] > 0.001f) {
+            int32_t v = gain + (int32_t)(20.0f * log10f(pan_gain[out_ch]) * 256.0f);
+            g = (int16_t)(v < -32767 ? -32767 : v);
+        }
+        SetMonitorGain(in_ch, out_ch, g);
+    }
+}
+
+// ADC AGC and DAC DRC, register codes of the last configuration without the channel enables,
+// both ADC channels share one AGC configuration. InitCodec writes them after the codec reset
+#define AGC_REGS 7                      // AGC1 .. AGC7 of one channel
+#define DRC_REGS 3
+#define FRAMES_PER_US(us) ((uint64_t)(us) * I2S_SAMPLE_RATE / 1000000)
+#define US_PER_FRAMES(frames) ((uint32_t)((uint64_t)(frames) * 1000000 / I2S_SAMPLE_RATE))
+
+static const codec_agc_cfg_t agc_default = {
+    .target_level = -10 * 256, .hysteresis = 256, .noise_threshold = -70 * 256, .max_gain = 40 * 256,
+    .attack_us = 8000, .decay_us = 100000, .noise_debounce_us = 0, .signal_debounce_us = 0,
+};
+static const codec_drc_cfg_t drc_default = {
+    .threshold = -12 * 256, .hysteresis = 3 * 256, .hold_us = 0, .attack_us = 1000, .decay_us = 500000,
+};
+// AGC1 target level codes 0 .. 7, in 1/256 dBFS
+static const int16_t agc_target_levels[8] = {-1408, -2048, -2560, -3072, -3584, -4352, -5120, -6144};
+static uint8_t agc_regs[AGC_REGS];         // under ctrl_mux, like the enables
+static uint8_t drc_regs[DRC_REGS];
+static bool agc_regs_set, drc_regs_set;     // configured before bring-up, InitCodec keeps them
+static bool agc_enable[2], drc_enable[2];
+
+// time of each code in frames, the codes are written to the register unchanged
+static uint32_t agc_attack_frames(uint8_t code) { return (2u * (code >> 3) + 1) * 32 << (code & 7); }
+static uint32_t agc_decay_frames(uint8_t code) { return (2u * (code >> 3) + 1) * 512 << (code & 7); }
+static uint32_t agc_noise_debounce_frames(uint8_t code) { return code == 0 ? 0 : code <= 11 ? 2u << code : (code - 10u) * 4096; }
+static uint32_t agc_signal_debounce_frames(uint8_t code) { return code == 0 ? 0 : code <= 10 ? 2u << code : (code - 9u) * 2048; }
+static uint32_t drc_hold_frames(uint8_t code) { return code == 0 ? 0 : code <= 10 ? 16u << code : (code - 9u) * 16384; }
+// attack 4 * 2^-n dB and decay 1.5625e-2 * 2^-n dB per frame, as the time for a 6 dB gain change
+static uint32_t drc_attack_frames(uint8_t code) { return (3u << code) / 2; }
+static uint32_t drc_decay_frames(uint8_t code) { return 384u << code; }
+
+static uint8_t nearest_time_code(uint32_t (*frames)(uint8_t), uint16_t codes, uint32_t us) {
+    const uint64_t target = FRAMES_PER_US(us);
+    uint8_t best = 0;
+    uint64_t best_err = UINT64_MAX;
+    for (uint16_t code = 0; code < codes; code++) {
+        const uint64_t f = frames(code);
+        const uint64_t err = f > target ? f - target : target - f;
+        if (err < best_err) {
+            best_err = err;
+            best = code;
+        }
+    }
+    return best;
+}
+
+static uint8_t clamp_code(int32_t code, int32_t max) {
+    return (uint8_t)(code < 0 ? 0 : code > max ? max : code);
+}
+
+static void encode_agc(const codec_agc_cfg_t *cfg, uint8_t *regs) {
+    uint8_t target = 0;
+    for (uint8_t i = 1; i < 8; i++) {
+        if (abs(cfg->target_level - agc_target_levels[i]) < abs(cfg->target_level - agc_target_levels[target])) target = i;
+    }
+    // noise threshold code n is -30 - 2 (n - 1) dB, 0 switches the noise gate off
+    const int32_t n = (-30 * 256 - cfg->noise_threshold + 256) / 512 + 1;
+    const uint8_t noise = cfg->noise_threshold == 0 ? 0 : clamp_code(n < 1 ? 1 : n, 31);
+    regs[0] = target << 4 | clamp_code((cfg->hysteresis + 64) / 128, 3);
+    regs[1] = 0b00 << 6 | noise << 1;  // noise hysteresis 1dB
+    regs[2] = clamp_code((cfg->max_gain + 64) / 128, 116);
+    regs[3] = nearest_time_code(agc_attack_frames, 256, cfg->attack_us);
+    regs[4] = nearest_time_code(agc_decay_frames, 256, cfg->decay_us);
+    regs[5] = nearest_time_code(agc_noise_debounce_frames, 32, cfg->noise_debounce_us);
+    regs[6] = nearest_time_code(agc_signal_debounce_frames, 16, cfg->signal_debounce_us);
+}
+
+static void decode_agc(const uint8_t *regs, codec_agc_cfg_t *cfg) {
+    const uint8_t noise = (regs[1] >> 1) & 0x1F;
+    cfg->target_level = agc_target_levels[(regs[0] >> 4) & 0x07];
+    cfg->hysteresis = (regs[0] & 0x03) * 128;
+    cfg->noise_threshold = noise ? -30 * 256 - (noise - 1) * 512 : 0;
+    cfg->max_gain = regs[2] * 128;
+    cfg->attack_us = US_PER_FRAMES(agc_attack_frames(regs[3]));
+    cfg->decay_us = US_PER_FRAMES(agc_decay_frames(regs[4]));
+    cfg->noise_debounce_us = US_PER_FRAMES(agc_noise_debounce_frames(regs[5]));
+    cfg->signal_debounce_us = US_PER_FRAMES(agc_signal_debounce_frames(regs[6]));
+}
+
+static void encode_drc(const codec_drc_cfg_t *cfg, uint8_t *regs) {
+    // threshold code n is -3 (n + 1) dB
+    regs[0] = clamp_code((-3 * 256 - cfg->threshold + 384) / 768, 7) << 2 | clamp_code((cfg->hysteresis + 128) / 256, 3);
+    regs[1] = nearest_time_code(drc_hold_frames, 16, cfg->hold_us) << 3;
+    regs[2] = nearest_time_code(drc_attack_frames, 16, cfg->attack_us) << 4 | nearest_time_code(drc_decay_frames, 16, cfg->decay_us);
+}
+
+static void decode_drc(const uint8_t *regs, codec_drc_cfg_t *cfg) {
+    cfg->threshold = -3 * 256 * (((regs[0] >> 2) & 0x07) + 1);
+    cfg->hysteresis = (regs[0] & 0x03) * 256;
+    cfg->hold_us = US_PER_FRAMES(drc_hold_frames(regs[1] >> 3));
+    cfg->attack_us = US_PER_FRAMES(drc_attack_frames(regs[2] >> 4));
+    cfg->decay_us = US_PER_FRAMES(drc_decay_frames(regs[2] & 0x0F));
+}
+
+// one burst per channel, the applied gain register sits between the left and right block
+static void apply_agc() {
+    uint8_t regs[AGC_REGS];
+    portENTER_CRITICAL(&ctrl_mux);
+    const bool enable[2] = {agc_enable[0], agc_enable[1]};
+    memcpy(regs, agc_regs, sizeof(regs));
+    portEXIT_CRITICAL(&ctrl_mux);
+    const uint8_t agc1 = regs[0];
+    regs[0] = agc1 | (enable[0] ? 0x80 : 0);
+    write_AIC32X4_regs(AIC32X4_LAGC1, regs, sizeof(regs));
+    regs[0] = agc1 | (enable[1] ? 0x80 : 0);
+    write_AIC32X4_regs(AIC32X4_RAGC1, regs, sizeof(regs));
+}
+
+static void apply_drc() {
+    uint8_t regs[DRC_REGS];
+    portENTER_CRITICAL(&ctrl_mux);
+    const bool enable[2] = {drc_enable[0], drc_enable[1]};
+    memcpy(regs, drc_regs, sizeof(regs));
+    portEXIT_CRITICAL(&ctrl_mux);
+    regs[0] |= (enable[0] ? 0x40 : 0) | (enable[1] ? 0x20 : 0);
+    write_AIC32X4_regs(AIC32X4_DRCCTL1, regs, sizeof(regs));
+}
+
+void SetInputAgc(const codec_agc_cfg_t *cfg) {
+    uint8_t regs[AGC_REGS];
+    encode_agc(cfg, regs);
+    portENTER_CRITICAL(&ctrl_mux);
+    memcpy(agc_regs, regs, sizeof(regs));
+    portEXIT_CRITICAL(&ctrl_mux);
+    agc_regs_set = true;
+    if (clock_cfg) apply_agc();
+    ESP_LOGI(TAG, "ADC AGC: AGC1 0x%02x AGC2 0x%02x max gain %d/2 dB, attack 0x%02x decay 0x%02x debounce 0x%02x 0x%02x",
+             regs[0], regs[1], regs[2], regs[3], regs[4], regs[5], regs[6]);
+}
+
+// from the feature unit AGC control on the USB task, before bring-up InitCodec writes the state
+void SetInputAgcEnable(uint32_t agc_l, uint32_t agc_r) {
+    portENTER_CRITICAL(&ctrl_mux);
+    agc_enable[0] = agc_l != 0;
+    agc_enable[1] = agc_r != 0;
+    portEXIT_CRITICAL(&ctrl_mux);
+    request_control(CTRL_AGC);
+}
+
+void SetOutputDrc(const codec_drc_cfg_t *cfg) {
+    uint8_t regs[DRC_REGS];
+    encode_drc(cfg, regs);
+    portENTER_CRITICAL(&ctrl_mux);
+    memcpy(drc_regs, regs, sizeof(regs));
+    portEXIT_CRITICAL(&ctrl_mux);
+    drc_regs_set = true;
+    if (clock_cfg) apply_drc();
+    ESP_LOGI(TAG, "DAC DRC: 0x%02x 0x%02x 0x%02x", regs[0], regs[1], regs[2]);
+}
+
+void SetOutputDrcEnable(uint32_t drc_l, uint32_t drc_r) {
+    portENTER_CRITICAL(&ctrl_mux);
+    drc_enable[0] = drc_l != 0;
+    drc_enable[1] = drc_r != 0;
+    portEXIT_CRITICAL(&ctrl_mux);
+    request_control(CTRL_DRC);
+}
+
+void GetDynamicsStatus(codec_dynamics_status_t *status) {
+    // a consistent snapshot, the setters run on other tasks
+    uint8_t agc[AGC_REGS], drc[DRC_REGS];
+    portENTER_CRITICAL(&ctrl_mux);
+    for (int ch = 0; ch < 2; ch++) {
+        status->agc_enable[ch] = agc_enable[ch];
+        status->drc_enable[ch] = drc_enable[ch];
+    }
+    memcpy(agc, agc_regs, sizeof(agc));
+    memcpy(drc, drc_regs, sizeof(drc));
+    portEXIT_CRITICAL(&ctrl_mux);
+    status->agc_gain[0] = status->agc_gain[1] = 0;
+    decode_agc(agc, &status->agc);
+    decode_drc(drc, &status->drc);
+    if (clock_cfg) {
+        // signed, 0.5dB steps
+        status->agc_gain[0] = (int8_t)read_AIC32X4_reg(AIC32X4_LAGCGAIN) * 128;
+        status->agc_gain[1] = (int8_t)read_AIC32X4_reg(AIC32X4_RAGCGAIN) * 128;
+    }
+}
+
+// MicPGA 0 .. 47.5dB in 0.5dB steps, the fine ADC gain takes the remainder as 0 .. -0.4dB in 0.1dB steps
+#define MIC_PGA_MAX_STEP 95
+// DAC digital volume -63.5 .. +24dB, the register holds the number of 0.5dB steps in two's complement
+#define DAC_VOLUME_MIN_STEP (-127)
+#define DAC_VOLUME_MAX_STEP 48
+#define OUTPUT_VOLUME_DEFAULT (-23 * 256)
+
+static int16_t input_gain[2];           // 1/256 dB, under ctrl_mux
+static bool input_mute[2];
+static int16_t output_volume[2] = {OUTPUT_VOLUME_DEFAULT, OUTPUT_VOLUME_DEFAULT};
+static bool output_mute[2];
+
+static void apply_input_gain() {
+    portENTER_CRITICAL(&ctrl_mux);
+    const int16_t gain[2] = {input_gain[0], input_gain[1]};
+    const bool mute[2] = {input_mute[0], input_mute[1]};
+    portEXIT_CRITICAL(&ctrl_mux);
+
+    uint8_t pga[2], fine[2];
+    for (int ch = 0; ch < 2; ch++) {
+        const int32_t g = gain[ch] < 0 ? 0 : gain[ch] > MIC_PGA_MAX_STEP * 128 ? MIC_PGA_MAX_STEP * 128 : gain[ch];
+        const int32_t step = (g + 127) / 128;                 // rounded up, the fine gain only attenuates
+        const int32_t att = ((step * 128 - g) * 10 + 128) / 256;  // in 0.1dB
+        pga[ch] = step;                                       // D7 clear, the gain is not fixed at 0dB
+        fine[ch] = att > 4 ? 4 : att;
+    }
+    // the MicPGA registers are neighbours, the fine gain and the mutes of both channels share one register
+    write_AIC32X4_regs(AIC32X4_LMICPGAVOL, pga, sizeof(pga));
+    write_AIC32X4_reg(AIC32X4_ADCFGA, (mute[0] ? 0x80 : 0) | fine[0] << 4 | (mute[1] ? 0x08 : 0) | fine[1]);
+}
 
-    // write volume registers
-    write_AIC32X4_reg(AIC32X4_LDACVOL, left_reg);
-    write_AIC32X4_reg(AIC32X4_RDACVOL, right_reg);
+// nearest 0.5dB step, the arithmetic shift rounds negative gains down like positive ones
+static uint8_t dac_volume_reg(int16_t gain) {
+    int32_t step = ((int32_t)gain + 64) >> 7;
+    if (step < DAC_VOLUME_MIN_STEP) step = DAC_VOLUME_MIN_STEP;
+    if (step > DAC_VOLUME_MAX_STEP) step = DAC_VOLUME_MAX_STEP;
+    return (uint8_t)step;
+}
+
+// mute and both volumes in one burst, the DAC soft-steps to the new volume (DACSETUP D1-0 = 00, 0.5dB per frame)
+static void apply_output_volume() {
+    portENTER_CRITICAL(&ctrl_mux);
+    const int16_t volume[2] = {output_volume[0], output_volume[1]};
+    const bool mute[2] = {output_mute[0], output_mute[1]};
+    portEXIT_CRITICAL(&ctrl_mux);
+
+    const uint8_t regs[3] = {
+        (mute[0] ? 0b00001000 : 0) | (mute[1] ? 0b00000100 : 0),   // DACMUTE, independent volumes
+        dac_volume_reg(volume[0]),                                  // LDACVOL
+        dac_volume_reg(volume[1]),                                  // RDACVOL
+    };
+    write_AIC32X4_regs(AIC32X4_DACMUTE, regs, sizeof(regs));
+}
+
+static void control_task(void *pvParameters) {
+    while (1) {
+        uint32_t pending = 0;
+        xTaskNotifyWait(0, UINT32_MAX, &pending, portMAX_DELAY);
+        if (pending & CTRL_INPUT_GAIN) apply_input_gain();
+        if (pending & CTRL_OUTPUT_VOLUME) apply_output_volume();
+        if (pending & CTRL_MONITOR) apply_codec_monitor();
+        if (pending & CTRL_AGC) apply_agc();
+        if (pending & CTRL_DRC) apply_drc();
+    }
+}
+
+void SetOutputVolume(int16_t volume_l, int16_t volume_r) {
+    portENTER_CRITICAL(&ctrl_mux);
+    output_volume[0] = volume_l;
+    output_volume[1] = volume_r;
+    portEXIT_CRITICAL(&ctrl_mux);
+    request_control(CTRL_OUTPUT_VOLUME);
+}
+
+void SetMute(uint32_t mute_l, uint32_t mute_r) {
+    portENTER_CRITICAL(&ctrl_mux);
+    output_mute[0] = mute_l != 0;
+    output_mute[1] = mute_r != 0;
+    portEXIT_CRITICAL(&ctrl_mux);
+    request_control(CTRL_OUTPUT_VOLUME);
+}
+
+void SetInputGain(int16_t gain_l, int16_t gain_r) {
+    portENTER_CRITICAL(&ctrl_mux);
+    input_gain[0] = gain_l;
+    input_gain[1] = gain_r;
+    portEXIT_CRITICAL(&ctrl_mux);
+    request_control(CTRL_INPUT_GAIN);
+}
+
+void SetInputMute(uint32_t mute_l, uint32_t mute_r) {
+    portENTER_CRITICAL(&ctrl_mux);
+    input_mute[0] = mute_l != 0;
+    input_mute[1] = mute_r != 0;
+    portEXIT_CRITICAL(&ctrl_mux);
+    request_control(CTRL_INPUT_GAIN);
+}
+
+/* APLL lock to the USB SOF. The I2S frame count is compared with the host frame clock at the SOF timestamps
+ * of uac_device_get_sof_time, and a PI loop steers the fractional divider of the APLL until both advance
+ * together. esp_timer only bridges the few milliseconds between a SOF timestamp and the last RX DMA
+ * interrupt, so the crystal offset does not enter the measurement. */
+#if CONFIG_UAC_SOF_CLOCK_LOCK
+#define LOCK_UPDATE_MS 100
+#define LOCK_KP 40.0f                   // ppm per frame of phase error, settles the phase in about a second
+#define LOCK_KI 2.0f                    // ppm per frame and update, critically damped with LOCK_KP
+#define LOCK_RANGE_PPM ((float)CONFIG_UAC_SOF_CLOCK_LOCK_RANGE_PPM)
+#define LOCK_IN_FRAMES 0.5f             // phase error that counts as locked ...
+#define LOCK_IN_UPDATES 20              // ... for 2 s in a row
+#define LOCK_LOST_FRAMES 4.0f
+#define LOCK_SOF_STALE_US 500000        // SOF timestamps older than this mean the bus is gone
+#define FRAMES_TO_NS(f) ((f) * (1e9f / I2S_SAMPLE_RATE))
+
+static clock_lock_stats_t lock_stats;   // under lock_mux
+static double lock_err_sq_sum;
+static uint32_t lock_err_count;
+
+// the APLL multiplies the crystal by 4 + sdm2 + sdm1 / 2^8 + sdm0 / 2^16, sdm below is that fraction as one 6.16 number
+static uint32_t apll_o_div, apll_sdm_base, apll_sdm_set; // setting of the I2S driver, last value written
+
+static uint32_t apll_read_sdm(uint32_t *o_div) {
+    uint32_t sdm0, sdm1, sdm2;
+    clk_ll_apll_get_config(o_div, &sdm0, &sdm1, &sdm2);
+    return sdm2 << 16 | sdm1 << 8 | sdm0;
+}
+
+static void apll_set_ppm(float ppm) {
+    // one step is about 1.5 ppm, the loop dithers between neighbours
+    const uint32_t sdm = apll_sdm_base + (int32_t)lrintf(ppm * 1e-6f * (float)((4u << 16) + apll_sdm_base));
+    if (sdm == apll_sdm_set) return;
+    // no recalibration, the steps stay far inside the capture range of the APLL
+    clk_ll_apll_set_config(apll_o_div, sdm & 0xFF, (sdm >> 8) & 0xFF, sdm >> 16);
+    apll_sdm_set = sdm;
+}
+
+static void lock_state(clock_lock_state_t state, float ppm, float err) {
+    portENTER_CRITICAL(&lock_mux);
+    if (state == CLOCK_LOCK_ACQUIRING && lock_stats.state == CLOCK_LOCK_LOCKED) lock_stats.relocks++;
+    if (state != CLOCK_LOCK_LOCKED) lock_stats.lock_time_ms = 0;
+    lock_stats.state = state;
+    lock_stats.offset_ppb = (int32_t)lrintf(ppm * 1000.0f);
+    lock_stats.phase_err_ns = (int32_t)lrintf(FRAMES_TO_NS(err));
+    if (state == CLOCK_LOCK_LOCKED) {
+        const float ns = fabsf(FRAMES_TO_NS(err));
+        lock_err_sq_sum += (double)ns * ns;
+        lock_err_count++;
+        lock_stats.jitter_rms_ns = (uint32_t)sqrt(lock_err_sq_sum / lock_err_count);
+        if (ns > lock_stats.jitter_max_ns) lock_stats.jitter_max_ns = (uint32_t)ns;
+    }
+    portEXIT_CRITICAL(&lock_mux);
+}
+
+static void clock_lock_task(void *pvParameters) {
+    const double sof_frames_per_us = I2S_SAMPLE_RATE / 1e6;
+    clock_lock_state_t state = CLOCK_LOCK_NO_SOF;
+    uint32_t epoch = 0, last_sof = 0, last_dma = 0, settled = 0;
+    double host_pos = 0, i2s_pos = 0;   // frames since the reference
+    float integ = 0, ppm = 0;
+    int64_t start_us = 0, settled_us = 0;
+    apll_sdm_base = apll_sdm_set = apll_read_sdm(&apll_o_div);
+    while (1) {
+        vTaskDelay(pdMS_TO_TICKS(LOCK_UPDATE_MS));
+        uac_sof_time_t sof;
+        if (uac_device_get_sof_time(&sof) != ESP_OK || esp_timer_get_time() - sof.time_us > LOCK_SOF_STALE_US) {
+            // holdover, the APLL keeps the last correction until the host is back
+            state = CLOCK_LOCK_NO_SOF;
+            lock_state(state, ppm, 0);
+            continue;
+        }
+        uint32_t o_div;
+        const uint32_t sdm = apll_read_sdm(&o_div);
+        if (sdm != apll_sdm_set || o_div != apll_o_div) {
+            // the APLL was reprogrammed behind the loop, e.g. for another I2S rate, start over from there
+            apll_o_div = o_div;
+            apll_sdm_base = apll_sdm_set = sdm;
+            integ = ppm = 0;
+            state = CLOCK_LOCK_NO_SOF;
+        }
+        if (state != CLOCK_LOCK_NO_SOF && sof.epoch == epoch && sof.frames == last_sof) continue; // no new window
+
+        portENTER_CRITICAL(&lock_mux);
+        const uint32_t dma_frames = rx_dma_frames;
+        const int64_t dma_us = rx_dma_us;
+        portEXIT_CRITICAL(&lock_mux);
+        // I2S frames at the SOF instant, extrapolated from the last DMA interrupt at the nominal rate
+        const double dma_to_sof = (double)(sof.time_us - dma_us) * sof_frames_per_us;
+        if (state == CLOCK_LOCK_NO_SOF || sof.epoch != epoch) {
+            // new reference, the frequency found so far is kept as the starting point
+            epoch = sof.epoch;
+            last_sof = sof.frames;
+            last_dma = dma_frames;
+            host_pos = 0;
+            i2s_pos = -dma_to_sof;
+            settled = 0;
+            start_us = esp_timer_get_time();
+            state = CLOCK_LOCK_ACQUIRING;
+            lock_state(state, ppm, 0);
+            continue;
+        }
+        host_pos += (double)(sof.frames - last_sof) * sof.period_us * sof_frames_per_us;
+        i2s_pos += (uint32_t)(dma_frames - last_dma);
+        last_sof = sof.frames;
+        last_dma = dma_frames;
+        const float err = (float)(i2s_pos + dma_to_sof - host_pos); // > 0: the I2S runs ahead of the host
+
+        integ -= LOCK_KI * err;
+        integ = integ > LOCK_RANGE_PPM ? LOCK_RANGE_PPM : (integ < -LOCK_RANGE_PPM ? -LOCK_RANGE_PPM : integ);
+        ppm = integ - LOCK_KP * err;
+        ppm = ppm > LOCK_RANGE_PPM ? LOCK_RANGE_PPM : (ppm < -LOCK_RANGE_PPM ? -LOCK_RANGE_PPM : ppm);
+        apll_set_ppm(ppm);
+
+        if (state == CLOCK_LOCK_LOCKED) {
+            if (fabsf(err) > LOCK_LOST_FRAMES) {
+                settled = 0;
+                start_us = esp_timer_get_time();
+                state = CLOCK_LOCK_ACQUIRING;
+            }
+        } else if (fabsf(err) < LOCK_IN_FRAMES) {
+            if (settled++ == 0) settled_us = esp_timer_get_time();
+            if (settled >= LOCK_IN_UPDATES) {
+                state = CLOCK_LOCK_LOCKED;
+                const uint32_t lock_ms = (uint32_t)((settled_us - start_us) / 1000);
+                portENTER_CRITICAL(&lock_mux);
+                lock_stats.lock_time_ms = lock_ms;
+                portEXIT_CRITICAL(&lock_mux);
+                ESP_LOGI(TAG, "APLL locked to SOF in %lu ms, %+.1f ppm", (unsigned long)lock_ms, ppm);
+            }
+        } else {
+            settled = 0;
+        }
+        lock_state(state, ppm, err);
+    }
+}
+#endif
+
+void GetClockLockStats(clock_lock_stats_t *stats, bool reset) {
+#if CONFIG_UAC_SOF_CLOCK_LOCK
+    portENTER_CRITICAL(&lock_mux);
+    *stats = lock_stats;
+    if (reset) {
+        lock_stats.jitter_rms_ns = 0;
+        lock_stats.jitter_max_ns = 0;
+        lock_stats.relocks = 0;
+        lock_err_sq_sum = 0;
+        lock_err_count = 0;
+    }
+    portEXIT_CRITICAL(&lock_mux);
+#else
+    (void)reset;
+    *stats = (clock_lock_stats_t) { .state = CLOCK_LOCK_OFF };
+#endif
 }
 
 static void cfg_i2s() {
     ESP_LOGI(TAG, "cfg codec i2s");
     i2s_chan_config_t chan_cfg = I2S_CHANNEL_DEFAULT_CONFIG(I2S_PORT_NUM, I2S_ROLE_MASTER);
     chan_cfg.auto_clear = false;
-    chan_cfg.dma_desc_num = 4;
-    chan_cfg.dma_frame_num = 512;
+    chan_cfg.dma_desc_num = I2S_DMA_DESC_NUM;
+    chan_cfg.dma_frame_num = I2S_DMA_FRAME_NUM;
 
     ESP_ERROR_CHECK(i2s_new_channel(&chan_cfg, &tx_handle, &rx_handle));
 
+#if I2S_TDM
+    i2s_tdm_config_t tdm_cfg = {
+            .clk_cfg = {
+                    .sample_rate_hz = I2S_SAMPLE_RATE,
+                    .clk_src = SOC_MOD_CLK_APLL,
+                    .ext_clk_freq_hz = 0,
+                    .mclk_multiple = I2S_MCLK_MULTIPLE_256,
+                    .bclk_div = 0,
+            },
+            .slot_cfg = I2S_TDM_PCM_SHORT_SLOT_DEFAULT_CONFIG(I2S_DATA_BIT_WIDTH_16BIT, I2S_SLOT_MODE_STEREO,
+                                                              I2S_TDM_SLOT0 | I2S_TDM_SLOT1 | I2S_TDM_SLOT2 | I2S_TDM_SLOT3 |
+                                                              I2S_TDM_SLOT4 | I2S_TDM_SLOT5 | I2S_TDM_SLOT6 | I2S_TDM_SLOT7),
+            .gpio_cfg = {
+                    .mclk = I2S_MCLK,
+                    .bclk = I2S_BCLK,
+                    .ws   = I2S_WS,
+                    .dout = I2S_DOUT,
+                    .din  = I2S_DIN,
+                    .invert_flags = {
+                            .mclk_inv = true,
+                            .bclk_inv = false,
+                            .ws_inv = false,
+                    },
+            },
+    };
+    tdm_cfg.slot_cfg.total_slot = I2S_SLOT_NUM;
+
+    /* Initialize the channels */
+    ESP_ERROR_CHECK(i2s_channel_init_tdm_mode(tx_handle, &tdm_cfg));
+    ESP_ERROR_CHECK(i2s_channel_init_tdm_mode(rx_handle, &tdm_cfg));
+    ESP_LOGI(TAG, "I2S TDM, %d slots, %d out / %d in channels", I2S_SLOT_NUM, I2S_SPK_CHANNELS, I2S_MIC_CHANNELS);
+#else
     i2s_std_config_t std_cfg = {
             .clk_cfg = {
                     //.sample_rate_hz = 44100,
-                    .sample_rate_hz = 48000,
+                    .sample_rate_hz = I2S_SAMPLE_RATE,
                     //.clk_src = I2S_CLK_SRC_DEFAULT, // direct XTAL
                     .clk_src = SOC_MOD_CLK_APLL,
                     .ext_clk_freq_hz = 0,
@@ -547,6 +1365,17 @@ static void cfg_i2s() {
     /* Initialize the channels */
     ESP_ERROR_CHECK(i2s_channel_init_std_mode(tx_handle, &std_cfg));
     ESP_ERROR_CHECK(i2s_channel_init_std_mode(rx_handle, &std_cfg));
+#endif
+
+    i2s_event_callbacks_t rx_cbs = {
+        .on_recv = i2s_rx_done_cb,
+        .on_recv_q_ovf = i2s_rx_queue_ovf_cb,
+    };
+    ESP_ERROR_CHECK(i2s_channel_register_event_callback(rx_handle, &rx_cbs, NULL));
+    i2s_event_callbacks_t tx_cbs = {
+        .on_sent = i2s_tx_sent_cb,
+    };
+    ESP_ERROR_CHECK(i2s_channel_register_event_callback(tx_handle, &tx_cbs, NULL));
 
     ESP_ERROR_CHECK(i2s_channel_enable(tx_handle));
     ESP_ERROR_CHECK(i2s_channel_enable(rx_handle));
@@ -555,34 +1384,280 @@ static void cfg_i2s() {
 
 void i2s_read(void* buf, uint32_t size, uint32_t* bytes_read){
     size_t nb;
+    UAC_TRACE_BEGIN(UAC_TRACE_I2S_READ, size);
+#if I2S_TDM
+    // buf holds I2S_MIC_CHANNELS per frame in USB order
+    const uint32_t frame_bytes = I2S_MIC_CHANNELS * sizeof(int16_t);
+    *bytes_read = 0;
+    for (uint32_t frames = 0; frames < size / frame_bytes;) {
+        uint32_t chunk = size / frame_bytes - frames;
+        if (chunk > I2S_DMA_FRAME_NUM) chunk = I2S_DMA_FRAME_NUM;
+        ESP_ERROR_CHECK(i2s_channel_read(rx_handle, tdm_rx_buf, chunk * I2S_SLOT_NUM * sizeof(int16_t), &nb, portMAX_DELAY));
+        chunk = nb / (I2S_SLOT_NUM * sizeof(int16_t));
+        pcm_slots_to_channels((int16_t *)buf + frames * I2S_MIC_CHANNELS, I2S_MIC_CHANNELS, tdm_rx_buf, I2S_SLOT_NUM, chunk, mic_slot_map);
+        frames += chunk;
+        *bytes_read += chunk * frame_bytes;
+    }
+    rx_read_frames += *bytes_read / frame_bytes;
+#else
     ESP_ERROR_CHECK(i2s_channel_read(rx_handle, buf, size, &nb, portMAX_DELAY));
     *bytes_read = nb;
+    rx_read_frames += nb / (I2S_SLOT_NUM * sizeof(int16_t));
+#endif
+    // the latency probe peak is in this block once the reader is past it, in RX DMA frames
+    if (probe_state != PROBE_IDLE && probe_peak != 0 && probe_usb_in_frame != probe_peak_frame &&
+        (int32_t)(rx_read_frames + rx_dropped_frames - probe_peak_frame) > 0) {
+        probe_usb_in_us = esp_timer_get_time();
+        probe_usb_in_frame = probe_peak_frame;
+    }
+    UAC_TRACE_END(UAC_TRACE_I2S_READ, *bytes_read);
 }
 
 void i2s_write(void* buf, uint32_t size, uint32_t* bytes_read){
     size_t nb;
-    ESP_ERROR_CHECK(i2s_channel_write(tx_handle, buf, size, &nb, portMAX_DELAY));
-    *bytes_read = nb;
+    last_write_us = esp_timer_get_time();
+    const int64_t usb_us = next_usb_out_us ? next_usb_out_us : last_write_us;
+    next_usb_out_us = 0;
+    UAC_TRACE_BEGIN(UAC_TRACE_I2S_WRITE, size);
+#if I2S_TDM
+    // spread the USB frames over the TDM slots, the monitor is added to the codec slots
+    const uint32_t frame_bytes = I2S_SPK_CHANNELS * sizeof(int16_t);
+    *bytes_read = 0;
+    uint32_t chunk;
+    for (uint32_t frames = 0; frames < size / frame_bytes; frames += chunk) {
+        chunk = size / frame_bytes - frames;
+        if (chunk > I2S_DMA_FRAME_NUM) chunk = I2S_DMA_FRAME_NUM;
+        pcm_channels_to_slots(mix_buf, I2S_SLOT_NUM, (const int16_t *)buf + frames * I2S_SPK_CHANNELS, I2S_SPK_CHANNELS, chunk, spk_slot_map);
+        if (monitor_mode == MONITOR_FIRMWARE) {
+            monitor_pop(mix_buf, chunk);
+        }
+        probe_inject(mix_buf, chunk, usb_us);
+        ESP_ERROR_CHECK(i2s_channel_write(tx_handle, mix_buf, chunk * I2S_SLOT_NUM * sizeof(int16_t), &nb, portMAX_DELAY));
+        *bytes_read += nb / I2S_SLOT_NUM * I2S_SPK_CHANNELS;
+    }
+#else
+    if (monitor_mode != MONITOR_FIRMWARE && probe_state != PROBE_INJECT) {
+        ESP_ERROR_CHECK(i2s_channel_write(tx_handle, buf, size, &nb, portMAX_DELAY));
+        *bytes_read = nb;
+        UAC_TRACE_END(UAC_TRACE_I2S_WRITE, nb);
+        return;
+    }
+    // the playback buffer may be shared, mix into a local copy
+    *bytes_read = 0;
+    uint32_t chunk;
+    for (uint32_t offset = 0; offset < size; offset += chunk) {
+        chunk = size - offset < sizeof(mix_buf) ? size - offset : sizeof(mix_buf);
+        memcpy(mix_buf, (uint8_t *)buf + offset, chunk);
+        if (monitor_mode == MONITOR_FIRMWARE) {
+            monitor_pop(mix_buf, chunk / (2 * sizeof(int16_t)));
+        }
+        probe_inject(mix_buf, chunk / (2 * sizeof(int16_t)), usb_us);
+        ESP_ERROR_CHECK(i2s_channel_write(tx_handle, mix_buf, chunk, &nb, portMAX_DELAY));
+        *bytes_read += nb;
+    }
+#endif
+    UAC_TRACE_END(UAC_TRACE_I2S_WRITE, *bytes_read);
+}
+
+void SetSlotMap(uint8_t input, const uint8_t *slot_map, uint8_t channels){
+#if I2S_TDM
+    uint8_t *map = input ? mic_slot_map : spk_slot_map;
+    const uint8_t n = input ? I2S_MIC_CHANNELS : I2S_SPK_CHANNELS;
+    if (channels != n) {
+        ESP_LOGE(TAG, "Slot map needs %d channels, got %d", n, channels);
+        return;
+    }
+    for (uint8_t c = 0; c < n; c++) {
+        if (slot_map[c] >= I2S_SLOT_NUM) {
+            ESP_LOGE(TAG, "Slot %d of channel %d out of range", slot_map[c], c);
+            return;
+        }
+    }
+    // takes effect with the next DMA buffer
+    memcpy(map, slot_map, n);
+    ESP_LOGI(TAG, "%s slot map updated", input ? "Input" : "Output");
+#else
+    ESP_LOGE(TAG, "Slot map requires TDM mode (more than 2 channels)");
+#endif
 }
 
 void InitCodec() {
+#if I2S_TDM
+    for (uint8_t c = 0; c < I2S_SPK_CHANNELS; c++) spk_slot_map[c] = c;
+    for (uint8_t c = 0; c < I2S_MIC_CHANNELS; c++) mic_slot_map[c] = c;
+#endif
+    monitor_lock = xSemaphoreCreateMutex();
+    i2c_lock = xSemaphoreCreateMutex();
+    uac_mem_create_task(monitor_task, "monitor_task", 4096, NULL, UAC_AUDIO_AUX_TASK_PRIORITY, &monitor_task_handle, UAC_RT_AUDIO_CORE);
+    uac_mem_note("codec mix buf", mix_buf, sizeof(mix_buf));
+    uac_mem_note("codec monitor", monitor_ring, sizeof(monitor_ring));
+    uac_mem_note("codec probe buf", probe_buf, sizeof(probe_buf));
+#if I2S_TDM
+    uac_mem_note("codec tdm rx buf", tdm_rx_buf, sizeof(tdm_rx_buf));
+#endif
     cfg_i2c();
     identify();
-    SetOutputLevels(0, 0);
     cfg_i2s();
-    cfg_codec(false);
-    SetOutputLevels(58, 58);
+#if CONFIG_UAC_SOF_CLOCK_LOCK
+    xTaskCreatePinnedToCore(clock_lock_task, "clock_lock", 3072, NULL, UAC_CONTROL_TASK_PRIORITY, NULL, UAC_CONTROL_TASK_CORE);
+#endif
+    clock_cfg = find_clock_cfg(I2S_MCLK_HZ, I2S_SAMPLE_RATE);
+    if (clock_cfg == NULL) {
+        ESP_LOGE(TAG, "No AIC3254 clock tree for MCLK %d Hz at %d Hz, run tools/aic3254_clock_solver.py generate",
+                 I2S_MCLK_HZ, I2S_SAMPLE_RATE);
+        return;
+    }
+    // settings applied before bring-up are only stored by the setters, they are written with the first configuration
+    dac_prb = select_dac_prb(dac_latency_mode);
+    adc_prb = select_adc_prb(adc_latency_mode);
+    if (!agc_regs_set) encode_agc(&agc_default, agc_regs);
+    if (!drc_regs_set) encode_drc(&drc_default, drc_regs);
+    cfg_codec();
+    apply_agc();
+    apply_drc();
+    apply_input_gain();
+    apply_output_volume();
+    // like clock_lock a cold control task, its stack stays out of the hot arena the USB tasks need
+    xTaskCreatePinnedToCore(control_task, "codec_ctrl", 3072, NULL, UAC_CONTROL_TASK_PRIORITY, &control_task_handle, UAC_CONTROL_TASK_CORE);
+}
+
+void GetCodecLatency(uint32_t *output_frames, uint32_t *input_frames){
+    // i2s_write blocks on a full DMA queue, so playback sees all descriptors ahead of it,
+    // while capture data is handed out once a single DMA buffer has been filled
+    *output_frames = dac_prb->group_delay + I2S_DMA_DESC_NUM * I2S_DMA_FRAME_NUM;
+    *input_frames = adc_prb->group_delay + I2S_DMA_FRAME_NUM;
+}
+
+// the processing block and the DAC dividers can only be changed while the DAC is powered down
+static void write_dac_prb(uint8_t prb, char filter) {
+    write_AIC32X4_reg(AIC32X4_DACMUTE, 0b00001100);
+    write_AIC32X4_reg(AIC32X4_DACSETUP, 0b00010100);
+    write_dac_dividers(filter);
+    write_AIC32X4_reg(AIC32X4_DACPRB, prb);
+    write_AIC32X4_reg(AIC32X4_DACSETUP, 0b11010100);
+    // the host mute may have changed in the meantime
+    apply_output_volume();
+}
+
+void SetLatencyMode(codec_latency_mode_t dac_mode, codec_latency_mode_t adc_mode){
+    dac_latency_mode = dac_mode;
+    adc_latency_mode = adc_mode;
+    if (clock_cfg == NULL) return;
+    const dac_prb_t *new_dac_prb = select_dac_prb(dac_mode);
+    const adc_prb_t *new_adc_prb = select_adc_prb(adc_mode);
+
+    if (new_dac_prb != dac_prb) {
+        dac_prb = new_dac_prb;
+        write_dac_prb(dac_prb->prb, dac_prb->filter);
+    }
+    if (new_adc_prb != adc_prb) {
+        adc_prb = new_adc_prb;
+        apply_adc_prb();
+    }
+    ESP_LOGI(TAG, "Latency mode: DAC PRB_P%d (filter %c, %d/fs), ADC PRB_R%d (filter %c, %d/fs)",
+             dac_prb->prb, dac_prb->filter, dac_prb->group_delay, adc_prb->prb, adc_prb->filter, adc_prb->group_delay);
+}
+
+static bool playback_idle() {
+    return monitor_mode != MONITOR_FIRMWARE && esp_timer_get_time() - last_write_us >= MONITOR_IDLE_US;
+}
+
+// without a playback stream the probe keeps the output running itself, the marker goes into the first buffer
+static void probe_write_idle(size_t buffers) {
+    for (size_t i = 0; i < buffers && playback_idle(); i++) {
+        memset(probe_buf, 0, sizeof(probe_buf));
+        probe_inject(probe_buf, I2S_DMA_FRAME_NUM, 0);
+        size_t nb;
+        i2s_channel_write(tx_handle, probe_buf, sizeof(probe_buf), &nb, portMAX_DELAY);
+    }
+}
+
+static int32_t us_to_frames(int64_t us) {
+    return (int32_t)((us * I2S_SAMPLE_RATE + 500000) / 1000000);
 }
 
-void SetMute(uint32_t mute_l, uint32_t mute_r){
-    // incoming range 0 to 63 for lvol and rvol, default 0dB is 58
-    uint8_t dac_mute = 0x00;
-    if(mute_l) {
-        dac_mute |= 0b00001000; // mute left channel
+void LatencyProbeOutputBlock(int64_t usb_us){
+    next_usb_out_us = usb_us;
+}
+
+bool RunLatencyProbe(latency_probe_marker_t marker, latency_probe_loop_t loop, latency_probe_result_t *result){
+    if (marker == LATENCY_PROBE_BEEP && loop != LATENCY_LOOP_ANALOG) {
+        ESP_LOGE(TAG, "The beep is generated behind the digital loopback, use the analog loop");
+        return false;
+    }
+    if (probe_state != PROBE_IDLE) return false;
+
+    const uint8_t iface3 = read_AIC32X4_reg(AIC32X4_IFACE3);
+    if (loop == LATENCY_LOOP_DIGITAL) {
+        write_AIC32X4_reg(AIC32X4_IFACE3, iface3 | 0b00100000); // DIN to DOUT loopback
     }
-    if(mute_r) {
-        dac_mute |= 0b00000100; // mute right channel
+    // start from silence so stale DMA buffers cannot be taken for the marker
+    probe_write_idle(I2S_DMA_DESC_NUM);
+
+    probe_marker = marker;
+    probe_peak = 0;
+    probe_hold = 0;
+    probe_tx_us = probe_rx_us = probe_usb_in_us = probe_usb_out_us = 0;
+    probe_usb_in_frame = rx_dma_frames - 1;
+    if (marker == LATENCY_PROBE_BEEP) {
+        write_dac_prb(AIC3254_BEEP_PRB, AIC3254_BEEP_FILTER);
+        write_AIC32X4_reg(AIC3254_BEEPCTL_R, PROBE_BEEP_VOLUME);
+        write_AIC32X4_reg(AIC3254_BEEPLEN_MSB, (PROBE_BEEP_FRAMES >> 16) & 0xFF);
+        write_AIC32X4_reg(AIC3254_BEEPLEN_MID, (PROBE_BEEP_FRAMES >> 8) & 0xFF);
+        write_AIC32X4_reg(AIC3254_BEEPLEN_LSB, PROBE_BEEP_FRAMES & 0xFF);
+        write_AIC32X4_reg(AIC3254_BEEPSIN_MSB, PROBE_BEEP_COEFF >> 8);
+        write_AIC32X4_reg(AIC3254_BEEPSIN_LSB, PROBE_BEEP_COEFF & 0xFF);
+        write_AIC32X4_reg(AIC3254_BEEPCOS_MSB, PROBE_BEEP_COEFF >> 8);
+        write_AIC32X4_reg(AIC3254_BEEPCOS_LSB, PROBE_BEEP_COEFF & 0xFF);
+        write_AIC32X4_reg(AIC3254_BEEPCTL_L, 0x80 | PROBE_BEEP_VOLUME);
+        // the beep starts with the next frame after the write, only good to the I2C transfer time
+        probe_tx_us = esp_timer_get_time();
+        probe_state = PROBE_WAIT_RX;
+    } else {
+        probe_state = PROBE_INJECT;
+    }
+
+    const int64_t deadline = esp_timer_get_time() + PROBE_TIMEOUT_MS * 1000;
+    while (probe_state != PROBE_DONE && esp_timer_get_time() < deadline) {
+        if (playback_idle()) {
+            probe_write_idle(1);
+        } else {
+            vTaskDelay(1);
+        }
+    }
+    const bool found = probe_state == PROBE_DONE;
+    // with a capture stream running, wait for the block holding the peak to be handed to USB
+    const int64_t usb_in_deadline = esp_timer_get_time() + PROBE_USB_IN_WAIT_MS * 1000;
+    while (found && probe_usb_in_frame != probe_peak_frame && esp_timer_get_time() < usb_in_deadline) {
+        probe_write_idle(1);
+        vTaskDelay(1);
+    }
+    probe_state = PROBE_IDLE;
+    // flush the marker out of the DMA ring, stale buffers are repeated while nothing is written
+    probe_write_idle(I2S_DMA_DESC_NUM);
+
+    if (marker == LATENCY_PROBE_BEEP) {
+        write_AIC32X4_reg(AIC3254_BEEPCTL_L, 0);
+        write_dac_prb(dac_prb->prb, dac_prb->filter);
+    }
+    if (loop == LATENCY_LOOP_DIGITAL) {
+        write_AIC32X4_reg(AIC32X4_IFACE3, iface3);
+    }
+
+    if (!found) {
+        ESP_LOGW(TAG, "Latency probe: marker %s", probe_tx_us ? "not detected on the input" : "never left the output");
+        return false;
     }
-    write_AIC32X4_reg(AIC32X4_DACMUTE, dac_mute);
+    result->loop_us = (int32_t)(probe_rx_us - probe_tx_us);
+    result->loop_frames = us_to_frames(probe_rx_us - probe_tx_us);
+    result->out_frames = probe_usb_out_us ? us_to_frames(probe_tx_us - probe_usb_out_us) : -1;
+    result->in_frames = probe_usb_in_frame == probe_peak_frame ? us_to_frames(probe_usb_in_us - probe_rx_us) : -1;
+    result->peak = (int16_t)(probe_peak > INT16_MAX ? INT16_MAX : probe_peak);
+    // the beep block uses interpolation filter A like PRB_P1
+    result->dac_group_delay = marker == LATENCY_PROBE_BEEP ? dac_prbs[0].group_delay : dac_prb->group_delay;
+    result->adc_group_delay = adc_prb->group_delay;
+    ESP_LOGI(TAG, "Latency probe: out %ld, loop %ld (%ld us), in %ld frames, peak %d",
+             (long)result->out_frames, (long)result->loop_frames, (long)result->loop_us, (long)result->in_frames, result->peak);
+    return true;
 }
 
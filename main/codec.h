@@ -21,11 +21,114 @@ respective component folders / files if different from this license.
 
 #pragma once
 
+#include <stdbool.h>
 #include <stdint.h>
 
+typedef enum {
+    CODEC_LATENCY_STANDARD = 0, // filter A processing blocks, best stopband attenuation
+    CODEC_LATENCY_LOW = 1,      // lowest group delay processing block valid for the sample rate and OSR
+} codec_latency_mode_t;
+
+typedef enum {
+    MONITOR_OFF = 0,
+    MONITOR_CODEC = 1,    // analog MicPGA -> mixer amplifier -> line out inside the AIC3254
+    MONITOR_FIRMWARE = 2, // input mixed into the output in the I2S DMA path
+} monitor_mode_t;
+
+#define MONITOR_GAIN_SILENCE INT16_MIN
+
+typedef enum {
+    LATENCY_PROBE_IMPULSE = 0, // firmware doublet in the I2S output, timestamped at both ends to the frame
+    LATENCY_PROBE_BEEP = 1,    // AIC3254 beep generator (PRB_P25 while it runs), start time taken at the I2C write
+} latency_probe_marker_t;
+
+typedef enum {
+    LATENCY_LOOP_ANALOG = 0,  // line out cabled to line in, DAC and ADC in the loop
+    LATENCY_LOOP_DIGITAL = 1, // codec DIN looped back to DOUT, serial interface only
+} latency_probe_loop_t;
+
+// intervals in frames at the I2S rate, -1 if the USB stream was not running during the measurement
+typedef struct {
+    int32_t out_frames;       // playback block handed to i2s_write -> marker on the I2S output
+    int32_t loop_frames;      // marker on the I2S output -> marker on the I2S input
+    int32_t in_frames;        // marker on the I2S input -> capture block handed back from i2s_read
+    int32_t loop_us;
+    int16_t peak;             // detected marker level
+    uint16_t dac_group_delay; // of the active processing blocks, frames
+    uint16_t adc_group_delay;
+} latency_probe_result_t;
+
+typedef enum {
+    CLOCK_LOCK_OFF = 0,       // CONFIG_UAC_SOF_CLOCK_LOCK disabled, the APLL runs at its nominal setting
+    CLOCK_LOCK_NO_SOF = 1,    // no host frame clock, the last correction is held
+    CLOCK_LOCK_ACQUIRING = 2,
+    CLOCK_LOCK_LOCKED = 3,
+} clock_lock_state_t;
+
+// APLL lock to the USB SOF, jitter and relocks since the last reset
+typedef struct {
+    clock_lock_state_t state;
+    uint32_t lock_time_ms;    // start of acquisition -> phase error settled, 0 until locked
+    int32_t offset_ppb;       // APLL correction applied
+    int32_t phase_err_ns;     // I2S against the host frame clock at the last update
+    uint32_t jitter_rms_ns;   // phase error while locked
+    uint32_t jitter_max_ns;
+    uint32_t relocks;         // times the lock was lost
+} clock_lock_stats_t;
+
+// ADC automatic gain control, the codec steers the MicPGA towards the target level. Levels and gains in 1/256 dB,
+// every value is rounded to the nearest codec step
+typedef struct {
+    int16_t target_level;         // -5.5 .. -24 dBFS
+    uint16_t hysteresis;          // gain hysteresis, 0 .. 1.5 dB in 0.5 dB steps
+    int16_t noise_threshold;      // -30 .. -90 dBFS in 2 dB steps, the gain holds below it, 0 no noise gate
+    uint16_t max_gain;            // 0 .. 58 dB in 0.5 dB steps
+    uint32_t attack_us;           // time constant of the gain decrease
+    uint32_t decay_us;            // time constant of the gain increase
+    uint32_t noise_debounce_us;   // signal below the noise threshold before the gain holds
+    uint32_t signal_debounce_us;  // signal above the noise threshold before the AGC resumes
+} codec_agc_cfg_t;
+
+// DAC dynamic range compression, the codec lowers the digital volume while the output exceeds the threshold
+typedef struct {
+    int16_t threshold;            // -3 .. -24 dBFS in 3 dB steps
+    uint16_t hysteresis;          // 0 .. 3 dB in 1 dB steps
+    uint32_t hold_us;             // before the gain recovers, 0 no hold
+    uint32_t attack_us;           // for a 6 dB gain decrease
+    uint32_t decay_us;            // for a 6 dB gain recovery
+} codec_drc_cfg_t;
+
+typedef struct {
+    bool agc_enable[2];           // left, right
+    bool drc_enable[2];
+    int16_t agc_gain[2];          // MicPGA gain applied by the AGC, 1/256 dB
+    codec_agc_cfg_t agc;          // as programmed, after rounding to the codec steps
+    codec_drc_cfg_t drc;
+} codec_dynamics_status_t;
+
 void InitCodec();
 void SetMute(uint32_t mute_l, uint32_t mute_r);
-void SetOutputLevels(const uint32_t left, const uint32_t right);
+// DAC volume in 1/256 dB, -63.5 .. +24 dB in 0.5 dB steps, written by the codec control task
+void SetOutputVolume(int16_t volume_l, int16_t volume_r);
+void GetCodecLatency(uint32_t *output_frames, uint32_t *input_frames);
+void SetLatencyMode(codec_latency_mode_t dac_mode, codec_latency_mode_t adc_mode);
+void SetMonitorMode(monitor_mode_t mode);
+void SetMonitorGain(uint8_t in_ch, uint8_t out_ch, int16_t gain); // gain in 1/256 dB, <= 0dB
+void SetMonitorLevel(uint8_t in_ch, int16_t gain, int8_t pan);    // pan -100 (left) .. 100 (right)
+void SetSlotMap(uint8_t input, const uint8_t *slot_map, uint8_t channels); // TDM slot per USB channel, TDM builds only
+// injects a marker and blocks until it came back through the loop, at most 0.5 s, false on timeout
+bool RunLatencyProbe(latency_probe_marker_t marker, latency_probe_loop_t loop, latency_probe_result_t *result);
+void LatencyProbeOutputBlock(int64_t usb_us); // USB arrival time of the data in the next i2s_write call
+void GetClockLockStats(clock_lock_stats_t *stats, bool reset);
+void SetInputAgc(const codec_agc_cfg_t *cfg);          // both ADC channels, the enables are kept
+void SetInputAgcEnable(uint32_t agc_l, uint32_t agc_r);
+void SetOutputDrc(const codec_drc_cfg_t *cfg);         // both DAC channels, the enables are kept
+void SetOutputDrcEnable(uint32_t drc_l, uint32_t drc_r);
+void GetDynamicsStatus(codec_dynamics_status_t *status);
+// gain in 1/256 dB, 0 .. 47.5 dB on the MicPGA and the fine ADC gain, written by the codec control task
+void SetInputGain(int16_t gain_l, int16_t gain_r);
+void SetInputMute(uint32_t mute_l, uint32_t mute_r);
+void SetInputHighPass(uint32_t enable);                // 3.7 Hz DC blocking IIR on both ADC channels, on by default
 
 void i2s_read(void *buf, uint32_t size, uint32_t *bytes_read);
 void i2s_write(void *buf, uint32_t size, uint32_t *bytes_read);
@@ -0,0 +1,118 @@
+/***************
+CTAG TBD >>to be determined<< is an open source eurorack synthesizer module.
+
+A project conceived within the Creative Technologies Arbeitsgruppe of
+Kiel University of Applied Sciences: https://www.creative-technologies.de
+
+(c) 2020 by Robert Manzke. All rights reserved.
+
+The CTAG TBD software is licensed under the GNU General Public License
+(GPL 3.0), available here: https://www.gnu.org/licenses/gpl-3.0.txt
+
+The CTAG TBD hardware design is released under the Creative Commons
+Attribution-NonCommercial-ShareAlike 4.0 International (CC BY-NC-SA 4.0).
+Details here: https://creativecommons.org/licenses/by-nc-sa/4.0/
+
+CTAG TBD is provided "as is" without any express or implied warranties.
+
+License and copyright details for specific submodules are included in their
+respective component folders / files if different from this license.
+***************/
+
+#include "pcm_bench.h"
+
+#include <stdlib.h>
+#include "sdkconfig.h"
+#include "esp_heap_caps.h"
+#include "pcm_ops.h"
+#if CONFIG_UAC_BENCHMARK
+#include "uac_bench.h"
+#endif
+
+#if CONFIG_UAC_BENCHMARK
+// one I2S DMA buffer of the TDM build, stereo USB channels in 8 slots
+#define BENCH_FRAMES 240
+#define BENCH_SLOTS 8
+#define BENCH_CHANNELS 2
+#define BENCH_GAINS 256
+
+typedef struct {
+    int16_t *src;       // BENCH_FRAMES * BENCH_SLOTS
+    int16_t *dst;
+    int16_t gain[2][2];
+    uint8_t slot_map[BENCH_CHANNELS];
+    int16_t db256[BENCH_GAINS];
+    volatile int16_t q15;
+} bench_ctx_t;
+
+static void bench_mix_matrix(void *ctx) {
+    bench_ctx_t *b = ctx;
+    pcm_mix_matrix_2x2(b->dst, b->src, BENCH_SLOTS, BENCH_FRAMES, (const int16_t (*)[2])b->gain);
+}
+
+static void bench_add_sat(void *ctx) {
+    bench_ctx_t *b = ctx;
+    pcm_add_sat(b->dst, b->src, BENCH_FRAMES * BENCH_CHANNELS);
+}
+
+static void bench_add_sat_stereo(void *ctx) {
+    bench_ctx_t *b = ctx;
+    pcm_add_sat_stereo(b->dst, BENCH_SLOTS, b->src, BENCH_FRAMES);
+}
+
+static void bench_channels_to_slots(void *ctx) {
+    bench_ctx_t *b = ctx;
+    pcm_channels_to_slots(b->dst, BENCH_SLOTS, b->src, BENCH_CHANNELS, BENCH_FRAMES, b->slot_map);
+}
+
+static void bench_slots_to_channels(void *ctx) {
+    bench_ctx_t *b = ctx;
+    pcm_slots_to_channels(b->dst, BENCH_CHANNELS, b->src, BENCH_SLOTS, BENCH_FRAMES, b->slot_map);
+}
+
+// the volume mapping of the monitor mix, one item per gain
+static void bench_db256_to_q15(void *ctx) {
+    bench_ctx_t *b = ctx;
+    for (int i = 0; i < BENCH_GAINS; i++) {
+        b->q15 = pcm_db256_to_q15(b->db256[i]);
+    }
+}
+#endif
+
+bool RunKernelBenchmark(uint32_t iterations, uint32_t seed, char *json, size_t size) {
+#if CONFIG_UAC_BENCHMARK
+    const size_t bytes = BENCH_FRAMES * BENCH_SLOTS * sizeof(int16_t);
+    bench_ctx_t b = {
+        .src = heap_caps_malloc(bytes, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT),
+        .dst = heap_caps_malloc(bytes, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT),
+        .gain = {{23170, 0}, {0, 23170}},   // -3 dB, both channels straight through
+        .slot_map = {1, 0},                 // swapped, the identity map takes the plain copy
+    };
+    bool ok = false;
+    if (b.src && b.dst) {
+        // a different stream than the component kernels get, the same for every run with this seed
+        uint32_t state = seed ^ 0x5043u;
+        uac_bench_fill(b.src, bytes, &state);
+        uac_bench_fill(b.dst, bytes, &state);
+        // 0 dB down to -127.5 dB in 0.5 dB steps, the range of the DAC volume
+        for (int i = 0; i < BENCH_GAINS; i++) b.db256[i] = (int16_t)(-128 * i);
+
+        const uint32_t stereo = BENCH_FRAMES * BENCH_CHANNELS * sizeof(int16_t);
+        const uint32_t tdm = BENCH_FRAMES * BENCH_SLOTS * sizeof(int16_t);
+        const uac_bench_case_t cases[] = {
+            {"pcm_mix_matrix_2x2", bench_mix_matrix, &b, BENCH_FRAMES, tdm + stereo},
+            {"pcm_add_sat", bench_add_sat, &b, BENCH_FRAMES, 3 * stereo},
+            {"pcm_add_sat_stereo", bench_add_sat_stereo, &b, BENCH_FRAMES, 3 * stereo},
+            {"pcm_channels_to_slots", bench_channels_to_slots, &b, BENCH_FRAMES, stereo + tdm},
+            {"pcm_slots_to_channels", bench_slots_to_channels, &b, BENCH_FRAMES, tdm + stereo},
+            {"pcm_db256_to_q15", bench_db256_to_q15, &b, BENCH_GAINS, BENCH_GAINS * 2 * sizeof(int16_t)},
+        };
+        ok = uac_bench_run(cases, sizeof(cases) / sizeof(cases[0]), iterations, seed, json, size) == ESP_OK;
+    }
+    free(b.src);
+    free(b.dst);
+    return ok;
+#else
+    return false;
+#endif
+}
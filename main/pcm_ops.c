@@ -0,0 +1,118 @@
+/***************
+CTAG TBD >>to be determined<< is an open source eurorack synthesizer module.
+
+A project conceived within the Creative Technologies Arbeitsgruppe of
+Kiel University of Applied Sciences: https://www.creative-technologies.de
+
+(c) 2025 by Robert Manzke. All rights reserved.
+
+The CTAG TBD software is licensed under the GNU General Public License
+(GPL 3.0), available here: https://www.gnu.org/licenses/gpl-3.0.txt
+
+The CTAG TBD hardware design is released under the Creative Commons
+Attribution-NonCommercial-ShareAlike 4.0 International (CC BY-NC-SA 4.0).
+Details here: https://creativecommons.org/licenses/by-nc-sa/4.0/
+
+CTAG TBD is provided "as is" without any express or implied warranties.
+
+License and copyright details for specific submodules are included in their
+respective component folders / files if different from this license.
+***************/
+
+#include "pcm_ops.h"
+
+#include <math.h>
+#include <stdbool.h>
+#include <string.h>
+
+static inline int16_t sat16(int32_t v) {
+    if (v > INT16_MAX) return INT16_MAX;
+    if (v < INT16_MIN) return INT16_MIN;
+    return (int16_t)v;
+}
+
+void pcm_mix_matrix_2x2(int16_t *restrict dst, const int16_t *restrict src, size_t src_stride, size_t frames, const int16_t gain[2][2]) {
+    const int32_t ll = gain[0][0], lr = gain[0][1], rl = gain[1][0], rr = gain[1][1];
+    for (size_t f = 0; f < frames; f++) {
+        const int32_t l = src[src_stride * f];
+        const int32_t r = src[src_stride * f + 1];
+        dst[2 * f] = sat16((l * ll + r * rl) >> 15);
+        dst[2 * f + 1] = sat16((l * lr + r * rr) >> 15);
+    }
+}
+
+void pcm_add_sat(int16_t *restrict dst, const int16_t *restrict src, size_t samples) {
+    for (size_t i = 0; i < samples; i++) {
+        dst[i] = sat16((int32_t)dst[i] + src[i]);
+    }
+}
+
+void pcm_add_sat_stereo(int16_t *restrict dst, size_t dst_stride, const int16_t *restrict src, size_t frames) {
+    if (dst_stride == 2) {
+        pcm_add_sat(dst, src, frames * 2);
+        return;
+    }
+    for (size_t f = 0; f < frames; f++) {
+        dst[dst_stride * f] = sat16((int32_t)dst[dst_stride * f] + src[2 * f]);
+        dst[dst_stride * f + 1] = sat16((int32_t)dst[dst_stride * f + 1] + src[2 * f + 1]);
+    }
+}
+
+static bool is_identity_map(size_t channels, size_t slots, const uint8_t *slot_map) {
+    if (channels != slots) return false;
+    for (size_t c = 0; c < channels; c++) {
+        if (slot_map[c] != c) return false;
+    }
+    return true;
+}
+
+// copies one stream with constant strides, the inner loop is kept free of the map lookup
+static void copy_strided(int16_t *restrict dst, size_t dst_stride, const int16_t *restrict src, size_t src_stride, size_t frames) {
+    size_t f = 0;
+    for (; f + 4 <= frames; f += 4) {
+        const int16_t s0 = src[0], s1 = src[src_stride], s2 = src[2 * src_stride], s3 = src[3 * src_stride];
+        dst[0] = s0;
+        dst[dst_stride] = s1;
+        dst[2 * dst_stride] = s2;
+        dst[3 * dst_stride] = s3;
+        src += 4 * src_stride;
+        dst += 4 * dst_stride;
+    }
+    for (; f < frames; f++) {
+        *dst = *src;
+        src += src_stride;
+        dst += dst_stride;
+    }
+}
+
+void pcm_channels_to_slots(int16_t *restrict dst, size_t slots, const int16_t *restrict src, size_t channels, size_t frames, const uint8_t *slot_map) {
+    if (is_identity_map(channels, slots, slot_map)) {
+        memcpy(dst, src, frames * slots * sizeof(int16_t));
+        return;
+    }
+    memset(dst, 0, frames * slots * sizeof(int16_t));
+    for (size_t c = 0; c < channels; c++) {
+        if (slot_map[c] >= slots) continue;
+        copy_strided(dst + slot_map[c], slots, src + c, channels, frames);
+    }
+}
+
+void pcm_slots_to_channels(int16_t *restrict dst, size_t channels, const int16_t *restrict src, size_t slots, size_t frames, const uint8_t *slot_map) {
+    if (is_identity_map(channels, slots, slot_map)) {
+        memcpy(dst, src, frames * slots * sizeof(int16_t));
+        return;
+    }
+    for (size_t c = 0; c < channels; c++) {
+        if (slot_map[c] >= slots) {
+            for (size_t f = 0; f < frames; f++) dst[f * channels + c] = 0;
+            continue;
+        }
+        copy_strided(dst + c, channels, src + slot_map[c], slots, frames);
+    }
+}
+
+int16_t pcm_db256_to_q15(int16_t gain) {
+    if (gain == INT16_MIN) return 0;
+    if (gain >= 0) return INT16_MAX;
+    return (int16_t)(powf(10.0f, (float)gain / (256.0f * 20.0f)) * 32767.0f + 0.5f);
+}
@@ -0,0 +1,46 @@
+/***************
+CTAG TBD >>to be determined<< is an open source eurorack synthesizer module.
+
+A project conceived within the Creative Technologies Arbeitsgruppe of
+Kiel University of Applied Sciences: https://www.creative-technologies.de
+
+(c) 2025 by Robert Manzke. All rights reserved.
+
+The CTAG TBD software is licensed under the GNU General Public License
+(GPL 3.0), available here: https://www.gnu.org/licenses/gpl-3.0.txt
+
+The CTAG TBD hardware design is released under the Creative Commons
+Attribution-NonCommercial-ShareAlike 4.0 International (CC BY-NC-SA 4.0).
+Details here: https://creativecommons.org/licenses/by-nc-sa/4.0/
+
+CTAG TBD is provided "as is" without any express or implied warranties.
+
+License and copyright details for specific submodules are included in their
+respective component folders / files if different from this license.
+***************/
+
+#pragma once
+
+// Sample kernels for interleaved 16-bit PCM. Pure computation, no driver dependencies.
+
+#include <stdint.h>
+#include <stddef.h>
+
+// dst[f] = gain * src[f] for a stereo frame, gain[in][out] in Q15
+// src_stride is the number of samples per source frame, the stereo pair is taken from its first two samples
+void pcm_mix_matrix_2x2(int16_t *dst, const int16_t *src, size_t src_stride, size_t frames, const int16_t gain[2][2]);
+
+// dst[i] = saturate(dst[i] + src[i])
+void pcm_add_sat(int16_t *dst, const int16_t *src, size_t samples);
+
+// adds stereo frames to the first two samples of each dst frame, dst_stride samples apart
+void pcm_add_sat_stereo(int16_t *dst, size_t dst_stride, const int16_t *src, size_t frames);
+
+// USB channel order -> TDM slot order, channel c goes to slot slot_map[c], unmapped slots are cleared
+void pcm_channels_to_slots(int16_t *dst, size_t slots, const int16_t *src, size_t channels, size_t frames, const uint8_t *slot_map);
+
+// TDM slot order -> USB channel order, channel c is taken from slot slot_map[c]
+void pcm_slots_to_channels(int16_t *dst, size_t channels, const int16_t *src, size_t slots, size_t frames, const uint8_t *slot_map);
+
+// converts a gain in 1/256 dB to Q15, gains above 0 dB are clamped, INT16_MIN is silence
+int16_t pcm_db256_to_q15(int16_t gain);
@@ -0,0 +1,285 @@
+/***************
+CTAG TBD >>to be determined<< is an open source eurorack synthesizer module.
+
+A project conceived within the Creative Technologies Arbeitsgruppe of
+Kiel University of Applied Sciences: https://www.creative-technologies.de
+
+(c) 2020 by Robert Manzke. All rights reserved.
+
+The CTAG TBD software is licensed under the GNU General Public License
+(GPL 3.0), available here: https://www.gnu.org/licenses/gpl-3.0.txt
+
+The CTAG TBD hardware design is released under the Creative Commons
+Attribution-NonCommercial-ShareAlike 4.0 International (CC BY-NC-SA 4.0).
+Details here: https://creativecommons.org/licenses/by-nc-sa/4.0/
+
+CTAG TBD is provided "as is" without any express or implied warranties.
+
+License and copyright details for specific submodules are included in their
+respective component folders / files if different from this license.
+***************/
+
+#include "settings.h"
+
+#include <string.h>
+#include "esp_log.h"
+#include "nvs.h"
+#include "nvs_flash.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+
+static const char *TAG = "SETTINGS";
+
+// bump when settings_t changes, an image of another version or size is ignored
+#define SETTINGS_VERSION 1
+#define SETTINGS_NAMESPACE "uac"
+#define SETTINGS_KEY "settings"
+// the image is written once nothing changed for the quiet time, while a control keeps moving at the latest
+// after the maximum delay. Writing flash disables the cache and with it the I2S interrupts, so the write also
+// waits until the host closed both streams; SettingsFlush before a reboot writes at once
+#define SETTINGS_QUIET_MS 2000
+#define SETTINGS_MAX_DELAY_MS 10000
+#define SETTINGS_IDLE_POLL_MS 1000
+
+typedef struct {
+    uint16_t version;
+    uint16_t size;
+    settings_t settings;
+} settings_image_t;
+
+static const settings_t settings_default = {
+    .volume = {[UAC_FEATURE_UNIT_SPK] = {-23 * 256, 0, 0}},
+    .input_hpf = true,
+    .dac_latency_mode = CODEC_LATENCY_STANDARD,
+    .adc_latency_mode = CODEC_LATENCY_STANDARD,
+};
+
+static portMUX_TYPE settings_mux = portMUX_INITIALIZER_UNLOCKED;
+static settings_t settings;             // RAM image, under settings_mux
+static bool dirty;                      // the image differs from flash, under settings_mux
+static settings_t stored;               // as last written, under flush_lock
+static SemaphoreHandle_t flush_lock;
+static TaskHandle_t flush_task_handle;
+static nvs_handle_t nvs;
+static bool nvs_ready;                  // without NVS the settings last until the next reboot
+
+// the image is compared and copied with memcmp and memcpy only, so the padding stays zero
+static void update(void *field, const void *value, size_t size) {
+    portENTER_CRITICAL(&settings_mux);
+    const bool changed = memcmp(field, value, size) != 0;
+    if (changed) {
+        memcpy(field, value, size);
+        dirty = true;
+    }
+    portEXIT_CRITICAL(&settings_mux);
+    if (changed && flush_task_handle) xTaskNotifyGive(flush_task_handle);
+}
+
+static int16_t add_volume(int16_t a, int16_t b) {
+    const int32_t sum = (int32_t)a + b;
+    return sum < INT16_MIN ? INT16_MIN : sum > INT16_MAX ? INT16_MAX : sum;
+}
+
+static void apply_volume(uac_feature_unit_t unit) {
+    int16_t v[3];
+    portENTER_CRITICAL(&settings_mux);
+    memcpy(v, settings.volume[unit], sizeof(v));
+    portEXIT_CRITICAL(&settings_mux);
+    if (unit == UAC_FEATURE_UNIT_MIC) {
+        SetInputGain(add_volume(v[0], v[1]), add_volume(v[0], v[2]));
+    } else {
+        SetOutputVolume(add_volume(v[0], v[1]), add_volume(v[0], v[2]));
+    }
+}
+
+static void apply_mute(uac_feature_unit_t unit) {
+    bool m[3];
+    portENTER_CRITICAL(&settings_mux);
+    memcpy(m, settings.mute[unit], sizeof(m));
+    portEXIT_CRITICAL(&settings_mux);
+    if (unit == UAC_FEATURE_UNIT_MIC) {
+        SetInputMute(m[0] || m[1], m[0] || m[2]);
+    } else {
+        SetMute(m[0] || m[1], m[0] || m[2]);
+    }
+}
+
+static void apply_agc(uac_feature_unit_t unit) {
+    bool a[3];
+    portENTER_CRITICAL(&settings_mux);
+    memcpy(a, settings.agc[unit], sizeof(a));
+    portEXIT_CRITICAL(&settings_mux);
+    if (unit == UAC_FEATURE_UNIT_MIC) {
+        SetInputAgcEnable(a[0] || a[1], a[0] || a[2]);
+    } else {
+        SetOutputDrcEnable(a[0] || a[1], a[0] || a[2]);
+    }
+}
+
+static void sync_host(uac_feature_unit_t unit, uint8_t channel) {
+    portENTER_CRITICAL(&settings_mux);
+    const bool mute = settings.mute[unit][channel];
+    const int16_t volume = settings.volume[unit][channel];
+    const bool agc = settings.agc[unit][channel];
+    portEXIT_CRITICAL(&settings_mux);
+    uac_device_set_fu_state(unit, channel, mute, volume, agc);
+}
+
+static void flush() {
+    settings_image_t image = {.version = SETTINGS_VERSION, .size = sizeof(settings_t)};
+    xSemaphoreTake(flush_lock, portMAX_DELAY);
+    portENTER_CRITICAL(&settings_mux);
+    memcpy(&image.settings, &settings, sizeof(settings));
+    dirty = false;
+    portEXIT_CRITICAL(&settings_mux);
+    // nothing to write when the controls went back to the stored values
+    if (memcmp(&image.settings, &stored, sizeof(stored)) != 0) {
+        esp_err_t err = nvs_set_blob(nvs, SETTINGS_KEY, &image, sizeof(image));
+        if (err == ESP_OK) err = nvs_commit(nvs);
+        if (err == ESP_OK) {
+            memcpy(&stored, &image.settings, sizeof(stored));
+            ESP_LOGI(TAG, "Settings stored");
+        } else {
+            ESP_LOGE(TAG, "Storing settings failed: %s", esp_err_to_name(err));
+        }
+    }
+    xSemaphoreGive(flush_lock);
+}
+
+// lowest priority, the flash write waits until the controls are quiet and never delays the control path
+static void flush_task(void *pvParameters) {
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        const TickType_t first = xTaskGetTickCount();
+        while (ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(SETTINGS_QUIET_MS)) &&
+               xTaskGetTickCount() - first < pdMS_TO_TICKS(SETTINGS_MAX_DELAY_MS)) {
+        }
+        // changes in the meantime are only collected, flush writes the latest image
+        while (uac_device_is_streaming()) {
+            vTaskDelay(pdMS_TO_TICKS(SETTINGS_IDLE_POLL_MS));
+        }
+        ulTaskNotifyTake(pdTRUE, 0);
+        flush();
+    }
+}
+
+static bool open_nvs() {
+    esp_err_t err = nvs_flash_init();
+    if (err == ESP_ERR_NVS_NO_FREE_PAGES || err == ESP_ERR_NVS_NEW_VERSION_FOUND) {
+        // the partition was written by another layout, start over
+        ESP_LOGW(TAG, "Erasing NVS: %s", esp_err_to_name(err));
+        nvs_flash_erase();
+        err = nvs_flash_init();
+    }
+    if (err == ESP_OK) err = nvs_open(SETTINGS_NAMESPACE, NVS_READWRITE, &nvs);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "NVS unavailable, settings are not kept: %s", esp_err_to_name(err));
+        return false;
+    }
+    return true;
+}
+
+static void load() {
+    settings_image_t image;
+    size_t size = sizeof(image);
+    memcpy(&settings, &settings_default, sizeof(settings));
+    if (!nvs_ready) return;
+    const esp_err_t err = nvs_get_blob(nvs, SETTINGS_KEY, &image, &size);
+    if (err == ESP_OK && size == sizeof(image) && image.version == SETTINGS_VERSION && image.size == sizeof(settings_t)) {
+        memcpy(&settings, &image.settings, sizeof(settings));
+        memcpy(&stored, &settings, sizeof(stored));
+        ESP_LOGI(TAG, "Settings restored");
+    } else if (err == ESP_ERR_NVS_NOT_FOUND) {
+        ESP_LOGI(TAG, "No stored settings, using the defaults");
+    } else {
+        ESP_LOGW(TAG, "Stored settings not usable (%s, %u bytes), using the defaults", esp_err_to_name(err), (unsigned)size);
+    }
+}
+
+void SettingsInit() {
+    flush_lock = xSemaphoreCreateMutex();
+    nvs_ready = open_nvs();
+    load();
+
+    // the codec setters only store the values before InitCodec, bring-up writes them with the first configuration
+    for (int unit = 0; unit < UAC_FEATURE_UNIT_NUM; unit++) {
+        apply_volume(unit);
+        apply_mute(unit);
+        apply_agc(unit);
+    }
+    SetInputHighPass(settings.input_hpf);
+    SetLatencyMode(settings.dac_latency_mode, settings.adc_latency_mode);
+    if (settings.agc_cfg_set) SetInputAgc(&settings.agc_cfg);
+    if (settings.drc_cfg_set) SetOutputDrc(&settings.drc_cfg);
+
+    // a cold task, its stack stays out of the hot arena the USB tasks and pools need
+    if (nvs_ready) xTaskCreatePinnedToCore(flush_task, "settings", 3072, NULL, 1, &flush_task_handle, tskNO_AFFINITY);
+}
+
+void SettingsSyncHost() {
+    for (int unit = 0; unit < UAC_FEATURE_UNIT_NUM; unit++) {
+        for (uint8_t ch = 0; ch < 3; ch++) sync_host(unit, ch);
+    }
+}
+
+void GetSettings(settings_t *s) {
+    portENTER_CRITICAL(&settings_mux);
+    memcpy(s, &settings, sizeof(settings));
+    portEXIT_CRITICAL(&settings_mux);
+}
+
+void SettingsSetVolume(uac_feature_unit_t unit, uint8_t channel, int16_t volume) {
+    if (unit >= UAC_FEATURE_UNIT_NUM || channel > 2) return;
+    update(&settings.volume[unit][channel], &volume, sizeof(volume));
+    apply_volume(unit);
+    sync_host(unit, channel);
+}
+
+void SettingsSetMute(uac_feature_unit_t unit, uint8_t channel, bool mute) {
+    if (unit >= UAC_FEATURE_UNIT_NUM || channel > 2) return;
+    update(&settings.mute[unit][channel], &mute, sizeof(mute));
+    apply_mute(unit);
+    sync_host(unit, channel);
+}
+
+void SettingsSetAgc(uac_feature_unit_t unit, uint8_t channel, bool enable) {
+    if (unit >= UAC_FEATURE_UNIT_NUM || channel > 2) return;
+    update(&settings.agc[unit][channel], &enable, sizeof(enable));
+    apply_agc(unit);
+    sync_host(unit, channel);
+}
+
+void SettingsSetInputHighPass(bool enable) {
+    update(&settings.input_hpf, &enable, sizeof(enable));
+    SetInputHighPass(enable);
+}
+
+void SettingsSetLatencyMode(codec_latency_mode_t dac_mode, codec_latency_mode_t adc_mode) {
+    const uint8_t modes[2] = {dac_mode, adc_mode};
+    update(&settings.dac_latency_mode, &modes[0], sizeof(modes[0]));
+    update(&settings.adc_latency_mode, &modes[1], sizeof(modes[1]));
+    SetLatencyMode(dac_mode, adc_mode);
+}
+
+void SettingsSetInputAgc(const codec_agc_cfg_t *cfg) {
+    const bool set = true;
+    update(&settings.agc_cfg, cfg, sizeof(*cfg));
+    update(&settings.agc_cfg_set, &set, sizeof(set));
+    SetInputAgc(cfg);
+}
+
+void SettingsSetOutputDrc(const codec_drc_cfg_t *cfg) {
+    const bool set = true;
+    update(&settings.drc_cfg, cfg, sizeof(*cfg));
+    update(&settings.drc_cfg_set, &set, sizeof(set));
+    SetOutputDrc(cfg);
+}
+
+void SettingsFlush() {
+    if (!nvs_ready) return;
+    portENTER_CRITICAL(&settings_mux);
+    const bool pending = dirty;
+    portEXIT_CRITICAL(&settings_mux);
+    if (pending) flush();
+}
@@ -0,0 +1,60 @@
+/***************
+CTAG TBD >>to be determined<< is an open source eurorack synthesizer module.
+
+A project conceived within the Creative Technologies Arbeitsgruppe of
+Kiel University of Applied Sciences: https://www.creative-technologies.de
+
+(c) 2020 by Robert Manzke. All rights reserved.
+
+The CTAG TBD software is licensed under the GNU General Public License
+(GPL 3.0), available here: https://www.gnu.org/licenses/gpl-3.0.txt
+
+The CTAG TBD hardware design is released under the Creative Commons
+Attribution-NonCommercial-ShareAlike 4.0 International (CC BY-NC-SA 4.0).
+Details here: https://creativecommons.org/licenses/by-nc-sa/4.0/
+
+CTAG TBD is provided "as is" without any express or implied warranties.
+
+License and copyright details for specific submodules are included in their
+respective component folders / files if different from this license.
+***************/
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "usb_device_uac.h"
+#include "codec.h"
+
+/* Device settings kept in NVS. The setters update a RAM image and apply the change at once, a low priority
+ * task writes the image once the settings stopped changing, so a moving slider costs one flash write, and holds
+ * the write until no audio stream is open since flash writes stall the I2S interrupts. */
+
+// feature unit controls as the host set them, [0] is the master control of both channels
+typedef struct {
+    int16_t volume[UAC_FEATURE_UNIT_NUM][3];  // 1/256 dB, the master adds to the channel volume
+    bool mute[UAC_FEATURE_UNIT_NUM][3];
+    bool agc[UAC_FEATURE_UNIT_NUM][3];        // microphone ADC AGC, speaker DAC DRC
+    bool input_hpf;
+    uint8_t dac_latency_mode;                 // codec_latency_mode_t
+    uint8_t adc_latency_mode;
+    bool agc_cfg_set;                         // otherwise the codec defaults apply
+    bool drc_cfg_set;
+    codec_agc_cfg_t agc_cfg;
+    codec_drc_cfg_t drc_cfg;
+} settings_t;
+
+// loads the stored image and hands it to the codec setters, call before InitCodec so bring-up writes it
+void SettingsInit();
+// reports the restored feature unit controls to the host, call after uac_device_init
+void SettingsSyncHost();
+void GetSettings(settings_t *settings);
+void SettingsSetVolume(uac_feature_unit_t unit, uint8_t channel, int16_t volume);
+void SettingsSetMute(uac_feature_unit_t unit, uint8_t channel, bool mute);
+void SettingsSetAgc(uac_feature_unit_t unit, uint8_t channel, bool enable);
+void SettingsSetInputHighPass(bool enable);
+void SettingsSetLatencyMode(codec_latency_mode_t dac_mode, codec_latency_mode_t adc_mode);
+void SettingsSetInputAgc(const codec_agc_cfg_t *cfg);
+void SettingsSetOutputDrc(const codec_drc_cfg_t *cfg);
+// writes pending changes now, e.g. before a reboot
+void SettingsFlush();
@@ -1,27 +1,15 @@
-#include "spi_api.h"
-#include "freertos/FreeRTOS.h"
-#include "task.h"
-#include "driver/spi_slave.h"
-#include "driver/gpio.h"
+#include "spi_api_priv.h"
+#include <stdlib.h>
+#include <string.h>
 #include "esp_log.h"
 #include "esp_ota_ops.h"
-
-static TaskHandle_t hTask;
-static spi_slave_transaction_t transaction;
-static uint8_t *send_buffer, *receive_buffer;
-
-#define RCV_HOST    SPI3_HOST // SPI2 connects to rp2350 spi1
-#define GPIO_HANDSHAKE GPIO_NUM_50 // GPIO50 is used for handshake line, P4_PICO_02 which is GPIO18 on rp2350
-#define GPIO_MOSI GPIO_NUM_23
-#define GPIO_MISO GPIO_NUM_22
-#define GPIO_SCLK GPIO_NUM_21
-#define GPIO_CS GPIO_NUM_20
-
-typedef enum{
-    Reboot = 0x13, // reboots the device
-    GetFirmwareInfo = 0x19, // returns json {"HWV": hardware version, "FWV": firmware version, "OTA": active ota partition}
-    RebootToOTAX = 0x22, // reboots the device to OTAX, args [X (uint8_t)]
-} RequestType;
+#include "usb_device_uac.h"
+#include "uac_flight_recorder.h"
+#include "uac_glitch_detector.h"
+#include "uac_trace.h"
+#include "codec.h"
+#include "settings.h"
+#include "pcm_bench.h"
 
 static void boot_into_slot(int slot) { // slot 0 or 1
     esp_partition_subtype_t st = (slot == 0)
@@ -68,154 +56,415 @@ static int count_bootable_ota_partitions(void) {
     return count;
 }
 
-static bool transmitCString(const RequestType reqType, const char* str){
-    uint32_t len = strlen(str);
-    // fields are: // 0xCA, 0xFE, request type, length (uint32_t), cstring
-    uint8_t* requestTypeField = send_buffer + 2;
-    *requestTypeField = (uint8_t)(reqType);
-    uint32_t* lengthField = (uint32_t*)(send_buffer + 3);
-    uint32_t bytes_to_send = 0;
-    uint32_t bytes_sent = 0;
-    while (len > 0){
-        *lengthField = len;
-        bytes_to_send = len > 2048 - 7 ? 2048 - 7 : len; // 7 bytes for header
-        const char* ptr_cstring_section = str + bytes_sent;
-        memcpy(send_buffer + 7, ptr_cstring_section, bytes_to_send);
-        len -= bytes_to_send;
-        bytes_sent += bytes_to_send;
-        spi_slave_transmit(RCV_HOST, &transaction, portMAX_DELAY);
-        // fingerprint check
-        if (receive_buffer[0] != 0xCA || receive_buffer[1] != 0xFE){
-            return false;
-        }
-        // check request type acknowledgment
-        const uint8_t requestType = receive_buffer[2];
-        if (requestType != (uint8_t)reqType){
-            return false;
-        }
+#if CONFIG_UAC_FLIGHT_RECORDER
+// the data is pulled from the frozen flight recorder frame by frame while it is sent
+static size_t read_recording(const api_response_t* resp, uint8_t* dst, size_t len){
+    size_t n = 0;
+    uac_recorder_read((uac_recorder_stream_t)resp->stream, resp->stream_offset + resp->offset, dst, len, &n);
+    return n;
+}
+
+// the download keeps the recording frozen, RearmRecorder fails until the response is released
+static void stream_recording(api_response_t* resp, uac_recorder_stream_t stream, uint32_t offset, uint32_t len){
+    uac_recorder_info_t info;
+    if (uac_recorder_read_begin() != ESP_OK) return;
+    resp->done = uac_recorder_read_end;
+    if (uac_recorder_get_info(&info) != ESP_OK) return;
+    const uint32_t avail = info.stream[stream].bytes;
+    if (offset >= avail) len = 0;
+    else if (len > avail - offset) len = avail - offset;
+    resp->read = read_recording;
+    resp->stream = stream;
+    resp->stream_offset = offset;
+    resp->len = len;
+}
+#endif
+
+#if CONFIG_UAC_TRACE
+// the trace stays frozen while it is sent and records again once the response is released
+static size_t read_trace(const api_response_t* resp, uint8_t* dst, size_t len){
+    size_t n = 0;
+    uac_trace_read(resp->offset, dst, len, &n);
+    return n;
+}
+
+static void resume_trace(void){
+    uac_trace_resume();
+}
+
+static void stream_trace(api_response_t* resp){
+    size_t len = 0;
+    if (uac_trace_freeze(&len) != ESP_OK){
+        uac_trace_resume();
+        return;
     }
-    return true;
-}
-
-static void api_task(void* pvParameters){
-    bool result = true;
-    ESP_LOGI("spi_api", "api_task()");
-    while (1){
-        if (result) spi_slave_transmit(RCV_HOST, &transaction, portMAX_DELAY);
-        // recycle last transaction, if previous was not successful, sometimes data gets stuck
-        const uint8_t* rcv_data = (uint8_t*)transaction.rx_buffer;
-
-        // check integrity of transaction
-        if (transaction.trans_len != 2048 * 8){
-            ESP_LOGE("spiapi", "Received transaction length %d, expected 2048 * 8", transaction.trans_len);
-            result = true;
-            continue;
-        }
-        if (rcv_data[0] != 0xCA || rcv_data[1] != 0xFE){
-            ESP_LOGE("spiapi", "Received data %x %x, expected 0xCA 0xFE", rcv_data[0], rcv_data[1]);
-            result = true;
-            continue;
-        }
-
-        // parse request
-        RequestType requestType = (RequestType)(rcv_data[2]);
-        const int uint8_param_0 = rcv_data[3]; // first request parameter, e.g. channel, favorite number, ...
-
-        // handle request
-        if (requestType == GetFirmwareInfo){
-            ESP_LOGI("SpiAPI", "GetFirmwareInfo");
-            {
-                char info[1024] = "{\"HWV\": \"DADA\", \"FWV\": \"usb_uac_1.0\", \"OTA\": \"";
-                const char* ota_label = esp_get_current_ota_label();
-                strcat(info, ota_label);
-                strcat(info, "\"}");
-                ESP_LOGI("SpiAPI", "Firmware info: %s", info);
-                result = transmitCString(requestType, info);
-            }
-        }else if (requestType == Reboot){
-            ESP_LOGI("SpiAPI", "Rebooting device!");
-            // TODO: dismount sd-card, filesystem etc!
-            esp_restart();
-        }else if (requestType == RebootToOTAX){
-            int num_ota = count_bootable_ota_partitions();
-            if (uint8_param_0 >= num_ota){
-                ESP_LOGE("SpiAPI", "Requested OTA %d but only %d OTAs available!", uint8_param_0, num_ota);
-            }else{
-                // TODO: dismount sd-card, filesystem etc!
-                boot_into_slot(uint8_param_0);
-                ESP_LOGI("SpiAPI", "Rebooting device to OTA %d!", uint8_param_0);
-            }
-        }else{
-            ESP_LOGE("SpiAPI", "Unknown request type %d", (uint8_t)requestType);
-            result = true;
-        }
+    resp->read = read_trace;
+    resp->done = resume_trace;
+    resp->len = len;
+}
+#endif
+
+static void handle_get_firmware_info(const api_request_t* req, api_response_t* resp){
+    ESP_LOGI("SpiAPI", "GetFirmwareInfo");
+    {
+        char info[1024] = "{\"HWV\": \"DADA\", \"FWV\": \"usb_uac_1.0\", \"OTA\": \"";
+        const char* ota_label = esp_get_current_ota_label();
+        strcat(info, ota_label);
+        strcat(info, "\"}");
+        ESP_LOGI("SpiAPI", "Firmware info: %s", info);
+        api_respond(resp, info);
+    }
+}
+
+static void handle_get_latency(const api_request_t* req, api_response_t* resp){
+    uac_device_latency_t latency = {0};
+    uac_device_get_latency(&latency);
+    char info[64];
+    snprintf(info, sizeof(info), "{\"OUT\": %lu, \"IN\": %lu}",
+             (unsigned long)latency.spk_latency_ns, (unsigned long)latency.mic_latency_ns);
+    ESP_LOGI("SpiAPI", "Latency: %s", info);
+    api_respond(resp, info);
+}
+
+static void handle_set_codec_latency_mode(const api_request_t* req, api_response_t* resp){
+    const int uint8_param_0 = req->args[0];
+    const int uint8_param_1 = req->args[1];
+    ESP_LOGI("SpiAPI", "SetCodecLatencyMode DAC %d ADC %d", uint8_param_0, uint8_param_1);
+    SettingsSetLatencyMode(uint8_param_0 ? CODEC_LATENCY_LOW : CODEC_LATENCY_STANDARD,
+                           uint8_param_1 ? CODEC_LATENCY_LOW : CODEC_LATENCY_STANDARD);
+    uint32_t output_latency = 0, input_latency = 0;
+    GetCodecLatency(&output_latency, &input_latency);
+    uac_device_set_path_latency(output_latency, input_latency);
+}
+
+static void handle_select_monitor_mode(const api_request_t* req, api_response_t* resp){
+    const int uint8_param_0 = req->args[0];
+    ESP_LOGI("SpiAPI", "SelectMonitorMode %d", uint8_param_0);
+    if (uint8_param_0 > MONITOR_FIRMWARE){
+        ESP_LOGE("SpiAPI", "Unknown monitor mode %d", uint8_param_0);
+        resp->status = API_STATUS_FAILED;
+    }else{
+        SetMonitorMode((monitor_mode_t)uint8_param_0);
+    }
+}
+
+static void handle_set_input_monitor_level(const api_request_t* req, api_response_t* resp){
+    const int uint8_param_0 = req->args[0];
+    const int8_t gain_db = (int8_t)req->args[1];
+    const int8_t pan = (int8_t)req->args[2];
+    ESP_LOGI("SpiAPI", "SetInputMonitorLevel input %d gain %d dB pan %d", uint8_param_0, gain_db, pan);
+    SetMonitorLevel(uint8_param_0, gain_db == INT8_MIN ? MONITOR_GAIN_SILENCE : gain_db * 256, pan);
+}
+
+static void handle_set_tdm_slot_map(const api_request_t* req, api_response_t* resp){
+    const int uint8_param_0 = req->args[0];
+    const int uint8_param_1 = req->args[1];
+    ESP_LOGI("SpiAPI", "SetTdmSlotMap direction %d channels %d", uint8_param_0, uint8_param_1);
+    SetSlotMap(uint8_param_0, &req->args[2], uint8_param_1);
+}
+
+#if CONFIG_UAC_FLIGHT_RECORDER
+static void handle_trigger_recorder(const api_request_t* req, api_response_t* resp){
+    const int uint8_param_0 = req->args[0];
+    ESP_LOGI("SpiAPI", "TriggerRecorder reason %d", uint8_param_0);
+    uac_recorder_trigger(uint8_param_0);
+}
+
+static void handle_rearm_recorder(const api_request_t* req, api_response_t* resp){
+    ESP_LOGI("SpiAPI", "RearmRecorder");
+    if (uac_recorder_rearm() != ESP_OK) resp->status = API_STATUS_FAILED;
+}
+
+static void handle_get_recorder_info(const api_request_t* req, api_response_t* resp){
+    uac_recorder_info_t info = {0};
+    uac_recorder_get_info(&info);
+    char json[512];
+    int n = snprintf(json, sizeof(json), "{\"frozen\": %d, \"reason\": %lu, \"time\": %lld",
+                     info.frozen, (unsigned long)info.reason, (long long)info.trigger_time_us);
+    static const char* names[UAC_RECORDER_STREAM_NUM] = {"OUT", "IN"};
+    for (int i = 0; i < UAC_RECORDER_STREAM_NUM; i++){
+        const uac_recorder_stream_info_t* si = &info.stream[i];
+        n += snprintf(json + n, sizeof(json) - n,
+                      ", \"%s\": {\"rate\": %lu, \"ch\": %d, \"bits\": %d, \"bytes\": %lu, \"pos\": %llu, \"lost\": %lu}",
+                      names[i], (unsigned long)si->format.sample_rate, si->format.channels, si->format.bits_per_sample,
+                      (unsigned long)si->bytes, (unsigned long long)si->first_sample_pos, (unsigned long)si->lost_bytes);
+    }
+    snprintf(json + n, sizeof(json) - n, "}");
+    ESP_LOGI("SpiAPI", "Recorder info: %s", json);
+    api_respond(resp, json);
+}
+
+static void handle_read_recorder(const api_request_t* req, api_response_t* resp){
+    const int uint8_param_0 = req->args[0];
+    uint32_t offset, length;
+    memcpy(&offset, &req->args[1], sizeof(offset));
+    memcpy(&length, &req->args[5], sizeof(length));
+    ESP_LOGI("SpiAPI", "ReadRecorder stream %d offset %lu length %lu", uint8_param_0, (unsigned long)offset, (unsigned long)length);
+    stream_recording(resp, uint8_param_0 ? UAC_RECORDER_IN : UAC_RECORDER_OUT, offset, length);
+}
+#endif
+
+static void handle_get_task_latency(const api_request_t* req, api_response_t* resp){
+    const int uint8_param_0 = req->args[0];
+    uac_task_latency_t stats[UAC_TASK_NUM] = {0};
+    uac_device_get_task_latency(stats, uint8_param_0 != 0);
+    static const char* names[UAC_TASK_NUM] = {"TinyUSB", "spk", "mic"};
+    char json[384];
+    int n = snprintf(json, sizeof(json), "{");
+    for (int i = 0; i < UAC_TASK_NUM; i++){
+        n += snprintf(json + n, sizeof(json) - n, "%s\"%s\": {\"wakeups\": %lu, \"mean\": %lu, \"max\": %lu, \"late\": %lu}",
+                      i ? ", " : "", names[i], (unsigned long)stats[i].wakeups, (unsigned long)stats[i].mean_us,
+                      (unsigned long)stats[i].max_us, (unsigned long)stats[i].late);
+    }
+    snprintf(json + n, sizeof(json) - n, "}");
+    ESP_LOGI("SpiAPI", "Task latency: %s", json);
+    api_respond(resp, json);
+}
+
+static void handle_measure_latency(const api_request_t* req, api_response_t* resp){
+    const int uint8_param_0 = req->args[0];
+    const int uint8_param_1 = req->args[1];
+    ESP_LOGI("SpiAPI", "MeasureLatency marker %d loop %d", uint8_param_0, uint8_param_1);
+    latency_probe_result_t probe = {0};
+    const bool ok = RunLatencyProbe(uint8_param_0 ? LATENCY_PROBE_BEEP : LATENCY_PROBE_IMPULSE,
+                                    uint8_param_1 ? LATENCY_LOOP_DIGITAL : LATENCY_LOOP_ANALOG, &probe);
+    // the reported latency goes along so the host can compare it against the measurement
+    uac_device_latency_t latency = {0};
+    uac_device_get_latency(&latency);
+    char json[256];
+    if (ok){
+        snprintf(json, sizeof(json), "{\"ok\": 1, \"out\": %ld, \"loop\": %ld, \"in\": %ld, \"loop_us\": %ld, \"peak\": %d, "
+                 "\"dac_gd\": %u, \"adc_gd\": %u, \"OUT\": %lu, \"IN\": %lu}",
+                 (long)probe.out_frames, (long)probe.loop_frames, (long)probe.in_frames, (long)probe.loop_us, probe.peak,
+                 probe.dac_group_delay, probe.adc_group_delay,
+                 (unsigned long)latency.spk_latency_ns, (unsigned long)latency.mic_latency_ns);
+    }else{
+        snprintf(json, sizeof(json), "{\"ok\": 0, \"OUT\": %lu, \"IN\": %lu}",
+                 (unsigned long)latency.spk_latency_ns, (unsigned long)latency.mic_latency_ns);
+    }
+    ESP_LOGI("SpiAPI", "Measured latency: %s", json);
+    api_respond(resp, json);
+}
+
+static void handle_set_usb_loopback(const api_request_t* req, api_response_t* resp){
+    const int uint8_param_0 = req->args[0];
+    ESP_LOGI("SpiAPI", "SetUsbLoopback %d", uint8_param_0);
+    if (uac_device_set_loopback((uac_loopback_mode_t)uint8_param_0) != ESP_OK){
+        ESP_LOGE("SpiAPI", "Loopback mode %d not available", uint8_param_0);
+        resp->status = API_STATUS_FAILED;
     }
 }
 
-// Called after a transaction is queued and ready for pickup by master. We use this to set the handshake line high.
-IRAM_ATTR static void spi_post_setup_cb(spi_slave_transaction_t *trans){
-    gpio_set_level(GPIO_HANDSHAKE, 1);
-}
-
-// Called after transaction is sent/received. We use this to set the handshake line low.
-IRAM_ATTR static void spi_post_trans_cb(spi_slave_transaction_t *trans){
-    gpio_set_level(GPIO_HANDSHAKE, 0);
-}
-
-void spi_start(){
-    ESP_LOGI("spi_api", "spi_start()");
-    //Configuration for the SPI bus
-    spi_bus_config_t buscfg = {
-        .mosi_io_num = GPIO_MOSI,
-        .miso_io_num = GPIO_MISO,
-        .sclk_io_num = GPIO_SCLK,
-        .quadwp_io_num = -1,
-        .quadhd_io_num = -1,
-        .data4_io_num = -1,
-        .data5_io_num = -1,
-        .data6_io_num = -1,
-        .data7_io_num = -1,
-        .data_io_default_level = false,
-        .max_transfer_sz = 2048,
-        .flags = 0,
-        .isr_cpu_id = ESP_INTR_CPU_AFFINITY_0,
-        .intr_flags = 0
-    };
-
-    //Configuration for the SPI slave interface
-    spi_slave_interface_config_t slvcfg = {
-        .spics_io_num = GPIO_CS,
-        .flags = 0,
-        .queue_size = 1,
-        .mode = 3,
-        .post_setup_cb = spi_post_setup_cb,
-        .post_trans_cb = spi_post_trans_cb
-    };
-
-    //Configuration for the handshake line
-    gpio_config_t io_conf = {
-        .pin_bit_mask = BIT64(GPIO_HANDSHAKE),
-        .mode = GPIO_MODE_OUTPUT,
-        .pull_up_en = GPIO_PULLUP_DISABLE,
-        .pull_down_en = GPIO_PULLDOWN_DISABLE,
-        .intr_type = GPIO_INTR_DISABLE,
-        .hys_ctrl_mode = GPIO_HYS_SOFT_DISABLE
-    };
-
-    //Configure handshake line as output
-    gpio_config(&io_conf);
-    gpio_set_level(GPIO_HANDSHAKE, 0);
-
-    send_buffer = (uint8_t*)spi_bus_dma_memory_alloc(RCV_HOST, 2048, 0);
-    send_buffer[0] = 0xCA;
-    send_buffer[1] = 0xFE;
-    receive_buffer = (uint8_t*)spi_bus_dma_memory_alloc(RCV_HOST, 2048, 0);
-    transaction.length = 2048 * 8;
-    transaction.tx_buffer = send_buffer;
-    transaction.rx_buffer = receive_buffer;
-
-    esp_err_t ret = spi_slave_initialize(RCV_HOST, &buscfg, &slvcfg, SPI_DMA_CH_AUTO);
-    assert(ret == ESP_OK);
-
-    xTaskCreatePinnedToCore(api_task, "spi_task", 4096 * 2, NULL, 10, &hTask, 1);
+static void handle_get_loopback_stats(const api_request_t* req, api_response_t* resp){
+    const int uint8_param_0 = req->args[0];
+    uac_loopback_stats_t stats = {0};
+    uac_device_get_loopback_stats(&stats, uint8_param_0 != 0);
+    char json[256];
+    snprintf(json, sizeof(json), "{\"mode\": %lu, \"blocks\": %lu, \"bytes\": %lu, \"underruns\": %lu, \"overruns\": %lu, "
+             "\"mismatch\": %lu, \"latency\": %lu, \"latency_max\": %lu, \"jitter_max\": %lu}",
+             (unsigned long)stats.mode, (unsigned long)stats.blocks, (unsigned long)stats.bytes,
+             (unsigned long)stats.underruns, (unsigned long)stats.overruns, (unsigned long)stats.format_mismatch,
+             (unsigned long)stats.latency_mean_us, (unsigned long)stats.latency_max_us, (unsigned long)stats.jitter_max_us);
+    ESP_LOGI("SpiAPI", "Loopback stats: %s", json);
+    api_respond(resp, json);
+}
+
+static void handle_get_mic_stream_stats(const api_request_t* req, api_response_t* resp){
+    const int uint8_param_0 = req->args[0];
+    uac_mic_stats_t stats = {0};
+    uac_device_get_mic_stats(&stats, uint8_param_0 != 0);
+    char json[256];
+    snprintf(json, sizeof(json), "{\"packets\": %lu, \"short\": %lu, \"underruns\": %lu, \"overruns\": %lu, "
+             "\"min\": %lu, \"max\": %lu, \"rate_mhz\": %lu, \"fill\": %lu, \"margin\": %lu, \"resample\": %lu, \"rs_dropped\": %lu}",
+             (unsigned long)stats.packets, (unsigned long)stats.short_packets, (unsigned long)stats.underruns,
+             (unsigned long)stats.overruns, (unsigned long)stats.frames_min, (unsigned long)stats.frames_max,
+             (unsigned long)stats.rate_mhz, (unsigned long)stats.fill_frames, (unsigned long)stats.margin_ms,
+             (unsigned long)stats.resampling, (unsigned long)stats.resampler_dropped);
+    ESP_LOGI("SpiAPI", "Mic stream stats: %s", json);
+    api_respond(resp, json);
+}
+
+static void handle_get_apll_lock_stats(const api_request_t* req, api_response_t* resp){
+    const int uint8_param_0 = req->args[0];
+    clock_lock_stats_t stats;
+    GetClockLockStats(&stats, uint8_param_0 != 0);
+    char json[192];
+    snprintf(json, sizeof(json), "{\"state\": %d, \"lock_ms\": %lu, \"offset_ppb\": %ld, \"phase_ns\": %ld, "
+             "\"jitter_rms_ns\": %lu, \"jitter_max_ns\": %lu, \"relocks\": %lu}",
+             (int)stats.state, (unsigned long)stats.lock_time_ms, (long)stats.offset_ppb, (long)stats.phase_err_ns,
+             (unsigned long)stats.jitter_rms_ns, (unsigned long)stats.jitter_max_ns, (unsigned long)stats.relocks);
+    ESP_LOGI("SpiAPI", "Clock lock stats: %s", json);
+    api_respond(resp, json);
+}
+
+static void handle_configure_input_agc(const api_request_t* req, api_response_t* resp){
+    const int uint8_param_0 = req->args[0];
+    codec_agc_cfg_t agc;
+    memcpy(&agc.target_level, &req->args[1], sizeof(agc.target_level));
+    memcpy(&agc.hysteresis, &req->args[3], sizeof(agc.hysteresis));
+    memcpy(&agc.noise_threshold, &req->args[5], sizeof(agc.noise_threshold));
+    memcpy(&agc.max_gain, &req->args[7], sizeof(agc.max_gain));
+    memcpy(&agc.attack_us, &req->args[9], sizeof(agc.attack_us));
+    memcpy(&agc.decay_us, &req->args[13], sizeof(agc.decay_us));
+    memcpy(&agc.noise_debounce_us, &req->args[17], sizeof(agc.noise_debounce_us));
+    memcpy(&agc.signal_debounce_us, &req->args[21], sizeof(agc.signal_debounce_us));
+    ESP_LOGI("SpiAPI", "ConfigureInputAgc enable 0x%x target %d max gain %u", uint8_param_0, agc.target_level, agc.max_gain);
+    SettingsSetInputAgc(&agc);
+    SettingsSetAgc(UAC_FEATURE_UNIT_MIC, 0, false);
+    SettingsSetAgc(UAC_FEATURE_UNIT_MIC, 1, uint8_param_0 & 1);
+    SettingsSetAgc(UAC_FEATURE_UNIT_MIC, 2, uint8_param_0 & 2);
+}
+
+static void handle_configure_output_drc(const api_request_t* req, api_response_t* resp){
+    const int uint8_param_0 = req->args[0];
+    codec_drc_cfg_t drc;
+    memcpy(&drc.threshold, &req->args[1], sizeof(drc.threshold));
+    memcpy(&drc.hysteresis, &req->args[3], sizeof(drc.hysteresis));
+    memcpy(&drc.hold_us, &req->args[5], sizeof(drc.hold_us));
+    memcpy(&drc.attack_us, &req->args[9], sizeof(drc.attack_us));
+    memcpy(&drc.decay_us, &req->args[13], sizeof(drc.decay_us));
+    ESP_LOGI("SpiAPI", "ConfigureOutputDrc enable 0x%x threshold %d", uint8_param_0, drc.threshold);
+    SettingsSetOutputDrc(&drc);
+    SettingsSetAgc(UAC_FEATURE_UNIT_SPK, 0, false);
+    SettingsSetAgc(UAC_FEATURE_UNIT_SPK, 1, uint8_param_0 & 1);
+    SettingsSetAgc(UAC_FEATURE_UNIT_SPK, 2, uint8_param_0 & 2);
+}
+
+static void handle_get_dynamics(const api_request_t* req, api_response_t* resp){
+    codec_dynamics_status_t dyn;
+    GetDynamicsStatus(&dyn);
+    char json[384];
+    snprintf(json, sizeof(json), "{\"agc\": {\"en\": [%d, %d], \"gain\": [%d, %d], \"target\": %d, \"hyst\": %u, \"noise\": %d, "
+             "\"max\": %u, \"attack\": %lu, \"decay\": %lu, \"noise_debounce\": %lu, \"signal_debounce\": %lu}, "
+             "\"drc\": {\"en\": [%d, %d], \"threshold\": %d, \"hyst\": %u, \"hold\": %lu, \"attack\": %lu, \"decay\": %lu}}",
+             dyn.agc_enable[0], dyn.agc_enable[1], dyn.agc_gain[0], dyn.agc_gain[1], dyn.agc.target_level,
+             dyn.agc.hysteresis, dyn.agc.noise_threshold, dyn.agc.max_gain, (unsigned long)dyn.agc.attack_us,
+             (unsigned long)dyn.agc.decay_us, (unsigned long)dyn.agc.noise_debounce_us, (unsigned long)dyn.agc.signal_debounce_us,
+             dyn.drc_enable[0], dyn.drc_enable[1], dyn.drc.threshold, dyn.drc.hysteresis, (unsigned long)dyn.drc.hold_us,
+             (unsigned long)dyn.drc.attack_us, (unsigned long)dyn.drc.decay_us);
+    ESP_LOGI("SpiAPI", "Dynamics: %s", json);
+    api_respond(resp, json);
+}
+
+static void handle_enable_input_high_pass(const api_request_t* req, api_response_t* resp){
+    const int uint8_param_0 = req->args[0];
+    ESP_LOGI("SpiAPI", "EnableInputHighPass %d", uint8_param_0);
+    SettingsSetInputHighPass(uint8_param_0 != 0);
+}
+
+#if CONFIG_UAC_TRACE
+static void handle_get_trace_dump(const api_request_t* req, api_response_t* resp){
+    ESP_LOGI("SpiAPI", "GetTraceDump");
+    stream_trace(resp);
+}
+#endif
+
+#if CONFIG_UAC_BENCHMARK
+static void handle_run_benchmark(const api_request_t* req, api_response_t* resp){
+    uint16_t iterations;
+    uint32_t seed;
+    memcpy(&iterations, &req->args[0], sizeof(iterations));
+    memcpy(&seed, &req->args[2], sizeof(seed));
+    iterations = iterations ? iterations : 200;
+    ESP_LOGI("SpiAPI", "RunBenchmark iterations %u seed %lu", iterations, (unsigned long)seed);
+    const size_t size = 3072;
+    char* json = malloc(size);
+    if (json == NULL || !RunKernelBenchmark(iterations, seed, json, size)){
+        resp->status = API_STATUS_FAILED;
+    }else{
+        api_respond(resp, json);
+    }
+    free(json);
+}
+#endif
+
+#if CONFIG_UAC_GLITCH_DETECTOR
+static void handle_get_glitch_events(const api_request_t* req, api_response_t* resp){
+    uint32_t cursor;
+    memcpy(&cursor, &req->args[0], sizeof(cursor));
+    uac_glitch_event_t events[16];
+    const size_t num = uac_glitch_read(&cursor, events, sizeof(events) / sizeof(events[0]));
+    uint32_t counts[UAC_GLITCH_TYPE_NUM][UAC_GLITCH_STREAM_NUM];
+    uac_glitch_get_counts(counts);
+    static char json[2560];
+    int n = snprintf(json, sizeof(json), "{\"next\": %lu, \"counts\": [", (unsigned long)cursor);
+    for (int t = 0; t < UAC_GLITCH_TYPE_NUM; t++){
+        n += snprintf(json + n, sizeof(json) - n, "%s[%lu, %lu]", t ? ", " : "",
+                      (unsigned long)counts[t][UAC_GLITCH_STREAM_OUT], (unsigned long)counts[t][UAC_GLITCH_STREAM_IN]);
+    }
+    n += snprintf(json + n, sizeof(json) - n, "], \"events\": [");
+    for (size_t i = 0; i < num; i++){
+        const uac_glitch_event_t* ev = &events[i];
+        n += snprintf(json + n, sizeof(json) - n,
+                      "%s{\"seq\": %lu, \"type\": %d, \"dir\": %d, \"ch\": %d, \"sof\": %lu, \"time\": %lld, \"pos\": %llu, \"value\": %ld}",
+                      i ? ", " : "", (unsigned long)ev->seq, ev->type, ev->stream, ev->channel, (unsigned long)ev->sof_frame,
+                      (long long)ev->timestamp_us, (unsigned long long)ev->sample_pos, (long)ev->value);
+    }
+    snprintf(json + n, sizeof(json) - n, "]}");
+    ESP_LOGI("SpiAPI", "GetGlitchEvents %d events, next %lu", (int)num, (unsigned long)cursor);
+    api_respond(resp, json);
+}
+#endif
+
+static void handle_reboot(const api_request_t* req, api_response_t* resp){
+    ESP_LOGI("SpiAPI", "Rebooting device!");
+    // TODO: dismount sd-card, filesystem etc!
+    SettingsFlush();
+    esp_restart();
+}
+
+static void handle_reboot_to_ota_x(const api_request_t* req, api_response_t* resp){
+    const int uint8_param_0 = req->args[0];
+    int num_ota = count_bootable_ota_partitions();
+    if (uint8_param_0 >= num_ota){
+        ESP_LOGE("SpiAPI", "Requested OTA %d but only %d OTAs available!", uint8_param_0, num_ota);
+        resp->status = API_STATUS_FAILED;
+    }else{
+        // TODO: dismount sd-card, filesystem etc!
+        boot_into_slot(uint8_param_0);
+        ESP_LOGI("SpiAPI", "Rebooting device to OTA %d!", uint8_param_0);
+    }
+}
+
+static const api_command_t commands[] = {
+    {Reboot, API_QUICK, handle_reboot},
+    {GetFirmwareInfo, API_QUICK, handle_get_firmware_info},
+    {RebootToOTAX, API_QUICK, handle_reboot_to_ota_x},
+    {GetLatency, API_QUICK, handle_get_latency},
+    {SetCodecLatencyMode, API_QUICK, handle_set_codec_latency_mode},
+    {SelectMonitorMode, API_QUICK, handle_select_monitor_mode},
+    {SetInputMonitorLevel, API_QUICK, handle_set_input_monitor_level},
+    {SetTdmSlotMap, API_QUICK, handle_set_tdm_slot_map},
+#if CONFIG_UAC_FLIGHT_RECORDER
+    {TriggerRecorder, API_QUICK, handle_trigger_recorder},
+    {RearmRecorder, API_QUICK, handle_rearm_recorder},
+    {GetRecorderInfo, API_QUICK, handle_get_recorder_info},
+    {ReadRecorder, API_BULK, handle_read_recorder},
+#endif
+#if CONFIG_UAC_GLITCH_DETECTOR
+    {GetGlitchEvents, API_QUICK, handle_get_glitch_events},
+#endif
+#if CONFIG_UAC_TRACE
+    {GetTraceDump, API_BULK, handle_get_trace_dump},
+#endif
+#if CONFIG_UAC_BENCHMARK
+    {RunBenchmark, API_BULK, handle_run_benchmark},
+#endif
+    {GetTaskLatency, API_QUICK, handle_get_task_latency},
+    {MeasureLatency, API_BULK, handle_measure_latency},
+    {SetUsbLoopback, API_QUICK, handle_set_usb_loopback},
+    {GetLoopbackStats, API_QUICK, handle_get_loopback_stats},
+    {GetMicStreamStats, API_QUICK, handle_get_mic_stream_stats},
+    {GetApllLockStats, API_QUICK, handle_get_apll_lock_stats},
+    {ConfigureInputAgc, API_QUICK, handle_configure_input_agc},
+    {ConfigureOutputDrc, API_QUICK, handle_configure_output_drc},
+    {GetDynamics, API_QUICK, handle_get_dynamics},
+    {EnableInputHighPass, API_QUICK, handle_enable_input_high_pass},
+};
+
+const api_command_t* api_find_command(uint8_t type){
+    for (size_t i = 0; i < sizeof(commands) / sizeof(commands[0]); i++){
+        if (commands[i].type == type) return &commands[i];
+    }
+    return NULL;
 }
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// shared by the request handlers in spi_api.c and the transport in spi_api_transport.c
+
+typedef enum{
+    Poll = 0x00, // tagged frames only, no request, clocks out the next response frame
+    Reboot = 0x13, // reboots the device
+    GetFirmwareInfo = 0x19, // returns json {"HWV": hardware version, "FWV": firmware version, "OTA": active ota partition}
+    RebootToOTAX = 0x22, // reboots the device to OTAX, args [X (uint8_t)]
+    GetLatency = 0x30, // returns json {"OUT": playback latency in ns, "IN": capture latency in ns}
+    SetCodecLatencyMode = 0x31, // selects codec processing blocks, args [DAC mode (uint8_t), ADC mode (uint8_t)], 0 standard, 1 low latency, kept in NVS
+    SelectMonitorMode = 0x32, // selects the direct monitor path, args [mode (uint8_t)], 0 off, 1 codec analog, 2 firmware mix
+    SetInputMonitorLevel = 0x33, // sets the monitor level of an input, args [input channel (uint8_t), gain in dB (int8_t, <= 0, -128 silence), pan (int8_t, -100 .. 100)]
+    SetTdmSlotMap = 0x34, // maps USB channels to TDM slots, args [direction (uint8_t, 0 out, 1 in), channels (uint8_t), slot of each channel (uint8_t)...]
+    TriggerRecorder = 0x35, // freezes the flight recorder, args [reason (uint8_t)]
+    RearmRecorder = 0x36, // discards the frozen recording and records again
+    GetRecorderInfo = 0x37, // returns json {"frozen": 0/1, "reason", "time": us, "OUT"/"IN": {"rate", "ch", "bits", "bytes", "pos", "lost"}}
+    ReadRecorder = 0x38, // returns raw recorded PCM, args [stream (uint8_t, 0 out, 1 in), offset (uint32_t), length (uint32_t)]
+    GetGlitchEvents = 0x39, // returns json {"next": cursor, "counts": [[out, in] per type], "events": [{"seq", "type", "dir", "ch", "sof", "time", "pos", "value"}...]}, args [cursor (uint32_t)]
+    GetTraceDump = 0x3A, // returns the binary hot path trace dump, see uac_trace_dump_header_t and tools/uac_trace_to_perfetto.py
+    GetTaskLatency = 0x3B, // returns json {"TinyUSB"/"spk"/"mic": {"wakeups", "mean", "max", "late"}} in us, args [reset (uint8_t)]
+    MeasureLatency = 0x3C, // runs the latency probe, args [marker (uint8_t, 0 impulse, 1 codec beep), loop (uint8_t, 0 analog cable, 1 codec digital)], returns json {"ok": 0/1, "out", "loop", "in" in frames (-1 stream not running), "loop_us", "peak", "dac_gd", "adc_gd" in frames, "OUT", "IN": reported latency in ns}
+    SetUsbLoopback = 0x3D, // returns the USB OUT stream on USB IN without the codec, args [mode (uint8_t), 0 off, 1 on, 2 CRC32 tag per ms]
+    GetLoopbackStats = 0x3E, // returns json {"mode", "blocks", "bytes", "underruns", "overruns", "mismatch", "latency": mean us, "latency_max": us, "jitter_max": us}, args [reset (uint8_t)]
+    GetMicStreamStats = 0x3F, // returns json {"packets", "short", "underruns", "overruns", "min", "max": frames per packet, "rate_mhz", "fill": frames, "margin": ms, "resample", "rs_dropped": frames}, args [reset (uint8_t)]
+    GetApllLockStats = 0x40, // returns json {"state": 0 off 1 no SOF 2 acquiring 3 locked, "lock_ms", "offset_ppb", "phase_ns", "jitter_rms_ns", "jitter_max_ns", "relocks"}, args [reset (uint8_t)]
+    ConfigureInputAgc = 0x41, // configures the ADC AGC, args [enable (uint8_t, bit 0 left, bit 1 right), target (int16_t), hysteresis (uint16_t), noise threshold (int16_t, 0 off), max gain (uint16_t) in 1/256 dB, attack, decay, noise debounce, signal debounce (uint32_t) in us], kept in NVS
+    ConfigureOutputDrc = 0x42, // configures the DAC DRC, args [enable (uint8_t, bit 0 left, bit 1 right), threshold (int16_t), hysteresis (uint16_t) in 1/256 dB, hold, attack, decay (uint32_t) in us], kept in NVS
+    GetDynamics = 0x43, // returns json {"agc": {"en": [l, r], "gain": [l, r], "target", "hyst", "noise", "max", "attack", "decay", "noise_debounce", "signal_debounce"}, "drc": {"en": [l, r], "threshold", "hyst", "hold", "attack", "decay"}}, levels in 1/256 dB, times in us
+    EnableInputHighPass = 0x44, // switches the 3.7 Hz DC blocking filter of the ADC path, args [enable (uint8_t)], kept in NVS
+    RunBenchmark = 0x45, // times the audio kernels, args [iterations (uint16_t, 0 for 200), seed (uint32_t)], returns json {"cpu_mhz", "iterations", "seed", "kernels": {name: {"frames", "bytes", "ns_per_frame", "ns_per_frame_mean", "bytes_per_s"}...}}
+} RequestType;
+
+/* Every transaction is SPI_FRAME_SIZE bytes in both directions and starts with 0xCA and a framing byte.
+ *
+ * 0xCA 0xFE, legacy: the master sends [request type, args...] and clocks out the response right away, one frame
+ * [0xCA 0xFE, request type, remaining length (uint32_t), data] per transaction, each acknowledged by echoing the
+ * request type. Requests without a response send nothing back.
+ *
+ * 0xCA 0xFD, tagged: the master sends [request type, request id (uint16_t), args...] and goes on with further
+ * requests or Poll. Requests run on a worker by class, every tagged request is answered when it is done, at least
+ * one frame [0xCA 0xFD, request type, request id, status, total length (uint32_t), offset (uint32_t), data].
+ * Each transaction clocks out the next frame, quick responses go ahead of bulk transfers; a Poll frame with id 0
+ * means nothing is ready. A frame counts as delivered once the master sent a complete tagged frame in return.
+ */
+#define SPI_FRAME_SIZE 2048
+#define SPI_LEGACY 0xFE
+#define SPI_TAGGED 0xFD
+#define LEGACY_HEADER_SIZE 7
+#define TAGGED_HEADER_SIZE 14
+#define LEGACY_ARGS_OFFSET 3
+#define TAGGED_ARGS_OFFSET 5
+#define API_MAX_ARGS 64         // the longest request, ConfigureInputAgc, has 25 bytes of arguments
+#define API_QUEUE_LEN 8         // tagged requests of a class between acceptance and the last frame of the response
+#define API_STATUS_LEN 8        // room for status only responses on top of the quick responses
+
+typedef enum{
+    API_STATUS_OK = 0,
+    API_STATUS_UNKNOWN = 1,     // request type not supported by this build
+    API_STATUS_BUSY = 2,        // API_QUEUE_LEN responses of the class were pending, the request was dropped
+    API_STATUS_FAILED = 3,
+} api_status_t;
+
+typedef enum{
+    API_QUICK = 0,              // queries and settings
+    API_BULK = 1,               // blocking measurements and downloads, at a lower priority
+    API_CLASS_NUM,
+} api_class_t;
+
+typedef struct{
+    uint8_t type;
+    bool tagged;
+    uint16_t id;
+    uint8_t args[API_MAX_ARGS]; // from the byte after the request type, or after the id of tagged requests
+} api_request_t;
+
+typedef struct api_response{
+    uint8_t type;
+    uint16_t id;
+    api_status_t status;
+    uint32_t len;
+    uint32_t offset;            // bytes delivered
+    uint8_t* data;              // NULL for streams
+    // streams pull every frame from their source while it is sent, done runs when the response is released
+    size_t (*read)(const struct api_response* resp, uint8_t* dst, size_t len);
+    void (*done)(void);
+    uint32_t stream;
+    uint32_t stream_offset;
+    api_class_t cls;
+    bool slot;                  // holds a response slot of cls until released
+} api_response_t;
+
+typedef void (*api_handler_t)(const api_request_t* req, api_response_t* resp);
+
+typedef struct{
+    RequestType type;
+    api_class_t cls;
+    api_handler_t handler;
+} api_command_t;
+
+// the command of a request type, NULL if this build does not handle it
+const api_command_t* api_find_command(uint8_t type);
+// copies a string response, an empty string sends none
+void api_respond(api_response_t* resp, const char* str);
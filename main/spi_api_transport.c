@@ -0,0 +1,319 @@
+#include "spi_api.h"
+#include "spi_api_priv.h"
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "driver/spi_slave.h"
+#include "driver/gpio.h"
+#include "esp_err.h"
+#include "esp_log.h"
+#include "uac_trace.h"
+#include "uac_mem.h"
+#include "uac_rt_profile.h"
+
+// the frame transport and the request workers, the handlers are in spi_api.c
+
+static TaskHandle_t hTask;
+static spi_slave_transaction_t transaction;
+static uint8_t *send_buffer, *receive_buffer;
+
+#define RCV_HOST    SPI3_HOST // SPI2 connects to rp2350 spi1
+#define GPIO_HANDSHAKE GPIO_NUM_50 // GPIO50 is used for handshake line, P4_PICO_02 which is GPIO18 on rp2350
+#define GPIO_MOSI GPIO_NUM_23
+#define GPIO_MISO GPIO_NUM_22
+#define GPIO_SCLK GPIO_NUM_21
+#define GPIO_CS GPIO_NUM_20
+
+/* A tagged request is only accepted with one of the API_QUEUE_LEN response slots of its class, so the ready queue
+ * always has room and the workers never wait for the master. The transport in turn never waits for a worker
+ * queue, the request queue has one more entry for the single legacy request in progress. */
+static QueueHandle_t request_queue[API_CLASS_NUM];     // api_request_t, to the workers
+static QueueHandle_t ready_queue[API_CLASS_NUM];       // api_response_t*, tagged responses to the transport
+static QueueHandle_t legacy_queue;                     // api_response_t*, the response a legacy request waits for
+static SemaphoreHandle_t response_slots[API_CLASS_NUM];
+static uint32_t status_dropped;                        // status only responses lost to a full quick queue
+static api_response_t* sending[API_CLASS_NUM];         // response whose frames are being sent, per class
+static api_response_t* in_flight;                      // response of the frame on MISO
+static size_t in_flight_len;
+
+static void release_response(api_response_t* resp){
+    if (resp->slot) xSemaphoreGive(response_slots[resp->cls]);
+    if (resp->done) resp->done();
+    free(resp->data);
+    free(resp);
+}
+
+void api_respond(api_response_t* resp, const char* str){
+    const size_t len = strlen(str);
+    if (len == 0) return;
+    resp->data = malloc(len);
+    if (resp->data == NULL){
+        resp->status = API_STATUS_FAILED;
+        return;
+    }
+    memcpy(resp->data, str, len);
+    resp->len = len;
+}
+
+// bytes at the current offset, a stream that ends early truncates the response and marks it failed
+static size_t read_response(api_response_t* resp, uint8_t* dst, size_t max){
+    const uint32_t left = resp->len - resp->offset;
+    const size_t len = left < max ? left : max;
+    if (len == 0) return 0;
+    if (resp->data){
+        memcpy(dst, resp->data + resp->offset, len);
+        return len;
+    }
+    const size_t n = resp->read(resp, dst, len);
+    if (n < len){
+        resp->len = resp->offset + n;
+        resp->status = API_STATUS_FAILED;
+    }
+    return n;
+}
+
+// one per class, requests of a class run in order
+static void worker_task(void* pvParameters){
+    const api_class_t cls = (api_class_t)(uintptr_t)pvParameters;
+    api_request_t req;
+    while (1){
+        xQueueReceive(request_queue[cls], &req, portMAX_DELAY);
+        api_response_t* resp = calloc(1, sizeof(api_response_t));
+        if (resp == NULL){
+            ESP_LOGE("SpiAPI", "No memory for the response to request type %d", req.type);
+            if (req.tagged) xSemaphoreGive(response_slots[cls]);
+        }else{
+            resp->type = req.type;
+            resp->id = req.id;
+            resp->cls = cls;
+            resp->slot = req.tagged;
+            UAC_TRACE_BEGIN(UAC_TRACE_SPI_API, req.type);
+            api_find_command(req.type)->handler(&req, resp);
+            UAC_TRACE_END(UAC_TRACE_SPI_API, req.type);
+        }
+        // a legacy master waits for every response, NULL included. Both queues have room, see response_slots
+        if (req.tagged){
+            if (resp && xQueueSend(ready_queue[cls], &resp, 0) != pdTRUE) release_response(resp);
+        }else{
+            xQueueSend(legacy_queue, &resp, 0);
+        }
+    }
+}
+
+// status only responses are generated by the transport, e.g. for an unknown request. They take the quick queue
+// entries past the API_QUEUE_LEN slots, a master that keeps sending without reading loses them and times out
+static void post_status(const api_request_t* req, api_status_t status){
+    api_response_t* resp = calloc(1, sizeof(api_response_t));
+    if (resp != NULL){
+        resp->type = req->type;
+        resp->id = req->id;
+        resp->status = status;
+        if (xQueueSend(ready_queue[API_QUICK], &resp, 0) == pdTRUE) return;
+        free(resp);
+    }
+    status_dropped++;
+    ESP_LOGW("SpiAPI", "Status %d of request type %d, id %d dropped, %lu in total", status, req->type, req->id,
+             (unsigned long)status_dropped);
+}
+
+static void dispatch_tagged(const api_request_t* req){
+    const api_command_t* cmd = api_find_command(req->type);
+    if (cmd == NULL){
+        ESP_LOGE("SpiAPI", "Unknown request type %d, id %d", req->type, req->id);
+        post_status(req, API_STATUS_UNKNOWN);
+    }else if (xSemaphoreTake(response_slots[cmd->cls], 0) != pdTRUE){
+        ESP_LOGW("SpiAPI", "Request type %d, id %d dropped, queue full", req->type, req->id);
+        post_status(req, API_STATUS_BUSY);
+    }else{
+        xQueueSend(request_queue[cmd->cls], req, 0);
+    }
+}
+
+// the frame on MISO for the next transaction: a frame of the oldest quick response, otherwise one of the oldest bulk
+// response, so quick queries are answered in between the frames of a download
+static void prepare_tagged_frame(){
+    in_flight = NULL;
+    in_flight_len = 0;
+    for (int cls = 0; cls < API_CLASS_NUM && in_flight == NULL; cls++){
+        if (sending[cls] == NULL) xQueueReceive(ready_queue[cls], &sending[cls], 0);
+        in_flight = sending[cls];
+    }
+    memset(send_buffer + 2, 0, TAGGED_HEADER_SIZE - 2);     // Poll, id 0: nothing ready
+    send_buffer[1] = SPI_TAGGED;
+    if (in_flight == NULL) return;
+    in_flight_len = read_response(in_flight, send_buffer + TAGGED_HEADER_SIZE, SPI_FRAME_SIZE - TAGGED_HEADER_SIZE);
+    send_buffer[2] = in_flight->type;
+    memcpy(send_buffer + 3, &in_flight->id, sizeof(in_flight->id));
+    send_buffer[5] = in_flight->status;
+    memcpy(send_buffer + 6, &in_flight->len, sizeof(in_flight->len));
+    memcpy(send_buffer + 10, &in_flight->offset, sizeof(in_flight->offset));
+}
+
+// the master clocked the frame out in a complete tagged transaction, the next one carries the following frame
+static void tagged_frame_delivered(){
+    if (in_flight == NULL) return;
+    in_flight->offset += in_flight_len;
+    if (in_flight->offset >= in_flight->len){
+        for (int cls = 0; cls < API_CLASS_NUM; cls++){
+            if (sending[cls] == in_flight) sending[cls] = NULL;
+        }
+        release_response(in_flight);
+    }
+    in_flight = NULL;
+}
+
+// the master reads the response right after the request and echoes the request type for every frame. False if it
+// sent something else, receive_buffer then holds its next request
+static bool send_legacy(api_response_t* resp){
+    send_buffer[1] = SPI_LEGACY;
+    send_buffer[2] = resp->type;
+    while (resp->offset < resp->len){
+        const uint32_t remaining = resp->len - resp->offset;
+        memcpy(send_buffer + 3, &remaining, sizeof(remaining));
+        const size_t n = read_response(resp, send_buffer + LEGACY_HEADER_SIZE, SPI_FRAME_SIZE - LEGACY_HEADER_SIZE);
+        if (n == 0) break;
+        resp->offset += n;
+        spi_slave_transmit(RCV_HOST, &transaction, portMAX_DELAY);
+        if (receive_buffer[0] != 0xCA || receive_buffer[1] != SPI_LEGACY || receive_buffer[2] != resp->type){
+            return false;
+        }
+    }
+    return true;
+}
+
+// legacy requests hold the transport until their response is sent, as the master expects
+static bool run_legacy(const api_request_t* req){
+    in_flight = NULL;
+    const api_command_t* cmd = api_find_command(req->type);
+    if (cmd == NULL){
+        ESP_LOGE("SpiAPI", "Unknown request type %d", req->type);
+        return true;
+    }
+    xQueueSend(request_queue[cmd->cls], req, 0);
+    // the worker never blocks, this only waits for the handlers of the requests ahead and this one
+    api_response_t* resp = NULL;
+    xQueueReceive(legacy_queue, &resp, portMAX_DELAY);
+    if (resp == NULL) return true;
+    const bool ok = send_legacy(resp);
+    release_response(resp);
+    return ok;
+}
+
+// the transport only moves frames, the transaction is re-armed right after each request is queued
+static void api_task(void* pvParameters){
+    bool pending = false;       // receive_buffer holds a request the legacy response did not consume
+    ESP_LOGI("spi_api", "api_task()");
+    while (1){
+        if (!pending){
+            prepare_tagged_frame();
+            spi_slave_transmit(RCV_HOST, &transaction, portMAX_DELAY);
+            // check integrity of transaction
+            if (transaction.trans_len != SPI_FRAME_SIZE * 8){
+                ESP_LOGE("spiapi", "Received transaction length %u, expected 2048 * 8", (unsigned)transaction.trans_len);
+                continue;
+            }
+        }
+        pending = false;
+        const uint8_t* rcv_data = receive_buffer;
+        if (rcv_data[0] != 0xCA || (rcv_data[1] != SPI_LEGACY && rcv_data[1] != SPI_TAGGED)){
+            ESP_LOGE("spiapi", "Received data %x %x, expected 0xCA 0xFE or 0xCA 0xFD", rcv_data[0], rcv_data[1]);
+            continue;
+        }
+
+        // the arguments are copied, the receive buffer is reused by the next transaction
+        api_request_t req = {.type = rcv_data[2], .tagged = rcv_data[1] == SPI_TAGGED};
+        if (req.tagged){
+            tagged_frame_delivered();
+            memcpy(&req.id, &rcv_data[3], sizeof(req.id));
+            memcpy(req.args, &rcv_data[TAGGED_ARGS_OFFSET], API_MAX_ARGS);
+            if (req.type != Poll) dispatch_tagged(&req);
+        }else{
+            memcpy(req.args, &rcv_data[LEGACY_ARGS_OFFSET], API_MAX_ARGS);
+            pending = !run_legacy(&req);
+        }
+    }
+}
+
+// Called after a transaction is queued and ready for pickup by master. We use this to set the handshake line high.
+IRAM_ATTR static void spi_post_setup_cb(spi_slave_transaction_t *trans){
+    gpio_set_level(GPIO_HANDSHAKE, 1);
+}
+
+// Called after transaction is sent/received. We use this to set the handshake line low.
+IRAM_ATTR static void spi_post_trans_cb(spi_slave_transaction_t *trans){
+    gpio_set_level(GPIO_HANDSHAKE, 0);
+}
+
+void spi_start(){
+    ESP_LOGI("spi_api", "spi_start()");
+    //Configuration for the SPI bus
+    spi_bus_config_t buscfg = {
+        .mosi_io_num = GPIO_MOSI,
+        .miso_io_num = GPIO_MISO,
+        .sclk_io_num = GPIO_SCLK,
+        .quadwp_io_num = -1,
+        .quadhd_io_num = -1,
+        .data4_io_num = -1,
+        .data5_io_num = -1,
+        .data6_io_num = -1,
+        .data7_io_num = -1,
+        .data_io_default_level = false,
+        .max_transfer_sz = SPI_FRAME_SIZE,
+        .flags = 0,
+        // transaction interrupts stay off the audio core
+        .isr_cpu_id = ESP_INTR_CPU_CORE_ID_TO_AFFINITY(UAC_RT_CONTROL_CORE),
+        .intr_flags = 0
+    };
+
+    //Configuration for the SPI slave interface
+    spi_slave_interface_config_t slvcfg = {
+        .spics_io_num = GPIO_CS,
+        .flags = 0,
+        .queue_size = 1,
+        .mode = 3,
+        .post_setup_cb = spi_post_setup_cb,
+        .post_trans_cb = spi_post_trans_cb
+    };
+
+    //Configuration for the handshake line
+    gpio_config_t io_conf = {
+        .pin_bit_mask = BIT64(GPIO_HANDSHAKE),
+        .mode = GPIO_MODE_OUTPUT,
+        .pull_up_en = GPIO_PULLUP_DISABLE,
+        .pull_down_en = GPIO_PULLDOWN_DISABLE,
+        .intr_type = GPIO_INTR_DISABLE,
+        .hys_ctrl_mode = GPIO_HYS_SOFT_DISABLE
+    };
+
+    //Configure handshake line as output
+    gpio_config(&io_conf);
+    gpio_set_level(GPIO_HANDSHAKE, 0);
+
+    send_buffer = (uint8_t*)spi_bus_dma_memory_alloc(RCV_HOST, SPI_FRAME_SIZE, 0);
+    send_buffer[0] = 0xCA;
+    send_buffer[1] = SPI_TAGGED;
+    receive_buffer = (uint8_t*)spi_bus_dma_memory_alloc(RCV_HOST, SPI_FRAME_SIZE, 0);
+    uac_mem_note("spi send", send_buffer, SPI_FRAME_SIZE);
+    uac_mem_note("spi receive", receive_buffer, SPI_FRAME_SIZE);
+    transaction.length = SPI_FRAME_SIZE * 8;
+    transaction.tx_buffer = send_buffer;
+    transaction.rx_buffer = receive_buffer;
+
+    ESP_ERROR_CHECK(spi_slave_initialize(RCV_HOST, &buscfg, &slvcfg, SPI_DMA_CH_AUTO));
+
+    for (int cls = 0; cls < API_CLASS_NUM; cls++){
+        request_queue[cls] = xQueueCreate(API_QUEUE_LEN + 1, sizeof(api_request_t));
+        ready_queue[cls] = xQueueCreate(API_QUEUE_LEN + (cls == API_QUICK ? API_STATUS_LEN : 0), sizeof(api_response_t*));
+        response_slots[cls] = xSemaphoreCreateCounting(API_QUEUE_LEN, API_QUEUE_LEN);
+    }
+    legacy_queue = xQueueCreate(1, sizeof(api_response_t*));
+
+    // with the RT profile below every audio task and on the other core, a long request can not delay audio.
+    // Bulk requests run in the background, the transport and quick requests preempt them
+    xTaskCreatePinnedToCore(api_task, "spi_task", 4096, NULL, UAC_CONTROL_TASK_PRIORITY, &hTask, UAC_CONTROL_TASK_CORE);
+    xTaskCreatePinnedToCore(worker_task, "spi_quick", 4096 * 2, (void*)API_QUICK, UAC_CONTROL_TASK_PRIORITY, NULL, UAC_CONTROL_TASK_CORE);
+    xTaskCreatePinnedToCore(worker_task, "spi_bulk", 4096 * 2, (void*)API_BULK, UAC_BACKGROUND_TASK_PRIORITY, NULL, UAC_CONTROL_TASK_CORE);
+}
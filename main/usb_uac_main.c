@@ -10,17 +10,20 @@
 #include "esp_err.h"
 #include "esp_log.h"
 #include "usb_device_uac.h"
+#include "uac_mem.h"
 #include "codec.h"
 #include "spi_api.h"
+#include "settings.h"
 
 static const char *TAG = "usb_uac_main";
 
-static esp_err_t uac_device_output_cb(uint8_t *buf, size_t len, void *arg)
+static esp_err_t uac_device_output_block_cb(const uac_block_t *block, void *arg)
 {
     uint32_t bytes_written = 0;
-    //ESP_LOGI(TAG, "uac_device_output_cb: %"PRIu32"", len);
     //bsp_extra_i2s_write(buf, len, &bytes_written, 0);
-    i2s_write(buf, len, &bytes_written);
+    // the latency probe measures from the moment the block arrived over USB
+    LatencyProbeOutputBlock(block->timestamp_us);
+    i2s_write(block->data, block->frames * block->format->bytes_per_frame, &bytes_written);
     return ESP_OK;
 }
 
@@ -38,32 +41,60 @@ static esp_err_t uac_device_input_cb(uint8_t *buf, size_t len, size_t *bytes_rea
     return ESP_OK;
 }
 
-static void uac_device_set_mute_cb(uint32_t mute, void *arg)
+static void uac_device_set_monitor_cb(uint8_t in_ch, uint8_t out_ch, int16_t gain, void *arg)
 {
-    ESP_LOGI(TAG, "uac_device_set_mute_cb: %"PRIu32"", mute);
-    SetMute(mute, mute);
+    ESP_LOGI(TAG, "uac_device_set_monitor_cb: in %d out %d gain %d", in_ch, out_ch, gain);
+    SetMonitorGain(in_ch, out_ch, gain);
 }
 
-static void uac_device_set_volume_cb(uint32_t volume, void *arg)
+// the settings keep the master and channel controls of each unit and hand the sum to the codec
+static void uac_device_set_fu_mute_cb(uac_feature_unit_t unit, uint8_t channel, bool mute, void *arg)
 {
-    ESP_LOGI(TAG, "uac_device_set_volume_cb: %"PRIu32"", volume);
-    SetOutputLevels(volume, volume);
+    ESP_LOGI(TAG, "uac_device_set_fu_mute_cb: unit %d channel %d %d", unit, channel, mute);
+    SettingsSetMute(unit, channel, mute);
+}
+
+static void uac_device_set_fu_volume_cb(uac_feature_unit_t unit, uint8_t channel, int16_t volume, void *arg)
+{
+    ESP_LOGI(TAG, "uac_device_set_fu_volume_cb: unit %d channel %d %d/256 dB", unit, channel, volume);
+    SettingsSetVolume(unit, channel, volume);
+}
+
+// the speaker AGC control switches the DAC DRC, the microphone one the ADC AGC
+static void uac_device_set_agc_cb(uac_feature_unit_t unit, uint8_t channel, bool enable, void *arg)
+{
+    ESP_LOGI(TAG, "uac_device_set_agc_cb: unit %d channel %d %d", unit, channel, enable);
+    SettingsSetAgc(unit, channel, enable);
 }
 
 void app_main(void)
 {
+    // the stored volumes, mutes and filters go out with the codec configuration
+    SettingsInit();
     InitCodec();
     //bsp_extra_codec_set_fs(CONFIG_UAC_SAMPLE_RATE, 16, CONFIG_UAC_SPEAKER_CHANNEL_NUM);
 
     uac_device_config_t config = {
-        .output_cb = uac_device_output_cb,
+        .output_block_cb = uac_device_output_block_cb,
         .input_cb = uac_device_input_cb,
-        .set_mute_cb = uac_device_set_mute_cb,
-        .set_volume_cb = uac_device_set_volume_cb,
+        .set_monitor_cb = uac_device_set_monitor_cb,
+        .set_agc_cb = uac_device_set_agc_cb,
+        .set_fu_mute_cb = uac_device_set_fu_mute_cb,
+        .set_fu_volume_cb = uac_device_set_fu_volume_cb,
+        .spk_volume_range = { .min = -127 * 128, .max = 0, .res = 128 },   // DAC volume -63.5 .. 0dB
+        .mic_volume_range = { .min = 0, .max = 95 * 128, .res = 128 },     // MicPGA 0 .. 47.5dB
         .cb_ctx = NULL,
     };
 
     uac_device_init(&config);
+    SettingsSyncHost();
+
+    uint32_t output_latency = 0, input_latency = 0;
+    GetCodecLatency(&output_latency, &input_latency);
+    uac_device_set_path_latency(output_latency, input_latency);
 
     spi_start();
+
+    // where the hot buffers and task stacks ended up
+    uac_mem_report();
 }
@@ -0,0 +1,30 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * The kernel benchmark of RunBenchmark on the host: the pcm_ops kernels, the ring copies and the capture
+ * resampler, with the same JSON report as on the target. The TinyUSB FIFO case is left out and cpu_mhz is 1000,
+ * a "cycle" is a ns of the host clock. Compare two reports with tools/spi_api_master.py compare OLD NEW.
+ *
+ * Usage: uac_bench_host [iterations, default 200] [seed, default 1]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "pcm_bench.h"
+
+int main(int argc, char **argv)
+{
+    const uint32_t iterations = argc > 1 ? (uint32_t)strtoul(argv[1], NULL, 0) : 200;
+    const uint32_t seed = argc > 2 ? (uint32_t)strtoul(argv[2], NULL, 0) : 1;
+    static char json[4096];
+    if (!RunKernelBenchmark(iterations, seed, json, sizeof(json))) {
+        fprintf(stderr, "benchmark failed\n");
+        return 1;
+    }
+    printf("%s\n", json);
+    return 0;
+}
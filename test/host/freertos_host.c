@@ -0,0 +1,175 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * The FreeRTOS queues and tasks the host built modules use, on POSIX threads. Ticks are milliseconds,
+ * priorities and cores are ignored.
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+
+struct host_queue {
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    UBaseType_t length;
+    UBaseType_t item_size;      // 0 for semaphores
+    UBaseType_t count;
+    UBaseType_t head;
+    uint8_t items[];
+};
+
+typedef struct {
+    TaskFunction_t fn;
+    void *arg;
+} host_task_t;
+
+static void deadline_after(struct timespec *ts, TickType_t ticks)
+{
+    clock_gettime(CLOCK_REALTIME, ts);
+    ts->tv_sec += ticks / 1000;
+    ts->tv_nsec += (long)(ticks % 1000) * 1000000;
+    if (ts->tv_nsec >= 1000000000) {
+        ts->tv_sec++;
+        ts->tv_nsec -= 1000000000;
+    }
+}
+
+// waits with the lock held until ready() holds or the ticks passed, false on timeout
+static bool wait_until(QueueHandle_t q, bool (*ready)(QueueHandle_t), TickType_t ticks)
+{
+    struct timespec deadline;
+    deadline_after(&deadline, ticks == portMAX_DELAY ? 0 : ticks);
+    while (!ready(q)) {
+        if (ticks == 0) {
+            return false;
+        }
+        if (ticks == portMAX_DELAY) {
+            pthread_cond_wait(&q->changed, &q->lock);
+        } else if (pthread_cond_timedwait(&q->changed, &q->lock, &deadline) == ETIMEDOUT) {
+            return ready(q);
+        }
+    }
+    return true;
+}
+
+static bool has_room(QueueHandle_t q)
+{
+    return q->count < q->length;
+}
+
+static bool has_item(QueueHandle_t q)
+{
+    return q->count > 0;
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size)
+{
+    QueueHandle_t q = calloc(1, sizeof(*q) + (size_t)length * item_size);
+    if (q == NULL) {
+        return NULL;
+    }
+    pthread_mutex_init(&q->lock, NULL);
+    pthread_cond_init(&q->changed, NULL);
+    q->length = length;
+    q->item_size = item_size;
+    return q;
+}
+
+BaseType_t xQueueSend(QueueHandle_t q, const void *item, TickType_t ticks)
+{
+    pthread_mutex_lock(&q->lock);
+    const bool ok = wait_until(q, has_room, ticks);
+    if (ok) {
+        if (q->item_size) {
+            memcpy(q->items + (size_t)((q->head + q->count) % q->length) * q->item_size, item, q->item_size);
+        }
+        q->count++;
+        pthread_cond_broadcast(&q->changed);
+    }
+    pthread_mutex_unlock(&q->lock);
+    return ok ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t q, void *item, TickType_t ticks)
+{
+    pthread_mutex_lock(&q->lock);
+    const bool ok = wait_until(q, has_item, ticks);
+    if (ok) {
+        if (q->item_size) {
+            memcpy(item, q->items + (size_t)q->head * q->item_size, q->item_size);
+        }
+        q->head = (q->head + 1) % q->length;
+        q->count--;
+        pthread_cond_broadcast(&q->changed);
+    }
+    pthread_mutex_unlock(&q->lock);
+    return ok ? pdTRUE : pdFALSE;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t q)
+{
+    pthread_mutex_lock(&q->lock);
+    const UBaseType_t count = q->count;
+    pthread_mutex_unlock(&q->lock);
+    return count;
+}
+
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max, UBaseType_t initial)
+{
+    QueueHandle_t q = xQueueCreate(max, 0);
+    if (q != NULL) {
+        q->count = initial;
+    }
+    return q;
+}
+
+static void *task_entry(void *arg)
+{
+    host_task_t task = *(host_task_t *)arg;
+    free(arg);
+    task.fn(task.arg);
+    return NULL;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t stack_size, void *arg,
+                                   UBaseType_t priority, TaskHandle_t *handle, BaseType_t core)
+{
+    (void)name;
+    (void)stack_size;
+    (void)priority;
+    (void)core;
+    host_task_t *task = malloc(sizeof(host_task_t));
+    pthread_t thread;
+    if (task == NULL) {
+        return pdFALSE;
+    }
+    task->fn = fn;
+    task->arg = arg;
+    if (pthread_create(&thread, NULL, task_entry, task) != 0) {
+        free(task);
+        return pdFALSE;
+    }
+    pthread_detach(thread);
+    if (handle) {
+        *handle = (TaskHandle_t)thread;
+    }
+    return pdPASS;
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    usleep(ticks * 1000);
+}
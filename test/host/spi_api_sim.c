@@ -0,0 +1,254 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * The SPI API transport of main/spi_api_transport.c on the host, behind a simulated SPI slave and handshake
+ * GPIO, with canned handlers in place of the codec and USB ones. tools/spi_api_master.py --sim runs it and
+ * plays the master over stdin and stdout, one record per transaction:
+ *
+ *   master: length (uint16_t, 1 .. 2048), MOSI bytes
+ *   sim:    1 and the MISO bytes, or 0 if the handshake stayed low for the timeout
+ *
+ * Usage: spi_api_sim [handshake timeout in ms, default 2000]
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "driver/gpio.h"
+#include "driver/spi_slave.h"
+#include "spi_api.h"
+#include "spi_api_priv.h"
+#include "uac_mem.h"
+
+#define SIM_MAX_STREAM  (1024 * 1024)
+
+static pthread_mutex_t bus_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t bus_changed = PTHREAD_COND_INITIALIZER;
+static spi_slave_interface_config_t slave_config;
+static spi_slave_transaction_t *armed;      // the transaction the slave waits in, NULL once the master clocked it
+static int handshake_gpio = -1;             // the output gpio_config set up
+static uint32_t gpio_level[GPIO_NUM_MAX];
+
+esp_err_t gpio_config(const gpio_config_t *config)
+{
+    if (config->mode == GPIO_MODE_OUTPUT && config->pin_bit_mask) {
+        handshake_gpio = __builtin_ctzll(config->pin_bit_mask);
+    }
+    return ESP_OK;
+}
+
+esp_err_t gpio_set_level(gpio_num_t gpio, uint32_t level)
+{
+    pthread_mutex_lock(&bus_lock);
+    gpio_level[gpio] = level;
+    pthread_cond_broadcast(&bus_changed);
+    pthread_mutex_unlock(&bus_lock);
+    return ESP_OK;
+}
+
+esp_err_t spi_slave_initialize(spi_host_device_t host, const spi_bus_config_t *bus_config,
+                               const spi_slave_interface_config_t *config, int dma_chan)
+{
+    (void)host;
+    (void)bus_config;
+    (void)dma_chan;
+    slave_config = *config;
+    return ESP_OK;
+}
+
+void *spi_bus_dma_memory_alloc(spi_host_device_t host, size_t size, uint32_t extra_heap_caps)
+{
+    (void)host;
+    (void)extra_heap_caps;
+    return calloc(1, size);
+}
+
+esp_err_t spi_slave_transmit(spi_host_device_t host, spi_slave_transaction_t *trans, TickType_t ticks)
+{
+    (void)host;
+    (void)ticks;
+    pthread_mutex_lock(&bus_lock);
+    armed = trans;
+    pthread_mutex_unlock(&bus_lock);
+    if (slave_config.post_setup_cb) {
+        slave_config.post_setup_cb(trans);
+    }
+    pthread_mutex_lock(&bus_lock);
+    while (armed == trans) {
+        pthread_cond_wait(&bus_changed, &bus_lock);
+    }
+    pthread_mutex_unlock(&bus_lock);
+    if (slave_config.post_trans_cb) {
+        slave_config.post_trans_cb(trans);
+    }
+    return ESP_OK;
+}
+
+// one transaction of len bytes once the slave armed one and raised the handshake, false on timeout
+static bool master_transfer(const uint8_t *mosi, uint8_t *miso, size_t len, unsigned timeout_ms)
+{
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += timeout_ms / 1000;
+    deadline.tv_nsec += (long)(timeout_ms % 1000) * 1000000;
+    if (deadline.tv_nsec >= 1000000000) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000;
+    }
+    pthread_mutex_lock(&bus_lock);
+    while (armed == NULL || handshake_gpio < 0 || gpio_level[handshake_gpio] == 0) {
+        if (pthread_cond_timedwait(&bus_changed, &bus_lock, &deadline) == ETIMEDOUT) {
+            pthread_mutex_unlock(&bus_lock);
+            return false;
+        }
+    }
+    // a short transaction only clocks its own bytes
+    memcpy(miso, armed->tx_buffer, len);
+    memcpy(armed->rx_buffer, mosi, len);
+    armed->trans_len = len * 8;
+    armed = NULL;
+    pthread_cond_broadcast(&bus_changed);
+    pthread_mutex_unlock(&bus_lock);
+    return true;
+}
+
+void uac_mem_note(const char *name, const void *ptr, size_t size)
+{
+    (void)name;
+    (void)ptr;
+    (void)size;
+}
+
+// canned handlers, the transport only sees the response shapes: short and multi frame JSON, streams, slow bulk work
+static void handle_get_firmware_info(const api_request_t *req, api_response_t *resp)
+{
+    (void)req;
+    api_respond(resp, "{\"HWV\": \"SIM\", \"FWV\": \"usb_uac_1.0\", \"OTA\": \"factory\"}");
+}
+
+static void handle_get_latency(const api_request_t *req, api_response_t *resp)
+{
+    (void)req;
+    api_respond(resp, "{\"OUT\": 1500000, \"IN\": 1500000}");
+}
+
+static void handle_query(const api_request_t *req, api_response_t *resp)
+{
+    char json[64];
+    snprintf(json, sizeof(json), "{\"type\": %d, \"arg\": %d}", req->type, req->args[0]);
+    api_respond(resp, json);
+}
+
+// several frames long, like a full glitch log
+static void handle_get_glitch_events(const api_request_t *req, api_response_t *resp)
+{
+    uint32_t cursor;
+    memcpy(&cursor, req->args, sizeof(cursor));
+    const size_t size = 6000;
+    char *json = malloc(size);
+    if (json == NULL) {
+        resp->status = API_STATUS_FAILED;
+        return;
+    }
+    size_t n = snprintf(json, size, "{\"next\": %u, \"events\": [", (unsigned)(cursor + 64));
+    for (int i = 0; i < 64; i++) {
+        n += snprintf(json + n, size - n, "%s{\"seq\": %u, \"type\": 1, \"time\": %u}", i ? ", " : "",
+                      (unsigned)(cursor + i), (unsigned)(1000 * i));
+    }
+    snprintf(json + n, size - n, "]}");
+    api_respond(resp, json);
+    free(json);
+}
+
+static size_t read_pattern(const api_response_t *resp, uint8_t *dst, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+        const uint32_t pos = resp->stream_offset + resp->offset + i;
+        dst[i] = (uint8_t)(pos * 7 + resp->stream);
+    }
+    return len;
+}
+
+// a download streamed frame by frame as ReadRecorder does, byte n is n * 7 + stream
+static void handle_read_recorder(const api_request_t *req, api_response_t *resp)
+{
+    uint32_t offset, len;
+    memcpy(&offset, req->args + 1, sizeof(offset));
+    memcpy(&len, req->args + 5, sizeof(len));
+    resp->read = read_pattern;
+    resp->stream = req->args[0];
+    resp->stream_offset = offset;
+    resp->len = len < SIM_MAX_STREAM ? len : SIM_MAX_STREAM;
+}
+
+static void handle_measure_latency(const api_request_t *req, api_response_t *resp)
+{
+    (void)req;
+    vTaskDelay(pdMS_TO_TICKS(50));
+    api_respond(resp, "{\"ok\": 1, \"out\": 72, \"loop\": 0, \"in\": 72}");
+}
+
+static void handle_setting(const api_request_t *req, api_response_t *resp)
+{
+    (void)req;
+    (void)resp;
+}
+
+static const api_command_t commands[] = {
+    {GetFirmwareInfo, API_QUICK, handle_get_firmware_info},
+    {GetLatency, API_QUICK, handle_get_latency},
+    {SelectMonitorMode, API_QUICK, handle_setting},
+    {GetRecorderInfo, API_QUICK, handle_query},
+    {ReadRecorder, API_BULK, handle_read_recorder},
+    {GetGlitchEvents, API_QUICK, handle_get_glitch_events},
+    {GetTaskLatency, API_QUICK, handle_query},
+    {MeasureLatency, API_BULK, handle_measure_latency},
+    {SetUsbLoopback, API_QUICK, handle_setting},
+    {GetLoopbackStats, API_QUICK, handle_query},
+    {GetMicStreamStats, API_QUICK, handle_query},
+    {GetApllLockStats, API_QUICK, handle_query},
+    {GetDynamics, API_QUICK, handle_query},
+};
+
+const api_command_t *api_find_command(uint8_t type)
+{
+    for (size_t i = 0; i < sizeof(commands) / sizeof(commands[0]); i++) {
+        if (commands[i].type == type) {
+            return &commands[i];
+        }
+    }
+    return NULL;
+}
+
+int main(int argc, char **argv)
+{
+    const unsigned timeout_ms = argc > 1 ? (unsigned)atoi(argv[1]) : 2000;
+    static uint8_t mosi[SPI_FRAME_SIZE], miso[SPI_FRAME_SIZE];
+    spi_start();
+    while (1) {
+        uint8_t header[2];
+        if (fread(header, 1, sizeof(header), stdin) != sizeof(header)) {
+            return 0;
+        }
+        const size_t len = header[0] | header[1] << 8;
+        if (len == 0 || len > SPI_FRAME_SIZE || fread(mosi, 1, len, stdin) != len) {
+            fprintf(stderr, "spi_api_sim: bad record of %zu bytes\n", len);
+            return 1;
+        }
+        const uint8_t ok = master_transfer(mosi, miso, len, timeout_ms);
+        fwrite(&ok, 1, 1, stdout);
+        if (ok) {
+            fwrite(miso, 1, len, stdout);
+        }
+        fflush(stdout);
+    }
+}
@@ -0,0 +1,61 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+// a simulated SPI slave, spi_api_sim.c plays the master
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+
+typedef enum { SPI2_HOST = 1, SPI3_HOST = 2 } spi_host_device_t;
+#define SPI_DMA_CH_AUTO 3
+#define ESP_INTR_CPU_AFFINITY_0 1
+#define ESP_INTR_CPU_CORE_ID_TO_AFFINITY(core) ((core) + 1)
+
+typedef struct {
+    int mosi_io_num;
+    int miso_io_num;
+    int sclk_io_num;
+    int quadwp_io_num;
+    int quadhd_io_num;
+    int data4_io_num;
+    int data5_io_num;
+    int data6_io_num;
+    int data7_io_num;
+    bool data_io_default_level;
+    int max_transfer_sz;
+    uint32_t flags;
+    int isr_cpu_id;
+    int intr_flags;
+} spi_bus_config_t;
+
+typedef struct spi_slave_transaction_t spi_slave_transaction_t;
+typedef void (*slave_transaction_cb_t)(spi_slave_transaction_t *trans);
+
+struct spi_slave_transaction_t {
+    size_t length;              // bits
+    size_t trans_len;           // bits the master clocked
+    const void *tx_buffer;
+    void *rx_buffer;
+    void *user;
+};
+
+typedef struct {
+    int spics_io_num;
+    uint32_t flags;
+    int queue_size;
+    uint8_t mode;
+    slave_transaction_cb_t post_setup_cb;
+    slave_transaction_cb_t post_trans_cb;
+} spi_slave_interface_config_t;
+
+esp_err_t spi_slave_initialize(spi_host_device_t host, const spi_bus_config_t *bus_config,
+                               const spi_slave_interface_config_t *slave_config, int dma_chan);
+// blocks until the simulated master ran a transaction, the timeout is ignored
+esp_err_t spi_slave_transmit(spi_host_device_t host, spi_slave_transaction_t *trans, TickType_t ticks);
+void *spi_bus_dma_memory_alloc(spi_host_device_t host, size_t size, uint32_t extra_heap_caps);
@@ -0,0 +1,12 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+// esp_cpu_get_cycle_count counts ns on the host
+static inline int esp_clk_cpu_freq(void)
+{
+    return 1000000000;
+}
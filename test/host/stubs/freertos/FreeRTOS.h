@@ -0,0 +1,24 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+// FreeRTOS on POSIX threads for the host built modules, ticks are milliseconds. See freertos_host.c
+#include <assert.h>
+#include <stdint.h>
+#include "esp_attr.h"
+
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+
+#define pdTRUE                  1
+#define pdFALSE                 0
+#define pdPASS                  pdTRUE
+#define portMAX_DELAY           ((TickType_t)0xffffffff)
+#define configTICK_RATE_HZ      1000
+#define configMAX_PRIORITIES    25
+#define tskNO_AFFINITY          0x7fffffff
+#define pdMS_TO_TICKS(ms)       ((TickType_t)(ms))
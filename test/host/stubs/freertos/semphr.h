@@ -0,0 +1,15 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#include "freertos/queue.h"
+
+// semaphores are queues of items without data, as in FreeRTOS
+typedef QueueHandle_t SemaphoreHandle_t;
+
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max, UBaseType_t initial);
+#define xSemaphoreTake(sem, ticks)  xQueueReceive((sem), NULL, (ticks))
+#define xSemaphoreGive(sem)         xQueueSend((sem), NULL, 0)
@@ -0,0 +1,15 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+// The options of sdkconfig.defaults the host built modules depend on
+#define CONFIG_UAC_SPEAKER_CHANNEL_NUM 2
+#define CONFIG_UAC_MIC_CHANNEL_NUM 2
+#define CONFIG_UAC_SAMPLE_RATE 48000
+#define CONFIG_UAC_SPK_INTERVAL_MS 10
+#define CONFIG_UAC_MIC_INTERVAL_MS 10
+#define CONFIG_UAC_MIC_RESAMPLER 1
+#define CONFIG_UAC_BENCHMARK 1
@@ -0,0 +1,212 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Capture resampler on the host: sines through uac_resampler_process at a fixed drift of up to +/-500 ppm
+ * and with the ratio changing every block like the ring fill servo does. Checks the output count against the
+ * ratio, the SNR against a least squares sine fit, and that no frame is lost or repeated.
+ */
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "uac_config.h"
+#include "uac_resampler_priv.h"
+
+#define FS                  DEFAULT_SAMPLE_RATE
+#define CHANNELS            MIC_CHANNEL_NUM
+#define BLOCK_FRAMES        (MIC_INTERVAL_MS * FS / 1000)
+#define MAX_OUT_FRAMES      (MIC_INTERVAL_MS * (FS / 1000 + 2))     // UAC_MIC_RS_MAX_FRAMES
+#define RUN_FRAMES          (20 * FS)
+#define SETTLE_FRAMES       (4 * UAC_RESAMPLER_DELAY_FRAMES)
+#define AMPLITUDE           0.5                                     // of full scale, -6 dBFS
+
+typedef struct {
+    const char *name;
+    uint8_t bits;
+    double freq;
+    double ppm;                 // capture clock against the USB clock
+    bool servo;                 // ratio changes every block within +/-ppm
+    double min_snr_db;          // fixed ratio only
+} test_case_t;
+
+static const test_case_t cases[] = {
+    {"s16 1 kHz 0 ppm", 16, 1000, 0, false, 90},
+    {"s16 1 kHz +500 ppm", 16, 1000, 500, false, 85},
+    {"s16 1 kHz -500 ppm", 16, 1000, -500, false, 85},
+    {"s16 18 kHz +500 ppm", 16, 18000, 500, false, 72},
+    {"s16 18 kHz -500 ppm", 16, 18000, -500, false, 72},
+    {"s32 1 kHz +500 ppm", 32, 1000, 500, false, 92},
+    {"s32 1 kHz -500 ppm", 32, 1000, -500, false, 92},
+    {"s16 1 kHz servo +/-500 ppm", 16, 1000, 500, true, 0},
+    {"s32 1 kHz servo +/-500 ppm", 32, 1000, 500, true, 0},
+};
+
+static uac_resampler_t rs;
+static uint32_t rng_state = 1;
+
+static uint32_t xorshift32(void)
+{
+    uint32_t x = rng_state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return rng_state = x;
+}
+
+static double full_scale(uint8_t bits)
+{
+    return bits == 16 ? 32767.0 : 2147483647.0;
+}
+
+static void make_input(void *buf, uint8_t bits, size_t first, size_t frames, double freq)
+{
+    const double a = AMPLITUDE * full_scale(bits);
+    for (size_t f = 0; f < frames; f++) {
+        for (int c = 0; c < CHANNELS; c++) {
+            // the channels a quarter period apart
+            const double v = a * sin(2 * M_PI * freq * (double)(first + f) / FS + c * M_PI_2);
+            if (bits == 16) {
+                ((int16_t *)buf)[f * CHANNELS + c] = (int16_t)lrint(v);
+            } else {
+                ((int32_t *)buf)[f * CHANNELS + c] = (int32_t)lrint(v);
+            }
+        }
+    }
+}
+
+static double sample(const void *buf, uint8_t bits, size_t i)
+{
+    return bits == 16 ? ((const int16_t *)buf)[i] : ((const int32_t *)buf)[i];
+}
+
+// SNR of one channel against the best fitting sine of angular frequency w per frame, and the largest error
+static double fit_snr(const void *out, uint8_t bits, size_t frames, int ch, double w, double *max_err)
+{
+    double ss = 0, cc = 0, sc = 0, ys = 0, yc = 0;
+    for (size_t m = SETTLE_FRAMES; m < frames; m++) {
+        const double s = sin(w * m), c = cos(w * m), y = sample(out, bits, m * CHANNELS + ch);
+        ss += s * s;
+        cc += c * c;
+        sc += s * c;
+        ys += y * s;
+        yc += y * c;
+    }
+    const double det = ss * cc - sc * sc;
+    const double a = (ys * cc - yc * sc) / det;
+    const double b = (yc * ss - ys * sc) / det;
+    double noise = 0;
+    *max_err = 0;
+    for (size_t m = SETTLE_FRAMES; m < frames; m++) {
+        const double e = sample(out, bits, m * CHANNELS + ch) - a * sin(w * m) - b * cos(w * m);
+        noise += e * e;
+        *max_err = fabs(e) > *max_err ? fabs(e) : *max_err;
+    }
+    const double signal = (a * a + b * b) / 2 * (frames - SETTLE_FRAMES);
+    return 10 * log10(signal / noise);
+}
+
+// A lost or repeated frame steps the sine by a whole frame, the second difference stays near a * w^2 otherwise
+static double max_second_difference(const void *out, uint8_t bits, size_t frames, int ch)
+{
+    double max = 0;
+    for (size_t m = SETTLE_FRAMES + 1; m + 1 < frames; m++) {
+        const double d = sample(out, bits, (m + 1) * CHANNELS + ch) - 2 * sample(out, bits, m * CHANNELS + ch) +
+                         sample(out, bits, (m - 1) * CHANNELS + ch);
+        max = fabs(d) > max ? fabs(d) : max;
+    }
+    return max;
+}
+
+static bool run_case(const test_case_t *t)
+{
+    const size_t bytes = t->bits / 8;
+    const uac_format_t format = {
+        .sample_rate = FS,
+        .channels = CHANNELS,
+        .bits_per_sample = t->bits,
+        .bytes_per_frame = CHANNELS * bytes,
+    };
+    uint8_t *in = malloc(BLOCK_FRAMES * format.bytes_per_frame);
+    uint8_t *out = malloc((RUN_FRAMES / 2 * 3) * format.bytes_per_frame);
+    if (!in || !out || !uac_resampler_reset(&rs, &format)) {
+        printf("FAIL %s: setup\n", t->name);
+        return false;
+    }
+
+    bool ok = true;
+    const double nominal = ldexp(1.0, 32);
+    double step = 1.0 + t->ppm * 1e-6;
+    double in_expected = 0;             // output frames the input is worth at the ratios used
+    size_t n_out = 0;
+    uint32_t dropped = 0;
+    for (size_t pos = 0, block = 0; pos < RUN_FRAMES; pos += BLOCK_FRAMES, block++) {
+        if (t->servo) {
+            step = 1.0 + t->ppm * 1e-6 * ((double)(xorshift32() % 2001) / 1000.0 - 1.0);
+        }
+        const uint64_t step_q32 = (uint64_t)llrint(step * nominal);
+        make_input(in, t->bits, pos, BLOCK_FRAMES, t->freq);
+        const size_t n = uac_resampler_process(&rs, in, BLOCK_FRAMES, out + n_out * format.bytes_per_frame,
+                                               MAX_OUT_FRAMES, step_q32, &dropped);
+        // past the filter delay of the first block every block yields its length over the ratio, rounded
+        const double expected = BLOCK_FRAMES / ((double)step_q32 / nominal);
+        if (block > 0 && fabs((double)n - expected) > 1.0) {
+            printf("FAIL %s: block %zu has %zu frames, expected %.2f\n", t->name, block, n, expected);
+            ok = false;
+            break;
+        }
+        in_expected += expected;
+        n_out += n;
+    }
+    const double lag = in_expected - (double)n_out;
+    if (ok && (dropped != 0 || fabs(lag - (UAC_RESAMPLER_DELAY_FRAMES - 1)) > 2.0)) {
+        printf("FAIL %s: %zu output frames, %.1f short of the ratio, %u input frames dropped\n",
+               t->name, n_out, lag, dropped);
+        ok = false;
+    }
+
+    const double a = AMPLITUDE * full_scale(t->bits);
+    const double w = 2 * M_PI * t->freq / FS * step;
+    for (int ch = 0; ok && ch < CHANNELS; ch++) {
+        if (t->servo) {
+            // twice the smooth bound, a frame slip at 1 kHz is ten times more
+            const double limit = 2 * a * w * w + 4;
+            const double d2 = max_second_difference(out, t->bits, n_out, ch);
+            if (d2 > limit) {
+                printf("FAIL %s: ch %d second difference %.1f over %.1f\n", t->name, ch, d2, limit);
+                ok = false;
+            } else if (ch == 0) {
+                printf("ok   %s: %zu frames, max second difference %.1f%% of the limit\n", t->name, n_out, 100 * d2 / limit);
+            }
+            continue;
+        }
+        double max_err;
+        const double snr = fit_snr(out, t->bits, n_out, ch, w, &max_err);
+        // a discontinuity shows up as an error of a * w or more, far above the noise
+        if (snr < t->min_snr_db || max_err > a * 0.01) {
+            printf("FAIL %s: ch %d SNR %.1f dB (min %.1f), max error %.2g of the amplitude\n",
+                   t->name, ch, snr, t->min_snr_db, max_err / a);
+            ok = false;
+        } else if (ch == 0) {
+            printf("ok   %s: %zu frames, SNR %.1f dB, max error %.2g of the amplitude\n", t->name, n_out, snr, max_err / a);
+        }
+    }
+    free(in);
+    free(out);
+    return ok;
+}
+
+int main(void)
+{
+    int failed = 0;
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        failed += !run_case(&cases[i]);
+    }
+    printf("%d of %zu cases failed\n", failed, sizeof(cases) / sizeof(cases[0]));
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,349 @@
+#!/usr/bin/env python3
+# SPDX-FileCopyrightText: 2025 Espressif Systems (Shanghai) CO LTD
+#
+# SPDX-License-Identifier: Apache-2.0
+"""
+Clock tree solver for the TLV320AIC3254.
+
+Enumerates every PLL (P, R, J.D) and divider (NDAC, MDAC, DOSR, NADC, MADC, AOSR) combination within the
+datasheet limits that produces a sample rate exactly from a given MCLK, per interpolation and decimation
+filter, and picks the lowest power one: PLL off when MCLK allows it, otherwise the lowest PLL clock, and
+the lowest DAC_CLK / ADC_CLK that still gives the processing block its instruction budget.
+
+  solve MCLK FS       print the chosen configuration and the number of alternatives
+  generate            write the table of common rates compiled into the firmware (main/aic3254_clocks.h)
+  check [HEADER]      decode every entry of a generated header, verify it against the datasheet limits
+                      independently of the solver and that it matches what the solver produces now
+
+Usage: aic3254_clock_solver.py solve 12000000 44100
+       aic3254_clock_solver.py generate -o main/aic3254_clocks.h
+       aic3254_clock_solver.py check main/aic3254_clocks.h
+"""
+
+import argparse
+import os
+import re
+import sys
+from fractions import Fraction
+
+# datasheet limits, DVDD >= 1.65 V
+PLL_P = range(1, 9)
+PLL_R = range(1, 5)
+PLL_J = range(1, 64)
+PLL_D_MAX = 9999
+PLL_IN_MIN, PLL_IN_MAX = 512000, 20000000          # MCLK / P, D = 0
+PLL_IN_FRAC_MIN = 10000000                           # MCLK / P, D != 0
+PLL_OUT_MIN, PLL_OUT_MAX = 80000000, 110000000
+CODEC_CLKIN_MAX = 137000000
+MCLK_MAX = 50000000
+CLK_MAX = 55296000                                   # DAC_CLK, ADC_CLK
+MOD_CLK_MAX = 6758000                                # DAC_MOD_CLK, ADC_MOD_CLK
+DOSR_FS_MIN, DOSR_FS_MAX = 2800000, 6200000
+FS_MAX = 192000
+
+# per filter, keep in sync with dac_prbs / adc_prbs in main/codec.c
+# DAC: (filter, resource class of the PRB, DOSR multiple, max fs)
+DAC_FILTERS = (('A', 8, 8, 48000), ('B', 8, 4, 96000), ('C', 6, 2, 192000))
+# ADC: (filter, resource class of the PRB, AOSR, max fs)
+ADC_FILTERS = (('A', 6, 128, 48000), ('B', 3, 64, 96000), ('C', 3, 32, 192000))
+
+TABLE_RATES = (32000, 44100, 48000, 88200, 96000, 176400, 192000)
+TABLE_MCLKS = (11289600, 12000000, 12288000, 22579200, 24000000, 24576000)   # plus 256 * fs for every rate
+
+HEADER_NAME = 'aic3254_clocks.h'
+
+
+def pll_options(mclk, clkin):
+    """All (P, R, J, D) giving clkin from mclk exactly."""
+    out = []
+    for p in PLL_P:
+        pin = Fraction(mclk, p)
+        if not PLL_IN_MIN <= pin <= PLL_IN_MAX:
+            continue
+        for r in PLL_R:
+            jd = Fraction(clkin * p, mclk * r)
+            j = jd.numerator // jd.denominator
+            d = (jd - j) * 10000
+            if d.denominator != 1 or j not in PLL_J:
+                continue
+            d = int(d)
+            if d == 0 and 4 <= r * j <= 259:
+                out.append((p, r, j, 0))
+            elif d != 0 and r == 1 and 4 <= j <= 11 and d <= PLL_D_MAX and pin >= PLL_IN_FRAC_MIN:
+                out.append((p, r, j, d))
+    return out
+
+
+def dac_options(clkin, fs, rc, dosr_multiple):
+    """(NDAC, MDAC, DOSR) for one interpolation filter, lowest DAC_CLK first, then the highest DOSR."""
+    out = []
+    for dosr in range(dosr_multiple, 1025, dosr_multiple):
+        if not DOSR_FS_MIN <= dosr * fs <= DOSR_FS_MAX:
+            continue
+        for mdac in range(1, 129):
+            if mdac * dosr < 32 * rc:
+                continue
+            div = mdac * dosr * fs
+            if clkin % div:
+                continue
+            ndac = clkin // div
+            if 1 <= ndac <= 128 and clkin // ndac <= CLK_MAX:
+                out.append((ndac, mdac, dosr))
+    return sorted(out, key=lambda o: (o[1] * o[2], -o[2]))
+
+
+def adc_options(clkin, fs, rc, aosr):
+    """(NADC, MADC, AOSR) for one decimation filter, lowest ADC_CLK first."""
+    out = []
+    if aosr * fs > MOD_CLK_MAX:
+        return out
+    for madc in range(1, 129):
+        if madc * aosr < 32 * rc:
+            continue
+        div = madc * aosr * fs
+        if clkin % div:
+            continue
+        nadc = clkin // div
+        if 1 <= nadc <= 128 and clkin // nadc <= CLK_MAX:
+            out.append((nadc, madc, aosr))
+    return sorted(out, key=lambda o: o[1] * o[2])
+
+
+def dividers(clkin, fs):
+    dac = [dac_options(clkin, fs, rc, mult)[:1] if fs <= max_fs else [] for _, rc, mult, max_fs in DAC_FILTERS]
+    adc = [adc_options(clkin, fs, rc, aosr)[:1] if fs <= max_fs else [] for _, rc, aosr, max_fs in ADC_FILTERS]
+    return [d[0] if d else None for d in dac], [a[0] if a else None for a in adc]
+
+
+def solve(mclk, fs):
+    """Return (best configuration, number of configurations considered) or (None, 0)."""
+    if mclk > MCLK_MAX or fs > FS_MAX:
+        return None, 0
+    candidates = []
+    # PLL off: CODEC_CLKIN = MCLK
+    if mclk <= CODEC_CLKIN_MAX:
+        candidates.append((mclk, None))
+    for k in range(-(-PLL_OUT_MIN // fs), PLL_OUT_MAX // fs + 1):
+        clkin = k * fs
+        for pll in pll_options(mclk, clkin):
+            candidates.append((clkin, pll))
+    best, best_key, count = None, None, 0
+    for clkin, pll in candidates:
+        dac, adc = dividers(clkin, fs)
+        # a tree is of use once both converters have a filter
+        if dac == [None] * 3 or adc == [None] * 3:
+            continue
+        count += 1
+        filters = sum(x is not None for x in dac + adc)
+        # most filters usable, then PLL off, then the lowest clock, then the smallest PLL dividers
+        key = (-filters, pll is not None, clkin, pll or ())
+        if best_key is None or key < best_key:
+            best, best_key = {'mclk': mclk, 'fs': fs, 'clkin': clkin, 'pll': pll, 'dac': dac, 'adc': adc}, key
+    return best, count
+
+
+def table():
+    entries = []
+    for fs in TABLE_RATES:
+        for mclk in sorted(set(TABLE_MCLKS + (256 * fs,))):
+            cfg, _ = solve(mclk, fs)
+            if cfg:
+                entries.append(cfg)
+    return entries
+
+
+def c_divider(d):
+    return '{%d, %d, %d}' % d if d else '{0, 0, 0}'
+
+
+def generate(path):
+    lines = [
+        '/***************',
+        'CTAG TBD >>to be determined<< is an open source eurorack synthesizer module.',
+        '',
+        'A project conceived within the Creative Technologies Arbeitsgruppe of',
+        'Kiel University of Applied Sciences: https://www.creative-technologies.de',
+        '',
+        '(c) 2020 by Robert Manzke. All rights reserved.',
+        '',
+        'The CTAG TBD software is licensed under the GNU General Public License',
+        '(GPL 3.0), available here: https://www.gnu.org/licenses/gpl-3.0.txt',
+        '',
+        'The CTAG TBD hardware design is released under the Creative Commons',
+        'Attribution-NonCommercial-ShareAlike 4.0 International (CC BY-NC-SA 4.0).',
+        'Details here: https://creativecommons.org/licenses/by-nc-sa/4.0/',
+        '',
+        'CTAG TBD is provided "as is" without any express or implied warranties.',
+        '',
+        'License and copyright details for specific submodules are included in their',
+        'respective component folders / files if different from this license.',
+        '***************/',
+        '',
+        '// Generated by tools/aic3254_clock_solver.py, do not edit. Check with: aic3254_clock_solver.py check',
+        '',
+        '#pragma once',
+        '',
+        '#include <stdint.h>',
+        '',
+        '// NDAC, MDAC, DOSR or NADC, MADC, AOSR, all zero if the filter can not run at this rate',
+        'typedef struct {',
+        '    uint8_t n;',
+        '    uint8_t m;',
+        '    uint16_t osr;',
+        '} aic3254_dividers_t;',
+        '',
+        'typedef struct {',
+        '    uint32_t mclk_hz;',
+        '    uint32_t fs;',
+        '    uint32_t codec_clkin_hz;',
+        '    uint8_t pll_p;                  // 0: PLL off, CODEC_CLKIN = MCLK',
+        '    uint8_t pll_r;',
+        '    uint8_t pll_j;',
+        '    uint16_t pll_d;',
+        '    aic3254_dividers_t dac[3];      // interpolation filter A, B, C',
+        '    aic3254_dividers_t adc[3];      // decimation filter A, B, C',
+        '} aic3254_clock_cfg_t;',
+        '',
+        'static const aic3254_clock_cfg_t aic3254_clock_cfgs[] = {',
+    ]
+    entries = table()
+    for e in entries:
+        p, r, j, d = e['pll'] or (0, 0, 0, 0)
+        lines.append('    {%d, %d, %d, %d, %d, %d, %d, {%s}, {%s}},' % (
+            e['mclk'], e['fs'], e['clkin'], p, r, j, d,
+            ', '.join(c_divider(x) for x in e['dac']), ', '.join(c_divider(x) for x in e['adc'])))
+    lines += ['};', '']
+    with open(path, 'w') as f:
+        f.write('\n'.join(lines))
+    print('%s: %d configurations' % (path, len(entries)))
+
+
+ENTRY = re.compile(r'^\s*\{(\d+), (\d+), (\d+), (\d+), (\d+), (\d+), (\d+), (\{.*\})\},$')
+DIVIDERS = re.compile(r'\{(\d+), (\d+), (\d+)\}')
+
+
+def parse(path):
+    entries = []
+    with open(path) as f:
+        for line in f:
+            m = ENTRY.match(line)
+            if m:
+                v = [int(x) for x in m.groups()[:7]]
+                div = [tuple(int(x) for x in d) for d in DIVIDERS.findall(m.group(8))]
+                dac, adc = div[:3], div[3:]
+                entries.append({'mclk': v[0], 'fs': v[1], 'clkin': v[2], 'pll': tuple(v[3:7]), 'dac': dac, 'adc': adc})
+    return entries
+
+
+def verify(e):
+    """Datasheet checks of one decoded entry, written out on their own rather than reusing the solver."""
+    errors = []
+    mclk, fs, clkin = e['mclk'], e['fs'], e['clkin']
+    p, r, j, d = e['pll']
+    if fs > FS_MAX or mclk > MCLK_MAX or clkin > CODEC_CLKIN_MAX:
+        errors.append('fs, MCLK or CODEC_CLKIN above the maximum')
+    if p == 0:
+        if clkin != mclk:
+            errors.append('PLL off but CODEC_CLKIN != MCLK')
+    else:
+        if not (1 <= p <= 8 and 1 <= r <= 4 and 1 <= j <= 63 and 0 <= d <= 9999):
+            errors.append('PLL divider out of range')
+        if Fraction(mclk * r, p) * (j + Fraction(d, 10000)) != clkin:
+            errors.append('PLL output %s != CODEC_CLKIN' % float(Fraction(mclk * r, p) * (j + Fraction(d, 10000))))
+        if not PLL_OUT_MIN <= clkin <= PLL_OUT_MAX:
+            errors.append('PLL output outside 80..110 MHz')
+        pin = Fraction(mclk, p)
+        if d == 0 and not (PLL_IN_MIN <= pin <= PLL_IN_MAX and 4 <= r * j <= 259):
+            errors.append('integer PLL input or R * J out of range')
+        if d != 0 and not (PLL_IN_FRAC_MIN <= pin <= PLL_IN_MAX and r == 1 and 4 <= j <= 11):
+            errors.append('fractional PLL input, R or J out of range')
+    if len(e['dac']) != 3 or len(e['adc']) != 3:
+        return errors + ['expected three filters per converter']
+    for (name, rc, mult, max_fs), (n, m, osr) in zip(DAC_FILTERS, e['dac']):
+        if n == 0:
+            continue
+        what = 'DAC filter %s: ' % name
+        if not (1 <= n <= 128 and 1 <= m <= 128 and 1 <= osr <= 1024):
+            errors.append(what + 'divider out of range')
+        elif n * m * osr * fs != clkin:
+            errors.append(what + 'NDAC * MDAC * DOSR * fs != CODEC_CLKIN')
+        if clkin / n > CLK_MAX or clkin / (n * m) > MOD_CLK_MAX:
+            errors.append(what + 'DAC_CLK or DAC_MOD_CLK too high')
+        if osr % mult or not DOSR_FS_MIN <= osr * fs <= DOSR_FS_MAX:
+            errors.append(what + 'DOSR not valid for the filter')
+        if m * osr < 32 * rc or fs > max_fs:
+            errors.append(what + 'resource class or sample rate not met')
+    for (name, rc, aosr, max_fs), (n, m, osr) in zip(ADC_FILTERS, e['adc']):
+        if n == 0:
+            continue
+        what = 'ADC filter %s: ' % name
+        if not (1 <= n <= 128 and 1 <= m <= 128 and osr == aosr):
+            errors.append(what + 'divider out of range or AOSR not the filter\'s')
+        elif n * m * osr * fs != clkin:
+            errors.append(what + 'NADC * MADC * AOSR * fs != CODEC_CLKIN')
+        if clkin / n > CLK_MAX or clkin / (n * m) > MOD_CLK_MAX:
+            errors.append(what + 'ADC_CLK or ADC_MOD_CLK too high')
+        if m * osr < 32 * rc or fs > max_fs:
+            errors.append(what + 'resource class or sample rate not met')
+    if all(n == 0 for n, _, _ in e['dac']) or all(n == 0 for n, _, _ in e['adc']):
+        errors.append('no filter for one of the converters')
+    return errors
+
+
+def cmd_check(args):
+    entries = parse(args.header)
+    if not entries:
+        sys.exit('%s: no configurations found' % args.header)
+    failed = 0
+    for e in entries:
+        errors = verify(e)
+        for err in errors:
+            print('MCLK %d fs %d: %s' % (e['mclk'], e['fs'], err))
+        failed += bool(errors)
+    # the solver must not have found something better or different since the header was generated
+    fresh = [dict(x, pll=x['pll'] or (0, 0, 0, 0), dac=[d or (0, 0, 0) for d in x['dac']],
+                  adc=[a or (0, 0, 0) for a in x['adc']]) for x in table()]
+    stale = fresh != entries
+    if stale:
+        print('%s does not match the solver, run generate' % args.header)
+    print('%d configurations, %d failed%s' % (len(entries), failed, ', stale' if stale else ''))
+    return 1 if failed or stale else 0
+
+
+def cmd_solve(args):
+    cfg, count = solve(args.mclk, args.fs)
+    if cfg is None:
+        print('no valid clock tree for MCLK %d Hz, fs %d Hz' % (args.mclk, args.fs))
+        return 1
+    p, r, j, d = cfg['pll'] or (0, 0, 0, 0)
+    print('CODEC_CLKIN %d Hz, %s (%d valid trees)' % (cfg['clkin'], 'PLL P=%d R=%d J=%d D=%d' % (p, r, j, d)
+                                                        if cfg['pll'] else 'PLL off', count))
+    for (name, _, _, _), x in zip(DAC_FILTERS, cfg['dac']):
+        print('  DAC filter %s: %s' % (name, 'NDAC=%d MDAC=%d DOSR=%d' % x if x else '-'))
+    for (name, _, _, _), x in zip(ADC_FILTERS, cfg['adc']):
+        print('  ADC filter %s: %s' % (name, 'NADC=%d MADC=%d AOSR=%d' % x if x else '-'))
+    return 0
+
+
+def main():
+    default_header = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', 'main', HEADER_NAME)
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    sub = parser.add_subparsers(dest='cmd', required=True)
+    p = sub.add_parser('solve')
+    p.add_argument('mclk', type=int)
+    p.add_argument('fs', type=int)
+    p = sub.add_parser('generate')
+    p.add_argument('-o', '--output', default=default_header)
+    p = sub.add_parser('check')
+    p.add_argument('header', nargs='?', default=default_header)
+    args = parser.parse_args()
+    if args.cmd == 'solve':
+        return cmd_solve(args)
+    if args.cmd == 'generate':
+        generate(args.output)
+        return 0
+    return cmd_check(args)
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,563 @@
+#!/usr/bin/env python3
+# SPDX-FileCopyrightText: 2025 Espressif Systems (Shanghai) CO LTD
+#
+# SPDX-License-Identifier: Apache-2.0
+"""
+Reference SPI master for main/spi_api.c on a Linux host with spidev, in place of the RP2350.
+
+  request NAME [ARG...]   send one request and print the response, NAME from COMMANDS or a number,
+                          --raw HEX replaces the packed arguments, --legacy uses the 0xCA 0xFE framing
+  fuzz                    malformed frames, short transactions, unknown types, random arguments, queue
+                          floods and broken legacy acknowledgements, each followed by a liveness check
+  bench                   requests/s, response bytes/s and latency percentiles per query, --json for
+                          tracking between firmware versions; --under-download measures the quick queries
+                          while a ReadRecorder download runs (freeze the recorder first)
+  kernels                 run the on-target audio kernel benchmark (CONFIG_UAC_BENCHMARK), --json for the raw
+                          report, --baseline FILE compares against an earlier report and fails on regressions
+  compare OLD NEW         compare two kernel reports offline, e.g. of two commits, no SPI access
+
+Wiring: SPI mode 3 to GPIO 20 (CS), 21 (SCLK), 22 (MISO), 23 (MOSI) and the handshake GPIO 50, which the
+slave raises once a transaction is armed. Without --handshake CHIP:LINE (libgpiod 2) the master waits --gap-us
+between transactions instead. Only queries that change nothing are fuzzed and benchmarked.
+
+--sim PATH talks to the host build of the transport instead, test/host/spi_api_sim, which simulates the SPI slave
+and the handshake line and answers with canned handlers; ctest runs the fuzzer against it.
+
+Usage: spi_api_master.py request GetLatency
+       spi_api_master.py request ReadRecorder 0 0 4096 -o out.raw
+       spi_api_master.py --handshake gpiochip0:25 fuzz --rounds 200 --seed 1
+       spi_api_master.py --sim build-host/spi_api_sim --gap-us 0 fuzz --rounds 400
+       spi_api_master.py bench --count 500 --json > bench.json
+       spi_api_master.py kernels --seed 1 --json > kernels.json
+       spi_api_master.py kernels --seed 1 --baseline kernels.json --threshold 5
+"""
+
+import argparse
+import json
+import random
+import struct
+import subprocess
+import sys
+import time
+
+FRAME = 2048
+LEGACY = 0xFE
+TAGGED = 0xFD
+LEGACY_HEADER = struct.Struct('<BBBI')          # 0xCA 0xFE, request type, remaining length
+TAGGED_HEADER = struct.Struct('<BBBHBII')       # 0xCA 0xFD, request type, id, status, total length, offset
+TAGGED_REQUEST = struct.Struct('<BBBH')
+POLL = 0x00
+API_QUEUE_LEN = 8
+STATUS = {0: 'ok', 1: 'unknown', 2: 'busy', 3: 'failed'}
+
+# keep in sync with RequestType in main/spi_api_priv.h: type, has a response, argument format (None: --raw only)
+COMMANDS = {
+    'Reboot': (0x13, False, ''),
+    'GetFirmwareInfo': (0x19, True, ''),
+    'RebootToOTAX': (0x22, False, 'B'),
+    'GetLatency': (0x30, True, ''),
+    'SetCodecLatencyMode': (0x31, False, 'BB'),
+    'SelectMonitorMode': (0x32, False, 'B'),
+    'SetInputMonitorLevel': (0x33, False, 'Bbb'),
+    'SetTdmSlotMap': (0x34, False, None),
+    'TriggerRecorder': (0x35, False, 'B'),
+    'RearmRecorder': (0x36, False, ''),
+    'GetRecorderInfo': (0x37, True, ''),
+    'ReadRecorder': (0x38, True, '<BII'),
+    'GetGlitchEvents': (0x39, True, '<I'),
+    'GetTraceDump': (0x3A, True, ''),
+    'GetTaskLatency': (0x3B, True, 'B'),
+    'MeasureLatency': (0x3C, True, 'BB'),
+    'SetUsbLoopback': (0x3D, False, 'B'),
+    'GetLoopbackStats': (0x3E, True, 'B'),
+    'GetMicStreamStats': (0x3F, True, 'B'),
+    'GetApllLockStats': (0x40, True, 'B'),
+    'ConfigureInputAgc': (0x41, False, None),
+    'ConfigureOutputDrc': (0x42, False, None),
+    'GetDynamics': (0x43, True, ''),
+    'EnableInputHighPass': (0x44, False, 'B'),
+    'RunBenchmark': (0x45, True, '<HI'),
+}
+# no side effects, the statistics are read with reset 0
+SAFE_QUERIES = ('GetFirmwareInfo', 'GetLatency', 'GetRecorderInfo', 'GetGlitchEvents', 'GetTaskLatency',
+                'GetLoopbackStats', 'GetMicStreamStats', 'GetApllLockStats', 'GetDynamics')
+
+
+class ProtocolError(Exception):
+    pass
+
+
+def open_handshake(spec):
+    if not spec:
+        return None
+    import gpiod
+    chip, line = spec.rsplit(':', 1)
+    line = int(line)
+    path = chip if chip.startswith('/') else '/dev/' + chip
+    req = gpiod.request_lines(path, consumer='spi_api_master',
+                              config={line: gpiod.LineSettings(direction=gpiod.line.Direction.INPUT)})
+    return lambda: req.get_value(line) == gpiod.line.Value.ACTIVE
+
+
+class Link:
+    """One full duplex transaction per call, padded to the frame size unless short is given."""
+
+    def __init__(self, bus, device, speed_hz, handshake, gap_us, timeout):
+        import spidev
+        self.spi = spidev.SpiDev()
+        self.spi.open(bus, device)
+        self.spi.mode = 3
+        self.spi.max_speed_hz = speed_hz
+        self.ready = open_handshake(handshake)
+        self.gap = gap_us / 1e6
+        self.timeout = timeout
+        self.transactions = 0
+
+    def xfer(self, data, short=None):
+        frame = bytes(data[:FRAME]).ljust(FRAME if short is None else short, b'\0')
+        if self.ready:
+            deadline = time.monotonic() + self.timeout
+            while not self.ready():
+                if time.monotonic() > deadline:
+                    raise ProtocolError('handshake stays low')
+        elif self.gap:
+            time.sleep(self.gap)
+        self.transactions += 1
+        return bytes(self.spi.xfer2(list(frame)))
+
+
+class SimLink:
+    """The same transactions to spi_api_sim over its stdin and stdout, which waits for the handshake itself."""
+
+    def __init__(self, path, gap_us, timeout):
+        self.proc = subprocess.Popen([path, str(int(timeout * 1000))], stdin=subprocess.PIPE, stdout=subprocess.PIPE)
+        self.gap = gap_us / 1e6
+        self.transactions = 0
+
+    def xfer(self, data, short=None):
+        frame = bytes(data[:FRAME]).ljust(FRAME if short is None else short, b'\0')
+        if self.gap:
+            time.sleep(self.gap)
+        self.proc.stdin.write(struct.pack('<H', len(frame)) + frame)
+        self.proc.stdin.flush()
+        ok = self.proc.stdout.read(1)
+        if ok != b'\x01':
+            raise ProtocolError('handshake stays low' if ok else 'simulator exited')
+        self.transactions += 1
+        return self.proc.stdout.read(len(frame))
+
+
+class Response:
+    def __init__(self, rtype, status, length):
+        self.type = rtype
+        self.status = status
+        self.data = bytearray(length)
+        self.received = 0
+
+
+class Master:
+    def __init__(self, link, timeout):
+        self.link = link
+        self.timeout = timeout
+        self.next_id = 1
+        self.partial = {}
+        self.done = {}
+        self.errors = 0         # frames out of order or with an unexpected header
+
+    def legacy(self, rtype, args=b'', response=True):
+        """The response follows the request right away, every frame is acknowledged by echoing the type."""
+        self.link.xfer(bytes([0xCA, LEGACY, rtype]) + args)
+        if not response:
+            return b''
+        data = bytearray()
+        while True:
+            rx = self.link.xfer(bytes([0xCA, LEGACY, rtype]))
+            ca, framing, t, remaining = LEGACY_HEADER.unpack_from(rx)
+            if (ca, framing, t) != (0xCA, LEGACY, rtype):
+                raise ProtocolError('legacy frame %02x %02x type %02x' % (ca, framing, t))
+            n = min(remaining, FRAME - LEGACY_HEADER.size)
+            data += rx[LEGACY_HEADER.size:LEGACY_HEADER.size + n]
+            if remaining <= FRAME - LEGACY_HEADER.size:
+                return bytes(data)
+
+    def submit(self, rtype, args=b'', rid=None):
+        if rid is None:
+            rid = self.next_id
+            self.next_id = self.next_id % 0xFFFF + 1
+        self.collect(self.link.xfer(TAGGED_REQUEST.pack(0xCA, TAGGED, rtype, rid) + args))
+        return rid
+
+    def poll(self):
+        self.collect(self.link.xfer(TAGGED_REQUEST.pack(0xCA, TAGGED, POLL, 0)))
+
+    def collect(self, rx):
+        if len(rx) < TAGGED_HEADER.size:
+            return
+        ca, framing, t, rid, status, length, offset = TAGGED_HEADER.unpack_from(rx)
+        if (ca, framing) != (0xCA, TAGGED):
+            return
+        if t == POLL and rid == 0:
+            return
+        r = self.partial.get(rid)
+        if r is None:
+            if offset != 0:
+                self.errors += 1
+                return
+            r = self.partial[rid] = Response(t, status, length)
+        if offset < r.received:
+            return                              # repeated after a transaction the slave did not accept
+        if offset != r.received or t != r.type:
+            self.errors += 1
+            return
+        n = min(length - offset, FRAME - TAGGED_HEADER.size)
+        r.data[offset:offset + n] = rx[TAGGED_HEADER.size:TAGGED_HEADER.size + n]
+        r.received = offset + n
+        r.status = status
+        if r.received >= length:
+            # a stream that ended early shrinks the total length
+            del r.data[length:]
+            self.done[rid] = self.partial.pop(rid)
+
+    def wait(self, rid, timeout=None):
+        deadline = time.monotonic() + (timeout or self.timeout)
+        while rid not in self.done:
+            if time.monotonic() > deadline:
+                raise ProtocolError('no response to id %d' % rid)
+            self.poll()
+        return self.done.pop(rid)
+
+    def request(self, rtype, args=b'', timeout=None):
+        return self.wait(self.submit(rtype, args), timeout)
+
+    def drain(self, quiet=4):
+        """Poll until a few idle frames in a row, pending responses are dropped."""
+        idle = 0
+        while idle < quiet:
+            before = len(self.done) + sum(r.received for r in self.partial.values())
+            self.poll()
+            idle = idle + 1 if len(self.done) + sum(r.received for r in self.partial.values()) == before else 0
+        self.done.clear()
+        self.partial.clear()
+
+
+def pack_args(name, values, raw):
+    if raw is not None:
+        return bytes.fromhex(raw)
+    fmt = COMMANDS[name][2] if name in COMMANDS else ''
+    if fmt is None:
+        sys.exit('%s takes its arguments with --raw' % name)
+    if not fmt:
+        return b''
+    count = len(fmt.lstrip('<'))
+    values = (list(values) + [0] * count)[:count]
+    return struct.pack(fmt, *values)
+
+
+def resolve(name):
+    if name in COMMANDS:
+        return name, COMMANDS[name][0]
+    return None, int(name, 0)
+
+
+def cmd_request(master, args):
+    name, rtype = resolve(args.name)
+    payload = pack_args(name, [int(v, 0) for v in args.values], args.raw)
+    if args.legacy:
+        has_response = COMMANDS[name][1] if name else True
+        data, status = master.legacy(rtype, payload, has_response), 'ok'
+    else:
+        r = master.request(rtype, payload)
+        data, status = bytes(r.data), STATUS.get(r.status, r.status)
+    if args.output:
+        with open(args.output, 'wb') as f:
+            f.write(data)
+        print('%s, %d bytes written to %s' % (status, len(data), args.output))
+    else:
+        print('status %s, %d bytes' % (status, len(data)))
+        if data:
+            print(data.decode('utf-8', 'replace'))
+    return 0
+
+
+def random_args(rng, name):
+    # reset flags stay 0, queries without arguments get random bytes they must ignore
+    if name in ('GetTaskLatency', 'GetLoopbackStats', 'GetMicStreamStats', 'GetApllLockStats'):
+        return b'\0'
+    if name == 'GetGlitchEvents':
+        return struct.pack('<I', rng.getrandbits(32))
+    return bytes(rng.getrandbits(8) for _ in range(rng.randrange(0, 64)))
+
+
+def fuzz_cases(master, rng):
+    link = master.link
+    known = {c[0] for c in COMMANDS.values()} | {POLL}
+
+    def garbage():
+        link.xfer(bytes(rng.getrandbits(8) for _ in range(FRAME)))
+
+    def bad_fingerprint():
+        link.xfer(bytes([rng.choice((0xCA, rng.getrandbits(8))), rng.choice((0x00, 0xFF, 0xFC, 0xCA))]) +
+                  bytes(rng.getrandbits(8) for _ in range(16)))
+
+    def short_transaction():
+        link.xfer(TAGGED_REQUEST.pack(0xCA, TAGGED, 0x30, 1), short=rng.randrange(1, FRAME))
+
+    def unknown_type():
+        rtype = rng.choice([t for t in range(1, 256) if t not in known])
+        r = master.request(rtype)
+        if r.status != 1:
+            raise ProtocolError('type 0x%02x answered with status %s' % (rtype, r.status))
+
+    def random_query():
+        name = rng.choice(SAFE_QUERIES)
+        master.request(COMMANDS[name][0], random_args(rng, name))
+
+    def flood():
+        ids = [master.submit(COMMANDS['GetDynamics'][0]) for _ in range(3 * API_QUEUE_LEN)]
+        statuses = [master.wait(i).status for i in ids]
+        if any(s not in (0, 2) for s in statuses):
+            raise ProtocolError('flood statuses %s' % statuses)
+
+    def legacy_behind_flood():
+        # multi frame responses pile up unread, then a legacy request must still get through
+        ids = [master.submit(COMMANDS['GetGlitchEvents'][0], struct.pack('<I', 0)) for _ in range(3 * API_QUEUE_LEN)]
+        json.loads(master.legacy(COMMANDS['GetLatency'][0]))
+        statuses = [master.wait(i).status for i in ids]
+        if any(s not in (0, 2) for s in statuses):
+            raise ProtocolError('flood statuses %s' % statuses)
+
+    def duplicate_ids():
+        rid = rng.randrange(1, 0x10000)
+        master.submit(COMMANDS['GetLatency'][0], rid=rid)
+        master.submit(COMMANDS['GetLatency'][0], rid=rid)
+        master.drain()
+
+    def legacy_broken_ack():
+        # a new request instead of the acknowledgement, the slave takes it as the next request
+        link.xfer(bytes([0xCA, LEGACY, COMMANDS['GetFirmwareInfo'][0]]))
+        master.request(COMMANDS['GetLatency'][0])
+        master.drain()
+
+    def legacy_roundtrip():
+        data = master.legacy(COMMANDS['GetLatency'][0])
+        json.loads(data)
+
+    return [garbage, bad_fingerprint, short_transaction, unknown_type, random_query, flood, legacy_behind_flood,
+            duplicate_ids, legacy_broken_ack, legacy_roundtrip]
+
+
+def cmd_fuzz(master, args):
+    rng = random.Random(args.seed)
+    cases = fuzz_cases(master, rng)
+    results = {c.__name__: {'runs': 0, 'failures': 0} for c in cases}
+    failures = 0
+    for i in range(args.rounds):
+        case = rng.choice(cases)
+        res = results[case.__name__]
+        res['runs'] += 1
+        try:
+            case()
+            master.drain()
+            # the link must still answer a plain query
+            r = master.request(COMMANDS['GetFirmwareInfo'][0])
+            json.loads(r.data)
+        except (ProtocolError, ValueError) as e:
+            res['failures'] += 1
+            failures += 1
+            print('round %d %s: %s' % (i, case.__name__, e), file=sys.stderr)
+            master.drain()
+    for name, res in results.items():
+        print('%-20s %5d runs %5d failures' % (name, res['runs'], res['failures']))
+    print('%d transactions, %d out of order frames' % (master.link.transactions, master.errors))
+    return 1 if failures or master.errors else 0
+
+
+def percentile(values, p):
+    values = sorted(values)
+    return values[min(len(values) - 1, int(p / 100.0 * len(values)))] if values else 0
+
+
+def summarize(latencies, nbytes, elapsed, transactions):
+    return {
+        'requests': len(latencies),
+        'requests_per_s': round(len(latencies) / elapsed, 1),
+        'bytes_per_s': round(nbytes / elapsed, 1),
+        'transactions_per_request': round(transactions / max(1, len(latencies)), 2),
+        'latency_us': {p: round(percentile(latencies, int(p[1:])) * 1e6) for p in ('p50', 'p90', 'p99')} |
+                      {'max': round(max(latencies) * 1e6) if latencies else 0},
+    }
+
+
+def bench_query(master, name, count):
+    rtype = COMMANDS[name][0]
+    args = pack_args(name, [], None)
+    latencies = []
+    nbytes = 0
+    start_transactions = master.link.transactions
+    start = time.perf_counter()
+    for _ in range(count):
+        t0 = time.perf_counter()
+        r = master.request(rtype, args)
+        latencies.append(time.perf_counter() - t0)
+        nbytes += len(r.data)
+    return summarize(latencies, nbytes, time.perf_counter() - start, master.link.transactions - start_transactions)
+
+
+def bench_under_download(master, count, length):
+    """Quick queries while a ReadRecorder download runs, the download keeps the other frames busy."""
+    info = json.loads(master.request(COMMANDS['GetRecorderInfo'][0]).data)
+    if not info.get('frozen'):
+        raise ProtocolError('the flight recorder is not frozen, send TriggerRecorder first')
+    read = COMMANDS['ReadRecorder'][0]
+    download = master.submit(read, struct.pack('<BII', 0, 0, length))
+    latencies = []
+    start = time.perf_counter()
+    for _ in range(count):
+        t0 = time.perf_counter()
+        master.request(COMMANDS['GetLatency'][0])
+        latencies.append(time.perf_counter() - t0)
+        if download in master.done:
+            master.done.pop(download)
+            download = master.submit(read, struct.pack('<BII', 0, 0, length))
+    result = summarize(latencies, 0, time.perf_counter() - start, 0)
+    master.drain()
+    return result
+
+
+def cmd_bench(master, args):
+    names = args.commands.split(',') if args.commands else SAFE_QUERIES
+    results = {}
+    for name in names:
+        if name not in COMMANDS or not COMMANDS[name][1]:
+            sys.exit('%s is not a query' % name)
+        results[name] = bench_query(master, name, args.count)
+    if args.under_download:
+        results['GetLatency during ReadRecorder'] = bench_under_download(master, args.count, args.under_download)
+    report = {'speed_hz': args.speed, 'frame': FRAME, 'count': args.count, 'results': results}
+    if args.json:
+        json.dump(report, sys.stdout, indent=2)
+        print()
+        return 0
+    print('%-32s %9s %11s %6s %8s %8s %8s' % ('request', 'req/s', 'bytes/s', 'xfers', 'p50 us', 'p99 us', 'max us'))
+    for name, r in results.items():
+        lat = r['latency_us']
+        print('%-32s %9.1f %11.1f %6.2f %8d %8d %8d' % (name, r['requests_per_s'], r['bytes_per_s'],
+                                                        r['transactions_per_request'], lat['p50'], lat['p99'], lat['max']))
+    return 0
+
+
+def compare_kernels(old, new, threshold, out=sys.stdout):
+    """Print ns/frame of both reports per kernel, returns the kernels slower by more than threshold percent."""
+    if old.get('seed') != new.get('seed') or old.get('cpu_mhz') != new.get('cpu_mhz'):
+        print('warning: seed %s at %s MHz vs seed %s at %s MHz' % (
+            old.get('seed'), old.get('cpu_mhz'), new.get('seed'), new.get('cpu_mhz')), file=out)
+    print('%-24s %12s %12s %8s' % ('kernel', 'old ns/frame', 'new ns/frame', 'change'), file=out)
+    regressions = []
+    for name, r in new['kernels'].items():
+        if name not in old['kernels']:
+            print('%-24s %12s %12.2f %8s' % (name, '-', r['ns_per_frame'], 'new'), file=out)
+            continue
+        before = old['kernels'][name]['ns_per_frame']
+        change = (r['ns_per_frame'] - before) * 100.0 / before if before else 0.0
+        flag = ''
+        if change > threshold:
+            regressions.append(name)
+            flag = '  REGRESSION'
+        print('%-24s %12.2f %12.2f %+7.1f%%%s' % (name, before, r['ns_per_frame'], change, flag), file=out)
+    return regressions
+
+
+def print_kernels(report):
+    print('%d MHz, %d iterations, seed %d' % (report['cpu_mhz'], report['iterations'], report['seed']))
+    print('%-24s %7s %10s %10s %14s' % ('kernel', 'frames', 'ns/frame', 'mean', 'bytes/s'))
+    for name, r in report['kernels'].items():
+        print('%-24s %7d %10.2f %10.2f %14.0f' % (name, r['frames'], r['ns_per_frame'], r['ns_per_frame_mean'],
+                                                 r['bytes_per_s']))
+
+
+def cmd_kernels(master, args):
+    # the target is blocked for the whole run, a few seconds at the most iterations
+    r = master.request(COMMANDS['RunBenchmark'][0], struct.pack('<HI', args.iterations, args.seed),
+                       max(args.timeout, 30.0))
+    if r.status != 0:
+        sys.exit('RunBenchmark %s, is CONFIG_UAC_BENCHMARK enabled?' % STATUS.get(r.status, r.status))
+    report = json.loads(bytes(r.data))
+    if args.json:
+        json.dump(report, sys.stdout, indent=2)
+        print()
+    elif not args.baseline:
+        print_kernels(report)
+    if args.baseline:
+        with open(args.baseline) as f:
+            baseline = json.load(f)
+        # the table goes to stderr so --json output stays parseable
+        regressions = compare_kernels(baseline, report, args.threshold, sys.stderr if args.json else sys.stdout)
+        return 1 if regressions else 0
+    return 0
+
+
+def cmd_compare(args):
+    with open(args.old) as f:
+        old = json.load(f)
+    with open(args.new) as f:
+        new = json.load(f)
+    return 1 if compare_kernels(old, new, args.threshold) else 0
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('--bus', type=int, default=0)
+    parser.add_argument('--device', type=int, default=0)
+    parser.add_argument('--speed', type=int, default=10000000, help='SPI clock in Hz')
+    parser.add_argument('--handshake', help='handshake input as CHIP:LINE, e.g. gpiochip0:25')
+    parser.add_argument('--sim', metavar='PATH', help='host simulator of the slave in place of spidev')
+    parser.add_argument('--gap-us', type=int, default=200, help='pause between transactions without handshake')
+    parser.add_argument('--timeout', type=float, default=2.0, help='seconds to wait for a response')
+    sub = parser.add_subparsers(dest='cmd', required=True)
+    p = sub.add_parser('request')
+    p.add_argument('name')
+    p.add_argument('values', nargs='*')
+    p.add_argument('--raw')
+    p.add_argument('--legacy', action='store_true')
+    p.add_argument('-o', '--output')
+    p = sub.add_parser('fuzz')
+    p.add_argument('--rounds', type=int, default=100)
+    p.add_argument('--seed', type=int, default=0)
+    p = sub.add_parser('bench')
+    p.add_argument('--count', type=int, default=200)
+    p.add_argument('--commands', help='comma separated queries, default all side effect free ones')
+    p.add_argument('--under-download', type=int, metavar='BYTES', default=0)
+    p.add_argument('--json', action='store_true')
+    p = sub.add_parser('kernels')
+    p.add_argument('--iterations', type=int, default=200, help='calls per kernel, at most 65535')
+    p.add_argument('--seed', type=int, default=1)
+    p.add_argument('--baseline', help='earlier --json report to compare against')
+    p.add_argument('--threshold', type=float, default=5.0, help='percent slower that counts as a regression')
+    p.add_argument('--json', action='store_true')
+    p = sub.add_parser('compare')
+    p.add_argument('old')
+    p.add_argument('new')
+    p.add_argument('--threshold', type=float, default=5.0, help='percent slower that counts as a regression')
+    args = parser.parse_args()
+
+    if args.cmd == 'compare':
+        return cmd_compare(args)
+    if args.sim:
+        link = SimLink(args.sim, args.gap_us, args.timeout)
+    else:
+        link = Link(args.bus, args.device, args.speed, args.handshake, args.gap_us, args.timeout)
+    master = Master(link, args.timeout)
+    try:
+        if args.cmd == 'request':
+            return cmd_request(master, args)
+        if args.cmd == 'fuzz':
+            return cmd_fuzz(master, args)
+        if args.cmd == 'kernels':
+            return cmd_kernels(master, args)
+        return cmd_bench(master, args)
+    except ProtocolError as e:
+        sys.exit(str(e))
+
+
+if __name__ == '__main__':
+    sys.exit(main())
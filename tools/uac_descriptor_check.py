@@ -0,0 +1,369 @@
+#!/usr/bin/env python3
+# SPDX-FileCopyrightText: 2025 Espressif Systems (Shanghai) CO LTD
+#
+# SPDX-License-Identifier: Apache-2.0
+"""
+Parse the UAC2 configuration descriptor back and check it against the spec and the sizing rules of
+tusb_config_uac.h.
+
+  check FILE      a raw configuration descriptor, or a Linux sysfs 'descriptors' file
+                  (/sys/bus/usb/devices/<dev>/descriptors, device descriptor first)
+  check --device  read it from the device, needs pyusb
+
+Checked: descriptor lengths and wTotalLength of the configuration and the AC header, the IAD, the entity
+graph (unique IDs, sources, clocks, feature unit controls per channel), every streaming alternate setting
+(terminal link, Type I format, data and feedback endpoints) and that wMaxPacketSize of every data endpoint is
+exactly the largest packet of its alternate setting: the frames of one service interval at the highest rate
+rounded up, plus one for the clock drift, times channels and subslot size. Less cannot carry the stream, more
+reserves isochronous bandwidth nobody uses.
+
+Usage: uac_descriptor_check.py check descriptors --rate 48000
+       uac_descriptor_check.py check --device -v
+"""
+
+import argparse
+import struct
+import sys
+
+DESC_DEVICE = 0x01
+DESC_CONFIGURATION = 0x02
+DESC_INTERFACE = 0x04
+DESC_ENDPOINT = 0x05
+DESC_IAD = 0x0B
+DESC_CS_INTERFACE = 0x24
+DESC_CS_ENDPOINT = 0x25
+
+CLASS_AUDIO = 0x01
+SUBCLASS_CONTROL = 0x01
+SUBCLASS_STREAMING = 0x02
+PROTOCOL_V2 = 0x20
+
+AC_HEADER = 0x01
+AC_INPUT_TERMINAL = 0x02
+AC_OUTPUT_TERMINAL = 0x03
+AC_MIXER_UNIT = 0x04
+AC_FEATURE_UNIT = 0x06
+AC_CLOCK_SOURCE = 0x0A
+AS_GENERAL = 0x01
+AS_FORMAT_TYPE = 0x02
+FORMAT_TYPE_I = 0x01
+TERM_USB_STREAMING = 0x0101
+
+# fixed lengths, the variable ones are checked where they are parsed
+FIXED_LEN = {
+    DESC_CONFIGURATION: 9, DESC_INTERFACE: 9, DESC_ENDPOINT: 7, DESC_IAD: 8,
+    (DESC_CS_INTERFACE, SUBCLASS_CONTROL, AC_HEADER): 9,
+    (DESC_CS_INTERFACE, SUBCLASS_CONTROL, AC_INPUT_TERMINAL): 17,
+    (DESC_CS_INTERFACE, SUBCLASS_CONTROL, AC_OUTPUT_TERMINAL): 12,
+    (DESC_CS_INTERFACE, SUBCLASS_CONTROL, AC_CLOCK_SOURCE): 8,
+    (DESC_CS_INTERFACE, SUBCLASS_STREAMING, AS_GENERAL): 16,
+    (DESC_CS_INTERFACE, SUBCLASS_STREAMING, AS_FORMAT_TYPE): 6,
+    DESC_CS_ENDPOINT: 8,
+}
+
+# bytes a high-speed bus can schedule for periodic transfers in one microframe (80 % of 7500)
+HS_PERIODIC_BYTES = 6000
+FS_PERIODIC_BYTES = 1350
+
+
+class Checker:
+    def __init__(self, verbose):
+        self.verbose = verbose
+        self.errors = 0
+        self.warnings = 0
+
+    def error(self, msg):
+        self.errors += 1
+        print('ERROR   ' + msg)
+
+    def warn(self, msg):
+        self.warnings += 1
+        print('WARNING ' + msg)
+
+    def info(self, msg):
+        if self.verbose:
+            print('        ' + msg)
+
+
+def split_descriptors(data, chk):
+    out = []
+    pos = 0
+    while pos < len(data):
+        length = data[pos]
+        if length < 2 or pos + length > len(data):
+            chk.error('descriptor at offset %d has bLength %d, %d bytes left' % (pos, length, len(data) - pos))
+            break
+        out.append((pos, data[pos:pos + length]))
+        pos += length
+    return out
+
+
+def expected_packet(rate, channels, subslot, b_interval, high_speed):
+    """Largest packet of one service interval, as sized by UAC_EP_SZ."""
+    per_second = (8000 if high_speed else 1000) // (1 << (b_interval - 1))
+    frames = -(-rate // per_second) + 1
+    return frames * channels * subslot
+
+
+def packet_bytes(w_max_packet, high_speed):
+    size = w_max_packet & 0x7FF
+    return size * (1 + ((w_max_packet >> 11) & 3)) if high_speed else size
+
+
+def check(data, rate, high_speed, chk):
+    if len(data) >= 18 and data[0] == 18 and data[1] == DESC_DEVICE:
+        data = data[18:]
+    descs = split_descriptors(data, chk)
+    if not descs or descs[0][1][1] != DESC_CONFIGURATION:
+        chk.error('no configuration descriptor')
+        return
+    cfg = descs[0][1]
+    total, n_itf = struct.unpack_from('<HB', cfg, 2)
+    if total != len(data):
+        chk.error('wTotalLength %d, the descriptor is %d bytes' % (total, len(data)))
+    chk.info('configuration: %d bytes, %d interfaces' % (total, n_itf))
+
+    itf_numbers = set()
+    iad = None
+    entities = {}
+    ac_header = None
+    ac_len = 0
+    cur = None                  # (interface, alt, subclass)
+    alts = []                   # streaming alternate settings
+    for pos, d in descs[1:]:
+        dtype = d[1]
+        key = dtype
+        if dtype == DESC_CS_INTERFACE and cur is not None and len(d) > 2:
+            key = (dtype, cur[2], d[2])
+        want = FIXED_LEN.get(key)
+        if want is not None and len(d) != want:
+            chk.error('offset %d: descriptor %s is %d bytes, expected %d' % (pos, key, len(d), want))
+            continue
+
+        if dtype == DESC_IAD:
+            iad = d
+        elif dtype == DESC_INTERFACE:
+            num, alt, n_ep, cls, sub, proto = struct.unpack_from('<BBBBBB', d, 2)
+            itf_numbers.add(num)
+            cur = (num, alt, sub)
+            if cls == CLASS_AUDIO and proto != PROTOCOL_V2:
+                chk.error('interface %d alt %d: protocol 0x%02x is not UAC2' % (num, alt, proto))
+            if cls == CLASS_AUDIO and sub == SUBCLASS_STREAMING:
+                alts.append({'itf': num, 'alt': alt, 'n_ep': n_ep, 'eps': [], 'general': None, 'format': None})
+        elif dtype == DESC_CS_INTERFACE and cur and cur[2] == SUBCLASS_CONTROL:
+            sub = d[2]
+            if sub == AC_HEADER:
+                ac_header = d
+                continue
+            ac_len += len(d)
+            eid = d[3]
+            if eid in entities:
+                chk.error('entity %d defined twice' % eid)
+            if sub == AC_CLOCK_SOURCE:
+                entities[eid] = {'kind': 'clock'}
+            elif sub == AC_INPUT_TERMINAL:
+                ttype, _, clk, nch = struct.unpack_from('<HBBB', d, 4)
+                entities[eid] = {'kind': 'it', 'type': ttype, 'clock': clk, 'channels': nch}
+            elif sub == AC_OUTPUT_TERMINAL:
+                ttype, _, src, clk = struct.unpack_from('<HBBB', d, 4)
+                entities[eid] = {'kind': 'ot', 'type': ttype, 'clock': clk, 'sources': [src]}
+            elif sub == AC_FEATURE_UNIT:
+                entities[eid] = {'kind': 'fu', 'sources': [d[4]], 'length': len(d)}
+            elif sub == AC_MIXER_UNIT:
+                n_pins = d[4]
+                srcs = list(d[5:5 + n_pins])
+                nch = d[5 + n_pins]
+                # bmMixerControls holds one bit per input channel x output channel crosspoint
+                entities[eid] = {'kind': 'mu', 'sources': srcs, 'channels': nch, 'length': len(d)}
+            else:
+                entities[eid] = {'kind': 'unit 0x%02x' % sub, 'sources': []}
+        elif dtype == DESC_CS_INTERFACE and cur and cur[2] == SUBCLASS_STREAMING and alts:
+            if d[2] == AS_GENERAL:
+                term, _, ftype, formats, nch = struct.unpack_from('<BBBIB', d, 3)
+                alts[-1]['general'] = (term, ftype, formats, nch)
+            elif d[2] == AS_FORMAT_TYPE:
+                alts[-1]['format'] = (d[3], d[4], d[5])
+        elif dtype == DESC_ENDPOINT and alts and cur and cur[2] == SUBCLASS_STREAMING:
+            addr, attr, wmax, interval = struct.unpack_from('<BBHB', d, 2)
+            alts[-1]['eps'].append((addr, attr, wmax, interval))
+
+    if len(itf_numbers) != n_itf:
+        chk.error('bNumInterfaces %d, %d interfaces described' % (n_itf, len(itf_numbers)))
+
+    # audio control
+    if ac_header is None:
+        chk.error('no class-specific AC header')
+    else:
+        bcd, _, ac_total = struct.unpack_from('<HBH', ac_header, 3)
+        if bcd != 0x0200:
+            chk.error('bcdADC 0x%04x, expected 0x0200' % bcd)
+        if ac_total != ac_len + len(ac_header):
+            chk.error('AC header wTotalLength %d, the class-specific AC descriptors are %d bytes' %
+                      (ac_total, ac_len + len(ac_header)))
+    if iad is not None:
+        first, count = iad[2], iad[3]
+        audio_itfs = set(a['itf'] for a in alts)
+        if not audio_itfs <= set(range(first, first + count)):
+            chk.error('IAD covers interfaces %d..%d, streaming interfaces are %s' %
+                      (first, first + count - 1, sorted(audio_itfs)))
+    else:
+        chk.error('no interface association descriptor')
+
+    check_entities(entities, chk)
+    check_streaming(alts, entities, rate, high_speed, chk)
+
+
+def channels_of(eid, entities, depth=0):
+    e = entities.get(eid)
+    if e is None or depth > len(entities):
+        return None
+    if 'channels' in e:
+        return e['channels']
+    srcs = e.get('sources') or []
+    return channels_of(srcs[0], entities, depth + 1) if srcs else None
+
+
+def check_entities(entities, chk):
+    for eid, e in sorted(entities.items()):
+        for src in e.get('sources', []):
+            if src not in entities:
+                chk.error('entity %d (%s): source %d does not exist' % (eid, e['kind'], src))
+        clk = e.get('clock')
+        if clk is not None and entities.get(clk, {}).get('kind') != 'clock':
+            chk.error('entity %d (%s): clock %d is not a clock source' % (eid, e['kind'], clk))
+        if e['kind'] == 'fu':
+            nch = channels_of(e['sources'][0], entities)
+            if nch is not None and e['length'] != 6 + (nch + 1) * 4:
+                chk.error('feature unit %d: %d bytes, %d channels need %d (master + one control per channel)' %
+                          (eid, e['length'], nch, 6 + (nch + 1) * 4))
+            chk.info('feature unit %d: %s channels' % (eid, nch))
+        elif e['kind'] == 'mu':
+            n_in = sum(channels_of(s, entities) or 0 for s in e['sources'])
+            ctrl_bytes = (n_in * e['channels'] + 7) // 8
+            if e['length'] != 13 + len(e['sources']) + ctrl_bytes:
+                chk.error('mixer unit %d: %d bytes, %d x %d crosspoints need %d' %
+                          (eid, e['length'], n_in, e['channels'], 13 + len(e['sources']) + ctrl_bytes))
+            chk.info('mixer unit %d: %d inputs to %d channels' % (eid, n_in, e['channels']))
+        else:
+            chk.info('entity %d: %s' % (eid, e['kind']))
+
+
+def check_streaming(alts, entities, rate, high_speed, chk):
+    per_frame = {}
+    for a in alts:
+        name = 'interface %d alt %d' % (a['itf'], a['alt'])
+        if a['alt'] == 0:
+            if a['n_ep'] or a['eps']:
+                chk.error('%s: the default alternate setting must not have endpoints' % name)
+            continue
+        if len(a['eps']) != a['n_ep']:
+            chk.error('%s: bNumEndpoints %d, %d endpoints described' % (name, a['n_ep'], len(a['eps'])))
+        if a['general'] is None or a['format'] is None:
+            chk.error('%s: class-specific AS interface or format descriptor missing' % name)
+            continue
+        term, ftype, formats, nch = a['general']
+        t = entities.get(term)
+        if t is None or t['kind'] not in ('it', 'ot') or t['type'] != TERM_USB_STREAMING:
+            chk.error('%s: bTerminalLink %d is not a USB streaming terminal' % (name, term))
+        elif channels_of(term, entities) not in (None, nch):
+            chk.error('%s: %d channels, the terminal carries %d' % (name, nch, channels_of(term, entities)))
+        fmt_type, subslot, bits = a['format']
+        if ftype != FORMAT_TYPE_I or fmt_type != FORMAT_TYPE_I:
+            chk.warn('%s: not a Type I format, packet size not checked' % name)
+            continue
+        if subslot not in (1, 2, 3, 4) or bits > subslot * 8:
+            chk.error('%s: %d-bit resolution in %d byte subslots' % (name, bits, subslot))
+
+        data_eps = [e for e in a['eps'] if (e[1] & 0x30) == 0x00]
+        fb_eps = [e for e in a['eps'] if (e[1] & 0x30) == 0x10]
+        if len(data_eps) != 1:
+            chk.error('%s: %d data endpoints' % (name, len(data_eps)))
+            continue
+        addr, attr, wmax, interval = data_eps[0]
+        if attr & 0x03 != 0x01:
+            chk.error('%s: data endpoint 0x%02x is not isochronous' % (name, addr))
+        if not 1 <= interval <= 16:
+            chk.error('%s: bInterval %d out of range' % (name, interval))
+            continue
+        size = packet_bytes(wmax, high_speed)
+        want = expected_packet(rate, nch, subslot, interval, high_speed)
+        if size < want:
+            chk.error('%s: wMaxPacketSize %d, %d needed for %d ch x %d bytes at %d Hz' %
+                      (name, size, want, nch, subslot, rate))
+        elif size > want:
+            chk.error('%s: wMaxPacketSize %d reserves %d bytes more than the %d needed' %
+                      (name, size, size - want, want))
+        if (wmax & 0x7FF) > (1024 if high_speed else 1023):
+            chk.error('%s: %d bytes per transaction exceed the isochronous limit' % (name, wmax & 0x7FF))
+
+        sync = attr & 0x0C
+        if addr & 0x80 == 0 and sync == 0x04:
+            if len(fb_eps) != 1:
+                chk.error('%s: asynchronous OUT endpoint without an explicit feedback endpoint' % name)
+            else:
+                fb_addr, _, fb_size, fb_interval = fb_eps[0]
+                if fb_addr & 0x80 == 0:
+                    chk.error('%s: feedback endpoint 0x%02x is not IN' % (name, fb_addr))
+                if fb_size & 0x7FF not in ((4,) if high_speed else (3, 4)):
+                    chk.error('%s: feedback endpoint of %d bytes' % (name, fb_size & 0x7FF))
+                elif not high_speed and fb_size & 0x7FF == 4:
+                    chk.warn('%s: 4 byte feedback at full speed, the spec asks for 10.14 in 3 bytes' % name)
+                if fb_interval != interval:
+                    chk.warn('%s: feedback every %d, data every %d' % (name, fb_interval, interval))
+        per_sec = (8000 if high_speed else 1000) // (1 << (interval - 1))
+        print('%s: %d ch x %d bytes (%d-bit), EP 0x%02x %d bytes every %s, %d bytes/s reserved' %
+              (name, nch, subslot, bits, addr, size,
+               '%d us' % (1000000 // per_sec), size * per_sec))
+        per_frame[a['itf']] = max(per_frame.get(a['itf'], 0), size + sum(e[2] & 0x7FF for e in fb_eps))
+
+    # worst case: every streaming interface on its largest alternate setting in the same (micro)frame
+    worst = sum(per_frame.values())
+    limit = HS_PERIODIC_BYTES if high_speed else FS_PERIODIC_BYTES
+    print('all interfaces streaming: %d bytes per %s, %d%% of the periodic bandwidth' %
+          (worst, 'microframe' if high_speed else 'frame', 100 * worst // limit))
+    if worst > limit:
+        chk.error('the streaming interfaces cannot be scheduled together')
+
+
+def read_device(vid, pid):
+    import usb.core
+    import usb.util
+    dev = usb.core.find(idVendor=vid, idProduct=pid)
+    if dev is None:
+        sys.exit('device %04x:%04x not found' % (vid, pid))
+    head = bytes(dev.ctrl_transfer(0x80, 0x06, DESC_CONFIGURATION << 8, 0, 9))
+    total = struct.unpack_from('<H', head, 2)[0]
+    data = bytes(dev.ctrl_transfer(0x80, 0x06, DESC_CONFIGURATION << 8, 0, total))
+    return data, dev.speed == usb.util.SPEED_HIGH
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('--vid', type=lambda v: int(v, 0), default=0x303A)
+    parser.add_argument('--pid', type=lambda v: int(v, 0), default=0x8000)
+    sub = parser.add_subparsers(dest='cmd', required=True)
+    p = sub.add_parser('check')
+    p.add_argument('file', nargs='?')
+    p.add_argument('--device', action='store_true', help='read the descriptor from the device')
+    p.add_argument('--rate', type=int, action='append',
+                   help='sample rates the clock offers, the highest sizes the endpoints (default 48000)')
+    p.add_argument('--full-speed', action='store_true', help='the file was taken from a full-speed device')
+    p.add_argument('-v', '--verbose', action='store_true')
+    args = parser.parse_args()
+
+    if args.device:
+        data, high_speed = read_device(args.vid, args.pid)
+    elif args.file:
+        with open(args.file, 'rb') as f:
+            data = f.read()
+        high_speed = not args.full_speed
+    else:
+        parser.error('give a descriptor file or --device')
+    chk = Checker(args.verbose)
+    check(data, max(args.rate or [48000]), high_speed, chk)
+    print('%d errors, %d warnings' % (chk.errors, chk.warnings))
+    return 1 if chk.errors else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,159 @@
+#!/usr/bin/env python3
+# SPDX-FileCopyrightText: 2025 Espressif Systems (Shanghai) CO LTD
+#
+# SPDX-License-Identifier: Apache-2.0
+"""
+Drive and check the USB digital loopback (uac_device_set_loopback).
+
+  set MODE        switch the loopback through the vendor request, 0 off, 1 on, 2 CRC tagged
+  stats           read the device statistics, --reset starts a new measurement
+  check IN.wav    verify a capture taken while the loopback was on:
+                  the CRC32 tag in the last frame of every millisecond (mode 2), and with
+                  --sent OUT.wav that every other frame matches what was played bit for bit
+
+The set and stats commands need pyusb and access to the device, check only reads WAV files.
+
+Usage: uac_loopback_check.py set 2
+       uac_loopback_check.py check capture.wav --sent played.wav
+"""
+
+import argparse
+import struct
+import sys
+import wave
+import zlib
+
+VENDOR_REQ_LOOPBACK = 0x4C
+# keep in sync with uac_loopback_stats_t
+STATS = struct.Struct('<9I')
+STATS_FIELDS = ('mode', 'blocks', 'bytes', 'underruns', 'overruns', 'format_mismatch',
+                'latency_mean_us', 'latency_max_us', 'jitter_max_us')
+
+
+def open_device(vid, pid):
+    import usb.core
+    dev = usb.core.find(idVendor=vid, idProduct=pid)
+    if dev is None:
+        sys.exit('device %04x:%04x not found' % (vid, pid))
+    return dev
+
+
+def cmd_set(args):
+    dev = open_device(args.vid, args.pid)
+    # host to device, vendor, device recipient
+    dev.ctrl_transfer(0x40, VENDOR_REQ_LOOPBACK, args.mode, 0)
+
+
+def cmd_stats(args):
+    dev = open_device(args.vid, args.pid)
+    data = dev.ctrl_transfer(0xC0, VENDOR_REQ_LOOPBACK, 1 if args.reset else 0, 0, STATS.size)
+    for name, value in zip(STATS_FIELDS, STATS.unpack(bytes(data))):
+        print('%-16s %u' % (name, value))
+
+
+def read_frames(path):
+    with wave.open(path, 'rb') as w:
+        frame = w.getnchannels() * w.getsampwidth()
+        data = w.readframes(w.getnframes())
+        return w.getframerate(), frame, data
+
+
+def check_tags(data, frame, unit):
+    """Find the millisecond alignment with the most valid tags, return (offset, good, bad)."""
+    tag_len = min(frame, 4)
+    best = (0, 0, 0)
+    for offset in range(0, unit, frame):
+        good = bad = 0
+        for pos in range(offset, len(data) - unit + 1, unit):
+            chunk = data[pos:pos + unit]
+            crc = struct.pack('<I', zlib.crc32(chunk[:-frame]))[:tag_len]
+            tag = chunk[-frame:]
+            if tag[:tag_len] == crc and not any(tag[tag_len:]):
+                good += 1
+            elif any(chunk):
+                bad += 1
+        if good > best[1]:
+            best = (offset, good, bad)
+    return best
+
+
+def check_sent(data, sent, frame, unit, tagged, tag_offset):
+    """Locate the capture in the played stream and compare frame by frame, skipping the tags."""
+    if tagged:
+        # search with the untagged part of the first millisecond that carries audio
+        start = next((i for i in range(tag_offset, len(data) - unit + 1, unit) if any(data[i:i + unit - frame])), None)
+        length = unit - frame
+    else:
+        start = next((i for i in range(0, len(data), frame) if any(data[i:i + frame])), None)
+        length = 16 * frame
+    if start is None:
+        return None, 0, 0
+    probe = data[start:start + length]
+    at = sent.find(probe)
+    while at != -1 and at % frame:
+        at = sent.find(probe, at + 1)
+    if at == -1:
+        return None, 0, 0
+    good = bad = 0
+    for i in range(start, len(data) - frame + 1, frame):
+        j = at + i - start
+        if j + frame > len(sent):
+            break
+        if tagged and (i - tag_offset) % unit == unit - frame:
+            continue
+        if data[i:i + frame] == sent[j:j + frame]:
+            good += 1
+        else:
+            bad += 1
+    return at // frame, good, bad
+
+
+def cmd_check(args):
+    rate, frame, data = read_frames(args.capture)
+    unit = rate // 1000 * frame
+    offset, good, bad = check_tags(data, frame, unit)
+    tagged = good > 0
+    if tagged:
+        print('CRC tags: %d valid, %d invalid (alignment %d frames)' % (good, bad, offset // frame))
+    else:
+        print('CRC tags: none found, assuming plain loopback')
+    ok = bad == 0
+    if args.sent:
+        sent_rate, sent_frame, sent = read_frames(args.sent)
+        if (sent_rate, sent_frame) != (rate, frame):
+            sys.exit('played and captured formats differ')
+        pos, same, diff = check_sent(data, sent, frame, unit, tagged, offset)
+        if pos is None:
+            print('capture not found in the played stream')
+            ok = False
+        else:
+            print('played stream at frame %d: %d frames identical, %d differ' % (pos, same, diff))
+            ok = ok and diff == 0
+    print('bit-perfect' if ok else 'NOT bit-perfect')
+    return 0 if ok else 1
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('--vid', type=lambda v: int(v, 0), default=0x303A)
+    parser.add_argument('--pid', type=lambda v: int(v, 0), default=0x8000)
+    sub = parser.add_subparsers(dest='cmd', required=True)
+    p = sub.add_parser('set')
+    p.add_argument('mode', type=int, choices=(0, 1, 2))
+    p = sub.add_parser('stats')
+    p.add_argument('--reset', action='store_true')
+    p = sub.add_parser('check')
+    p.add_argument('capture')
+    p.add_argument('--sent')
+    args = parser.parse_args()
+    if args.cmd == 'set':
+        cmd_set(args)
+    elif args.cmd == 'stats':
+        cmd_stats(args)
+    else:
+        return cmd_check(args)
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,139 @@
+#!/usr/bin/env python3
+# SPDX-FileCopyrightText: 2025 Espressif Systems (Shanghai) CO LTD
+#
+# SPDX-License-Identifier: Apache-2.0
+"""
+Convert a hot path trace dump (payload of the SPI GetTraceDump request, 0x3A) into
+Chrome trace JSON that can be opened in https://ui.perfetto.dev or chrome://tracing.
+
+Every core becomes a process and every trace point a thread, so spans of different
+tasks never have to nest. Cycle counts are converted to microseconds on the esp_timer
+time base with the per-core anchor taken when the dump was frozen.
+
+Usage: uac_trace_to_perfetto.py trace.bin [-o trace.json]
+"""
+
+import argparse
+import json
+import struct
+import sys
+
+DUMP_MAGIC = 0x43525455
+DUMP_VERSION = 1
+MAX_CORES = 2
+
+HEADER = struct.Struct('<IHHI')
+CORE_INFO = struct.Struct('<IqII')
+RECORD = struct.Struct('<IBBH')
+
+PHASE_BEGIN, PHASE_END, PHASE_INSTANT = range(3)
+
+# keep in sync with uac_trace_id_t
+TRACE_NAMES = {
+    0: 'tud_audio_rx_done_post_read_cb',
+    1: 'tud_audio_tx_done_pre_load_cb',
+    2: 'usb_spk_task',
+    3: 'usb_mic_task',
+    4: 'i2s_channel_read',
+    5: 'i2s_channel_write',
+    6: 'spi_api request',
+}
+USER_BASE = 32
+
+
+def trace_name(trace_id):
+    if trace_id in TRACE_NAMES:
+        return TRACE_NAMES[trace_id]
+    if trace_id >= USER_BASE:
+        return 'user_%d' % (trace_id - USER_BASE)
+    return 'id_%d' % trace_id
+
+
+def parse_dump(data):
+    magic, version, num_cores, cpu_hz = HEADER.unpack_from(data, 0)
+    if magic != DUMP_MAGIC:
+        raise ValueError('not a trace dump, magic 0x%08x' % magic)
+    if version != DUMP_VERSION:
+        raise ValueError('unsupported dump version %d' % version)
+    if cpu_hz == 0:
+        raise ValueError('cycle counter frequency missing')
+    cores = [CORE_INFO.unpack_from(data, HEADER.size + i * CORE_INFO.size) for i in range(MAX_CORES)]
+    offset = HEADER.size + MAX_CORES * CORE_INFO.size
+    result = []
+    for core in range(num_cores):
+        anchor_cycles, anchor_us, count, lost = cores[core]
+        if offset + count * RECORD.size > len(data):
+            raise ValueError('dump truncated in core %d' % core)
+        records = [RECORD.unpack_from(data, offset + i * RECORD.size) for i in range(count)]
+        offset += count * RECORD.size
+        result.append({'anchor_cycles': anchor_cycles, 'anchor_us': anchor_us, 'lost': lost, 'records': records})
+    return cpu_hz, result
+
+
+def unwrap(records, anchor_cycles, anchor_us, cpu_hz):
+    """
+    Time stamps in us. The 32-bit counter wraps every few seconds, so the records are walked
+    backwards from the anchor and the distance to the next record is accumulated. Small negative
+    steps come from a trace point that was interrupted between reading the counter and storing.
+    """
+    times = [0.0] * len(records)
+    later = anchor_cycles
+    elapsed = 0
+    for i in range(len(records) - 1, -1, -1):
+        step = (later - records[i][0]) & 0xFFFFFFFF
+        if step >= 0x80000000:
+            step -= 0x100000000
+        elapsed += step
+        later = records[i][0]
+        times[i] = anchor_us - elapsed * 1e6 / cpu_hz
+    return times
+
+
+def convert(data):
+    cpu_hz, cores = parse_dump(data)
+    events = []
+    for core, info in enumerate(cores):
+        events.append({'ph': 'M', 'name': 'process_name', 'pid': core, 'args': {'name': 'Core %d' % core}})
+        if info['lost']:
+            print('core %d: %d older records were overwritten' % (core, info['lost']), file=sys.stderr)
+        times = unwrap(info['records'], info['anchor_cycles'], info['anchor_us'], cpu_hz)
+        open_spans = {}
+        seen = set()
+        for (cycles, trace_id, phase, arg), ts in zip(info['records'], times):
+            if trace_id not in seen:
+                seen.add(trace_id)
+                events.append({'ph': 'M', 'name': 'thread_name', 'pid': core, 'tid': trace_id,
+                               'args': {'name': trace_name(trace_id)}})
+            if phase == PHASE_BEGIN:
+                open_spans[trace_id] = (ts, arg)
+            elif phase == PHASE_END:
+                if trace_id not in open_spans:
+                    # the begin record was overwritten or the span started on the other core
+                    continue
+                start, begin_arg = open_spans.pop(trace_id)
+                events.append({'ph': 'X', 'name': trace_name(trace_id), 'pid': core, 'tid': trace_id,
+                               'ts': start, 'dur': max(ts - start, 0.0),
+                               'args': {'begin': begin_arg, 'end': arg}})
+            else:
+                events.append({'ph': 'i', 's': 't', 'name': trace_name(trace_id), 'pid': core, 'tid': trace_id,
+                               'ts': ts, 'args': {'arg': arg}})
+    return {'traceEvents': events, 'displayTimeUnit': 'ns', 'otherData': {'cpu_hz': cpu_hz}}
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('dump', help='binary dump received for GetTraceDump')
+    parser.add_argument('-o', '--output', help='output JSON file, default: stdout')
+    args = parser.parse_args()
+
+    with open(args.dump, 'rb') as f:
+        trace = convert(f.read())
+    if args.output:
+        with open(args.output, 'w') as f:
+            json.dump(trace, f)
+    else:
+        json.dump(trace, sys.stdout)
+
+
+if __name__ == '__main__':
+    main()